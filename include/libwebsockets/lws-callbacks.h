@@ -843,13 +843,14 @@ enum lws_callback_reasons {
 	LWS_CALLBACK_MQTT_ACK					= 209,
 	/**< When a message is fully sent, if QoS0 this callback is generated
 	 * to locally "acknowledge" it.  For QoS1, this callback is only
-	 * generated when the matching PUBACK is received.  Return nonzero to
-	 * close the wsi.
+	 * generated when the matching PUBACK is received, len is the packet
+	 * ID of the PUBLISH it acknowledges.  Return nonzero to close the wsi.
 	 */
 	LWS_CALLBACK_MQTT_RESEND				= 210,
 	/**< In QoS1, this callback is generated instead of the _ACK one if
-	 * we timed out waiting for a PUBACK and we must resend the message.
-	 * Return nonzero to close the wsi.
+	 * we timed out waiting for a PUBACK and we must resend the message,
+	 * len is the packet ID of the PUBLISH concerned.  Return nonzero to
+	 * close the wsi.
 	 */
 
 	/****** add new things just above ---^ ******/
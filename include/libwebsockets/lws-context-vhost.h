@@ -731,6 +731,26 @@ struct lws_context_creation_info {
 	 * nonzero means connect via a tcp socket to the tcp address in
 	 * ss_proxy_bind and the given port */
 #endif
+	uint32_t h2_rx_window_max;
+	/**< VHOST: 0 = default 16MiB, else the largest rx window that h2
+	 * streams on this vhost may auto-tune up to.  The peer may have this
+	 * much in flight towards us per stream, so set it according to how
+	 * much memory you can spare for buffering rx. */
+#if defined(LWS_WITH_SECURE_STREAMS)
+	const char *pss_policies_bin; /**< CONTEXT: NULL, or filepath of a
+	 * binary policy made by lws_ss_policy_compile().  It's mapped and
+	 * used in place in preference to pss_policies_json, which is used as
+	 * the fallback if the file is missing or doesn't validate. */
+#endif
+	uint8_t async_dns_prefetch_pc;
+	/**< CONTEXT: 0 = disabled, else async dns cache entries that were
+	 * used from the cache since they were fetched are looked up again in
+	 * the background when this percentage of their TTL remains, so users
+	 * keep hitting the cache instead of waiting on a fresh query */
+	const char *async_dns_servers;
+	/**< CONTEXT: NULL = use the platform nameserver config, eg,
+	 * /etc/resolv.conf, else a comma-separated list of up to 4 numeric
+	 * nameserver addresses for async dns to use instead */
 
 	/* Add new things just above here ---^
 	 * This is part of the ABI, don't needlessly break compatibility
@@ -1065,6 +1085,7 @@ enum lws_mount_protocols {
 	LWSMPRO_REDIR_HTTP	= 4, /**< redirect to http:// url */
 	LWSMPRO_REDIR_HTTPS	= 5, /**< redirect to https:// url */
 	LWSMPRO_CALLBACK	= 6, /**< hand by named protocol's callback */
+	LWSMPRO_FASTCGI		= 8, /**< pass to a pool of FastCGI workers */
 };
 
 /** enum lws_authentication_mode
@@ -1121,6 +1142,13 @@ struct lws_http_mount {
 	const char *basic_auth_login_file;
 	/**<NULL, or filepath to use to check basic auth logins against. (requires LWSAUTHM_DEFAULT) */
 
+	unsigned short fastcgi_conns;
+	/**< fastcgi:// max connections to the workers, and how many workers
+	 * are spawned if the origin is a program; 0 = 4 */
+	unsigned short fastcgi_queue;
+	/**< fastcgi:// max requests waiting for a free worker connection
+	 * before we return 503; 0 = 64 */
+
 	/* Add new things just above here ---^
 	 * This is part of the ABI, don't needlessly break compatibility
 	 *
@@ -205,10 +205,13 @@ struct _lejp_stack {
 	char b; /* user bitfield */
 };
 
+struct lejp_path_index;
+
 struct _lejp_parsing_stack {
 	void *user;	/* private to the stack level */
 	signed char (*callback)(struct lejp_ctx *ctx, char reason);
 	const char * const *paths;
+	const struct lejp_path_index *pidx; /* NULL, or compiled paths */
 	uint8_t count_paths;
 	uint8_t ppos;
 	uint8_t path_match;
@@ -262,6 +265,25 @@ lejp_construct(struct lejp_ctx *ctx,
 	       signed char (*callback)(struct lejp_ctx *ctx, char reason),
 	       void *user, const char * const *paths, unsigned char paths_count);
 
+/*
+ * Optionally, a path table can be compiled once into an index, and contexts
+ * constructed with it match paths by walking the index instead of comparing
+ * every path in turn.  It's worth it for tables with more than a handful of
+ * paths that are used for many or large parses.  Matching results are
+ * identical either way.
+ */
+LWS_VISIBLE LWS_EXTERN struct lejp_path_index *
+lejp_path_index_create(const char * const *paths, unsigned char count_paths,
+		       size_t path_stride);
+
+LWS_VISIBLE LWS_EXTERN void
+lejp_path_index_destroy(struct lejp_path_index **pidx);
+
+LWS_VISIBLE LWS_EXTERN void
+lejp_construct_indexed(struct lejp_ctx *ctx,
+		       signed char (*callback)(struct lejp_ctx *ctx, char reason),
+		       void *user, const struct lejp_path_index *pidx);
+
 LWS_VISIBLE LWS_EXTERN void
 lejp_destruct(struct lejp_ctx *ctx);
 
@@ -39,6 +39,66 @@
 ///@{
 
 struct lws_buflist;
+struct lws_refbuf;
+
+/**
+ * lws_refbuf_create(): create a refcounted buffer with LWS_PRE headroom
+ *
+ * \param buf: NULL, or len bytes to copy into the payload
+ * \param len: length of the payload
+ *
+ * Allocates a buffer with LWS_PRE bytes available before the payload, so the
+ * payload can be passed directly to lws_write_refbuf().  The creator holds
+ * one reference; the payload may be filled via lws_refbuf_payload() if buf
+ * was NULL.  Once it has been written anywhere the payload must not be
+ * changed.
+ *
+ * The refcount isn't atomic, the refbuf should only be used from one
+ * service thread.
+ *
+ * Returns NULL on OOM.
+ */
+LWS_VISIBLE LWS_EXTERN struct lws_refbuf *
+lws_refbuf_create(const void *buf, size_t len);
+
+/**
+ * lws_refbuf_payload(): get the payload address of a refbuf
+ *
+ * \param rb: the refbuf
+ *
+ * There are always LWS_PRE bytes available before the returned address.
+ */
+LWS_VISIBLE LWS_EXTERN uint8_t *
+lws_refbuf_payload(struct lws_refbuf *rb);
+
+/**
+ * lws_refbuf_len(): get the payload length of a refbuf
+ *
+ * \param rb: the refbuf
+ */
+LWS_VISIBLE LWS_EXTERN size_t
+lws_refbuf_len(const struct lws_refbuf *rb);
+
+/**
+ * lws_refbuf_ref(): take an additional reference on a refbuf
+ *
+ * \param rb: the refbuf
+ *
+ * Returns rb for convenience.
+ */
+LWS_VISIBLE LWS_EXTERN struct lws_refbuf *
+lws_refbuf_ref(struct lws_refbuf *rb);
+
+/**
+ * lws_refbuf_unref(): drop a reference on a refbuf
+ *
+ * \param prb: pointer to the refbuf pointer
+ *
+ * *prb is set to NULL.  The refbuf is freed when the last reference is
+ * dropped.  It's OK to call with *prb already NULL.
+ */
+LWS_VISIBLE LWS_EXTERN void
+lws_refbuf_unref(struct lws_refbuf **prb);
 
 /**
  * lws_buflist_append_segment(): add buffer to buflist at head
@@ -53,6 +113,26 @@ struct lws_buflist;
 LWS_VISIBLE LWS_EXTERN int LWS_WARN_UNUSED_RESULT
 lws_buflist_append_segment(struct lws_buflist **head, const uint8_t *buf,
 			   size_t len);
+
+/**
+ * lws_buflist_append_segment_refbuf(): add part of a refbuf to buflist
+ *
+ * \param head: list head
+ * \param rb: the refbuf the data is inside
+ * \param buf: start of data inside the refbuf's payload
+ * \param len: length of data
+ *
+ * Like lws_buflist_append_segment(), but instead of copying the data, the
+ * segment takes a reference on rb and points into its payload, dropping the
+ * reference when the segment is used up or destroyed.
+ *
+ * Returns -1 on OOM, 1 if this was the first segment on the list, and 0 if
+ * it was a subsequent segment.
+ */
+LWS_VISIBLE LWS_EXTERN int LWS_WARN_UNUSED_RESULT
+lws_buflist_append_segment_refbuf(struct lws_buflist **head,
+				  struct lws_refbuf *rb, const uint8_t *buf,
+				  size_t len);
 /**
  * lws_buflist_next_segment_len(): number of bytes left in current segment
  *
@@ -472,6 +552,7 @@ enum {
 	 * backwards-compatible single bool
 	 */
 	LWS_RXFLOW_REASON_USER_BOOL		= (1 << 0),
+	LWS_RXFLOW_REASON_SPLICE		= (1 << 1),
 	LWS_RXFLOW_REASON_HTTP_RXBUFFER		= (1 << 6),
 	LWS_RXFLOW_REASON_H2_PPS_PENDING	= (1 << 7),
 
@@ -743,6 +824,8 @@ typedef void (*lsp_cb_t)(void *opaque, lws_usec_t *accounting, siginfo_t *si,
  * \p timeout: optional us-resolution timeout, or zero
  * \p reap_cb: callback when child process has been reaped and the lsp destroyed
  * \p tsi: tsi to bind stdwsi to... from opt_parent if given
+ * \p use_stdin_fd: 0, or 1 to give the child \p stdin_fd as its stdin
+ * \p stdin_fd: if \p use_stdin_fd, fd to give the child instead of a pipe
  */
 struct lws_spawn_piped_info {
 	struct lws_dll2_owner		*owner;
@@ -768,6 +851,9 @@ struct lws_spawn_piped_info {
 	const struct lws_role_ops	*ops; /* NULL is raw file */
 
 	uint8_t				disable_ctrlc;
+	uint8_t				use_stdin_fd; /* stdin_fd, not a pipe */
+
+	int				stdin_fd; /* fd for child stdin */
 };
 
 /**
@@ -72,6 +72,12 @@ typedef struct lws_mqtt_client_connect_param_s {
 						   parameters */
 	const char 			*username;
 	const char 			*password;
+	uint16_t			publish_window; /* max QoS1 PUBLISH
+					   awaiting PUBACK at once on the
+					   connection, 0 = default (16), 1 is
+					   stop-and-wait.  It's further limited
+					   by any Receive Maximum the server
+					   gives */
 } lws_mqtt_client_connect_param_t;
 
 /*
@@ -90,7 +96,10 @@ typedef struct lws_mqtt_publish_param_s {
 	uint16_t 		packet_id;	/* Packet ID for QoS >
 						   0 */
 	uint8_t 		dup:1;		/* Retried PUBLISH,
-						   for QoS > 0 */
+						   for QoS > 0... if you
+						   set this when resending
+						   after MQTT_RESEND, the
+						   .packet_id is reused */
 } lws_mqtt_publish_param_t;
 
 typedef struct topic_elem {
@@ -288,11 +297,32 @@ lws_mqtt_str_free(lws_mqtt_str_t **s);
  * up into 1 or 2- mtu sized chunks and send that.
  *
  * Final should be set when you're calling with the last part of the payload.
+ *
+ * QoS1 PUBLISH can be issued while earlier ones are still waiting for their
+ * PUBACK, up to the connection's publish window, see
+ * lws_mqtt_client_publish_window_full().  Each one has its own PUBACK timeout,
+ * LWS_CALLBACK_MQTT_ACK and LWS_CALLBACK_MQTT_RESEND give its packet ID in the
+ * len parameter.
  */
 LWS_VISIBLE LWS_EXTERN int
 lws_mqtt_client_send_publish(struct lws *wsi, lws_mqtt_publish_param_t *pub,
 			     const void *buf, uint32_t len, int final);
 
+/**
+ * lws_mqtt_client_publish_window_full() - check if a QoS1 PUBLISH must wait
+ *
+ * \param wsi: the mqtt child wsi
+ *
+ * Returns nonzero if the connection already has as many QoS1 PUBLISH awaiting
+ * PUBACK as its publish window allows, in which case a new QoS1 PUBLISH can't
+ * be started yet.  The child wsi is then marked so it will get a
+ * LWS_CALLBACK_MQTT_CLIENT_WRITEABLE when a PUBACK opens the window again.
+ *
+ * Returns 0 if a new QoS1 PUBLISH can be started now.
+ */
+LWS_VISIBLE LWS_EXTERN int
+lws_mqtt_client_publish_window_full(struct lws *wsi);
+
 /**
  * lws_mqtt_client_send_subcribe() - lws_write a subscribe packet
  *
@@ -130,6 +130,7 @@ enum {
 	LWSSSP_H1,
 	LWSSSP_H2,
 	LWSSSP_WS,
+	LWSSSP_MQTT,
 
 
 	LWSSS_HBI_AUTH = 0,
@@ -216,6 +217,7 @@ typedef struct lws_ss_policy {
 			const char	*will_message;
 
 			uint16_t	keep_alive;
+			uint16_t	publish_window;
 			uint8_t		qos;
 			uint8_t		clean_start;
 			uint8_t		will_qos;
@@ -235,12 +237,41 @@ typedef struct lws_ss_policy {
 
 	const lws_retry_bo_t	*retry_bo;   /**< retry policy to use */
 
+	lws_ss_metadata_t	**metadata_index; /**< metadata by index, or
+						   * NULL, set by the parser */
+	const uint8_t		*metadata_hash; /**< metadata index + 1 by name
+			* hash (open addressed), or NULL, set by the parser */
+
 	uint32_t		flags;	     /**< stream attribute flags */
 
 	uint16_t		port;	     /**< endpoint port */
+	uint16_t		metadata_hash_mask; /**< metadata_hash size - 1 */
 
 	uint8_t			metadata_count;    /**< metadata count */
 	uint8_t			protocol;    /**< protocol index */
 	uint8_t			client_cert; /**< which client cert to apply
 						  0 = none, 1+ = cc 0+ */
 } lws_ss_policy_t;
+
+/**
+ * lws_ss_policy_compile() - compile a JSON policy into a binary policy file
+ *
+ * \param context: lws context, its pss_plugins are not needed
+ * \param json: the JSON policy
+ * \param len: length of \p json
+ * \param path: filepath to write the binary policy to
+ *
+ * Parses the JSON policy and writes it out as a blob that can be given to
+ * a later context as `info.pss_policies_bin`, where it is mapped and used
+ * in place without any parsing or per-object allocation.  Plugins are stored
+ * by name and bound to the context's pss_plugins when the blob is loaded.
+ *
+ * The blob is only valid for the same lws version and ABI that created it, a
+ * mismatched or damaged blob is rejected at load time and the context falls
+ * back to its JSON policy.
+ *
+ * Returns 0 if the blob was written, else nonzero.
+ */
+LWS_VISIBLE LWS_EXTERN int
+lws_ss_policy_compile(struct lws_context *context, const char *json,
+		      size_t len, const char *path);
@@ -121,6 +121,36 @@
  *   -  3: 1 byte state index
  *   -  7: 4-byte MSB-first ordinal
  *
+ * Shared memory transport
+ * -----------------------
+ *
+ * When lws is built with LWS_WITH_SECURE_STREAMS_PROXY_SHM, a client stream
+ * with ssi->proxy_shm_ring_size set asks the proxy, after it has seen the
+ * create result, to move the stream's frames into a pair of single-producer,
+ * single-consumer rings in a shared memfd, one per direction, with an eventfd
+ * doorbell each way.
+ *
+ * - Client to proxy: shared memory request
+ *
+ *   -  0: LWSSS_SER_TXPRE_SHM_REQ
+ *   -  1: 00, 04
+ *   -  3: 4-byte MSB-first requested ring size, at least 128KiB so the
+ *          biggest frame, 3 + 0xffff bytes, always fits
+ *
+ * - Proxy to client: shared memory offer
+ *
+ *   -  0: LWSSS_SER_RXPRE_SHM_OFFER
+ *   -  1: 00, 04
+ *   -  3: 4-byte MSB-first ring size actually used, 0 = declined
+ *
+ * An accepted offer is sent with SCM_RIGHTS ancillary data carrying the memfd,
+ * the eventfd that wakes the client and the eventfd that wakes the proxy, and
+ * it's the last frame the proxy sends on the socket.  After it, the frames in
+ * both directions are written into the rings with exactly the framing above,
+ * one whole frame at a time; a frame that won't fit before the end of the ring
+ * is preceded by a 0x00 byte telling the reader to skip to the start.  The
+ * payload is built and consumed in place in the ring, and the socket stays up
+ * for the setup and to signal the other side went away.
  *
  * Proxied tx may be read by the proxy but rejected due to lack of buffer space
  * at the proxy.  For that reason, tx must be held at the sender until it has
@@ -206,6 +236,7 @@ enum {
 	LWSSS_SER_RXPRE_CONNSTATE,
 	LWSSS_SER_RXPRE_TXCR_UPDATE,
 	LWSSS_SER_RXPRE_TLSNEG_ENCLAVE_SIGN,
+	LWSSS_SER_RXPRE_SHM_OFFER,
 
 	/* tx (send by client) prepends for proxied connections */
 
@@ -216,6 +247,7 @@ enum {
 	LWSSS_SER_TXPRE_METADATA,
 	LWSSS_SER_TXPRE_TXCR_UPDATE,
 	LWSSS_SER_TXPRE_TLSNEG_ENCLAVE_SIGNED,
+	LWSSS_SER_TXPRE_SHM_REQ,
 };
 
 typedef enum {
@@ -274,6 +306,15 @@ typedef struct lws_ss_info {
 	 * (*state) LWSSSCS_SINK_JOIN / _PART events, the new client handle
 	 * being provided in the h_src parameter.
 	 */
+	uint32_t    proxy_shm_ring_size;
+	/**< Only used by proxied client streams when lws was built with
+	 * LWS_WITH_SECURE_STREAMS_PROXY_SHM.  0 = frames go over the proxy
+	 * socket as usual, otherwise ask the proxy for shared memory rings of
+	 * about this many bytes in each direction to carry them instead.  It
+	 * must be at least 128KiB, so the rings can hold the biggest frames,
+	 * or creating the stream fails.  If the proxy declines, the socket is
+	 * used.
+	 */
 } lws_ss_info_t;
 
 /**
@@ -66,6 +66,10 @@ enum lws_spa_fileupload_states {
  *
  * Notice name and filename shouldn't be trusted, as they are passed from
  * HTTP provided by the client.
+ *
+ * For multipart uploads, buf may point directly into the data given to
+ * lws_spa_process(), and len may be larger than the spa's max_storage.  The
+ * callback must not modify it or expect it to remain valid after returning.
  */
 typedef int (*lws_spa_fileupload_cb)(void *data, const char *name,
 				     const char *filename, char *buf, int len,
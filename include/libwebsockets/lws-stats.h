@@ -58,6 +58,12 @@ enum {
 	LWSSTATS_C_PEER_LIMIT_WSI_DENIED, /**< number of times we would have given a wsi but for the peer limit */
 	LWSSTATS_C_CONNS_CLIENT, /**< attempted client conns */
 	LWSSTATS_C_CONNS_CLIENT_FAILED, /**< failed client conns */
+	LWSSTATS_C_H2_TX_WINDOW_STALLS, /**< h2 streams blocked by peer window */
+	LWSSTATS_C_H2_RX_WINDOW_STALLS, /**< h2 peer used up the window we gave */
+	LWSSTATS_C_H2_RX_WINDOW_GROWN, /**< h2 rx window grown from BDP sample */
+	LWSSTATS_C_ADNS_CACHE_HIT, /**< async dns queries answered from cache */
+	LWSSTATS_C_ADNS_CACHE_MISS, /**< async dns queries that went to the server */
+	LWSSTATS_C_ADNS_PREFETCH, /**< async dns cache entries refreshed ahead of TTL */
 
 	/* Add new things just above here ---^
 	 * This is part of the ABI, don't needlessly break compatibility
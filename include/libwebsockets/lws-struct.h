@@ -198,6 +198,7 @@ typedef struct lws_struct_serialize_st {
 	size_t size;
 	char subsequent;
 	char idt;
+	char str_open; /* key and opening quote of a partial string issued */
 } lws_struct_serialize_st_t;
 
 enum {
@@ -212,6 +213,8 @@ typedef struct lws_struct_serialize {
 
 	int sp;
 	int flags;
+
+	char ws_started; /* lws_struct_json_serialize_ws() sent a fragment */
 } lws_struct_serialize_t;
 
 typedef enum {
@@ -238,10 +241,37 @@ lws_struct_json_serialize_create(const lws_struct_map_t *map,
 LWS_VISIBLE LWS_EXTERN void
 lws_struct_json_serialize_destroy(lws_struct_serialize_t **pjs);
 
+/*
+ * Serializes as much as fits in len bytes at buf, and returns
+ * LSJS_RESULT_CONTINUE if there is more to come.  Call again with a fresh
+ * buffer to resume from where it left off, until LSJS_RESULT_FINISH.  len
+ * should be at least a couple of hundred bytes, so any key fits with room to
+ * spare.
+ */
 LWS_VISIBLE LWS_EXTERN lws_struct_json_serialize_result_t
 lws_struct_json_serialize(lws_struct_serialize_t *js, uint8_t *buf,
 			  size_t len, size_t *written);
 
+#if defined(LWS_ROLE_WS)
+/**
+ * lws_struct_json_serialize_ws() - serialize the next part and send it on ws
+ *
+ * \param js: the serializer from lws_struct_json_serialize_create()
+ * \param wsi: the ws connection, call this from its WRITEABLE callback
+ * \param buf: your send buffer, starting with LWS_PRE bytes of headroom
+ * \param len: the size of buf including the LWS_PRE
+ *
+ * The JSON is serialized directly after the LWS_PRE headroom and sent from
+ * there without copying, as one fragment of a ws TEXT message.  If the
+ * return is LSJS_RESULT_CONTINUE, request another WRITEABLE callback and
+ * call again to send the next fragment.  LSJS_RESULT_FINISH means the last
+ * fragment, with FIN, was sent.
+ */
+LWS_VISIBLE LWS_EXTERN lws_struct_json_serialize_result_t
+lws_struct_json_serialize_ws(lws_struct_serialize_t *js, struct lws *wsi,
+			     uint8_t *buf, size_t len);
+#endif
+
 #if defined(LWS_WITH_STRUCT_SQLITE3)
 
 LWS_VISIBLE LWS_EXTERN int
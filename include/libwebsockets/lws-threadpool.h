@@ -218,13 +218,14 @@ lws_threadpool_task_sync(struct lws_threadpool_task *task, int stop);
  *
  * \param tp: The threadpool to dump
  *
- * This locks the threadpool and then dumps the pending queue, the worker
- * threads and the done queue, together with time information for how long
- * the tasks have been in their current state, how long they have occupied a
- * thread, etc.
- *
- * This only does anything on lws builds with CMAKE_BUILD_TYPE=DEBUG, otherwise
- * while it still exists, it's a NOP.
+ * This locks the threadpool and logs a summary of the queue depths, how many
+ * tasks have run, and their average and maximum time queued and average time
+ * running on a thread.
+ *
+ * On lws builds with CMAKE_BUILD_TYPE=DEBUG, it then dumps the pending queue,
+ * the worker threads and the done queue, together with time information for
+ * how long the tasks have been in their current state, how long they have
+ * occupied a thread, etc.
  */
 
 LWS_VISIBLE LWS_EXTERN void
@@ -65,6 +65,8 @@
 #define LWS_FOP_FLAG_COMPR_IS_GZIP	   (1 << 25)
 #define LWS_FOP_FLAG_MOD_TIME_VALID	   (1 << 26)
 #define LWS_FOP_FLAG_VIRTUAL		   (1 << 27)
+#define LWS_FOP_FLAG_COMPR_ACCEPTABLE_BR   (1 << 28)
+#define LWS_FOP_FLAG_COMPR_IS_BR	   (1 << 29)
 
 struct lws_plat_file_ops;
 
@@ -104,6 +106,8 @@ struct lws_plat_file_ops {
 	 * LWS_FOP_FLAG_COMPR_ACCEPTABLE_GZIP is set.  If it actually is
 	 * gzip-compressed, then the open handler should OR
 	 * LWS_FOP_FLAG_COMPR_IS_GZIP on to *flags before returning.
+	 * Brotli is handled the same way with
+	 * LWS_FOP_FLAG_COMPR_ACCEPTABLE_BR and LWS_FOP_FLAG_COMPR_IS_BR.
 	 */
 	int (*LWS_FOP_CLOSE)(lws_fop_fd_t *fop_fd);
 	/**< close file AND set the pointer to NULL */
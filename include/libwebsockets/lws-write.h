@@ -218,6 +218,32 @@ lws_write(struct lws *wsi, unsigned char *buf, size_t len,
 #define lws_write_http(wsi, buf, len) \
 	lws_write(wsi, (unsigned char *)(buf), len, LWS_WRITE_HTTP)
 
+/**
+ * lws_write_refbuf() - lws_write() the payload of a refcounted buffer
+ *
+ * \param wsi:	the connection to write on
+ * \param rb:	refbuf created with lws_refbuf_create()
+ * \param protocol: as for lws_write()
+ *
+ * Writes the whole refbuf payload as lws_write() would.  But if the
+ * connection can't take all of it immediately, the remainder is queued on the
+ * connection by taking a reference on rb rather than by copying it.  The
+ * caller can drop its own reference as soon as this returns.
+ *
+ * This suits the case the same message is written to many connections, eg,
+ * from an lws_ring holding refbuf pointers, since the message is never copied
+ * per-connection and the ring element can be released as soon as every
+ * connection has written it, however long the connections take to send it.
+ *
+ * Connections that modify the payload in place, ie, ws client masking, use a
+ * private copy instead.
+ *
+ * Return is as for lws_write().
+ */
+LWS_VISIBLE LWS_EXTERN int
+lws_write_refbuf(struct lws *wsi, struct lws_refbuf *rb,
+		 enum lws_write_protocol protocol);
+
 /**
  * lws_write_ws_flags() - Helper for multi-frame ws message flags
  *
@@ -245,6 +271,71 @@ lws_write_ws_flags(int initial, int is_start, int is_end)
 	return r;
 }
 
+struct lws_ws_bcast;
+
+/**
+ * lws_ws_bcast_create() - prepare a ws message for sending to many connections
+ *
+ * \param buf: the message payload (no LWS_PRE needed)
+ * \param len: length of the payload
+ * \param wp: LWS_WRITE_TEXT or LWS_WRITE_BINARY
+ *
+ * Copies the payload and frames it once as a complete, unfragmented server
+ * message, so it can be sent to any number of ws server connections with
+ * lws_ws_bcast_write() without being reframed for each one.
+ *
+ * If recipients negotiated permessage-deflate, the first one whose tx stream
+ * can take a message compressed from a fresh stream (eg, the peer asked for
+ * client_no_context_takeover, or nothing was compressed on it yet) causes the
+ * message to be deflated once and kept alongside the plain frame, and other
+ * such recipients are sent the same deflated frame.  Recipients whose deflate
+ * stream holds context, clients, and ws-over-h2 streams are written using
+ * lws_write_refbuf() on the payload.  Either way, anything a connection can't
+ * send immediately is queued as a reference on the shared data, not a copy.
+ *
+ * Returns the object with one reference held by the caller, or NULL on OOM or
+ * if wp isn't suitable.  The object isn't threadsafe, it should be used from
+ * the service thread like lws_write().
+ */
+LWS_VISIBLE LWS_EXTERN struct lws_ws_bcast *
+lws_ws_bcast_create(const void *buf, size_t len, enum lws_write_protocol wp);
+
+/**
+ * lws_ws_bcast_ref() - take another reference on a broadcast message
+ *
+ * \param b: the broadcast message
+ *
+ * Returns b for convenience.
+ */
+LWS_VISIBLE LWS_EXTERN struct lws_ws_bcast *
+lws_ws_bcast_ref(struct lws_ws_bcast *b);
+
+/**
+ * lws_ws_bcast_unref() - drop a reference on a broadcast message
+ *
+ * \param pb: pointer to the pointer to the broadcast message
+ *
+ * *pb is set to NULL, and the message is freed when the last reference goes.
+ * Data from it already accepted by lws_ws_bcast_write() does not need it to
+ * stay around.
+ */
+LWS_VISIBLE LWS_EXTERN void
+lws_ws_bcast_unref(struct lws_ws_bcast **pb);
+
+/**
+ * lws_ws_bcast_write() - send a broadcast message on a ws connection
+ *
+ * \param wsi: the ws connection, from its WRITEABLE callback
+ * \param b: the broadcast message
+ *
+ * Use this in place of lws_write() for the whole message, typically after
+ * lws_callback_on_writable_all_protocol().  Returns -1 for a fatal error, or
+ * the payload length, and like lws_write() anything the connection can't take
+ * immediately is buffered and sent autonomously.
+ */
+LWS_VISIBLE LWS_EXTERN int
+lws_ws_bcast_write(struct lws *wsi, struct lws_ws_bcast *b);
+
 /**
  * lws_raw_transaction_completed() - Helper for flushing before close
  *
@@ -261,4 +352,23 @@ lws_write_ws_flags(int initial, int is_start, int is_end)
 LWS_VISIBLE LWS_EXTERN int LWS_WARN_UNUSED_RESULT
 lws_raw_transaction_completed(struct lws *wsi);
 
+/**
+ * lws_raw_proxy_splice() - forward between two raw-proxy conns in the kernel
+ *
+ * \param wsi: a raw-proxy connection
+ * \param peer: the raw-proxy connection on the other side of the tunnel
+ *
+ * If both connections are plain tcp or unix sockets with nothing buffered in
+ * either direction, from now on anything arriving on one is spliced to the
+ * other through a pipe, without being copied into userland.  The RX and
+ * WRITEABLE callbacks no longer happen for either connection, and when one
+ * side closes, the other is closed after it has sent what it still had.
+ *
+ * Returns 0 if the connections are spliced, or nonzero if that isn't possible,
+ * eg, TLS or buffered data is involved, or the platform has no splice(), in
+ * which case nothing changed and they should carry on using the callbacks.
+ */
+LWS_VISIBLE LWS_EXTERN int
+lws_raw_proxy_splice(struct lws *wsi, struct lws *peer);
+
 ///@}
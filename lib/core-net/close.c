@@ -112,6 +112,10 @@ __lws_reset_wsi(struct lws *wsi)
 	wsi->context->count_wsi_allocated--;
 
 	__lws_same_vh_protocol_remove(wsi);
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	while (wsi->rx_nfds)
+		close(wsi->rx_fds[--wsi->rx_nfds]);
+#endif
 #if defined(LWS_WITH_CLIENT)
 	lws_free_set_NULL(wsi->stash);
 	lws_free_set_NULL(wsi->cli_hostname_copy);
@@ -217,6 +221,11 @@ void
 lws_addrinfo_clean(struct lws *wsi)
 {
 #if defined(LWS_WITH_CLIENT)
+	/* any other connect attempts that didn't win are finished with */
+	lws_dll2_remove(&wsi->sul_connect_stagger.list);
+	while (wsi->he_parked)
+		compatible_close(wsi->he_fds[--wsi->he_parked]);
+
 	if (!wsi->dns_results)
 		return;
 
@@ -314,10 +314,6 @@ lws_callback_http_dummy(struct lws *wsi, enum lws_callback_reasons reason,
 				lwsl_debug("AUX_BF__CGI forcing close\n");
 				return -1;
 			}
-			if (!n && wsi->http.cgi &&
-			    wsi->http.cgi->lsp->stdwsi[LWS_STDOUT])
-				lws_rx_flow_control(
-					wsi->http.cgi->lsp->stdwsi[LWS_STDOUT], 1);
 
 			if (wsi->reason_bf & LWS_CB_REASON_AUX_BF__CGI_HEADERS)
 				wsi->reason_bf &=
@@ -325,8 +321,29 @@ lws_callback_http_dummy(struct lws *wsi, enum lws_callback_reasons reason,
 			else
 				wsi->reason_bf &= ~LWS_CB_REASON_AUX_BF__CGI;
 
-			if (wsi->http.cgi && wsi->http.cgi->cgi_transaction_over)
+			if (wsi->http.cgi && wsi->http.cgi->cgi_transaction_over) {
+#if defined(LWS_WITH_FASTCGI)
+				/* the worker is persistent, the conn can be */
+				if (wsi->http.cgi->fcgi) {
+					if (lws_http_transaction_completed(wsi))
+						return -1;
+					break;
+				}
+#endif
 				return -1;
+			}
+
+			if (n || !wsi->http.cgi)
+				break;
+#if defined(LWS_WITH_FASTCGI)
+			if (wsi->http.cgi->fcgi)
+				lws_fcgi_stdout_resume(wsi);
+			else
+#endif
+			if (wsi->http.cgi->lsp &&
+			    wsi->http.cgi->lsp->stdwsi[LWS_STDOUT])
+				lws_rx_flow_control(
+					wsi->http.cgi->lsp->stdwsi[LWS_STDOUT], 1);
 			break;
 		}
 
@@ -24,6 +24,40 @@
 
 #include "private-lib-core.h"
 
+/*
+ * Stash unsent data on buflist_out.  If it's the payload of the refbuf being
+ * written by lws_write_refbuf(), just take a reference on it; protocol
+ * framing in front of the payload, in the refbuf's LWS_PRE area, differs per
+ * connection and is copied.
+ */
+
+static int
+lws_buffer_out(struct lws_context_per_thread *pt, struct lws *wsi,
+	       const uint8_t *buf, size_t len)
+{
+	struct lws_refbuf *rb = pt->tx_refbuf;
+	uint8_t *p;
+	size_t hl;
+
+	if (!rb)
+		return lws_buflist_append_segment(&wsi->buflist_out, buf, len);
+
+	p = lws_refbuf_payload(rb);
+	if (buf < p - LWS_PRE || buf + len <= p || buf + len > p + rb->len)
+		return lws_buflist_append_segment(&wsi->buflist_out, buf, len);
+
+	if (buf < p) {
+		hl = (size_t)lws_ptr_diff(p, buf);
+		if (lws_buflist_append_segment(&wsi->buflist_out, buf, hl) < 0)
+			return -1;
+		buf = p;
+		len -= hl;
+	}
+
+	return lws_buflist_append_segment_refbuf(&wsi->buflist_out, rb, buf,
+						 len);
+}
+
 /*
  * notice this returns number of bytes consumed, or -1
  */
@@ -74,7 +108,7 @@ lws_issue_raw(struct lws *wsi, unsigned char *buf, size_t len)
 		 * the buflist...
 		 */
 
-		if (lws_buflist_append_segment(&wsi->buflist_out, buf, len))
+		if (lws_buffer_out(pt, wsi, buf, len) < 0)
 			return -1;
 
 		buf = NULL;
@@ -203,8 +237,7 @@ lws_issue_raw(struct lws *wsi, unsigned char *buf, size_t len)
 	lwsl_debug("%p new partial sent %d from %lu total\n", wsi, m,
 		    (unsigned long)real_len);
 
-	if (lws_buflist_append_segment(&wsi->buflist_out, buf + m,
-				       real_len - m) < 0)
+	if (lws_buffer_out(pt, wsi, buf + m, real_len - m) < 0)
 		return -1;
 
 	lws_stats_bump(pt, LWSSTATS_C_WRITE_PARTIALS, 1);
@@ -282,6 +315,47 @@ lws_write(struct lws *wsi, unsigned char *buf, size_t len,
 	return m;
 }
 
+int
+lws_write_refbuf(struct lws *wsi, struct lws_refbuf *rb,
+		 enum lws_write_protocol wp)
+{
+	struct lws_context_per_thread *pt = &wsi->context->pt[(int)wsi->tsi];
+	struct lws_refbuf *w;
+	int m;
+
+	/*
+	 * Paths that change the payload in place get a private copy, which
+	 * the buflist can then reference in the same way
+	 */
+#if defined(LWS_ROLE_WS)
+	if (lwsi_role_ws(wsi) && lwsi_role_client(wsi)) /* masking */
+		w = lws_refbuf_create(lws_refbuf_payload(rb), rb->len);
+	else
+#endif
+		w = lws_refbuf_ref(rb);
+	if (!w)
+		return -1;
+
+	pt->tx_refbuf = w;
+	m = lws_write(wsi, lws_refbuf_payload(w), w->len, wp);
+	pt->tx_refbuf = NULL;
+
+#if defined(LWS_ROLE_WS) && !defined(LWS_WITHOUT_EXTENSIONS)
+	/*
+	 * The deflate tx ext may not have taken all of the payload in yet, and
+	 * will continue reading it from where it is as it drains
+	 */
+	if (m >= 0 && lwsi_role_ws(wsi) && wsi->ws->tx_draining_ext) {
+		lws_refbuf_unref(&wsi->ws->tx_hold);
+		wsi->ws->tx_hold = lws_refbuf_ref(w);
+	}
+#endif
+
+	lws_refbuf_unref(&w);
+
+	return m;
+}
+
 int
 lws_ssl_capable_read_no_ssl(struct lws *wsi, unsigned char *buf, int len)
 {
@@ -298,6 +372,26 @@ lws_ssl_capable_read_no_ssl(struct lws *wsi, unsigned char *buf, int len)
 		n = recvfrom(wsi->desc.sockfd, (char *)buf, len, 0,
 			     &wsi->udp->sa, &wsi->udp->salen);
 	} else
+#endif
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	if (wsi->rx_fds_wanted) {
+		int fds[3], nfds;
+
+		/* the peer may pass fds with this data, keep them */
+
+		n = (int)lws_ss_shm_recv_fds(wsi->desc.sockfd, buf,
+					     (size_t)len, fds, &nfds);
+		if (nfds && (nfds != 3 || wsi->rx_nfds)) {
+			while (nfds > 0)
+				close(fds[--nfds]);
+
+			return LWS_SSL_CAPABLE_ERROR;
+		}
+		if (nfds) {
+			memcpy(wsi->rx_fds, fds, sizeof(fds));
+			wsi->rx_nfds = 3;
+		}
+	} else
 #endif
 		n = recv(wsi->desc.sockfd, (char *)buf, len, 0);
 
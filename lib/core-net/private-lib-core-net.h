@@ -321,21 +321,27 @@ typedef struct lws_dsh {
  * lws_async_dns
  */
 
+#define LWS_ADNS_CACHE_HASH	16 /* buckets, power of 2 */
+#define LWS_ADNS_MAX_SERVERS	4  /* fits in the uint8_t query masks */
+
+typedef struct lws_adns_server {
+	lws_sockaddr46		sa46;	/* nameserver */
+	struct lws		*wsi;	/* our udp socket to it, or NULL */
+	lws_usec_t		srtt_us; /* smoothed rtt, 0 until measured */
+	uint8_t			fails;	/* queries it was slow or silent on */
+} lws_adns_server_t;
+
 typedef struct lws_async_dns {
-	lws_sockaddr46 		sa46; /* nameserver */
+	lws_adns_server_t	server[LWS_ADNS_MAX_SERVERS];
 	lws_dll2_owner_t	waiting;
 	lws_dll2_owner_t	cached;
-	struct lws		*wsi;
-	time_t			time_set_server;
+	lws_dll2_owner_t	cached_hash[LWS_ADNS_CACHE_HASH];
+	const char		*servers; /* from info, overrides platform */
+	uint8_t			count_servers;
+	uint8_t			prefetch_pc;
 	char			dns_server_set;
 } lws_async_dns_t;
 
-typedef enum {
-	LADNS_CONF_SERVER_UNKNOWN				= -1,
-	LADNS_CONF_SERVER_SAME,
-	LADNS_CONF_SERVER_CHANGED
-} lws_async_dns_server_check_t;
-
 #if defined(LWS_WITH_SYS_ASYNC_DNS)
 void
 lws_aysnc_dns_completed(struct lws *wsi, void *sa, size_t salen,
@@ -408,6 +414,12 @@ struct lws_context_per_thread {
 	 */
 	unsigned char *serv_buf;
 
+	/*
+	 * during lws_write_refbuf(), data from inside this refbuf that has
+	 * to be buffered is referenced rather than copied
+	 */
+	struct lws_refbuf *tx_refbuf;
+
 	struct lws_pollfd *fds;
 	volatile struct lws_foreign_thread_pollfd * volatile foreign_pfd_list;
 #ifdef _WIN32
@@ -635,6 +647,16 @@ lws_wsi_mux_dump_waiting_children(struct lws *wsi);
 int
 lws_wsi_mux_apply_queue(struct lws *wsi);
 
+/*
+ * Client connections with several dns results start a new connect attempt
+ * every LWS_CLIENT_HE_STAGGER_US while the earlier ones are still pending,
+ * as RFC 8305 "Happy Eyeballs" describes.  Up to LWS_CLIENT_HE_PARKED
+ * earlier attempts are kept going alongside the newest one.
+ */
+
+#define LWS_CLIENT_HE_STAGGER_US	(250 * LWS_US_PER_MS)
+#define LWS_CLIENT_HE_PARKED		3
+
 /*
  * struct lws
  */
@@ -720,11 +742,18 @@ struct lws {
 #if defined(LWS_WITH_UDP)
 	struct lws_udp			*udp;
 #endif
+#if defined(LWS_ROLE_RAW_PROXY) && defined(LWS_HAVE_SPLICE)
+	struct lws_raw_proxy_splice	*splice;
+#endif
 #if defined(LWS_WITH_CLIENT)
 	struct client_info_stash	*stash;
 	char				*cli_hostname_copy;
 	const struct addrinfo		*dns_results;
 	const struct addrinfo		*dns_results_next;
+	lws_sorted_usec_list_t		sul_connect_stagger;
+	lws_sockfd_type			he_fds[LWS_CLIENT_HE_PARKED];
+	/**< earlier connect attempts still in progress, not polled */
+	uint32_t			he_tried; /* b(n) = dns result n tried */
 #endif
 	void				*user_space;
 	void				*opaque_parent_data;
@@ -754,6 +783,9 @@ struct lws {
 #if defined(LWS_WITH_CLIENT)
 	int				chunk_remaining;
 	int				flags;
+#endif
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	int				rx_fds[3]; /* SCM_RIGHTS fds taken by a read */
 #endif
 	unsigned int			cache_secs;
 
@@ -803,6 +835,9 @@ struct lws {
 	unsigned int			could_have_pending:1; /* detect back-to-back writes */
 	unsigned int			outer_will_close:1;
 	unsigned int			shadow:1; /* we do not control fd lifecycle at all */
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	unsigned int			rx_fds_wanted:1; /* read with recvmsg */
+#endif
 
 #ifdef LWS_WITH_ACCESS_LOG
 	unsigned int			access_log_pending:1;
@@ -822,6 +857,7 @@ struct lws {
 	unsigned int			client_mux_migrated:1;
 	unsigned int			client_subsequent_mime_part:1;
 	unsigned int                    client_no_follow_redirect:1;
+	unsigned int			client_he_stagger:1;
 #endif
 
 #ifdef _WIN32
@@ -849,6 +885,8 @@ struct lws {
 	char chunk_parser; /* enum lws_chunk_parser */
 	uint8_t addrinfo_idx;
 	uint8_t sys_tls_client_cert;
+	uint8_t he_parked; /* count of he_fds in use */
+	uint8_t he_family; /* address family of the last connect attempt */
 #endif
 #if defined(LWS_WITH_CGI) || defined(LWS_WITH_CLIENT)
 	char reason_bf; /* internal writeable callback reason bitfield */
@@ -857,6 +895,9 @@ struct lws {
 	char seen_rx;
 #endif
 	uint8_t immortal_substream_count;
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	uint8_t rx_nfds; /* count of rx_fds in use */
+#endif
 	/* volatile to make sure code is aware other thread can change */
 	volatile char handling_pollout;
 	volatile char leave_pollout_active;
@@ -1370,8 +1411,11 @@ void
 lws_inform_client_conn_fail(struct lws *wsi, void *arg, size_t len);
 
 #if defined(LWS_WITH_SYS_ASYNC_DNS)
-lws_async_dns_server_check_t
-lws_plat_asyncdns_init(struct lws_context *context, lws_sockaddr46 *sa);
+int
+lws_plat_asyncdns_init(struct lws_context *context, lws_sockaddr46 *sa46,
+		       int max);
+int
+lws_async_dns_parse_servers(const char *list, lws_sockaddr46 *sa46, int max);
 int
 lws_async_dns_init(struct lws_context *context);
 void
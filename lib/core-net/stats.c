@@ -64,6 +64,12 @@ static const char * stat_names[] = {
 	"C_PEER_LIMIT_WSI_DENIED",
 	"C_CONNECTIONS_CLIENT",
 	"C_CONNECTIONS_CLIENT_FAILED",
+	"C_H2_TX_WINDOW_STALLS",
+	"C_H2_RX_WINDOW_STALLS",
+	"C_H2_RX_WINDOW_GROWN",
+	"C_ADNS_CACHE_HIT",
+	"C_ADNS_CACHE_MISS",
+	"C_ADNS_PREFETCH",
 };
 
 static int
@@ -96,7 +96,9 @@ static const char * const mount_protocols[] = {
 	"cgi://",
 	">http://",
 	">https://",
-	"callback://"
+	"callback://",
+	"gzip://",
+	"fastcgi://"
 };
 
 const struct lws_role_ops *
@@ -144,7 +146,8 @@ lws_role_call_adoption_bind(struct lws *wsi, int type, const char *prot)
 	 * if the vhost is told to bind accepted sockets to a given role,
 	 * then look it up by name and try to bind to the specific role.
 	 */
-	if (lws_check_opt(wsi->vhost->options,
+	if ((type & LWS_ADOPT_SOCKET) &&
+	    lws_check_opt(wsi->vhost->options,
 			  LWS_SERVER_OPTION_ADOPT_APPLY_LISTEN_ACCEPT_CONFIG) &&
 	    wsi->vhost->listen_accept_role) {
 		const struct lws_role_ops *role =
@@ -594,7 +597,10 @@ lws_create_vhost(struct lws_context *context,
 #endif
 
 #if defined(LWS_WITH_HTTP_PROXY) && defined(LWS_ROLE_WS)
-	fx = 1;
+	fx++;
+#endif
+#if defined(LWS_WITH_FASTCGI)
+	fx++;
 #endif
 #if defined(LWS_WITH_ABSTRACT)
 	abs_pcol_count = (int)LWS_ARRAY_SIZE(available_abstract_protocols) - 1;
@@ -697,6 +703,10 @@ lws_create_vhost(struct lws_context *context,
 	memcpy(&lwsp[m++], &lws_ws_proxy, sizeof(*lwsp));
 	vh->count_protocols++;
 #endif
+#if defined(LWS_WITH_FASTCGI)
+	memcpy(&lwsp[m++], &lws_fastcgi_protocol, sizeof(*lwsp));
+	vh->count_protocols++;
+#endif
 
 	vh->protocols = lwsp;
 	vh->allocated_vhost_protocols = 1;
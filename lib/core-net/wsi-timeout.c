@@ -36,6 +36,9 @@ __lws_wsi_remove_from_sul(struct lws *wsi)
 	lws_dll2_remove(&wsi->sul_timeout.list);
 	lws_dll2_remove(&wsi->sul_hrtimer.list);
 	lws_dll2_remove(&wsi->sul_validity.list);
+#if defined(LWS_WITH_CLIENT)
+	lws_dll2_remove(&wsi->sul_connect_stagger.list);
+#endif
 	// lws_dll2_describe(&pt->pt_sul_owner, "post-remove");
 }
 
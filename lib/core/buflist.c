@@ -28,33 +28,97 @@
 #include <sys/types.h>
 #endif
 
+/* lws_refbuf */
+
+struct lws_refbuf *
+lws_refbuf_create(const void *buf, size_t len)
+{
+	struct lws_refbuf *rb;
+
+	rb = lws_malloc(sizeof(*rb) + LWS_PRE + len, __func__);
+	if (!rb)
+		return NULL;
+
+	rb->len = len;
+	rb->refcount = 1;
+	if (buf && len)
+		memcpy(lws_refbuf_payload(rb), buf, len);
+
+	return rb;
+}
+
+uint8_t *
+lws_refbuf_payload(struct lws_refbuf *rb)
+{
+	return (uint8_t *)&rb[1] + LWS_PRE;
+}
+
+size_t
+lws_refbuf_len(const struct lws_refbuf *rb)
+{
+	return rb->len;
+}
+
+struct lws_refbuf *
+lws_refbuf_ref(struct lws_refbuf *rb)
+{
+	rb->refcount++;
+
+	return rb;
+}
+
+void
+lws_refbuf_unref(struct lws_refbuf **prb)
+{
+	struct lws_refbuf *rb = *prb;
+
+	if (!rb)
+		return;
+
+	*prb = NULL;
+	assert(rb->refcount);
+	if (!--rb->refcount)
+		lws_free(rb);
+}
+
 /* lws_buflist */
 
-int
-lws_buflist_append_segment(struct lws_buflist **head, const uint8_t *buf,
-			   size_t len)
+static struct lws_buflist **
+lws_buflist_tail(struct lws_buflist **head)
 {
-	struct lws_buflist *nbuf;
-	int first = !*head;
-	void *p = *head;
 	int sanity = 1024;
 
-	assert(buf);
-	assert(len);
-
-	/* append at the tail */
 	while (*head) {
 		if (!--sanity) {
 			lwsl_err("%s: buflist reached sanity limit\n", __func__);
-			return -1;
+			return NULL;
 		}
 		if (*head == (*head)->next) {
 			lwsl_err("%s: corrupt list points to self\n", __func__);
-			return -1;
+			return NULL;
 		}
 		head = &((*head)->next);
 	}
 
+	return head;
+}
+
+int
+lws_buflist_append_segment(struct lws_buflist **head, const uint8_t *buf,
+			   size_t len)
+{
+	struct lws_buflist *nbuf;
+	int first = !*head;
+	void *p = *head;
+
+	assert(buf);
+	assert(len);
+
+	/* append at the tail */
+	head = lws_buflist_tail(head);
+	if (!head)
+		return -1;
+
 	(void)p;
 	lwsl_info("%s: len %u first %d %p\n", __func__, (unsigned int)len,
 					      first, p);
@@ -69,16 +133,59 @@ lws_buflist_append_segment(struct lws_buflist **head, const uint8_t *buf,
 	nbuf->len = len;
 	nbuf->pos = 0;
 	nbuf->next = NULL;
+	nbuf->rb = NULL;
 
 	/* whoever consumes this might need LWS_PRE from the start... */
-	p = (uint8_t *)nbuf + sizeof(*nbuf) + LWS_PRE;
-	memcpy(p, buf, len);
+	nbuf->data = (uint8_t *)nbuf + sizeof(*nbuf) + LWS_PRE;
+	memcpy(nbuf->data, buf, len);
 
 	*head = nbuf;
 
 	return first; /* returns 1 if first segment just created */
 }
 
+int
+lws_buflist_append_segment_refbuf(struct lws_buflist **head,
+				  struct lws_refbuf *rb, const uint8_t *buf,
+				  size_t len)
+{
+	struct lws_buflist *nbuf;
+	int first = !*head;
+
+	assert(len);
+	assert(buf >= lws_refbuf_payload(rb) &&
+	       buf + len <= lws_refbuf_payload(rb) + rb->len);
+
+	head = lws_buflist_tail(head);
+	if (!head)
+		return -1;
+
+	/* the segment just refers to the data, the refbuf keeps it alive */
+
+	nbuf = (struct lws_buflist *)lws_malloc(sizeof(*nbuf), __func__);
+	if (!nbuf) {
+		lwsl_err("%s: OOM\n", __func__);
+		return -1;
+	}
+
+	nbuf->len = len;
+	nbuf->pos = 0;
+	nbuf->next = NULL;
+	nbuf->rb = lws_refbuf_ref(rb);
+	nbuf->data = (uint8_t *)buf;
+
+	*head = nbuf;
+
+	return first;
+}
+
+static void
+lws_buflist_free_segment(struct lws_buflist *b)
+{
+	lws_refbuf_unref(&b->rb);
+	lws_free(b);
+}
+
 static int
 lws_buflist_destroy_segment(struct lws_buflist **head)
 {
@@ -88,7 +195,7 @@ lws_buflist_destroy_segment(struct lws_buflist **head)
 	*head = old->next;
 	old->next = NULL;
 	old->pos = old->len = 0;
-	lws_free(old);
+	lws_buflist_free_segment(old);
 
 	return !*head; /* returns 1 if last segment just destroyed */
 }
@@ -101,7 +208,7 @@ lws_buflist_destroy_all_segments(struct lws_buflist **head)
 	while (p) {
 		p1 = p->next;
 		p->next = NULL;
-		lws_free(p);
+		lws_buflist_free_segment(p);
 		p = p1;
 	}
 
@@ -130,7 +237,7 @@ lws_buflist_next_segment_len(struct lws_buflist **head, uint8_t **buf)
 	assert(b->pos < b->len);
 
 	if (buf)
-		*buf = ((uint8_t *)b) + sizeof(*b) + b->pos + LWS_PRE;
+		*buf = b->data + b->pos;
 
 	return b->len - b->pos;
 }
@@ -185,7 +292,7 @@ lws_buflist_linear_copy(struct lws_buflist **head, size_t ofs, uint8_t *buf,
 			s = p->len - ofs;
 			if (s > len)
 				s = len;
-			memcpy(buf, ((uint8_t *)&p[1]) + LWS_PRE + ofs, s);
+			memcpy(buf, p->data + ofs, s);
 			len -= s;
 			buf += s;
 			ofs = 0;
@@ -279,6 +279,11 @@ lws_create_context(const struct lws_context_creation_info *info)
 			  __func__, context->udp_loss_sim_tx_pc,
 			  context->udp_loss_sim_rx_pc);
 
+#if defined(LWS_WITH_SYS_ASYNC_DNS)
+	context->async_dns.prefetch_pc = info->async_dns_prefetch_pc;
+	context->async_dns.servers = info->async_dns_servers;
+#endif
+
 #if defined(LWS_WITH_SECURE_STREAMS_PROXY_API)
 	context->ss_proxy_bind = info->ss_proxy_bind;
 	context->ss_proxy_port = info->ss_proxy_port;
@@ -806,7 +811,7 @@ lws_create_context(const struct lws_context_creation_info *info)
 
 #if defined(LWS_WITH_SECURE_STREAMS)
 
-	if (context->pss_policies_json) {
+	if (context->pss_policies_json || info->pss_policies_bin) {
 		/*
 		 * You must create your context with the explicit vhosts flag
 		 * in order to use secure streams
@@ -814,6 +819,17 @@ lws_create_context(const struct lws_context_creation_info *info)
 		assert(lws_check_opt(info->options,
 		       LWS_SERVER_OPTION_EXPLICIT_VHOSTS));
 
+		/* a usable precompiled policy means we don't parse the JSON */
+
+		if (info->pss_policies_bin &&
+		    !lws_ss_policy_bin_load(context, info->pss_policies_bin))
+			goto policy_done;
+
+		if (!context->pss_policies_json) {
+			lwsl_err("%s: no usable policy\n", __func__);
+			goto bail;
+		}
+
 		if (lws_ss_policy_parse_begin(context))
 			goto bail;
 
@@ -829,6 +845,8 @@ lws_create_context(const struct lws_context_creation_info *info)
 		}
 	} else
 		lws_create_vhost(context, info);
+
+policy_done:
 #endif
 
 	lws_context_init_extensions(info, context);
@@ -986,6 +1004,10 @@ lws_context_destroy3(struct lws_context *context)
 		lws_system_blob_destroy(
 				lws_system_get_blob(context, n, 0));
 
+#if defined(LWS_WITH_ZIP_FOPS)
+	lws_fops_zip_cache_purge(&context->fops_platform);
+#endif
+
 	lws_free(context);
 	lwsl_info("%s: ctx %p freed\n", __func__, context);
 
@@ -1029,6 +1051,8 @@ lws_context_destroy2(struct lws_context *context)
 		lws_dll2_foreach_safe(&pt->ss_owner, NULL, lws_ss_destroy_dll);
 		if (context->ac_policy)
 			lwsac_free(&context->ac_policy);
+		lws_ss_policy_bin_free(context);
+		context->pss_policy_hash = NULL;
 #endif
 
 #if defined(LWS_WITH_SECURE_STREAMS_PROXY_API)
@@ -445,8 +445,13 @@ struct lws_context {
 #if defined(LWS_WITH_SECURE_STREAMS)
 	const char *pss_policies_json;
 	const lws_ss_policy_t *pss_policies;
+	const lws_ss_policy_t **pss_policy_hash; /* by streamtype, in ac_policy */
 	const lws_ss_plugin_t **pss_plugins;
 	struct lwsac *ac_policy;
+	void *pol_bin; /* binary policy in force, or NULL */
+	size_t pol_bin_len;
+	uint32_t pss_policy_hash_mask;
+	uint8_t pol_bin_mapped; /* pol_bin is mmapped, not on the heap */
 #endif
 
 	void *external_baggage_free_on_destroy;
@@ -557,8 +562,17 @@ int
 lws_system_do_attach(struct lws_context_per_thread *pt);
 #endif
 
+struct lws_refbuf {
+	size_t len;
+	unsigned int refcount;
+
+	/* LWS_PRE + len payload follows */
+};
+
 struct lws_buflist {
 	struct lws_buflist *next;
+	struct lws_refbuf *rb; /* NULL, or holds data alive for us */
+	uint8_t *data; /* our own copy following us, or inside rb */
 	size_t len;
 	size_t pos;
 };
@@ -722,6 +736,11 @@ LWS_EXTERN int alloc_file(struct lws_context *context, const char *filename,
 void
 lws_context_destroy2(struct lws_context *context);
 
+#if defined(LWS_WITH_ZIP_FOPS)
+void
+lws_fops_zip_cache_purge(const struct lws_plat_file_ops *fops);
+#endif
+
 #if !defined(PRIu64)
 #define PRIu64 "llu"
 #endif
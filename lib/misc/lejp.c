@@ -27,6 +27,12 @@
 #include <string.h>
 #include <stdio.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 static const char * const parser_errs[] = {
 	"",
 	"",
@@ -54,6 +60,31 @@ static const char * const parser_errs[] = {
 	"Parser callback errored (see earlier error)",
 };
 
+/*
+ * A path index is the path table compiled into a trie, one node per distinct
+ * prefix, so matching costs one walk down the trie whatever the number of
+ * paths.  Children of a node are a sibling list.  '*' nodes are wildcards
+ * with the same meaning as in the linear matcher.
+ */
+
+struct lejp_pi_node {
+	uint16_t child;		/* first child, 0 = none (root is never one) */
+	uint16_t sibling;	/* next sibling, 0 = none */
+	uint8_t c;		/* char on the edge into this node */
+	uint8_t match;		/* path index + 1 if a path ends here */
+	uint8_t lo;		/* lowest path index + 1 ending below here */
+};
+
+struct lejp_path_index {
+	const char * const *paths;
+	size_t path_stride;
+	uint16_t count_nodes;
+	uint8_t count_paths;
+	/* struct lejp_pi_node array follows */
+};
+
+#define lejp_pi_nodes(_pi) ((struct lejp_pi_node *)&(_pi)[1])
+
 /**
  * lejp_construct - prepare a struct lejp_ctx for use
  *
@@ -89,10 +120,114 @@ lejp_construct(struct lejp_ctx *ctx,
 	ctx->pst[0].count_paths = count_paths;
 	ctx->pst[0].user = NULL;
 	ctx->pst[0].ppos = 0;
+	ctx->pst[0].pidx = NULL;
 
 	ctx->pst[0].callback(ctx, LEJPCB_CONSTRUCTED);
 }
 
+/**
+ * lejp_construct_indexed - prepare a struct lejp_ctx using a path index
+ *
+ * \param ctx:	pointer to your struct lejp_ctx
+ * \param callback:	your user callback which will received parsed tokens
+ * \param user:	optional user data pointer untouched by lejp
+ * \param pidx:	path index from lejp_path_index_create()
+ *
+ * Like lejp_construct(), but the paths, count and stride come from the index,
+ * which is used to match them.  The index must outlive the ctx.
+ */
+
+void
+lejp_construct_indexed(struct lejp_ctx *ctx,
+	signed char (*callback)(struct lejp_ctx *ctx, char reason), void *user,
+			const struct lejp_path_index *pidx)
+{
+	lejp_construct(ctx, callback, user, pidx->paths, pidx->count_paths);
+	ctx->path_stride = pidx->path_stride;
+	ctx->pst[0].pidx = pidx;
+}
+
+/**
+ * lejp_path_index_create - compile a path table for faster matching
+ *
+ * \param paths:	your array of name elements you are interested in
+ * \param count_paths:	LWS_ARRAY_SIZE() of @paths
+ * \param path_stride:	0 for an array of char *, else the array stride
+ *
+ * Returns a heap-allocated index for use with lejp_construct_indexed(), or
+ * NULL on OOM.  The paths must outlive the index.
+ */
+
+struct lejp_path_index *
+lejp_path_index_create(const char * const *paths, unsigned char count_paths,
+		       size_t path_stride)
+{
+	struct lejp_path_index *pi;
+	struct lejp_pi_node *nd;
+	size_t s = path_stride ? path_stride : sizeof(char *), total = 1;
+	const char *q;
+	int n, ni, ci;
+
+	for (n = 0; n < count_paths; n++)
+		total += strlen(*((char **)(((char *)paths) + (n * s))));
+
+	if (total > 0xffff)
+		return NULL;
+
+	pi = lws_zalloc(sizeof(*pi) + (total * sizeof(*nd)), __func__);
+	if (!pi)
+		return NULL;
+
+	pi->paths = paths;
+	pi->path_stride = path_stride;
+	pi->count_paths = count_paths;
+	pi->count_nodes = 1;
+	nd = lejp_pi_nodes(pi);
+
+	for (n = 0; n < count_paths; n++) {
+		q = *((char **)(((char *)paths) + (n * s)));
+		ni = 0;
+
+		/* paths are added in order, so the first to get here is lo */
+		if (!nd[0].lo)
+			nd[0].lo = (uint8_t)(n + 1);
+
+		while (*q) {
+			for (ci = nd[ni].child; ci; ci = nd[ci].sibling)
+				if (nd[ci].c == (uint8_t)*q)
+					break;
+			if (!ci) {
+				ci = pi->count_nodes++;
+				nd[ci].c = (uint8_t)*q;
+				nd[ci].sibling = nd[ni].child;
+				nd[ni].child = (uint16_t)ci;
+			}
+			ni = ci;
+			if (!nd[ni].lo)
+				nd[ni].lo = (uint8_t)(n + 1);
+			q++;
+		}
+
+		/* a duplicate path can never match, as in the linear case */
+		if (!nd[ni].match)
+			nd[ni].match = (uint8_t)(n + 1);
+	}
+
+	return pi;
+}
+
+/**
+ * lejp_path_index_destroy - free a path index
+ *
+ * \param pidx:	pointer to the index pointer, set to NULL
+ */
+
+void
+lejp_path_index_destroy(struct lejp_path_index **pidx)
+{
+	lws_free_set_NULL(*pidx);
+}
+
 /**
  * lejp_destruct - retire a previously constructed struct lejp_ctx
  *
@@ -142,16 +277,97 @@ lejp_change_callback(struct lejp_ctx *ctx,
 	ctx->pst[0].callback(ctx, LEJPCB_START);
 }
 
+/*
+ * Walk the trie along p, finding the lowest-indexed path that matches, which
+ * is the one the linear search would find first.  Literal chars are followed
+ * iteratively, we only recurse for '*' nodes, so depth is bounded by the
+ * number of wildcards.  Subtrees that can only produce a later path than the
+ * best one so far are skipped.
+ */
+
+static void
+lejp_pi_walk(struct lejp_ctx *ctx, const struct lejp_path_index *pi, int ni,
+	     const char *p, int *best, uint16_t *wild, int wc)
+{
+	const struct lejp_pi_node *nd = lejp_pi_nodes(pi);
+	const char *p1;
+	int ci, next;
+
+	while (nd[ni].lo && nd[ni].lo < *best) {
+		if (!*p) {
+			if (nd[ni].match && nd[ni].match < *best) {
+				*best = nd[ni].match;
+				memcpy(ctx->wild, wild, (unsigned int)wc *
+							sizeof(*wild));
+				ctx->wildcount = (uint8_t)wc;
+			}
+			return;
+		}
+
+		next = 0;
+		for (ci = nd[ni].child; ci; ci = nd[ci].sibling) {
+			if (nd[ci].c != '*') {
+				if (nd[ci].c == (uint8_t)*p)
+					next = ci;
+				continue;
+			}
+			if (wc == LEJP_MAX_INDEX_DEPTH)
+				continue;
+
+			wild[wc] = (uint16_t)lws_ptr_diff(p, ctx->path);
+
+			/* '*' ending the path eats everything */
+			if (nd[ci].match && nd[ci].match < *best) {
+				*best = nd[ci].match;
+				memcpy(ctx->wild, wild, (unsigned int)(wc + 1) *
+							sizeof(*wild));
+				ctx->wildcount = (uint8_t)(wc + 1);
+			}
+
+			/* otherwise it eats up to the next '.' */
+			if (nd[ci].child) {
+				p1 = p;
+				while (*p1 && *p1 != '.')
+					p1++;
+				lejp_pi_walk(ctx, pi, ci, p1, best, wild, wc + 1);
+			}
+		}
+
+		if (!next)
+			return;
+
+		ni = next;
+		p++;
+	}
+}
+
 void
 lejp_check_path_match(struct lejp_ctx *ctx)
 {
+	const struct lejp_path_index *pi = ctx->pst[ctx->pst_sp].pidx;
+	uint16_t wild[LEJP_MAX_INDEX_DEPTH];
 	const char *p, *q;
-	int n;
+	int n, best;
 	size_t s = sizeof(char *);
 
 	if (ctx->path_stride)
 		s = ctx->path_stride;
 
+	if (pi) {
+		if (ctx->path_match)
+			return;
+
+		best = pi->count_paths + 1;
+		ctx->wildcount = 0;
+		lejp_pi_walk(ctx, pi, 0, ctx->path, &best, wild, 0);
+		if (best <= pi->count_paths) {
+			ctx->path_match = (uint8_t)best;
+			ctx->path_match_len = ctx->pst[ctx->pst_sp].ppos;
+		}
+
+		return;
+	}
+
 	/* we only need to check if a match is not active */
 	for (n = 0; !ctx->path_match &&
 	     n < ctx->pst[ctx->pst_sp].count_paths; n++) {
@@ -213,6 +429,122 @@ lejp_get_wildcard(struct lejp_ctx *ctx, int wildcard, char *dest, int len)
 	return n - ctx->wild[wildcard];
 }
 
+/*
+ * Count the bytes from p that a string value just takes as they are, ie, up
+ * to the first '"', '\\' or control char.  Checks 16 or 8 at a time where it
+ * can.
+ */
+
+static int
+lejp_scan_str(const unsigned char *p, int len)
+{
+	int n = 0;
+#if defined(__SSE2__)
+	const __m128i q = _mm_set1_epi8('\"'), bs = _mm_set1_epi8('\\'),
+		      lim = _mm_set1_epi8(0x1f);
+	__m128i v;
+	int m;
+
+	while (n + 16 <= len) {
+		v = _mm_loadu_si128((const __m128i *)(p + n));
+		m = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(
+				_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, bs)),
+				_mm_cmpeq_epi8(_mm_min_epu8(v, lim), v)));
+		if (m)
+			return n + __builtin_ctz((unsigned int)m);
+		n += 16;
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	uint8x16_t v;
+
+	while (n + 16 <= len) {
+		v = vld1q_u8(p + n);
+		if (vmaxvq_u8(vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('\"')),
+						vceqq_u8(v, vdupq_n_u8('\\'))),
+				       vcltq_u8(v, vdupq_n_u8(0x20)))))
+			break;
+		n += 16;
+	}
+#else
+	uint64_t w, x, y;
+
+	/* the usual "has a zero byte" trick on w ^ '"', w ^ '\\' and w < 0x20 */
+	while (n + 8 <= len) {
+		memcpy(&w, p + n, 8);
+		x = w ^ 0x2222222222222222ull;
+		y = w ^ 0x5c5c5c5c5c5c5c5cull;
+		if ((((x - 0x0101010101010101ull) & ~x) |
+		     ((y - 0x0101010101010101ull) & ~y) |
+		     ((w - 0x2020202020202020ull) & ~w)) &
+						0x8080808080808080ull)
+			break;
+		n += 8;
+	}
+#endif
+
+	while (n < len && p[n] != '"' && p[n] != '\\' && p[n] >= 0x20)
+		n++;
+
+	return n;
+}
+
+/*
+ * Count the JSON whitespace bytes from p, adding any '\n' to *lines
+ */
+
+static int
+lejp_scan_ws(const unsigned char *p, int len, uint32_t *lines)
+{
+	int n = 0;
+#if defined(__SSE2__)
+	__m128i v, nl;
+	int m, l;
+
+	while (n + 16 <= len) {
+		v = _mm_loadu_si128((const __m128i *)(p + n));
+		nl = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+		m = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(nl,
+				_mm_cmpeq_epi8(v, _mm_set1_epi8(' '))),
+				_mm_or_si128(
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')),
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')))));
+		l = _mm_movemask_epi8(nl);
+		if (m != 0xffff) {
+			m = __builtin_ctz((unsigned int)~m);
+			*lines += (uint32_t)__builtin_popcount(
+					(unsigned int)l & ((1u << m) - 1));
+
+			return n + m;
+		}
+		*lines += (uint32_t)__builtin_popcount((unsigned int)l);
+		n += 16;
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	uint8x16_t v, nl;
+
+	while (n + 16 <= len) {
+		v = vld1q_u8(p + n);
+		nl = vceqq_u8(v, vdupq_n_u8('\n'));
+		if (vminvq_u8(vorrq_u8(vorrq_u8(nl,
+				vceqq_u8(v, vdupq_n_u8(' '))),
+				vorrq_u8(vceqq_u8(v, vdupq_n_u8('\t')),
+					 vceqq_u8(v, vdupq_n_u8('\r'))))) != 0xff)
+			break;
+		*lines += vaddvq_u8(vandq_u8(nl, vdupq_n_u8(1)));
+		n += 16;
+	}
+#endif
+
+	while (n < len && (p[n] == ' ' || p[n] == '\t' || p[n] == '\r' ||
+			   p[n] == '\n')) {
+		if (p[n] == '\n')
+			(*lines)++;
+		n++;
+	}
+
+	return n;
+}
+
 /**
  * lejp_parse - interpret some more incoming data incrementally
  *
@@ -236,6 +568,8 @@ lejp_parse(struct lejp_ctx *ctx, const unsigned char *json, int len)
 	static const char esc_char[] = "\"\\/bfnrt";
 	static const char esc_tran[] = "\"\\/\b\f\n\r\t";
 	static const char tokens[] = "rue alse ull ";
+	const unsigned char *nl;
+	int run;
 
 	if (!ctx->sp && !ctx->pst[ctx->pst_sp].ppos)
 		ctx->pst[ctx->pst_sp].callback(ctx, LEJPCB_START);
@@ -254,12 +588,26 @@ lejp_parse(struct lejp_ctx *ctx, const unsigned char *json, int len)
 				if (c == '#')
 					ctx->st[ctx->sp].s |=
 						LEJP_FLAG_WS_COMMENTLINE;
+				else if (!(ctx->st[ctx->sp].s &
+						LEJP_FLAG_WS_COMMENTLINE)) {
+					/* take the rest of the run in one go */
+					run = lejp_scan_ws(json, len,
+							   &ctx->line);
+					json += run;
+					len -= run;
+				}
 				continue;
 			}
 		}
 
-		if (ctx->st[ctx->sp].s & LEJP_FLAG_WS_COMMENTLINE)
+		if (ctx->st[ctx->sp].s & LEJP_FLAG_WS_COMMENTLINE) {
+			/* nothing matters until the end of the line */
+			nl = memchr(json, '\n', (unsigned int)len);
+			run = nl ? lws_ptr_diff(nl, json) : len;
+			json += run;
+			len -= run;
 			continue;
+		}
 
 		switch (s) {
 		case LEJP_IDLE:
@@ -752,12 +1100,31 @@ emit_string_char:
 		if (!ctx->sp || ctx->st[ctx->sp - 1].s != LEJP_MP_DELIM) {
 			/* assemble the string value into chunks */
 			ctx->buf[ctx->npos++] = c;
-			if (ctx->npos == sizeof(ctx->buf) - 1) {
-				if (ctx->pst[ctx->pst_sp].callback(ctx, LEJPCB_VAL_STR_CHUNK)) {
-					ret = LEJP_REJECT_CALLBACK;
-					goto reject;
+			while (1) {
+				if (ctx->npos == sizeof(ctx->buf) - 1) {
+					if (ctx->pst[ctx->pst_sp].callback(ctx,
+							LEJPCB_VAL_STR_CHUNK)) {
+						ret = LEJP_REJECT_CALLBACK;
+						goto reject;
+					}
+					ctx->npos = 0;
 				}
-				ctx->npos = 0;
+				if (ctx->st[ctx->sp].s != LEJP_MP_STRING)
+					break;
+
+				/*
+				 * copy the plain run that follows in bulk, up
+				 * to the end of the chunk buffer so chunking
+				 * is unchanged
+				 */
+				run = (int)(sizeof(ctx->buf) - 1 - ctx->npos);
+				run = lejp_scan_str(json, len < run ? len : run);
+				if (!run)
+					break;
+				memcpy(&ctx->buf[ctx->npos], json, (size_t)run);
+				ctx->npos = (uint8_t)(ctx->npos + run);
+				json += run;
+				len -= run;
 			}
 			continue;
 		}
@@ -823,6 +1190,7 @@ lejp_parser_push(struct lejp_ctx *ctx, void *user, const char * const *paths,
 	p->paths = paths;
 	p->count_paths = paths_count;
 	p->ppos = 0;
+	p->pidx = NULL;
 
 	ctx->path_match = 0;
 	lejp_check_path_match(ctx);
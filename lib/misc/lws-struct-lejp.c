@@ -452,25 +452,102 @@ lws_struct_pretty(lws_struct_serialize_t *js, uint8_t **pbuf, size_t *plen)
 	}
 }
 
+/*
+ * Space kept back at the end of the buffer while serializing, so structural
+ * chars, numbers and the closing quote of a string always fit once we have
+ * started on an entry
+ */
+#define LSJS_RESERVE 92
+
+/* plain decimal formatting, much cheaper than going via printf */
+
+static size_t
+lws_struct_fmt_u64(uint8_t *p, unsigned long long v)
+{
+	char t[20];
+	size_t n = 0, m;
+
+	do {
+		t[n++] = (char)('0' + (v % 10));
+		v /= 10;
+	} while (v);
+
+	for (m = 0; m < n; m++)
+		p[m] = (uint8_t)t[n - 1 - m];
+
+	return n;
+}
+
+/*
+ * JSON-escape as much of in as fits in olen bytes of out, copying the runs
+ * that need no escaping in one go.  *used is set to how much of in was
+ * consumed, and the amount written is returned.
+ */
+
+static size_t
+lws_struct_escape(uint8_t *out, size_t olen, const char *in, size_t *used)
+{
+	static const char hex[] = "0123456789abcdef";
+	const uint8_t *p = (const uint8_t *)in, *r;
+	uint8_t *o = out, *oe = out + olen;
+	size_t n;
+
+	while (*p) {
+		r = p;
+		while (*r >= 0x20 && *r != '\"' && *r != '\\')
+			r++;
+		n = (size_t)lws_ptr_diff(r, p);
+		if (n > (size_t)lws_ptr_diff(oe, o))
+			n = (size_t)lws_ptr_diff(oe, o);
+		memcpy(o, p, n);
+		o += n;
+		p += n;
+		if (p != r || !*p)
+			break;
+
+		/* *p needs escaping */
+
+		if (*p == '\t' || *p == '\n' || *p == '\r') {
+			if (oe - o < 2)
+				break;
+			*o++ = '\\';
+			*o++ = *p == '\t' ? 't' : (*p == '\n' ? 'n' : 'r');
+		} else {
+			if (oe - o < 6)
+				break;
+			*o++ = '\\';
+			*o++ = 'u';
+			*o++ = '0';
+			*o++ = '0';
+			*o++ = (uint8_t)hex[(*p >> 4) & 15];
+			*o++ = (uint8_t)hex[*p & 15];
+		}
+		p++;
+	}
+
+	*used = (size_t)lws_ptr_diff(p, in);
+
+	return (size_t)lws_ptr_diff(o, out);
+}
+
 lws_struct_json_serialize_result_t
 lws_struct_json_serialize(lws_struct_serialize_t *js, uint8_t *buf,
 			  size_t len, size_t *written)
 {
 	lws_struct_serialize_st_t *j;
 	const lws_struct_map_t *map;
-	size_t budget = 0, olen = len, m;
+	size_t olen = len, m, used;
 	struct lws_dll2_owner *o;
 	unsigned long long uli;
 	const char *q;
 	const void *p;
-	char dbuf[72];
 	long long li;
-	int n, used;
+	int n;
 
 	*written = 0;
 	*buf = '\0';
 
-	while (len > sizeof(dbuf) + 20) {
+	while (len > LSJS_RESERVE) {
 		j = &js->st[js->sp];
 		map = &j->map[j->map_entry];
 		q = j->obj + map->ofs;
@@ -496,21 +573,40 @@ lws_struct_json_serialize(lws_struct_serialize_t *js, uint8_t *buf,
 			break;
 		}
 
-		if (j->subsequent) {
-			*buf++ = ',';
-			len--;
-			lws_struct_pretty(js, &buf, &len);
-		}
-		j->subsequent = 1;
+		/*
+		 * If we are resuming a string value that didn't fit last time,
+		 * its key and opening quote were already issued
+		 */
 
-		if (map->type != LSMT_SCHEMA && !js->offset) {
-			n = lws_snprintf((char *)buf, len, "\"%s\":",
-					    map->colname);
-			buf += n;
-			len -= n;
-			if (js->flags & LSSERJ_FLAG_PRETTY) {
-				*buf++ = ' ';
+		if (!j->str_open) {
+			m = strlen(map->colname);
+
+			/* leave the whole entry for next time if it won't fit */
+			if (len <= m + 8 + (size_t)j->idt + LSJS_RESERVE) {
+				if (len == olen)
+					/* ... and it never will */
+					return LSJS_RESULT_ERROR;
+				break;
+			}
+
+			if (j->subsequent) {
+				*buf++ = ',';
 				len--;
+				lws_struct_pretty(js, &buf, &len);
+			}
+			j->subsequent = 1;
+
+			if (map->type != LSMT_SCHEMA) {
+				*buf++ = '\"';
+				memcpy(buf, map->colname, m);
+				buf += m;
+				*buf++ = '\"';
+				*buf++ = ':';
+				len -= m + 3;
+				if (js->flags & LSSERJ_FLAG_PRETTY) {
+					*buf++ = ' ';
+					len--;
+				}
 			}
 		}
 
@@ -529,14 +625,14 @@ lws_struct_json_serialize(lws_struct_serialize_t *js, uint8_t *buf,
 						uli = *(unsigned long long *)q;
 				}
 			}
-			q = dbuf;
 
 			if (map->type == LSMT_BOOLEAN) {
-				budget = lws_snprintf(dbuf, sizeof(dbuf),
-						"%s", uli ? "true" : "false");
+				m = uli ? 4 : 5;
+				memcpy(buf, uli ? "true" : "false", m);
 			} else
-				budget = lws_snprintf(dbuf, sizeof(dbuf),
-						      "%llu", uli);
+				m = lws_struct_fmt_u64(buf, uli);
+			buf += m;
+			len -= m;
 			break;
 
 		case LSMT_SIGNED:
@@ -552,16 +648,48 @@ lws_struct_json_serialize(lws_struct_serialize_t *js, uint8_t *buf,
 						li = *(long long *)q;
 				}
 			}
-			q = dbuf;
-			budget = lws_snprintf(dbuf, sizeof(dbuf), "%lld", li);
+			if (li < 0) {
+				*buf++ = '-';
+				len--;
+				/* can't simply negate LLONG_MIN */
+				uli = (unsigned long long)(-(li + 1)) + 1;
+			} else
+				uli = (unsigned long long)li;
+			m = lws_struct_fmt_u64(buf, uli);
+			buf += m;
+			len -= m;
 			break;
 
 		case LSMT_STRING_CHAR_ARRAY:
 		case LSMT_STRING_PTR:
-			if (!js->offset) {
+			if (!j->str_open) {
 				*buf++ = '\"';
 				len--;
+				j->str_open = 1;
+			}
+
+			/*
+			 * Escaping may expand the string up to 6x, we issue as
+			 * much as fits and resume from js->offset next time.
+			 * If the rest didn't fit, even if none of it did, the
+			 * buffer is full.
+			 */
+
+			q += js->offset;
+			m = lws_struct_escape(buf, len - LSJS_RESERVE, q,
+					      &used);
+			buf += m;
+			len -= m;
+
+			if (q[used]) {
+				js->offset += used;
+				goto full;
 			}
+
+			js->offset = 0;
+			j->str_open = 0;
+			*buf++ = '\"';
+			len--;
 			break;
 
 		case LSMT_LIST:
@@ -583,7 +711,7 @@ lws_struct_json_serialize(lws_struct_serialize_t *js, uint8_t *buf,
 
 			n = j->idt;
 			j = &js->st[++js->sp];
-			j->idt = n + 2;
+			j->idt = (char)(n + 2);
 			j->map = map->child_map;
 			j->map_entries = map->child_map_size;
 			j->size = map->aux;
@@ -608,7 +736,7 @@ lws_struct_json_serialize(lws_struct_serialize_t *js, uint8_t *buf,
 
 			n = j->idt;
 			j = &js->st[++js->sp];
-			j->idt = n + 2;
+			j->idt = (char)(n + 2);
 			j->map = map->child_map;
 			j->map_entries = map->child_map_size;
 			j->size = map->aux;
@@ -622,19 +750,23 @@ lws_struct_json_serialize(lws_struct_serialize_t *js, uint8_t *buf,
 			continue;
 
 		case LSMT_SCHEMA:
-			q = dbuf;
 			*buf++ = '{';
 			len--;
 			j = &js->st[++js->sp];
 			lws_struct_pretty(js, &buf, &len);
-			budget = lws_snprintf(dbuf, 15, "\"schema\":");
-			if (js->flags & LSSERJ_FLAG_PRETTY)
-				dbuf[budget++] = ' ';
-
-			budget += lws_snprintf(dbuf + budget,
-					       sizeof(dbuf) - budget,
-					      "\"%s\"", map->colname);
-
+			memcpy(buf, "\"schema\":", 9);
+			buf += 9;
+			len -= 9;
+			if (js->flags & LSSERJ_FLAG_PRETTY) {
+				*buf++ = ' ';
+				len--;
+			}
+			m = strlen(map->colname);
+			*buf++ = '\"';
+			memcpy(buf, map->colname, m);
+			buf += m;
+			*buf++ = '\"';
+			len -= m + 2;
 
 			if (js->sp != 1)
 				return LSJS_RESULT_ERROR;
@@ -648,75 +780,9 @@ lws_struct_json_serialize(lws_struct_serialize_t *js, uint8_t *buf,
 			/* we're actually at the same level */
 			j->subsequent = 1;
 			j->idt = 1;
-			break;
-		}
-
-		switch (map->type) {
-		case LSMT_STRING_CHAR_ARRAY:
-		case LSMT_STRING_PTR:
-			/*
-			 * This is a bit tricky... we have to escape the string
-			 * which may 6x its length depending on what the
-			 * contents are.
-			 *
-			 * We offset the unescaped string starting point first
-			 */
-
-			q += js->offset;
-			budget = strlen(q); /* how much unescaped is left */
-
-			/*
-			 * This is going to escape as much as it can fit, and
-			 * let us know the amount of input that was consumed
-			 * in "used".
-			 */
-
-			lws_json_purify((char *)buf, q, len, &used);
-			m = strlen((const char *)buf);
-			buf += m;
-			len -= m;
-			js->remaining = budget - used;
-			js->offset = used;
-			if (!js->remaining)
-				js->offset = 0;
-
-			break;
-		default:
-			q += js->offset;
-			budget -= js->remaining;
-
-			if (budget > len) {
-				js->remaining = budget - len;
-				js->offset = len;
-				budget = len;
-			} else {
-				js->remaining = 0;
-				js->offset = 0;
-			}
-
-			memcpy(buf, q, budget);
-			buf += budget;
-			*buf = '\0';
-			len -= budget;
-			break;
-		}
-
-
-
-		switch (map->type) {
-		case LSMT_STRING_CHAR_ARRAY:
-		case LSMT_STRING_PTR:
-			*buf++ = '\"';
-			len--;
-			break;
-		case LSMT_SCHEMA:
 			continue;
-		default:
-			break;
 		}
 
-		if (js->remaining)
-			continue;
 up:
 		if (++j->map_entry < j->map_entries)
 			continue;
@@ -729,7 +795,11 @@ up:
 			*buf++ = '}';
 			len--;
 			lws_struct_pretty(js, &buf, &len);
-			break;
+
+			*written = olen - len;
+			*buf = '\0'; /* convenience, a NUL after the official end */
+
+			return LSJS_RESULT_FINISH;
 		}
 		js->offset = 0;
 		j = &js->st[js->sp];
@@ -789,8 +859,40 @@ up:
 		goto up;
 	}
 
+	/* we ran out of space, we'll pick up where we left off next time */
+
+full:
 	*written = olen - len;
-	*buf = '\0'; /* convenience, a NUL after the official end */
+	*buf = '\0';
+
+	return LSJS_RESULT_CONTINUE;
+}
+
+#if defined(LWS_ROLE_WS)
+lws_struct_json_serialize_result_t
+lws_struct_json_serialize_ws(lws_struct_serialize_t *js, struct lws *wsi,
+			     uint8_t *buf, size_t len)
+{
+	lws_struct_json_serialize_result_t r;
+	size_t w;
+
+	if (len <= LWS_PRE + LSJS_RESERVE)
+		return LSJS_RESULT_ERROR;
+
+	/* serialize straight into the area after the LWS_PRE headroom */
+
+	r = lws_struct_json_serialize(js, buf + LWS_PRE, len - LWS_PRE, &w);
+	if (r == LSJS_RESULT_ERROR)
+		return r;
+
+	if (lws_write(wsi, buf + LWS_PRE, w,
+		      (enum lws_write_protocol)lws_write_ws_flags(
+				LWS_WRITE_TEXT, !js->ws_started,
+				r == LSJS_RESULT_FINISH)) < (int)w)
+		return LSJS_RESULT_ERROR;
+
+	js->ws_started = 1;
 
-	return LSJS_RESULT_FINISH;
+	return r;
 }
+#endif
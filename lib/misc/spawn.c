@@ -304,15 +304,19 @@ lws_spawn_piped(const struct lws_spawn_piped_info *i)
 		lsp->pipe_fds[n][1] = -1;
 	}
 
-	/* create pipes for [stdin|stdout] and [stderr] */
+	/*
+	 * create pipes for [stdin|stdout] and [stderr]... if we were given
+	 * something else for the child's stdin, eg, a listen socket for a
+	 * FastCGI worker, there's no stdin pipe or stdwsi
+	 */
 
-	for (n = 0; n < 3; n++)
+	for (n = !!i->use_stdin_fd; n < 3; n++)
 		if (pipe(lsp->pipe_fds[n]) == -1)
 			goto bail1;
 
 	/* create wsis for each stdin/out/err fd */
 
-	for (n = 0; n < 3; n++) {
+	for (n = !!i->use_stdin_fd; n < 3; n++) {
 		lsp->stdwsi[n] = lws_create_basic_wsi(i->vh->context, i->tsi,
 					  i->ops ? i->ops : &role_ops_raw_file);
 		if (!lsp->stdwsi[n]) {
@@ -337,7 +341,7 @@ lws_spawn_piped(const struct lws_spawn_piped_info *i)
 		}
 	}
 
-	for (n = 0; n < 3; n++) {
+	for (n = !!i->use_stdin_fd; n < 3; n++) {
 		if (context->event_loop_ops->sock_accept)
 			if (context->event_loop_ops->sock_accept(lsp->stdwsi[n]))
 				goto bail3;
@@ -351,7 +355,8 @@ lws_spawn_piped(const struct lws_spawn_piped_info *i)
 		}
 	}
 
-	if (lws_change_pollfd(lsp->stdwsi[LWS_STDIN], LWS_POLLIN, LWS_POLLOUT))
+	if (lsp->stdwsi[LWS_STDIN] &&
+	    lws_change_pollfd(lsp->stdwsi[LWS_STDIN], LWS_POLLIN, LWS_POLLOUT))
 		goto bail3;
 	if (lws_change_pollfd(lsp->stdwsi[LWS_STDOUT], LWS_POLLOUT, LWS_POLLIN))
 		goto bail3;
@@ -359,7 +364,7 @@ lws_spawn_piped(const struct lws_spawn_piped_info *i)
 		goto bail3;
 
 	lwsl_debug("%s: fds in %d, out %d, err %d\n", __func__,
-		   lsp->stdwsi[LWS_STDIN]->desc.sockfd,
+		   lsp->pipe_fds[LWS_STDIN][1],
 		   lsp->stdwsi[LWS_STDOUT]->desc.sockfd,
 		   lsp->stdwsi[LWS_STDERR]->desc.sockfd);
 
@@ -398,12 +403,12 @@ lws_spawn_piped(const struct lws_spawn_piped_info *i)
 		 *  close:                stdin:r, stdout:w, stderr:w
 		 * hide from other forks: stdin:w, stdout:r, stderr:r
 		 */
-		for (n = 0; n < 3; n++) {
+		for (n = !!i->use_stdin_fd; n < 3; n++) {
 			lws_plat_apply_FD_CLOEXEC(lsp->pipe_fds[n][!!(n == 0)]);
 			close(lsp->pipe_fds[n][!(n == 0)]);
 		}
 
-		lsp->pipes_alive = 3;
+		lsp->pipes_alive = 3 - !!i->use_stdin_fd;
 		lsp->created = lws_now_usecs();
 
 		if (i->owner)
@@ -439,7 +444,16 @@ lws_spawn_piped(const struct lws_spawn_piped_info *i)
 	if (chdir(wd))
 		lwsl_notice("%s: Failed to cd to %s\n", __func__, wd);
 
-	for (m = 0; m < 3; m++) {
+	if (i->use_stdin_fd) {
+		/* dup2() onto itself doesn't clear FD_CLOEXEC, so do it here */
+		if (i->stdin_fd ? dup2(i->stdin_fd, 0) < 0 :
+				  fcntl(0, F_SETFD, 0) < 0) {
+			lwsl_err("%s: stdin dup2 failed\n", __func__);
+			goto bail3;
+		}
+	}
+
+	for (m = !!i->use_stdin_fd; m < 3; m++) {
 		if (dup2(lsp->pipe_fds[m][!(m == 0)], m) < 0) {
 			lwsl_err("%s: stdin dup2 failed\n", __func__);
 			goto bail3;
@@ -473,7 +487,7 @@ lws_spawn_piped(const struct lws_spawn_piped_info *i)
 
 bail3:
 
-	while (--n >= 0)
+	while (--n >= !!i->use_stdin_fd)
 		__remove_wsi_socket_from_fds(lsp->stdwsi[n]);
 bail2:
 	for (n = 0; n < 3; n++)
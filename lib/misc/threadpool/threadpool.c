@@ -36,7 +36,7 @@
 struct lws_threadpool;
 
 struct lws_threadpool_task {
-	struct lws_threadpool_task *task_queue_next;
+	lws_dll2_t list; /* on tp->task_queue or tp->task_done */
 
 	struct lws_threadpool *tp;
 	char name[32];
@@ -66,6 +66,7 @@ struct lws_pool {
 	pthread_mutex_t lock; /* part of task wake_idle */
 	struct lws_threadpool_task *task;
 	lws_usec_t acquired;
+	unsigned int tasks_run;
 	int worker_index;
 };
 
@@ -77,26 +78,24 @@ struct lws_threadpool {
 	struct lws_context *context;
 	struct lws_threadpool *tp_list; /* context list of threadpools */
 
-	struct lws_threadpool_task *task_queue_head;
-	struct lws_threadpool_task *task_done_head;
+	lws_dll2_owner_t task_queue; /* oldest at the head */
+	lws_dll2_owner_t task_done;
 
 	char name[32];
 
+	/* metrics for tasks that left the queue, for lws_threadpool_dump() */
+	lws_usec_t acc_queued;
+	lws_usec_t max_queued;
+	lws_usec_t acc_run;
+	unsigned int tasks_run;
+
 	int threads_in_pool;
-	int queue_depth;
-	int done_queue_depth;
 	int max_queue_depth;
 	int running_tasks;
 
 	unsigned int destroying:1;
 };
 
-static int
-ms_delta(lws_usec_t now, lws_usec_t then)
-{
-	return (int)((now - then) / 1000);
-}
-
 static void
 us_accrue(lws_usec_t *acc, lws_usec_t then)
 {
@@ -105,6 +104,13 @@ us_accrue(lws_usec_t *acc, lws_usec_t then)
 	*acc += now - then;
 }
 
+#if defined(_DEBUG)
+static int
+ms_delta(lws_usec_t now, lws_usec_t then)
+{
+	return (int)((now - then) / 1000);
+}
+
 static int
 pc_delta(lws_usec_t now, lws_usec_t then, lws_usec_t us)
 {
@@ -160,34 +166,41 @@ __lws_threadpool_task_dump(struct lws_threadpool_task *task, char *buf, int len)
 		pc_delta(task->done, task->acquired, syncms));
 }
 
+static int
+lws_threadpool_task_dump_cb(struct lws_dll2 *d, void *user)
+{
+	struct lws_threadpool_task *task = lws_container_of(d,
+					struct lws_threadpool_task, list);
+	char buf[160];
+
+	__lws_threadpool_task_dump(task, buf, sizeof(buf));
+	lwsl_thread("  - %s\n", buf);
+
+	return 0;
+}
+#endif
+
 void
 lws_threadpool_dump(struct lws_threadpool *tp)
 {
 #if defined(_DEBUG)
-	struct lws_threadpool_task **c;
 	char buf[160];
 	int n, count;
+#endif
 
 	pthread_mutex_lock(&tp->lock); /* ======================== tpool lock */
 
-	lwsl_thread("%s: tp: %s, Queued: %d, Run: %d, Done: %d\n", __func__,
-		    tp->name, tp->queue_depth, tp->running_tasks,
-		    tp->done_queue_depth);
-
-	count = 0;
-	c = &tp->task_queue_head;
-	while (*c) {
-		struct lws_threadpool_task *task = *c;
-		__lws_threadpool_task_dump(task, buf, sizeof(buf));
-		lwsl_thread("  - %s\n", buf);
-		count++;
-
-		c = &(*c)->task_queue_next;
-	}
+	lwsl_info("%s: tp: %s, Queued: %d, Run: %d, Done: %d, tasks run: %u, "
+		  "queued avg %dms max %dms, run avg %dms\n", __func__,
+		  tp->name, (int)tp->task_queue.count, tp->running_tasks,
+		  (int)tp->task_done.count, tp->tasks_run,
+		  tp->tasks_run ? (int)(tp->acc_queued / tp->tasks_run / 1000) : 0,
+		  (int)(tp->max_queued / 1000),
+		  tp->tasks_run ? (int)(tp->acc_run / tp->tasks_run / 1000) : 0);
 
-	if (count != tp->queue_depth)
-		lwsl_err("%s: tp says queue depth %d, but actually %d\n",
-			 __func__, tp->queue_depth, count);
+#if defined(_DEBUG)
+	lws_dll2_foreach_safe(&tp->task_queue, NULL,
+			      lws_threadpool_task_dump_cb);
 
 	count = 0;
 	for (n = 0; n < tp->threads_in_pool; n++) {
@@ -196,32 +209,23 @@ lws_threadpool_dump(struct lws_threadpool *tp)
 
 		if (task) {
 			__lws_threadpool_task_dump(task, buf, sizeof(buf));
-			lwsl_thread("  - worker %d: %s\n", n, buf);
+			lwsl_thread("  - worker %d (ran %u): %s\n", n,
+				    pool->tasks_run, buf);
 			count++;
-		}
+		} else
+			lwsl_thread("  - worker %d (ran %u): idle\n", n,
+				    pool->tasks_run);
 	}
 
 	if (count != tp->running_tasks)
 		lwsl_err("%s: tp says %d running_tasks, but actually %d\n",
 			 __func__, tp->running_tasks, count);
 
-	count = 0;
-	c = &tp->task_done_head;
-	while (*c) {
-		struct lws_threadpool_task *task = *c;
-		__lws_threadpool_task_dump(task, buf, sizeof(buf));
-		lwsl_thread("  - %s\n", buf);
-		count++;
-
-		c = &(*c)->task_queue_next;
-	}
-
-	if (count != tp->done_queue_depth)
-		lwsl_err("%s: tp says done_queue_depth %d, but actually %d\n",
-			 __func__, tp->done_queue_depth, count);
+	lws_dll2_foreach_safe(&tp->task_done, NULL,
+			      lws_threadpool_task_dump_cb);
+#endif
 
 	pthread_mutex_unlock(&tp->lock); /* --------------- tp unlock */
-#endif
 }
 
 static void
@@ -250,29 +254,15 @@ lws_threadpool_task_cleanup_destroy(struct lws_threadpool_task *task)
 static void
 __lws_threadpool_reap(struct lws_threadpool_task *task)
 {
-	struct lws_threadpool_task **c, *t = NULL;
 	struct lws_threadpool *tp = task->tp;
 
 	/* remove the task from the done queue */
 
-	c = &tp->task_done_head;
-
-	while (*c) {
-		if ((*c) == task) {
-			t = *c;
-			*c = t->task_queue_next;
-			t->task_queue_next = NULL;
-			tp->done_queue_depth--;
-
-			lwsl_thread("%s: tp %s: reaped task wsi %p\n", __func__,
-				   tp->name, task->args.wsi);
-
-			break;
-		}
-		c = &(*c)->task_queue_next;
-	}
-
-	if (!t)
+	if (task->list.owner == &tp->task_done) {
+		lws_dll2_remove(&task->list);
+		lwsl_thread("%s: tp %s: reaped task wsi %p\n", __func__,
+			    tp->name, task->args.wsi);
+	} else
 		lwsl_err("%s: task %p not in done queue\n", __func__, task);
 
 	/* call the task's cleanup and delete the task itself */
@@ -289,7 +279,7 @@ __lws_threadpool_reap(struct lws_threadpool_task *task)
 int
 lws_threadpool_tsi_context(struct lws_context *context, int tsi)
 {
-	struct lws_threadpool_task **c, *task = NULL;
+	struct lws_threadpool_task *task = NULL;
 	struct lws_threadpool *tp;
 	struct lws *wsi;
 
@@ -327,10 +317,10 @@ lws_threadpool_tsi_context(struct lws_context *context, int tsi)
 
 		/* for the done tasks... */
 
-		c = &tp->task_done_head;
-
-		while (*c) {
-			task = *c;
+		lws_start_foreach_dll(struct lws_dll2 *, d,
+				      lws_dll2_get_head(&tp->task_done)) {
+			task = lws_container_of(d, struct lws_threadpool_task,
+						list);
 			wsi = task->args.wsi;
 
 			if (wsi && wsi->tsi == tsi &&
@@ -347,9 +337,7 @@ lws_threadpool_tsi_context(struct lws_context *context, int tsi)
 
 				lws_callback_on_writable(wsi);
 			}
-
-			c = &task->task_queue_next;
-		}
+		} lws_end_foreach_dll(d);
 
 		tp = tp->tp_list;
 	}
@@ -456,10 +444,12 @@ done:
 static void *
 lws_threadpool_worker(void *d)
 {
-	struct lws_threadpool_task **c, **c2, *task;
+	struct lws_threadpool_task *task;
 	struct lws_pool *pool = d;
 	struct lws_threadpool *tp = pool->tp;
+#if defined(_DEBUG)
 	char buf[160];
+#endif
 
 	while (!tp->destroying) {
 
@@ -471,7 +461,7 @@ lws_threadpool_worker(void *d)
 		 * if there's no task already waiting in the queue, wait for
 		 * the wake_idle condition to signal us that might have changed
 		 */
-		while (!tp->task_queue_head && !tp->destroying)
+		while (!tp->task_queue.count && !tp->destroying)
 			pthread_cond_wait(&tp->wake_idle, &tp->lock);
 
 		if (tp->destroying) {
@@ -479,43 +469,30 @@ lws_threadpool_worker(void *d)
 			continue;
 		}
 
-		c = &tp->task_queue_head;
-		c2 = NULL;
-		task = NULL;
-		pool->task = NULL;
+		/* take the oldest task, from the queue head */
 
-		/* look at the queue tail */
-		while (*c) {
-			c2 = c;
-			c = &(*c)->task_queue_next;
-		}
+		pool->task = task = lws_container_of(tp->task_queue.head,
+					struct lws_threadpool_task, list);
+		lws_dll2_remove(&task->list);
+		task->acquired = pool->acquired = lws_now_usecs();
 
-		/* is there a task at the queue tail? */
-		if (c2 && *c2) {
-			pool->task = task = *c2;
-			task->acquired = pool->acquired = lws_now_usecs();
-			/* remove it from the queue */
-			*c2 = task->task_queue_next;
-			task->task_queue_next = NULL;
-			tp->queue_depth--;
-			/* mark it as running */
-			state_transition(task, LWS_TP_STATUS_RUNNING);
-		}
+		tp->acc_queued += task->acquired - task->created;
+		if (task->acquired - task->created > tp->max_queued)
+			tp->max_queued = task->acquired - task->created;
 
-		/* someone else got it first... wait and try again */
-		if (!task) {
-			pthread_mutex_unlock(&tp->lock);  /* ------ tp unlock */
-			continue;
-		}
+		/* mark it as running */
+		state_transition(task, LWS_TP_STATUS_RUNNING);
 
 		task->wanted_writeable_cb = 0;
 
 		/* we have acquired a new task */
 
+#if defined(_DEBUG)
 		__lws_threadpool_task_dump(task, buf, sizeof(buf));
 
 		lwsl_thread("%s: %s: worker %d ACQUIRING: %s\n",
 			    __func__, tp->name, pool->worker_index, buf);
+#endif
 		tp->running_tasks++;
 
 		pthread_mutex_unlock(&tp->lock); /* --------------- tp unlock */
@@ -587,25 +564,28 @@ lws_threadpool_worker(void *d)
 		pthread_mutex_lock(&tp->lock); /* =================== tp lock */
 
 		tp->running_tasks--;
+		tp->tasks_run++;
+		pool->tasks_run++;
+		tp->acc_run += task->acc_running;
 
 		if (pool->task->status == LWS_TP_STATUS_STOPPING)
 			state_transition(task, LWS_TP_STATUS_STOPPED);
 
 		/* move the task to the done queue */
 
-		pool->task->task_queue_next = tp->task_done_head;
-		tp->task_done_head = task;
-		tp->done_queue_depth++;
+		lws_dll2_add_head(&task->list, &tp->task_done);
 		pool->task->done = lws_now_usecs();
 
 		if (!pool->task->args.wsi &&
 		    (pool->task->status == LWS_TP_STATUS_STOPPED ||
 		     pool->task->status == LWS_TP_STATUS_FINISHED)) {
 
+#if defined(_DEBUG)
 			__lws_threadpool_task_dump(pool->task, buf, sizeof(buf));
 			lwsl_thread("%s: %s: worker %d REAPING: %s\n",
 				    __func__, tp->name, pool->worker_index,
 				    buf);
+#endif
 
 			/*
 			 * there is no longer any wsi attached, so nothing is
@@ -615,10 +595,12 @@ lws_threadpool_worker(void *d)
 			__lws_threadpool_reap(pool->task);
 		} else {
 
+#if defined(_DEBUG)
 			__lws_threadpool_task_dump(pool->task, buf, sizeof(buf));
 			lwsl_thread("%s: %s: worker %d DONE: %s\n",
 				    __func__, tp->name, pool->worker_index,
 				    buf);
+#endif
 
 			/* signal the associated wsi to take a fresh look at
 			 * task status */
@@ -700,8 +682,6 @@ lws_threadpool_create(struct lws_context *context,
 void
 lws_threadpool_finish(struct lws_threadpool *tp)
 {
-	struct lws_threadpool_task **c, *task;
-
 	pthread_mutex_lock(&tp->lock); /* ======================== tpool lock */
 
 	/* nothing new can start, running jobs will abort as STOPPED and the
@@ -710,19 +690,16 @@ lws_threadpool_finish(struct lws_threadpool *tp)
 
 	/* stop everyone in the pending queue and move to the done queue */
 
-	c = &tp->task_queue_head;
-	while (*c) {
-		task = *c;
-		*c = task->task_queue_next;
-		task->task_queue_next = tp->task_done_head;
-		tp->task_done_head = task;
+	lws_start_foreach_dll_safe(struct lws_dll2 *, d, d1,
+				   lws_dll2_get_head(&tp->task_queue)) {
+		struct lws_threadpool_task *task = lws_container_of(d,
+					struct lws_threadpool_task, list);
+
+		lws_dll2_remove(&task->list);
+		lws_dll2_add_head(&task->list, &tp->task_done);
 		state_transition(task, LWS_TP_STATUS_STOPPED);
-		tp->queue_depth--;
-		tp->done_queue_depth++;
 		task->done = lws_now_usecs();
-
-		c = &task->task_queue_next;
-	}
+	} lws_end_foreach_dll_safe(d, d1);
 
 	pthread_mutex_unlock(&tp->lock); /* -------------------- tpool unlock */
 
@@ -732,7 +709,7 @@ lws_threadpool_finish(struct lws_threadpool *tp)
 void
 lws_threadpool_destroy(struct lws_threadpool *tp)
 {
-	struct lws_threadpool_task *task, *next;
+	struct lws_threadpool_task *task;
 	struct lws_threadpool **ptp;
 	void *retval;
 	int n;
@@ -774,13 +751,13 @@ lws_threadpool_destroy(struct lws_threadpool *tp)
 	}
 	lwsl_info("%s: all threadpools exited\n", __func__);
 
-	task = tp->task_done_head;
-	while (task) {
-		next = task->task_queue_next;
+	lws_start_foreach_dll_safe(struct lws_dll2 *, d, d1,
+				   lws_dll2_get_head(&tp->task_done)) {
+		task = lws_container_of(d, struct lws_threadpool_task, list);
+
+		lws_dll2_remove(&task->list);
 		lws_threadpool_task_cleanup_destroy(task);
-		tp->done_queue_depth--;
-		task = next;
-	}
+	} lws_end_foreach_dll_safe(d, d1);
 
 	pthread_mutex_destroy(&tp->lock);
 
@@ -796,7 +773,7 @@ int
 lws_threadpool_dequeue(struct lws *wsi)
 {
 	struct lws_threadpool *tp;
-	struct lws_threadpool_task **c, *task;
+	struct lws_threadpool_task *task;
 	int n;
 
 	task = wsi->tp_task;
@@ -817,41 +794,25 @@ lws_threadpool_dequeue(struct lws *wsi)
 	}
 
 
-	c = &tp->task_queue_head;
-
-	/* is he queued waiting for a chance to run?  Mark him as stopped and
-	 * move him on to the done queue */
-
-	while (*c) {
-		if ((*c) == task) {
-			*c = task->task_queue_next;
-			task->task_queue_next = tp->task_done_head;
-			tp->task_done_head = task;
-			state_transition(task, LWS_TP_STATUS_STOPPED);
-			tp->queue_depth--;
-			tp->done_queue_depth++;
-			task->done = lws_now_usecs();
+	/*
+	 * is he queued waiting for a chance to run?  Then he was never
+	 * started, we can clean him up right away like a done task
+	 */
 
-			lwsl_debug("%s: tp %p: removed queued task wsi %p\n",
-				    __func__, tp, task->args.wsi);
+	if (task->list.owner == &tp->task_queue) {
+		state_transition(task, LWS_TP_STATUS_STOPPED);
+		task->done = lws_now_usecs();
 
-			break;
-		}
-		c = &(*c)->task_queue_next;
+		lwsl_debug("%s: tp %p: removed queued task wsi %p\n",
+			    __func__, tp, task->args.wsi);
 	}
 
-	/* is he on the done queue? */
+	/* is he on the done queue, or was he just in the pending queue? */
 
-	c = &tp->task_done_head;
-	while (*c) {
-		if ((*c) == task) {
-			*c = task->task_queue_next;
-			task->task_queue_next = NULL;
-			lws_threadpool_task_cleanup_destroy(task);
-			tp->done_queue_depth--;
-			goto bail;
-		}
-		c = &(*c)->task_queue_next;
+	if (task->list.owner) {
+		lws_dll2_remove(&task->list);
+		lws_threadpool_task_cleanup_destroy(task);
+		goto bail;
 	}
 
 	/* he's not in the queue... is he already running on a thread? */
@@ -918,7 +879,7 @@ lws_threadpool_enqueue(struct lws_threadpool *tp,
 	 * first, then any free thread may pick it up after the wake_idle
 	 */
 
-	if (tp->queue_depth == tp->max_queue_depth) {
+	if ((int)tp->task_queue.count == tp->max_queue_depth) {
 		lwsl_notice("%s: queue reached limit %d\n", __func__,
 			    tp->max_queue_depth);
 
@@ -947,10 +908,8 @@ lws_threadpool_enqueue(struct lws_threadpool *tp,
 	 * add him on the tp task queue
 	 */
 
-	task->task_queue_next = tp->task_queue_head;
 	state_transition(task, LWS_TP_STATUS_QUEUED);
-	tp->task_queue_head = task;
-	tp->queue_depth++;
+	lws_dll2_add_tail(&task->list, &tp->task_queue);
 
 	/*
 	 * mark the wsi itself as depending on this tp (so wsi close for
@@ -961,7 +920,7 @@ lws_threadpool_enqueue(struct lws_threadpool *tp,
 
 	lwsl_thread("%s: tp %s: enqueued task %p (%s) for wsi %p, depth %d\n",
 		    __func__, tp->name, task, task->name, args->wsi,
-		    tp->queue_depth);
+		    (int)tp->task_queue.count);
 
 	/* alert any idle thread there's something new on the task list */
 
@@ -993,12 +952,16 @@ lws_threadpool_task_status_wsi(struct lws *wsi,
 
 	if (status == LWS_TP_STATUS_FINISHED ||
 	    status == LWS_TP_STATUS_STOPPED) {
+#if defined(_DEBUG)
 		char buf[160];
+#endif
 
 		pthread_mutex_lock(&tp->lock); /* ================ tpool lock */
+#if defined(_DEBUG)
 		__lws_threadpool_task_dump(*task, buf, sizeof(buf));
 		lwsl_thread("%s: %s: service thread REAPING: %s\n",
 			    __func__, tp->name, buf);
+#endif
 		__lws_threadpool_reap(*task);
 		lws_memory_barrier();
 		pthread_mutex_unlock(&tp->lock); /* ------------ tpool unlock */
@@ -24,19 +24,16 @@
 
 #include "private-lib-core.h"
 
-lws_async_dns_server_check_t
-lws_plat_asyncdns_init(struct lws_context *context, lws_sockaddr46 *sa46)
+int
+lws_plat_asyncdns_init(struct lws_context *context, lws_sockaddr46 *sa46,
+		       int max)
 {
 	uint32_t ipv4;
-	lws_async_dns_server_check_t s = LADNS_CONF_SERVER_CHANGED;
 
 	FreeRTOS_GetAddressConfiguration(NULL, NULL, NULL, &ipv4);
 
 	sa46->sa4.sin_family = AF_INET;
-	if (sa46->sa4.sin_addr.s_addr == ipv4)
-		s = LADNS_CONF_SERVER_SAME;
-
 	sa46->sa4.sin_addr.s_addr = ipv4;
 
-	return s;
+	return 1;
 }
@@ -25,30 +25,24 @@
 #include "private-lib-core.h"
 #include <sys/system_properties.h>
 
-lws_async_dns_server_check_t
-lws_plat_asyncdns_init(struct lws_context *context, lws_sockaddr46 *sa46)
+int
+lws_plat_asyncdns_init(struct lws_context *context, lws_sockaddr46 *sa46,
+		       int max)
 {
-	char d[PROP_VALUE_MAX], *p;
-	uint32_t ip32;
-	uint8_t i[4];
-	int n;
+	char d[PROP_VALUE_MAX], prop[16];
+	int n, count = 0;
 
-	d[0] = '\0';
-	if (__system_property_get("net.dns1", d) <= 0)
-		return LADNS_CONF_SERVER_UNKNOWN;
+	/* net.dns1, net.dns2... in order of preference */
 
-	for (n = 0; n < 4; n++) {
-		i[n] = atoi(d);
-		p = strchr(d, '.');
-		if (n != 3 && !p)
-			return LADNS_CONF_SERVER_UNKNOWN;
-	}
+	for (n = 1; n <= 4 && count < max; n++) {
+		lws_snprintf(prop, sizeof(prop), "net.dns%d", n);
+		d[0] = '\0';
+		if (__system_property_get(prop, d) <= 0)
+			break;
 
-	ip32 = (i[0] << 24) | (i[1] << 16) | (i[2] << 8) | i[3];
-	n = ip32 == sa46->sa4.sin_addr.s_addr;
-	sa46->sa4.sin_family = AF_INET;
-	sa46->sa4.sin_addr.s_addr = ip32;
+		if (!lws_sa46_parse_numeric_address(d, &sa46[count]))
+			count++;
+	}
 
-	return n ? LADNS_CONF_SERVER_SAME : LADNS_CONF_SERVER_CHANGED;
+	return count ? count : -1;
 }
-
@@ -24,25 +24,24 @@
 
 #include "private-lib-core.h"
 
-lws_async_dns_server_check_t
-lws_plat_asyncdns_init(struct lws_context *context, lws_sockaddr46 *sa46)
+int
+lws_plat_asyncdns_init(struct lws_context *context, lws_sockaddr46 *sa46,
+		       int max)
 {
-	lws_async_dns_server_check_t s = LADNS_CONF_SERVER_CHANGED;
 	char resolv[512], ads[48];
-	lws_sockaddr46 sa46t;
+	int fd, n, ns = 0, count = 0;
 	lws_tokenize_t ts;
-	int fd, n, ns = 0;
 
 	/* grab the first chunk of /etc/resolv.conf */
 
 	fd = open("/etc/resolv.conf", LWS_O_RDONLY);
 	if (fd < 0)
-		return LADNS_CONF_SERVER_UNKNOWN;
+		return -1;
 
 	n = read(fd, resolv, sizeof(resolv) - 1);
 	close(fd);
 	if (n < 0)
-		return LADNS_CONF_SERVER_UNKNOWN;
+		return -1;
 
 	resolv[n] = '\0';
 	lws_tokenize_init(&ts, resolv, LWS_TOKENIZE_F_DOT_NONTERM |
@@ -72,17 +71,15 @@ lws_plat_asyncdns_init(struct lws_context *context, lws_sockaddr46 *sa46)
 
 		memcpy(ads, ts.token, ts.token_len);
 		ads[ts.token_len] = '\0';
-		if (lws_sa46_parse_numeric_address(ads, &sa46t) < 0)
+		if (lws_sa46_parse_numeric_address(ads, &sa46[count]) < 0)
 			continue;
 
-		if (!lws_sa46_compare_ads(sa46, &sa46t))
-			s = LADNS_CONF_SERVER_SAME;
+		/* collect them in resolv.conf order, up to max */
 
-		*sa46 = sa46t;
-
-		return s;
+		if (++count == max)
+			break;
 
 	} while (ts.e > 0);
 
-	return LADNS_CONF_SERVER_UNKNOWN;
+	return count ? count : -1;
 }
@@ -36,8 +36,9 @@
 
 #include "private-lib-core.h"
 
-lws_async_dns_server_check_t
-lws_plat_asyncdns_init(struct lws_context *context, lws_sockaddr46 *sa46)
+int
+lws_plat_asyncdns_init(struct lws_context *context, lws_sockaddr46 *sa46,
+		       int max)
 {
 	char	subkey[512], dhcpns[512], ns[512], value[128], *key =
 	"SYSTEM\\ControlSet001\\Services\\Tcpip\\Parameters\\Interfaces";
@@ -48,7 +49,7 @@ lws_plat_asyncdns_init(struct lws_context *context, lws_sockaddr46 *sa46)
 	if ((err = RegOpenKey(HKEY_LOCAL_MACHINE, key, &hKey)) != ERROR_SUCCESS) {
 		lwsl_err("%s: cannot open reg key %s: %d\n", __func__, key, err);
 
-		return 1;
+		return -1;
 	}
 
 	for (i = 0; RegEnumKey(hKey, i, subkey, sizeof(subkey)) == ERROR_SUCCESS; i++) {
@@ -59,15 +60,15 @@ lws_plat_asyncdns_init(struct lws_context *context, lws_sockaddr46 *sa46)
 		    &type, value, &len) == ERROR_SUCCESS ||
 		    RegQueryValueEx(hSub, "DhcpNameServer", 0,
 		    &type, value, &len) == ERROR_SUCCESS)) {
-			n = lws_sa46_parse_numeric_address(value, sa46)
+			/* the value may be a comma or space-separated list */
+			n = lws_async_dns_parse_servers(value, sa46, max);
 			RegCloseKey(hSub);
 			RegCloseKey(hKey);
-			return n == 0 ? LADNS_CONF_SERVER_CHANGED :
-					LADNS_CONF_SERVER_UNKNOWN;
+			return n ? n : -1;
 		}
 	}
 	RegCloseKey(hKey);
 
-	return LADNS_CONF_SERVER_UNKNOWN;
+	return -1;
 }
 
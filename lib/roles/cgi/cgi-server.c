@@ -68,59 +68,28 @@ urlencode(const char *in, int inlen, char *out, int outlen)
 	return out - start;
 }
 
+/*
+ * Prepare the CGI environment for the request on wsi in env_array, with the
+ * strings kept in e and REQUEST_URI in cgi_path.  wsi->http.cgi must already
+ * exist, since what we learn about the request is kept there.
+ *
+ * Returns the number of env entries (env_array is NULL terminated after
+ * them), or -1.
+ */
+
 int
-lws_cgi(struct lws *wsi, const char * const *exec_array,
-	int script_uri_path_len, int timeout_secs,
-	const struct lws_protocol_vhost_options *mp_cgienv)
+lws_cgi_env(struct lws *wsi, const char *script, int script_uri_path_len,
+	    const struct lws_protocol_vhost_options *mp_cgienv,
+	    char **env_array, int env_max, char *e, size_t e_len,
+	    char *cgi_path, size_t cgi_path_len)
 {
-	struct lws_context_per_thread *pt = &wsi->context->pt[(int)wsi->tsi];
-	struct lws_spawn_piped_info info;
-	char *env_array[30], cgi_path[500], e[1024], *p = e,
-	     *end = p + sizeof(e) - 1, tok[256], *t, *sum, *sumend;
-	struct lws_cgi *cgi;
-	int n, m = 0, i, uritok = -1, c;
-
-	/*
-	 * give the master wsi a cgi struct
-	 */
-
-	wsi->http.cgi = lws_zalloc(sizeof(*wsi->http.cgi), "new cgi");
-	if (!wsi->http.cgi) {
-		lwsl_err("%s: OOM\n", __func__);
-		return -1;
-	}
-
-	wsi->http.cgi->response_code = HTTP_STATUS_OK;
-
-	cgi = wsi->http.cgi;
-	cgi->wsi = wsi; /* set cgi's owning wsi */
-	sum = cgi->summary;
-	sumend = sum + strlen(cgi->summary) - 1;
-
-	if (timeout_secs)
-		lws_set_timeout(wsi, PENDING_TIMEOUT_CGI, timeout_secs);
-
-	/* the cgi stdout is always sending us http1.x header data first */
-	wsi->hdr_state = LCHS_HEADER;
-
-	/* add us to the pt list of active cgis */
-	lwsl_debug("%s: adding cgi %p to list\n", __func__, wsi->http.cgi);
-	cgi->cgi_list = pt->http.cgi_list;
-	pt->http.cgi_list = cgi;
+	char *p = e, *end = e + e_len - 1, tok[256], *t, *sum, *sumend;
+	int n = 0, m = 0, i, uritok = -1, c;
 
-	sum += lws_snprintf(sum, sumend - sum, "%s ", exec_array[0]);
+	sum = wsi->http.cgi->summary;
+	sumend = sum + sizeof(wsi->http.cgi->summary) - 1;
 
-	if (0) {
-		char *pct = lws_hdr_simple_ptr(wsi,
-				WSI_TOKEN_HTTP_CONTENT_ENCODING);
-
-		if (pct && !strcmp(pct, "gzip"))
-			wsi->http.cgi->gzip_inflate = 1;
-	}
-
-	/* prepare his CGI env */
-
-	n = 0;
+	sum += lws_snprintf(sum, sumend - sum, "%s ", script);
 
 	if (lws_is_ssl(wsi)) {
 		env_array[n++] = p;
@@ -161,7 +130,7 @@ lws_cgi(struct lws *wsi, const char * const *exec_array,
 				}
 
 		if (script_uri_path_len < 0 && uritok < 0)
-			goto bail;
+			return -1;
 //		if (script_uri_path_len < 0)
 //			uritok = 0;
 
@@ -218,11 +187,11 @@ lws_cgi(struct lws *wsi, const char * const *exec_array,
 		if (uritok >= 0) {
 			strcpy(cgi_path, "REQUEST_URI=");
 			c = lws_hdr_copy(wsi, cgi_path + 12,
-					 sizeof(cgi_path) - 12, uritok);
+					 (int)cgi_path_len - 12, uritok);
 			if (c < 0)
-				goto bail;
+				return -1;
 
-			cgi_path[sizeof(cgi_path) - 1] = '\0';
+			cgi_path[cgi_path_len - 1] = '\0';
 			env_array[n++] = cgi_path;
 		}
 
@@ -319,10 +288,10 @@ lws_cgi(struct lws *wsi, const char * const *exec_array,
 	p++;
 
 	env_array[n++] = p;
-	p += lws_snprintf(p, end - p, "SCRIPT_PATH=%s", exec_array[0]);
+	p += lws_snprintf(p, end - p, "SCRIPT_PATH=%s", script);
 	p++;
 
-	while (mp_cgienv) {
+	while (mp_cgienv && n < env_max - 2) {
 		env_array[n++] = p;
 		p += lws_snprintf(p, end - p, "%s=%s", mp_cgienv->name,
 			      mp_cgienv->value);
@@ -347,6 +316,56 @@ lws_cgi(struct lws *wsi, const char * const *exec_array,
 		lwsl_notice("    %s\n", env_array[m]);
 #endif
 
+	return n;
+}
+
+int
+lws_cgi(struct lws *wsi, const char * const *exec_array,
+	int script_uri_path_len, int timeout_secs,
+	const struct lws_protocol_vhost_options *mp_cgienv)
+{
+	struct lws_context_per_thread *pt = &wsi->context->pt[(int)wsi->tsi];
+	struct lws_spawn_piped_info info;
+	char *env_array[30], cgi_path[500], e[1024];
+	struct lws_cgi *cgi;
+	int n;
+
+	/*
+	 * give the master wsi a cgi struct
+	 */
+
+	wsi->http.cgi = lws_zalloc(sizeof(*wsi->http.cgi), "new cgi");
+	if (!wsi->http.cgi) {
+		lwsl_err("%s: OOM\n", __func__);
+		return -1;
+	}
+
+	wsi->http.cgi->response_code = HTTP_STATUS_OK;
+
+	cgi = wsi->http.cgi;
+	cgi->wsi = wsi; /* set cgi's owning wsi */
+
+	if (0) {
+		char *pct = lws_hdr_simple_ptr(wsi,
+				WSI_TOKEN_HTTP_CONTENT_ENCODING);
+
+		if (pct && !strcmp(pct, "gzip"))
+			wsi->http.cgi->gzip_inflate = 1;
+	}
+
+	/* prepare his CGI env */
+
+	if (lws_cgi_env(wsi, exec_array[0], script_uri_path_len, mp_cgienv,
+			env_array, (int)LWS_ARRAY_SIZE(env_array), e, sizeof(e),
+			cgi_path, sizeof(cgi_path)) < 0)
+		goto bail;
+
+	if (timeout_secs)
+		lws_set_timeout(wsi, PENDING_TIMEOUT_CGI, timeout_secs);
+
+	/* the cgi stdout is always sending us http1.x header data first */
+	wsi->hdr_state = LCHS_HEADER;
+
 	memset(&info, 0, sizeof(info));
 	info.env_array = env_array;
 	info.exec_array = exec_array;
@@ -377,6 +396,11 @@ lws_cgi(struct lws *wsi, const char * const *exec_array,
 
 	wsi->context->count_cgi_spawned++;
 
+	/* add us to the pt list of active cgis */
+	lwsl_debug("%s: adding cgi %p to list\n", __func__, wsi->http.cgi);
+	cgi->cgi_list = pt->http.cgi_list;
+	pt->http.cgi_list = cgi;
+
 	/* inform cgi owner of the child PID */
 	n = user_callback_handle_rxflow(wsi->protocol->callback, wsi,
 				    LWS_CALLBACK_CGI_PROCESS_ATTACH,
@@ -410,6 +434,28 @@ enum header_recode {
 	HR_CRLF,
 };
 
+/*
+ * Behaves like read() on the cgi stdout pipe, or on what we have from the
+ * FastCGI worker when the output is coming from there
+ */
+
+static int
+lws_cgi_read_stdout(struct lws *wsi, void *buf, size_t len)
+{
+	int fd;
+
+#if defined(LWS_WITH_FASTCGI)
+	if (wsi->http.cgi->fcgi)
+		return lws_fcgi_stdout_read(wsi, buf, len);
+#endif
+
+	fd = lws_get_socket_fd(wsi->http.cgi->lsp->stdwsi[LWS_STDOUT]);
+	if (fd < 0)
+		return -1;
+
+	return (int)read(fd, buf, len);
+}
+
 int
 lws_cgi_write_split_stdout_headers(struct lws *wsi)
 {
@@ -441,7 +487,11 @@ lws_cgi_write_split_stdout_headers(struct lws *wsi)
 					WSI_TOKEN_HTTP_TRANSFER_ENCODING,
 					(unsigned char *)"chunked", 7, &p, end))
 				return 1;
-			if (!(wsi->mux_substream))
+			if (!(wsi->mux_substream)
+#if defined(LWS_WITH_FASTCGI)
+			    && !wsi->http.cgi->fcgi /* conn persists */
+#endif
+			)
 				if (lws_add_http_header_by_token(wsi,
 						WSI_TOKEN_CONNECTION,
 						(unsigned char *)"close", 5,
@@ -617,10 +667,12 @@ post_hpack_recode:
 			}
 		}
 
-		n = lws_get_socket_fd(wsi->http.cgi->lsp->stdwsi[LWS_STDOUT]);
-		if (n < 0)
+		n = lws_cgi_read_stdout(wsi, &c, 1);
+#if defined(LWS_WITH_FASTCGI)
+		if (!n && wsi->http.cgi->fcgi)
+			/* the worker finished before the headers did */
 			return -1;
-		n = read(n, &c, 1);
+#endif
 		if (n < 0) {
 			if (errno != EAGAIN) {
 				lwsl_debug("%s: read says %d\n", __func__, n);
@@ -768,10 +820,9 @@ agin:
 	m = !wsi->http.cgi->implied_chunked && !wsi->mux_substream &&
 	//    !wsi->http.cgi->explicitly_chunked &&
 	    !wsi->http.cgi->content_length;
-	n = lws_get_socket_fd(wsi->http.cgi->lsp->stdwsi[LWS_STDOUT]);
-	if (n < 0)
-		return -1;
-	n = read(n, start, sizeof(buf) - LWS_PRE);
+	/* leave room to wrap it in a chunk */
+	n = lws_cgi_read_stdout(wsi, start, sizeof(buf) - LWS_PRE -
+				(m ? LWS_HTTP_CHUNK_HDR_SIZE : 0));
 
 	if (n < 0 && errno != EAGAIN) {
 		lwsl_debug("%s: stdout read says %d\n", __func__, n);
@@ -818,6 +869,46 @@ agin:
 		wsi->http.cgi->content_length_seen += n;
 	} else {
 
+#if defined(LWS_WITH_FASTCGI)
+		if (wsi->http.cgi->fcgi) {
+			if (n < 0)
+				/* nothing more yet, the pool wakes us */
+				return 0;
+
+			/*
+			 * The worker ended the request... we have to finish
+			 * the response in a way that leaves the connection
+			 * usable for the next transaction
+			 */
+
+			if (wsi->http.cgi->content_length) {
+				if (wsi->http.cgi->content_length_seen !=
+					wsi->http.cgi->content_length)
+					return -1;
+			} else
+				if (!wsi->mux_substream) {
+					uint8_t term[LWS_PRE + 6];
+
+					if (!m)
+						/* only close can delimit it */
+						return -1;
+
+					memcpy(term + LWS_PRE,
+					       (uint8_t *)"0\x0d\x0a\x0d\x0a", 5);
+					if (lws_write(wsi, term + LWS_PRE, 5,
+						      LWS_WRITE_HTTP_FINAL) != 5)
+						return -1;
+				} else
+					if (lws_write(wsi, start, 0,
+						      LWS_WRITE_HTTP_FINAL))
+						return -1;
+
+			wsi->http.cgi->cgi_transaction_over = 1;
+
+			return 0;
+		}
+#endif
+
 		if (!wsi->mux_substream && m) {
 			uint8_t term[LWS_PRE + 6];
 
@@ -1017,7 +1108,7 @@ finish_him:
 struct lws *
 lws_cgi_get_stdwsi(struct lws *wsi, enum lws_enum_stdinouterr ch)
 {
-	if (!wsi->http.cgi)
+	if (!wsi->http.cgi || !wsi->http.cgi->lsp)
 		return NULL;
 
 	return wsi->http.cgi->lsp->stdwsi[ch];
@@ -1029,6 +1120,11 @@ lws_cgi_remove_and_kill(struct lws *wsi)
 	struct lws_context_per_thread *pt = &wsi->context->pt[(int)wsi->tsi];
 	struct lws_cgi **pcgi = &pt->http.cgi_list;
 
+#if defined(LWS_WITH_FASTCGI)
+	if (wsi->http.cgi->fcgi)
+		lws_fcgi_req_detach(wsi->http.cgi);
+#endif
+
 	/* remove us from the cgi list */
 	lwsl_debug("%s: remove cgi %p from list\n", __func__, wsi->http.cgi);
 	while (*pcgi) {
@@ -0,0 +1,1174 @@
+/*
+ * libwebsockets - small server side websockets and web server implementation
+ *
+ * Copyright (C) 2010 - 2020 Andy Green <andy@warmcat.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * fastcgi:// mounts pass requests to a pool of persistent FastCGI responders,
+ * either ones we spawn ourselves listening on a private unix socket, or ones
+ * already listening on a unix socket or tcp port.
+ *
+ * Each pool keeps up to max_conns connections to its workers open, and each
+ * connection carries one request at a time, asking the worker to keep the
+ * connection open afterwards.  Requests arriving when all the connections are
+ * busy wait on a queue of limited length, after that they get a 503.
+ *
+ * The worker output is fed to the same code that interprets cgi stdout, so
+ * the headers are translated in the same way for h1 and h2.  Since the end
+ * of the response is told to us explicitly, the client connection doesn't
+ * have to be closed to mark it, and it can be kept alive.
+ */
+
+#include "private-lib-core.h"
+
+#include <sys/un.h>
+
+#define LWS_FCGI_VERSION_1		1
+#define LWS_FCGI_HDR_LEN		8
+#define LWS_FCGI_REQ_ID			1 /* one request per conn at a time */
+#define LWS_FCGI_RESPONDER		1
+#define LWS_FCGI_KEEP_CONN		1
+
+/* how much we buffer in each direction before applying rx flow control */
+#define LWS_FCGI_BUFFER_LIMIT		(64 * 1024)
+
+enum {
+	LWS_FCGI_BEGIN_REQUEST		= 1,
+	LWS_FCGI_ABORT_REQUEST		= 2,
+	LWS_FCGI_END_REQUEST		= 3,
+	LWS_FCGI_PARAMS			= 4,
+	LWS_FCGI_STDIN			= 5,
+	LWS_FCGI_STDOUT			= 6,
+	LWS_FCGI_STDERR			= 7,
+};
+
+struct lws_fcgi_pool;
+
+struct lws_fcgi_worker {
+	lws_sorted_usec_list_t		sul;	/* (re)spawn */
+	struct lws_fcgi_pool		*pool;
+	struct lws_spawn_piped		*lsp;
+};
+
+struct lws_fcgi_conn {
+	lws_dll2_t			list;	/* pool->idle or pool->busy */
+	struct lws_fcgi_pool		*pool;
+	struct lws			*wsi;
+	struct lws_fcgi_req		*req;	/* NULL if idle */
+
+	uint8_t				hdr[LWS_FCGI_HDR_LEN];
+	uint16_t			content_remain;
+	uint8_t				padding_remain;
+	uint8_t				hdr_pos;
+
+	char				connected;
+	char				in_connect;
+	char				failed;
+	char				rx_held;
+};
+
+struct lws_fcgi_req {
+	lws_dll2_t			list;	/* pool->queue while waiting */
+	struct lws_fcgi_pool		*pool;
+	struct lws_fcgi_conn		*conn;
+	struct lws			*wsi;	/* the http stream */
+
+	struct lws_buflist		*tx;	/* records going to the worker */
+	struct lws_buflist		*out;	/* stdout from the worker */
+	size_t				tx_len;
+	size_t				out_len;
+	int				timeout_secs;
+
+	char				stdin_ended;
+	char				out_seen;
+	char				ended;
+	char				broken;
+	char				rx_held;
+};
+
+struct lws_fcgi_pool {
+	lws_dll2_t			list;	/* vhd->pools */
+	const struct lws_http_mount	*mount;
+	struct lws_vhost		*vh;
+
+	lws_dll2_owner_t		idle;
+	lws_dll2_owner_t		busy;
+	lws_dll2_owner_t		queue;
+
+	struct lws_fcgi_worker		*workers; /* if we spawn them */
+	int				count_workers;
+
+	char				address[128];
+	char				sock_dir[32]; /* private, 0700 */
+	char				sock_path[64];
+	int				port;
+	int				listen_fd;
+
+	unsigned short			max_conns;
+	unsigned short			max_queue;
+
+	char				dispatching;
+	char				destroying;
+};
+
+struct lws_fcgi_vhd {
+	lws_dll2_owner_t		pools;
+};
+
+static void
+lws_fcgi_dispatch(struct lws_fcgi_pool *pool);
+
+static int
+lws_fcgi_pool_dead(struct lws_fcgi_pool *pool)
+{
+	return pool->destroying || pool->vh->being_destroyed ||
+	       pool->vh->context->being_destroyed;
+}
+
+/*
+ * Append one or more records of the given type carrying buf to a buflist.
+ * len 0 appends one empty record, which ends a stream.
+ */
+
+static int
+lws_fcgi_record(struct lws_buflist **b, size_t *total, uint8_t type,
+		const uint8_t *buf, size_t len)
+{
+	uint8_t hdr[LWS_FCGI_HDR_LEN];
+	size_t n;
+
+	do {
+		n = len > 0xffff ? 0xffff : len;
+
+		hdr[0] = LWS_FCGI_VERSION_1;
+		hdr[1] = type;
+		lws_ser_wu16be(&hdr[2], LWS_FCGI_REQ_ID);
+		lws_ser_wu16be(&hdr[4], (uint16_t)n);
+		hdr[6] = 0; /* padding */
+		hdr[7] = 0;
+
+		if (lws_buflist_append_segment(b, hdr, sizeof(hdr)) < 0 ||
+		    (n && lws_buflist_append_segment(b, buf, n) < 0))
+			return 1;
+
+		*total += sizeof(hdr) + n;
+		buf += n;
+		len -= n;
+	} while (len);
+
+	return 0;
+}
+
+/* copy out and consume up to len bytes across the buflist segments */
+
+static size_t
+lws_fcgi_buflist_use(struct lws_buflist **b, uint8_t *buf, size_t len)
+{
+	size_t done = 0, n;
+	uint8_t *p;
+
+	while (done < len) {
+		n = lws_buflist_next_segment_len(b, &p);
+		if (!n)
+			break;
+		if (n > len - done)
+			n = len - done;
+		memcpy(buf + done, p, n);
+		lws_buflist_use_segment(b, n);
+		done += n;
+	}
+
+	return done;
+}
+
+static uint8_t *
+lws_fcgi_param_len(uint8_t *p, size_t len)
+{
+	if (len < 128) {
+		*p++ = (uint8_t)len;
+
+		return p;
+	}
+
+	lws_ser_wu32be(p, (uint32_t)len | 0x80000000u);
+
+	return p + 4;
+}
+
+static int
+lws_fcgi_param(uint8_t **p, uint8_t *end, const char *name, size_t nl,
+	       const char *value, size_t vl)
+{
+	if (lws_ptr_diff(end, *p) < (int)(nl + vl + 8))
+		return 1;
+
+	*p = lws_fcgi_param_len(*p, nl);
+	*p = lws_fcgi_param_len(*p, vl);
+	memcpy(*p, name, nl);
+	*p += nl;
+	memcpy(*p, value, vl);
+	*p += vl;
+
+	return 0;
+}
+
+static void
+lws_fcgi_req_wake(struct lws_fcgi_req *req)
+{
+	if (!req->wsi)
+		return;
+
+	req->wsi->reason_bf |= LWS_CB_REASON_AUX_BF__CGI;
+	lws_callback_on_writable(req->wsi);
+}
+
+static int
+lws_fcgi_req_out(struct lws_fcgi_req *req, const uint8_t *buf, size_t len)
+{
+	if (lws_buflist_append_segment(&req->out, buf, len) < 0)
+		return 1;
+
+	req->out_len += len;
+	lws_fcgi_req_wake(req);
+
+	return 0;
+}
+
+/*
+ * The request can't be served by the worker... if nothing was sent on to the
+ * client yet, we can still make it an error status, otherwise all we can do
+ * is close the client connection
+ */
+
+static void
+lws_fcgi_req_fail(struct lws_fcgi_req *req, int status)
+{
+	char s[32];
+	int n;
+
+	if (req->ended)
+		return;
+
+	if (req->out_seen)
+		req->broken = 1;
+	else {
+		n = lws_snprintf(s, sizeof(s), "Status: %d\x0d\x0a\x0d\x0a",
+				 status);
+		if (lws_fcgi_req_out(req, (uint8_t *)s, (size_t)n))
+			req->broken = 1;
+	}
+
+	req->ended = 1;
+	lws_fcgi_req_wake(req);
+}
+
+static void
+lws_fcgi_conn_gone(struct lws_fcgi_conn *conn)
+{
+	struct lws_fcgi_pool *pool = conn->pool;
+	struct lws_fcgi_req *req = conn->req;
+
+	lws_dll2_remove(&conn->list);
+	if (req) {
+		req->conn = NULL;
+		lws_fcgi_req_fail(req, HTTP_STATUS_BAD_GATEWAY);
+	}
+	lws_free(conn);
+
+	lws_fcgi_dispatch(pool);
+}
+
+static struct lws_fcgi_conn *
+lws_fcgi_conn_create(struct lws_fcgi_pool *pool, struct lws_fcgi_req *req)
+{
+	struct lws_client_connect_info i;
+	struct lws_fcgi_conn *conn;
+
+	conn = lws_zalloc(sizeof(*conn), __func__);
+	if (!conn)
+		return NULL;
+
+	conn->pool = pool;
+	conn->req = req;
+	req->conn = conn;
+	lws_dll2_add_tail(&conn->list, &pool->busy);
+
+	memset(&i, 0, sizeof(i));
+	i.context = pool->vh->context;
+	i.vhost = pool->vh;
+	i.address = pool->address;
+	i.host = pool->address;
+	i.origin = pool->address;
+	i.port = pool->port;
+	i.path = "";
+	i.method = "RAW";
+	i.local_protocol_name = lws_fastcgi_protocol.name;
+	i.opaque_user_data = conn;
+	i.pwsi = &conn->wsi;
+
+	/*
+	 * If the connect fails inline, the error callback leaves the conn for
+	 * us to clean up after we're out of here
+	 */
+
+	conn->in_connect = 1;
+	if (!lws_client_connect_via_info(&i))
+		conn->failed = 1;
+	conn->in_connect = 0;
+
+	if (conn->failed) {
+		lwsl_notice("%s: unable to connect to %s\n", __func__,
+			    pool->address);
+		conn->wsi = NULL;
+		lws_fcgi_conn_gone(conn);
+
+		return NULL;
+	}
+
+	return conn;
+}
+
+/*
+ * Give waiting requests to idle connections, or make new connections for
+ * them if we're not at the limit
+ */
+
+static void
+lws_fcgi_dispatch(struct lws_fcgi_pool *pool)
+{
+	struct lws_fcgi_conn *conn;
+	struct lws_fcgi_req *req;
+
+	if (pool->dispatching || lws_fcgi_pool_dead(pool))
+		return;
+
+	pool->dispatching = 1;
+
+	while (pool->queue.head) {
+		req = lws_container_of(pool->queue.head, struct lws_fcgi_req,
+				       list);
+
+		if (pool->idle.head) {
+			conn = lws_container_of(pool->idle.head,
+						struct lws_fcgi_conn, list);
+			lws_dll2_remove(&conn->list);
+			lws_dll2_add_tail(&conn->list, &pool->busy);
+			lws_dll2_remove(&req->list);
+
+			conn->req = req;
+			req->conn = conn;
+			lws_callback_on_writable(conn->wsi);
+			continue;
+		}
+
+		if (pool->busy.count >= pool->max_conns)
+			break;
+
+		lws_dll2_remove(&req->list);
+		lws_fcgi_conn_create(pool, req);
+	}
+
+	pool->dispatching = 0;
+}
+
+static void
+lws_fcgi_req_ended(struct lws_fcgi_conn *conn)
+{
+	struct lws_fcgi_req *req = conn->req;
+	struct lws_fcgi_pool *pool = conn->pool;
+
+	if (req) {
+		req->conn = NULL;
+		conn->req = NULL;
+		if (!req->out_seen)
+			/* responders are supposed to say something */
+			lws_fcgi_req_fail(req, HTTP_STATUS_BAD_GATEWAY);
+		req->ended = 1;
+		lws_fcgi_req_wake(req);
+	}
+
+	/* the worker is keeping the connection for the next request */
+
+	lws_dll2_remove(&conn->list);
+	lws_dll2_add_tail(&conn->list, &pool->idle);
+
+	lws_fcgi_dispatch(pool);
+}
+
+static int
+lws_fcgi_conn_content(struct lws_fcgi_conn *conn, const uint8_t *in,
+		      size_t len)
+{
+	struct lws_fcgi_req *req = conn->req;
+
+	if (lws_ser_ru16be(&conn->hdr[2]) != LWS_FCGI_REQ_ID)
+		/* management records are of no interest */
+		return 0;
+
+	switch (conn->hdr[1]) {
+	case LWS_FCGI_STDOUT:
+		if (!req || req->ended)
+			break;
+
+		req->out_seen = 1;
+		lws_set_timeout(req->wsi, PENDING_TIMEOUT_CGI,
+				req->timeout_secs);
+		if (lws_fcgi_req_out(req, in, len))
+			return 1;
+
+		if (req->out_len > LWS_FCGI_BUFFER_LIMIT && !conn->rx_held) {
+			/* until the client catches up */
+			conn->rx_held = 1;
+			lws_rx_flow_control(conn->wsi, 0);
+		}
+		break;
+
+	case LWS_FCGI_STDERR:
+		lwsl_notice("FastCGI-stderr: %.*s\n", (int)len,
+			    (const char *)in);
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static int
+lws_fcgi_conn_rx(struct lws_fcgi_conn *conn, const uint8_t *in, size_t len)
+{
+	size_t n;
+
+	while (len) {
+		if (conn->hdr_pos < LWS_FCGI_HDR_LEN) {
+			conn->hdr[conn->hdr_pos++] = *in++;
+			len--;
+			if (conn->hdr_pos < LWS_FCGI_HDR_LEN)
+				continue;
+
+			if (conn->hdr[0] != LWS_FCGI_VERSION_1) {
+				lwsl_notice("%s: bad version %d\n", __func__,
+					    conn->hdr[0]);
+				return 1;
+			}
+			conn->content_remain = lws_ser_ru16be(&conn->hdr[4]);
+			conn->padding_remain = conn->hdr[6];
+		} else if (conn->content_remain) {
+			n = conn->content_remain;
+			if (n > len)
+				n = len;
+			if (lws_fcgi_conn_content(conn, in, n))
+				return 1;
+			in += n;
+			len -= n;
+			conn->content_remain = (uint16_t)(conn->content_remain - n);
+		} else {
+			n = conn->padding_remain;
+			if (n > len)
+				n = len;
+			in += n;
+			len -= n;
+			conn->padding_remain = (uint8_t)(conn->padding_remain - n);
+		}
+
+		if (conn->content_remain || conn->padding_remain)
+			continue;
+
+		/* the record is complete */
+
+		conn->hdr_pos = 0;
+		if (conn->hdr[1] == LWS_FCGI_END_REQUEST &&
+		    lws_ser_ru16be(&conn->hdr[2]) == LWS_FCGI_REQ_ID)
+			lws_fcgi_req_ended(conn);
+	}
+
+	return 0;
+}
+
+int
+lws_fcgi_stdin(struct lws *wsi, const uint8_t *buf, size_t len)
+{
+	struct lws_fcgi_req *req = wsi->http.cgi->fcgi;
+
+	if (req->stdin_ended || req->ended)
+		/* nobody is listening any more */
+		return 0;
+
+	if (!len)
+		req->stdin_ended = 1;
+
+	if (lws_fcgi_record(&req->tx, &req->tx_len, LWS_FCGI_STDIN, buf, len))
+		return 1;
+
+	if (req->conn && req->conn->connected)
+		lws_callback_on_writable(req->conn->wsi);
+
+	if (!req->stdin_ended && !req->rx_held &&
+	    req->tx_len > LWS_FCGI_BUFFER_LIMIT) {
+		/* until the worker catches up */
+		req->rx_held = 1;
+		lws_rx_flow_control(wsi, 0);
+	}
+
+	return 0;
+}
+
+/*
+ * Like read() on the cgi stdout pipe: > 0 is some data, 0 means the worker
+ * ended the response, -1 with EAGAIN means there is nothing yet
+ */
+
+int
+lws_fcgi_stdout_read(struct lws *wsi, uint8_t *buf, size_t len)
+{
+	struct lws_fcgi_req *req = wsi->http.cgi->fcgi;
+	size_t n;
+
+	if (req->broken) {
+		errno = EPIPE;
+
+		return -1;
+	}
+
+	n = lws_fcgi_buflist_use(&req->out, buf, len);
+	req->out_len -= n;
+	if (n)
+		return (int)n;
+
+	if (req->ended)
+		return 0;
+
+	errno = EAGAIN;
+
+	return -1;
+}
+
+/* the client connection took what it could, see if there's more */
+
+void
+lws_fcgi_stdout_resume(struct lws *wsi)
+{
+	struct lws_fcgi_req *req = wsi->http.cgi->fcgi;
+
+	if (req->out || req->ended)
+		lws_fcgi_req_wake(req);
+
+	if (req->conn && req->conn->rx_held &&
+	    req->out_len < LWS_FCGI_BUFFER_LIMIT / 2) {
+		req->conn->rx_held = 0;
+		lws_rx_flow_control(req->conn->wsi, 1);
+	}
+}
+
+/*
+ * The http side is finished with the request.  If it is still in flight on a
+ * worker connection, we can't use that connection again until the worker
+ * has finished with it, so we drop the connection.
+ */
+
+void
+lws_fcgi_req_detach(struct lws_cgi *cgi)
+{
+	struct lws_fcgi_req *req = cgi->fcgi;
+	struct lws_fcgi_conn *conn;
+
+	if (!req)
+		return;
+
+	cgi->fcgi = NULL;
+	conn = req->conn;
+	if (conn) {
+		conn->req = NULL;
+		if (conn->wsi) {
+			lws_set_opaque_user_data(conn->wsi, NULL);
+			lws_set_timeout(conn->wsi,
+					PENDING_TIMEOUT_KILLED_BY_PARENT,
+					LWS_TO_KILL_ASYNC);
+		}
+		conn->wsi = NULL;
+		lws_fcgi_conn_gone(conn);
+	}
+
+	lws_dll2_remove(&req->list);
+	lws_buflist_destroy_all_segments(&req->tx);
+	lws_buflist_destroy_all_segments(&req->out);
+	lws_free(req);
+}
+
+int
+lws_fastcgi(struct lws *wsi, const struct lws_http_mount *hit,
+	    int timeout_secs)
+{
+	char *env_array[30], cgi_path[500], e[1024], *eq;
+	uint8_t params[2048], *p = params, *end = params + sizeof(params),
+		begin[8];
+	struct lws_fcgi_pool *pool = NULL;
+	struct lws_fcgi_vhd *vhd;
+	struct lws_fcgi_req *req;
+	int n, m;
+
+	vhd = (struct lws_fcgi_vhd *)lws_protocol_vh_priv_get(wsi->vhost,
+							&lws_fastcgi_protocol);
+	if (vhd)
+		lws_start_foreach_dll(struct lws_dll2 *, d,
+				      lws_dll2_get_head(&vhd->pools)) {
+			struct lws_fcgi_pool *pp = lws_container_of(d,
+						struct lws_fcgi_pool, list);
+
+			if (pp->mount == hit)
+				pool = pp;
+		} lws_end_foreach_dll(d);
+
+	if (!pool) {
+		lwsl_err("%s: no pool for %s\n", __func__, hit->mountpoint);
+
+		return -1;
+	}
+
+	wsi->http.cgi = lws_zalloc(sizeof(*wsi->http.cgi), "new cgi");
+	if (!wsi->http.cgi) {
+		lwsl_err("%s: OOM\n", __func__);
+		return -1;
+	}
+
+	wsi->http.cgi->response_code = HTTP_STATUS_OK;
+	wsi->http.cgi->wsi = wsi;
+
+	/* the worker gets the same env a cgi would, as params */
+
+	n = lws_cgi_env(wsi, hit->origin, hit->mountpoint_len, hit->cgienv,
+			env_array, (int)LWS_ARRAY_SIZE(env_array), e, sizeof(e),
+			cgi_path, sizeof(cgi_path));
+	if (n < 0)
+		goto bail;
+
+	for (m = 0; m < n; m++) {
+		eq = strchr(env_array[m], '=');
+		if (!eq)
+			continue;
+		if (lws_fcgi_param(&p, end, env_array[m],
+				   (size_t)lws_ptr_diff(eq, env_array[m]),
+				   eq + 1, strlen(eq + 1)))
+			goto bail;
+	}
+	if (lws_fcgi_param(&p, end, "SCRIPT_NAME", 11, hit->mountpoint,
+			   hit->mountpoint_len))
+		goto bail;
+
+	req = lws_zalloc(sizeof(*req), __func__);
+	if (!req)
+		goto bail;
+
+	req->pool = pool;
+	req->wsi = wsi;
+	req->timeout_secs = timeout_secs;
+	wsi->http.cgi->fcgi = req;
+
+	memset(begin, 0, sizeof(begin));
+	lws_ser_wu16be(begin, LWS_FCGI_RESPONDER);
+	begin[2] = LWS_FCGI_KEEP_CONN;
+
+	if (lws_fcgi_record(&req->tx, &req->tx_len, LWS_FCGI_BEGIN_REQUEST,
+			    begin, sizeof(begin)) ||
+	    lws_fcgi_record(&req->tx, &req->tx_len, LWS_FCGI_PARAMS, params,
+			    (size_t)lws_ptr_diff(p, params)) ||
+	    lws_fcgi_record(&req->tx, &req->tx_len, LWS_FCGI_PARAMS, NULL, 0))
+		goto bail1;
+
+	if (!wsi->http.rx_content_length &&
+	    lws_fcgi_stdin(wsi, NULL, 0))
+		goto bail1;
+
+	lwsl_info("%s: %s\n", __func__, wsi->http.cgi->summary);
+
+	lws_set_timeout(wsi, PENDING_TIMEOUT_CGI, timeout_secs);
+
+	/* the worker is sending us http1.x header data first */
+	wsi->hdr_state = LCHS_HEADER;
+
+	if (pool->queue.count >= pool->max_queue) {
+		lwsl_notice("%s: %s: queue full\n", __func__, hit->mountpoint);
+		lws_fcgi_req_fail(req, HTTP_STATUS_SERVICE_UNAVAILABLE);
+
+		return 0;
+	}
+
+	lws_dll2_add_tail(&req->list, &pool->queue);
+	lws_fcgi_dispatch(pool);
+
+	return 0;
+
+bail1:
+	lws_fcgi_req_detach(wsi->http.cgi);
+bail:
+	lws_free_set_NULL(wsi->http.cgi);
+
+	return -1;
+}
+
+static void
+lws_fcgi_worker_spawn(lws_sorted_usec_list_t *sul);
+
+static void
+lws_fcgi_worker_reaped(void *opaque, lws_usec_t *accounting, siginfo_t *si,
+		       int we_killed_him)
+{
+	struct lws_fcgi_worker *w = (struct lws_fcgi_worker *)opaque;
+
+	lwsl_notice("%s: worker for %s exited\n", __func__,
+		    w->pool->mount->mountpoint);
+
+	if (!lws_fcgi_pool_dead(w->pool))
+		lws_sul_schedule(w->pool->vh->context, 0, &w->sul,
+				 lws_fcgi_worker_spawn, LWS_US_PER_SEC);
+}
+
+static void
+lws_fcgi_worker_spawn(lws_sorted_usec_list_t *sul)
+{
+	struct lws_fcgi_worker *w = lws_container_of(sul,
+					struct lws_fcgi_worker, sul);
+	const struct lws_protocol_vhost_options *pvo = w->pool->mount->cgienv;
+	struct lws_context *cx = w->pool->vh->context;
+	char *env_array[30], e[1024], *p = e, *end = e + sizeof(e) - 1;
+	struct lws_spawn_piped_info info;
+	const char *exec_array[2];
+	int n = 0;
+
+	if (lws_fcgi_pool_dead(w->pool))
+		return;
+
+	if (w->lsp) {
+		/*
+		 * His stdout and stderr closed, but he wasn't reaped yet.
+		 * Either he's still on his way out, or somebody else waited
+		 * for him already.
+		 */
+		if (lws_spawn_reap(w->lsp))
+			return;
+
+		if (!kill(w->lsp->child_pid, 0) || errno != ESRCH) {
+			lws_sul_schedule(cx, 0, &w->sul, lws_fcgi_worker_spawn,
+					 250 * LWS_US_PER_MS);
+			return;
+		}
+
+		lws_spawn_piped_destroy(&w->lsp);
+	}
+
+	env_array[n++] = p;
+	p += lws_snprintf(p, (size_t)lws_ptr_diff(end, p),
+			  "PATH=/bin:/usr/bin:/usr/local/bin");
+	p++;
+
+	while (pvo && n < (int)LWS_ARRAY_SIZE(env_array) - 2) {
+		env_array[n++] = p;
+		p += lws_snprintf(p, (size_t)lws_ptr_diff(end, p), "%s=%s",
+				  pvo->name, pvo->value);
+		p++;
+		pvo = pvo->next;
+	}
+
+	env_array[n++] = p;
+	p += lws_snprintf(p, (size_t)lws_ptr_diff(end, p),
+			  "SERVER_SOFTWARE=lws");
+	env_array[n] = NULL;
+
+	exec_array[0] = w->pool->mount->origin;
+	exec_array[1] = NULL;
+
+	memset(&info, 0, sizeof(info));
+	info.vh = w->pool->vh;
+	info.exec_array = exec_array;
+	info.env_array = env_array;
+	info.protocol_name = lws_fastcgi_protocol.name;
+	info.plsp = &w->lsp;
+	info.opaque = w;
+	info.reap_cb = lws_fcgi_worker_reaped;
+	info.max_log_lines = 20000;
+	info.disable_ctrlc = 1;
+	/* FastCGI workers accept() their connections on stdin */
+	info.use_stdin_fd = 1;
+	info.stdin_fd = w->pool->listen_fd;
+
+	w->lsp = lws_spawn_piped(&info);
+	if (!w->lsp) {
+		lwsl_err("%s: unable to spawn %s\n", __func__, exec_array[0]);
+		lws_sul_schedule(cx, 0, &w->sul, lws_fcgi_worker_spawn,
+				 5 * LWS_US_PER_SEC);
+		return;
+	}
+
+	/* workers are persistent, unlike cgi there's no time limit */
+	lws_sul_schedule(cx, 0, &w->lsp->sul, NULL, LWS_SET_TIMER_USEC_CANCEL);
+
+	lwsl_info("%s: %s: worker PID %d\n", __func__, exec_array[0],
+		  (int)w->lsp->child_pid);
+}
+
+static int
+lws_fcgi_pool_listen(struct lws_fcgi_pool *pool)
+{
+	struct sockaddr_un sau;
+	int fd;
+
+	/*
+	 * The socket goes in a directory only we can get into, so nobody else
+	 * can reach it or put something in its place, whatever the umask
+	 */
+
+	lws_strncpy(pool->sock_dir, "/tmp/lws-fcgi-XXXXXX",
+		    sizeof(pool->sock_dir));
+	if (!mkdtemp(pool->sock_dir)) {
+		lwsl_err("%s: unable to create socket dir, errno %d\n",
+			 __func__, errno);
+		pool->sock_dir[0] = '\0';
+
+		return 1;
+	}
+
+	lws_snprintf(pool->sock_path, sizeof(pool->sock_path), "%s/sock",
+		     pool->sock_dir);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		goto bail;
+
+	memset(&sau, 0, sizeof(sau));
+	sau.sun_family = AF_UNIX;
+	lws_strncpy(sau.sun_path, pool->sock_path, sizeof(sau.sun_path));
+
+	if (bind(fd, (struct sockaddr *)&sau, sizeof(sau)) < 0 ||
+	    listen(fd, SOMAXCONN) < 0) {
+		lwsl_err("%s: unable to listen on %s, errno %d\n", __func__,
+			 pool->sock_path, errno);
+		close(fd);
+		unlink(pool->sock_path);
+		goto bail;
+	}
+
+	lws_plat_apply_FD_CLOEXEC(fd);
+	pool->listen_fd = fd;
+	lws_snprintf(pool->address, sizeof(pool->address), "+%s",
+		     pool->sock_path);
+
+	return 0;
+
+bail:
+	rmdir(pool->sock_dir);
+	pool->sock_dir[0] = '\0';
+	pool->sock_path[0] = '\0';
+
+	return 1;
+}
+
+static void
+lws_fcgi_pool_destroy(struct lws_fcgi_pool *pool)
+{
+	struct lws_fcgi_worker *w;
+	int n, m;
+
+	pool->destroying = 1;
+
+	for (n = 0; n < pool->count_workers; n++) {
+		w = &pool->workers[n];
+
+		lws_sul_schedule(pool->vh->context, 0, &w->sul, NULL,
+				 LWS_SET_TIMER_USEC_CANCEL);
+		if (!w->lsp)
+			continue;
+
+		/* any stdwsi left can't refer to us after this */
+		for (m = 0; m < 3; m++)
+			if (w->lsp->stdwsi[m])
+				lws_set_opaque_user_data(w->lsp->stdwsi[m],
+							 NULL);
+		lws_spawn_piped_kill_child_process(w->lsp);
+		if (w->lsp)
+			lws_spawn_piped_destroy(&w->lsp);
+	}
+
+	/* the wsi have all been closed by now, but let's be sure */
+
+	lws_start_foreach_dll_safe(struct lws_dll2 *, d, d1,
+				   lws_dll2_get_head(&pool->queue)) {
+		struct lws_fcgi_req *req = lws_container_of(d,
+						struct lws_fcgi_req, list);
+
+		lws_dll2_remove(&req->list);
+		req->ended = 1;
+	} lws_end_foreach_dll_safe(d, d1);
+
+	while (pool->idle.head || pool->busy.head) {
+		struct lws_fcgi_conn *conn = lws_container_of(
+			pool->idle.head ? pool->idle.head : pool->busy.head,
+			struct lws_fcgi_conn, list);
+
+		if (conn->wsi)
+			lws_set_opaque_user_data(conn->wsi, NULL);
+		if (conn->req)
+			conn->req->conn = NULL;
+		lws_dll2_remove(&conn->list);
+		lws_free(conn);
+	}
+
+	if (pool->listen_fd >= 0)
+		close(pool->listen_fd);
+	if (pool->sock_path[0])
+		unlink(pool->sock_path);
+	if (pool->sock_dir[0])
+		rmdir(pool->sock_dir);
+
+	lws_dll2_remove(&pool->list);
+	lws_free(pool);
+}
+
+static int
+lws_fcgi_pool_create(struct lws_fcgi_vhd *vhd, struct lws_vhost *vh,
+		     const struct lws_http_mount *m)
+{
+	struct lws_fcgi_pool *pool;
+	unsigned short conns;
+	const char *colon;
+	int n, spawn;
+
+	conns = m->fastcgi_conns ? m->fastcgi_conns : 4;
+	spawn = m->origin[0] == '/';
+
+	pool = lws_zalloc(sizeof(*pool) + (spawn ? conns *
+			  sizeof(struct lws_fcgi_worker) : 0), __func__);
+	if (!pool)
+		return 1;
+
+	pool->mount = m;
+	pool->vh = vh;
+	pool->max_conns = conns;
+	pool->max_queue = m->fastcgi_queue ? m->fastcgi_queue : 64;
+	pool->listen_fd = -1;
+	lws_dll2_add_tail(&pool->list, &vhd->pools);
+
+	if (spawn) {
+		/*
+		 * We start one worker per connection we may make, they all
+		 * accept() on the same listening socket
+		 */
+		if (lws_fcgi_pool_listen(pool))
+			goto bail;
+
+		pool->workers = (struct lws_fcgi_worker *)&pool[1];
+		pool->count_workers = conns;
+		for (n = 0; n < conns; n++) {
+			pool->workers[n].pool = pool;
+			lws_sul_schedule(vh->context, 0,
+					 &pool->workers[n].sul,
+					 lws_fcgi_worker_spawn, 1);
+		}
+
+		return 0;
+	}
+
+	if (m->origin[0] == '+') {
+		/* an existing unix socket */
+		lws_strncpy(pool->address, m->origin, sizeof(pool->address));
+
+		return 0;
+	}
+
+	colon = strrchr(m->origin, ':');
+	if (!colon || colon == m->origin) {
+		lwsl_err("%s: fastcgi origin %s needs to be /program, "
+			 "+/unix/socket or host:port\n", __func__, m->origin);
+		goto bail;
+	}
+
+	lws_strnncpy(pool->address, m->origin,
+		     (size_t)lws_ptr_diff(colon, m->origin),
+		     sizeof(pool->address));
+	pool->port = atoi(colon + 1);
+
+	return 0;
+
+bail:
+	lws_fcgi_pool_destroy(pool);
+
+	return 1;
+}
+
+static int
+callback_fastcgi(struct lws *wsi, enum lws_callback_reasons reason,
+		 void *user, void *in, size_t len)
+{
+	struct lws_context_per_thread *pt = &wsi->context->pt[(int)wsi->tsi];
+	struct lws_vhost *vh = lws_get_vhost(wsi);
+	struct lws_fcgi_vhd *vhd = (struct lws_fcgi_vhd *)
+				lws_protocol_vh_priv_get(vh,
+						lws_get_protocol(wsi));
+	const struct lws_http_mount *m;
+	struct lws_fcgi_worker *w;
+	struct lws_fcgi_conn *conn;
+	struct lws_fcgi_req *req;
+	char buf[256];
+	int n;
+
+	switch (reason) {
+	case LWS_CALLBACK_PROTOCOL_INIT:
+		if (vhd)
+			break;
+
+		for (m = vh->http.mount_list; m; m = m->mount_next)
+			if (m->origin_protocol == LWSMPRO_FASTCGI)
+				break;
+		if (!m)
+			/* nothing for us to do on this vhost */
+			break;
+
+		vhd = lws_protocol_vh_priv_zalloc(vh, lws_get_protocol(wsi),
+						  sizeof(*vhd));
+		if (!vhd)
+			return -1;
+
+		for (m = vh->http.mount_list; m; m = m->mount_next)
+			if (m->origin_protocol == LWSMPRO_FASTCGI &&
+			    lws_fcgi_pool_create(vhd, vh, m))
+				return -1;
+		break;
+
+	case LWS_CALLBACK_PROTOCOL_DESTROY:
+		if (!vhd)
+			break;
+
+		lws_start_foreach_dll_safe(struct lws_dll2 *, d, d1,
+					   lws_dll2_get_head(&vhd->pools)) {
+			lws_fcgi_pool_destroy(lws_container_of(d,
+						struct lws_fcgi_pool, list));
+		} lws_end_foreach_dll_safe(d, d1);
+		break;
+
+	/* connections to the workers */
+
+	case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
+		conn = (struct lws_fcgi_conn *)lws_get_opaque_user_data(wsi);
+		if (!conn)
+			break;
+		lwsl_notice("%s: %s: %s\n", __func__, conn->pool->address,
+			    in ? (const char *)in : "connection error");
+		lws_set_opaque_user_data(wsi, NULL);
+		conn->wsi = NULL;
+		if (conn->in_connect) {
+			conn->failed = 1;
+			break;
+		}
+		lws_fcgi_conn_gone(conn);
+		break;
+
+	case LWS_CALLBACK_RAW_CONNECTED:
+		conn = (struct lws_fcgi_conn *)lws_get_opaque_user_data(wsi);
+		if (!conn)
+			return -1;
+		conn->connected = 1;
+		if (conn->req)
+			lws_callback_on_writable(wsi);
+		break;
+
+	case LWS_CALLBACK_RAW_RX:
+		conn = (struct lws_fcgi_conn *)lws_get_opaque_user_data(wsi);
+		if (!conn)
+			return -1;
+		if (lws_fcgi_conn_rx(conn, (const uint8_t *)in, len))
+			return -1;
+		break;
+
+	case LWS_CALLBACK_RAW_WRITEABLE:
+		conn = (struct lws_fcgi_conn *)lws_get_opaque_user_data(wsi);
+		if (!conn || !conn->req || !conn->req->tx)
+			break;
+		req = conn->req;
+
+		n = (int)lws_fcgi_buflist_use(&req->tx, pt->serv_buf + LWS_PRE,
+				wsi->context->pt_serv_buf_size - LWS_PRE);
+		req->tx_len -= (size_t)n;
+		if (lws_write(wsi, pt->serv_buf + LWS_PRE, (size_t)n,
+			      LWS_WRITE_RAW) != n)
+			return -1;
+
+		if (req->tx)
+			lws_callback_on_writable(wsi);
+
+		if (req->rx_held && req->tx_len < LWS_FCGI_BUFFER_LIMIT / 2) {
+			req->rx_held = 0;
+			lws_rx_flow_control(req->wsi, 1);
+		}
+		break;
+
+	case LWS_CALLBACK_RAW_CLOSE:
+		conn = (struct lws_fcgi_conn *)lws_get_opaque_user_data(wsi);
+		if (!conn)
+			break;
+		lws_set_opaque_user_data(wsi, NULL);
+		conn->wsi = NULL;
+		lws_fcgi_conn_gone(conn);
+		break;
+
+	/* stdout and stderr of workers we spawned */
+
+	case LWS_CALLBACK_RAW_RX_FILE:
+		n = (int)read(lws_get_socket_fd(wsi), buf, sizeof(buf) - 1);
+		if (n <= 0)
+			return -1;
+		while (n && (buf[n - 1] == '\n' || buf[n - 1] == '\r'))
+			n--;
+		buf[n] = '\0';
+		lwsl_notice("FastCGI-worker: %s\n", buf);
+		break;
+
+	case LWS_CALLBACK_RAW_CLOSE_FILE:
+		w = (struct lws_fcgi_worker *)lws_get_opaque_user_data(wsi);
+		if (!w || !w->lsp)
+			break;
+
+		/* the fd is closed along with the stdwsi */
+		n = lws_spawn_get_stdfd(wsi);
+		w->lsp->stdwsi[n] = NULL;
+		w->lsp->pipe_fds[n][0] = -1;
+		lws_spawn_stdwsi_closed(w->lsp);
+
+		if (w->lsp && !w->lsp->pipes_alive &&
+		    !lws_fcgi_pool_dead(w->pool))
+			/* follow up on him being reaped */
+			lws_sul_schedule(wsi->context, 0, &w->sul,
+					 lws_fcgi_worker_spawn,
+					 100 * LWS_US_PER_MS);
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+const struct lws_protocols lws_fastcgi_protocol = {
+	"lws-fastcgi",
+	callback_fastcgi,
+	0,
+	0,
+	0, NULL, 0
+};
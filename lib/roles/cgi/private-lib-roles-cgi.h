@@ -86,5 +86,31 @@ struct lws_cgi {
 	unsigned char gzip_inflate:1;
 	unsigned char gzip_init:1;
 
+#if defined(LWS_WITH_FASTCGI)
+	struct lws_fcgi_req *fcgi; /* set if stdout comes from a FastCGI pool */
+#endif
+
 	unsigned char chunked_grace;
 };
+
+int
+lws_cgi_env(struct lws *wsi, const char *script, int script_uri_path_len,
+	    const struct lws_protocol_vhost_options *mp_cgienv,
+	    char **env_array, int env_max, char *e, size_t e_len,
+	    char *cgi_path, size_t cgi_path_len);
+
+#if defined(LWS_WITH_FASTCGI)
+extern const struct lws_protocols lws_fastcgi_protocol;
+
+int
+lws_fastcgi(struct lws *wsi, const struct lws_http_mount *hit,
+	    int timeout_secs);
+int
+lws_fcgi_stdin(struct lws *wsi, const uint8_t *buf, size_t len);
+int
+lws_fcgi_stdout_read(struct lws *wsi, uint8_t *buf, size_t len);
+void
+lws_fcgi_stdout_resume(struct lws *wsi);
+void
+lws_fcgi_req_detach(struct lws_cgi *cgi);
+#endif
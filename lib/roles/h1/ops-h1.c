@@ -139,6 +139,14 @@ http_postbody:
 			body_chunk_len = min(wsi->http.rx_content_remain, len);
 			wsi->http.rx_content_remain -= body_chunk_len;
 			// len -= body_chunk_len;
+#if defined(LWS_WITH_FASTCGI)
+			if (wsi->http.cgi && wsi->http.cgi->fcgi) {
+				if (lws_fcgi_stdin(wsi, buf,
+						   (size_t)body_chunk_len))
+					goto bail;
+				n = (size_t)body_chunk_len;
+			} else
+#endif
 #ifdef LWS_WITH_CGI
 			if (wsi->http.cgi) {
 				struct lws_cgi_args args;
@@ -184,10 +192,27 @@ postbody_completion:
 			 * If we're running a cgi, we can't let him off the
 			 * hook just because he sent his POST data
 			 */
-			if (wsi->http.cgi)
+			if (wsi->http.cgi) {
 				lws_set_timeout(wsi, PENDING_TIMEOUT_CGI,
 						wsi->context->timeout_secs);
-			else
+#if defined(LWS_WITH_FASTCGI)
+				if (wsi->http.cgi->fcgi) {
+					/*
+					 * the worker may have completed the
+					 * transaction before it saw all the
+					 * body, which we just discarded
+					 */
+					if (lwsi_state(wsi) ==
+							LRS_DISCARD_BODY) {
+						if (lws_http_transaction_completed(wsi))
+							return -1;
+						break;
+					}
+					if (lws_fcgi_stdin(wsi, NULL, 0))
+						goto bail;
+				}
+#endif
+			} else
 #endif
 			lws_set_timeout(wsi, NO_PENDING_TIMEOUT, 0);
 #ifdef LWS_WITH_CGI
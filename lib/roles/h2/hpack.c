@@ -1385,11 +1385,421 @@ lws_h2_num(int starting_bits, unsigned long num,
 	return 0;
 }
 
+/*
+ * RFC7541 Appendix B Huffman codes by symbol, right-aligned, with their
+ * lengths in bits.  huftable.h only carries the decode tree.
+ */
+
+static const uint32_t huf_enc_code[] = {
+	0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5,
+	0xfffffe6, 0xfffffe7, 0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9,
+	0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec, 0xfffffed, 0xfffffee,
+	0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+	0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9,
+	0xffffffa, 0xffffffb, 0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8,
+	0x7fa, 0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18, 0x0, 0x1,
+	0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc,
+	0x20, 0xffb, 0x3fc, 0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+	0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e,
+	0x6f, 0x70, 0x71, 0x72, 0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc,
+	0x3ffc, 0x22, 0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26, 0x27, 0x6,
+	0x74, 0x75, 0x28, 0x29, 0x2a, 0x7, 0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d,
+	0x77, 0x78, 0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+	0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5,
+	0x7fffd9, 0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde,
+	0xffffeb, 0x7fffdf, 0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee,
+	0x7fffe1, 0x7fffe2, 0x7fffe3, 0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5,
+	0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef, 0x3fffda, 0x1fffdd, 0xfffe9,
+	0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde, 0x7fffea, 0x3fffdd,
+	0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec, 0x1fffe0,
+	0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+	0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6,
+	0x7ffff1, 0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2,
+	0x3fffe8, 0x1ffffec, 0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde,
+	0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed, 0x7fff2, 0x1fffe3,
+	0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+	0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3,
+	0x7ffffe4, 0x7ffffe5, 0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9,
+	0x1fffe7, 0x1fffe8, 0x7ffff3, 0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef,
+	0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4, 0x3ffffeb, 0x7ffffe6,
+	0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+	0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef,
+	0x7fffff0, 0x3ffffee,
+};
+
+static const uint8_t huf_enc_len[] = {
+	13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28, 28, 28,
+	28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28, 6, 10, 10, 12,
+	13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6, 5, 5, 5, 6, 6, 6, 6, 6, 6, 6,
+	7, 8, 15, 6, 12, 10, 13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6, 15, 5, 6, 5, 6, 5,
+	6, 6, 6, 5, 7, 7, 6, 6, 6, 5, 6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11,
+	14, 13, 28, 20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24,
+	23, 24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24, 22,
+	21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23, 21, 21, 22,
+	21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23, 26, 26, 20, 19, 22,
+	23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25, 19, 21, 26, 27, 27, 26, 27,
+	24, 21, 21, 26, 26, 28, 27, 27, 27, 20, 24, 20, 21, 22, 21, 21, 23, 22,
+	22, 25, 25, 24, 24, 26, 23, 26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27,
+	27, 27, 27, 27, 26,
+};
+
+static int
+lws_hpack_put_int(unsigned char flags, int starting_bits, unsigned long num,
+		  unsigned char **p, unsigned char *end)
+{
+	if (*p >= end)
+		return 1;
+
+	*((*p)++) = flags | lws_h2_num_start(starting_bits, num);
+
+	return lws_h2_num(starting_bits, num, p, end);
+}
+
+/*
+ * Emit a string literal, Huffman-coded if that's shorter.  Upper-case header
+ * names are verboten in h2, but OK on h1, so they're not illegal per se.
+ * Silently convert them for h2 if lower is set.
+ */
+
+static int
+lws_hpack_put_str(const unsigned char *s, int len, int lower,
+		  unsigned char **p, unsigned char *end)
+{
+	unsigned int bits = 0, c;
+	uint64_t acc = 0;
+	int n, hlen;
+
+	for (n = 0; n < len; n++) {
+		c = s[n];
+		if (lower)
+			c = tolower((int)c);
+		bits += huf_enc_len[c];
+	}
+	hlen = (int)((bits + 7) >> 3);
+
+	if (hlen >= len) {
+		if (lws_hpack_put_int(0, 7, len, p, end) || end - *p < len)
+			return 1;
+
+		while (len--)
+			*((*p)++) = lower ? tolower((int)*s++) : *s++;
+
+		return 0;
+	}
+
+	if (lws_hpack_put_int(0x80, 7, hlen, p, end) || end - *p < hlen)
+		return 1;
+
+	bits = 0;
+	while (len--) {
+		c = *s++;
+		if (lower)
+			c = tolower((int)c);
+		acc = (acc << huf_enc_len[c]) | huf_enc_code[c];
+		bits += huf_enc_len[c];
+		while (bits >= 8) {
+			bits -= 8;
+			*((*p)++) = (unsigned char)(acc >> bits);
+		}
+	}
+	if (bits) /* pad with the msbs of EOS, ie, 1s */
+		*((*p)++) = (unsigned char)((acc << (8 - bits)) |
+					    (0xff >> bits));
+
+	return 0;
+}
+
+static struct hpack_enc_entry *
+lws_hpack_enc_entry(struct hpack_enc_table *et, int rank)
+{
+	return &et->entries[(et->pos + LWS_H2_HPACK_ENC_ENTRIES - 1 - rank) %
+			    LWS_H2_HPACK_ENC_ENTRIES];
+}
+
+/*
+ * Returns the HPACK index of an exact name + value match in the peer's
+ * dynamic table, or 0.  *name_idx is set to the index of the newest entry
+ * with a matching name, or 0.
+ */
+
+static int
+lws_hpack_enc_find(struct hpack_enc_table *et, const unsigned char *name,
+		   int len, const unsigned char *value, int length,
+		   int *name_idx)
+{
+	struct hpack_enc_entry *e;
+	int n;
+
+	*name_idx = 0;
+
+	for (n = 0; n < et->used_entries; n++) {
+		e = lws_hpack_enc_entry(et, n);
+		if (e->name_len != len ||
+		    strncasecmp(e->nv, (const char *)name, len))
+			continue;
+
+		if (!*name_idx)
+			*name_idx = 62 + n;
+
+		if (e->value_len == length &&
+		    !memcmp(e->nv + len, value, length))
+			return 62 + n;
+	}
+
+	return 0;
+}
+
+static void
+lws_hpack_enc_evict(struct hpack_enc_table *et)
+{
+	struct hpack_enc_entry *e = lws_hpack_enc_entry(et,
+						et->used_entries - 1);
+
+	et->virtual_payload_usage -= e->name_len + e->value_len + 32;
+	lws_free_set_NULL(e->nv);
+	et->used_entries--;
+}
+
+/*
+ * Mirror what the peer decoder does when it sees a literal with incremental
+ * indexing: evict from the oldest end until the new entry fits, then add it
+ * as the newest.  nv is already prepared, so this can't fail.
+ */
+
+static void
+lws_hpack_enc_insert(struct hpack_enc_table *et, char *nv, int len, int length)
+{
+	struct hpack_enc_entry *e;
+	uint32_t size = len + length + 32;
+
+	while (et->used_entries &&
+	       et->virtual_payload_usage + size > LWS_H2_HPACK_ENC_TABLE_SIZE)
+		lws_hpack_enc_evict(et);
+
+	e = &et->entries[et->pos];
+	e->nv = nv;
+	e->name_len = len;
+	e->value_len = length;
+	et->pos = (et->pos + 1) % LWS_H2_HPACK_ENC_ENTRIES;
+	et->used_entries++;
+	et->virtual_payload_usage += size;
+}
+
+void
+lws_hpack_enc_destroy(struct lws_h2_netconn *h2n)
+{
+	struct hpack_enc_table *et = &h2n->hpack_enc_table;
+
+	if (!et->entries)
+		return;
+
+	while (et->used_entries)
+		lws_hpack_enc_evict(et);
+
+	lws_free_set_NULL(et->entries);
+}
+
+/*
+ * Only one header block at a time may own the dynamic table.  If another
+ * stream's block was started and not sent yet, we can't know which of the
+ * two the peer will decode first, so this block must neither reference nor
+ * add table entries... it's left as not the owner and encodes literals.
+ */
+
+static int
+lws_hpack_enc_block_start(struct lws_h2_netconn *h2n, struct lws *wsi,
+			  unsigned char **p, unsigned char *end)
+{
+	if (h2n->hpack_enc_wsi && h2n->hpack_enc_wsi != wsi)
+		return 0;
+
+	if (h2n->hpack_enc_resize) {
+		/* a size update to 0 flushes the peer's table, stop indexing */
+		if (lws_hpack_put_int(0x20, 5, 0, p, end))
+			return 1;
+		lws_hpack_enc_destroy(h2n);
+		h2n->hpack_enc_resize = 0;
+		h2n->hpack_enc_pending = 0;
+		h2n->hpack_enc_off = 1;
+	} else if (h2n->hpack_enc_pending) {
+		/*
+		 * The last block that indexed things was never sent, so the
+		 * peer never saw those entries.  Flush both tables by sizing
+		 * the peer's to 0 and back.
+		 */
+		if (lws_hpack_put_int(0x20, 5, 0, p, end) ||
+		    lws_hpack_put_int(0x20, 5, LWS_H2_HPACK_ENC_TABLE_SIZE,
+				      p, end))
+			return 1;
+		lws_hpack_enc_destroy(h2n);
+		h2n->hpack_enc_pending = 0;
+	}
+
+	h2n->hpack_enc_wsi = wsi;
+
+	return 0;
+}
+
+void
+lws_hpack_enc_block_sent(struct lws *wsi)
+{
+	struct lws *nwsi = lws_get_network_wsi(wsi);
+	struct lws_h2_netconn *h2n = nwsi ? nwsi->h2.h2n : NULL;
+
+	if (!h2n || h2n->hpack_enc_wsi != wsi)
+		return;
+
+	h2n->hpack_enc_wsi = NULL;
+	h2n->hpack_enc_pending = 0;
+}
+
+/*
+ * Headers that change from one response to the next would just churn the
+ * table and evict the ones worth keeping
+ */
+
+static int
+lws_hpack_enc_volatile(int token)
+{
+	switch (token) {
+	case WSI_TOKEN_HTTP_COLON_PATH:
+	case WSI_TOKEN_HTTP_CONTENT_LENGTH:
+	case WSI_TOKEN_HTTP_CONTENT_RANGE:
+	case WSI_TOKEN_HTTP_DATE:
+	case WSI_TOKEN_HTTP_AGE:
+	case WSI_TOKEN_HTTP_ETAG:
+	case WSI_TOKEN_HTTP_EXPIRES:
+	case WSI_TOKEN_HTTP_LAST_MODIFIED:
+	case WSI_TOKEN_HTTP_LOCATION:
+		return 1;
+	}
+
+	return 0;
+}
+
+/* the first static table index with the token's name, or 0 */
+
+static int
+lws_hpack_static_idx(int token)
+{
+	int n;
+
+	if (token < 0)
+		return 0;
+
+	for (n = 1; n < (int)LWS_ARRAY_SIZE(static_token); n++)
+		if (static_token[n] == token)
+			return n;
+
+	return 0;
+}
+
+/*
+ * sidx is the static table index for the name, or 0, and token the lws token
+ * for it, or -1 if unknown
+ */
+
+static int
+lws_hpack_encode(struct lws *wsi, int sidx, int token,
+		 const unsigned char *name, int len,
+		 const unsigned char *value, int length,
+		 unsigned char **p, unsigned char *end)
+{
+	struct lws *nwsi = lws_get_network_wsi(wsi);
+	struct lws_h2_netconn *h2n = nwsi ? nwsi->h2.h2n : NULL;
+	struct hpack_enc_table *et = NULL;
+	int n, idx, never, dyn_name_idx = 0;
+	char *nv = NULL;
+
+	if (end - *p < len + length + 8)
+		return 1;
+
+	/* lws always starts a header block with :status or :method */
+
+	if (h2n && (token == WSI_TOKEN_HTTP_COLON_STATUS ||
+		    token == WSI_TOKEN_HTTP_COLON_METHOD) &&
+	    lws_hpack_enc_block_start(h2n, wsi, p, end))
+		return 1;
+
+	/*
+	 * Headers can be prepared outside of a block, eg, other_headers for
+	 * lws_serve_http_file(), and be sent later or not at all... those
+	 * must not touch the dynamic table
+	 */
+
+	if (h2n && !h2n->hpack_enc_off && h2n->hpack_enc_wsi == wsi)
+		et = &h2n->hpack_enc_table;
+
+	/* some static entries carry the value as well */
+
+	for (n = sidx; n && n < (int)LWS_ARRAY_SIZE(http2_canned) &&
+		       static_token[n] == static_token[sidx]; n++)
+		if (length && (int)strlen(http2_canned[n]) == length &&
+		    !memcmp(http2_canned[n], value, length))
+			return lws_hpack_put_int(0x80, 7, n, p, end);
+
+	if (et) {
+		idx = lws_hpack_enc_find(et, name, len, value, length,
+					 &dyn_name_idx);
+		if (idx)
+			return lws_hpack_put_int(0x80, 7, idx, p, end);
+	}
+
+	never = token == WSI_TOKEN_HTTP_AUTHORIZATION ||
+		token == WSI_TOKEN_HTTP_PROXY_AUTHORIZATION ||
+		((token == WSI_TOKEN_HTTP_COOKIE ||
+		  token == WSI_TOKEN_HTTP_SET_COOKIE) && length < 20);
+
+	if (et && !never && !lws_hpack_enc_volatile(token) &&
+	    len + length + 32 <= LWS_H2_HPACK_ENC_TABLE_SIZE / 4) {
+		if (!et->entries)
+			et->entries = lws_zalloc(sizeof(*et->entries) *
+						 LWS_H2_HPACK_ENC_ENTRIES,
+						 "hpack enc");
+		/*
+		 * The peer will index it as soon as it sees it, so we must
+		 * be able to track it before we commit to indexing
+		 */
+		if (et->entries)
+			nv = lws_malloc(len + length + 1, "hpack enc nv");
+		if (nv) {
+			for (n = 0; n < len; n++)
+				nv[n] = tolower((int)name[n]);
+			memcpy(nv + len, value, length);
+		}
+	}
+
+	idx = sidx ? sidx : dyn_name_idx;
+
+	if (nv)
+		n = lws_hpack_put_int(0x40, 6, idx, p, end);
+	else
+		/* literal never indexed, or without indexing */
+		n = lws_hpack_put_int(never ? 0x10 : 0, 4, idx, p, end);
+
+	if (n || (!idx && lws_hpack_put_str(name, len, 1, p, end)) ||
+	    lws_hpack_put_str(value, length, 0, p, end)) {
+		if (nv)
+			lws_free(nv);
+
+		return 1;
+	}
+
+	if (nv) {
+		lws_hpack_enc_insert(et, nv, len, length);
+		h2n->hpack_enc_pending = 1;
+	}
+
+	return 0;
+}
+
 int lws_add_http2_header_by_name(struct lws *wsi, const unsigned char *name,
 				 const unsigned char *value, int length,
 				 unsigned char **p, unsigned char *end)
 {
-	int len;
+	char key[LWS_LEXHASH_MAX_KEY];
+	int len, n, tok = -1;
 
 	lwsl_header("%s: %p  %s:%s (len %d)\n", __func__, *p, name, value,
 					length);
@@ -1406,29 +1816,17 @@ int lws_add_http2_header_by_name(struct lws *wsi, const unsigned char *name,
 		return 0;
 	}
 
-	if (end - *p < len + length + 8)
-		return 1;
-
-	*((*p)++) = 0; /* literal hdr, literal name,  */
-
-	*((*p)++) = 0 | lws_h2_num_start(7, len); /* non-HUF */
-	if (lws_h2_num(7, len, p, end))
-		return 1;
-
-	/* upper-case header names are verboten in h2, but OK on h1, so
-	 * they're not illegal per se.  Silently convert them for h2... */
+	/* classify it the same way the parser does */
 
-	while(len--)
-		*((*p)++) = tolower((int)*name++);
-
-	*((*p)++) = 0 | lws_h2_num_start(7, length); /* non-HUF */
-	if (lws_h2_num(7, length, p, end))
-		return 1;
-
-	memcpy(*p, value, length);
-	*p += length;
+	if (len < (int)sizeof(key)) {
+		for (n = 0; n < len; n++)
+			key[n] = (char)tolower((int)name[n]);
+		key[len] = ':';
+		tok = lws_http_name_to_token(key, len + 1);
+	}
 
-	return 0;
+	return lws_hpack_encode(wsi, lws_hpack_static_idx(tok), tok, name, len,
+				value, length, p, end);
 }
 
 int lws_add_http2_header_by_token(struct lws *wsi, enum lws_token_indexes token,
@@ -1436,12 +1834,21 @@ int lws_add_http2_header_by_token(struct lws *wsi, enum lws_token_indexes token,
 				  unsigned char **p, unsigned char *end)
 {
 	const unsigned char *name;
+	int len;
 
 	name = lws_token_to_string(token);
 	if (!name)
 		return 1;
 
-	return lws_add_http2_header_by_name(wsi, name, value, length, p, end);
+	len = (int)strlen((char *)name);
+	if (len && name[len - 1] == ':')
+		len--;
+
+	if (wsi->mux_substream && token == WSI_TOKEN_HTTP_TRANSFER_ENCODING)
+		return 0;
+
+	return lws_hpack_encode(wsi, lws_hpack_static_idx(token), token,
+				name, len, value, length, p, end);
 }
 
 int lws_add_http2_header_status(struct lws *wsi, unsigned int code,
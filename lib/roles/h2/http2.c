@@ -135,6 +135,12 @@ void lws_h2_init(struct lws *wsi)
 {
 	wsi->h2.h2n->our_set = wsi->vhost->h2.set;
 	wsi->h2.h2n->peer_set = lws_h2_defaults;
+	wsi->h2.h2n->sched_quantum = LWS_H2_SCHED_QUANTUM;
+	wsi->h2.h2n->rx_window = LWS_H2_RX_WINDOW_INITIAL;
+	if (wsi->h2.h2n->rx_window <
+			wsi->h2.h2n->our_set.s[H2SET_INITIAL_WINDOW_SIZE])
+		wsi->h2.h2n->rx_window =
+			wsi->h2.h2n->our_set.s[H2SET_INITIAL_WINDOW_SIZE];
 }
 
 void
@@ -201,13 +207,91 @@ lws_h2_get_peer_txcredit_estimate(struct lws *wsi)
 	return (int)wsi->txc.peer_tx_cr_est;
 }
 
-static int
-lws_h2_update_peer_txcredit_thresh(struct lws *wsi, int sid, int threshold, int bump)
+/*
+ * Auto-tuning the rx window we give the peer
+ *
+ * On a high-RTT link a fixed window caps each stream's throughput at window /
+ * RTT.  So while DATA is arriving, we keep one PING in flight and count the
+ * DATA that turns up before its ACK... that's a sample of the link's
+ * bandwidth-delay product.  If the sample filled most of the window, the
+ * window is what's holding things back and we grow it to twice the sample,
+ * up to the vhost limit.
+ *
+ * Streams are topped back up to the window when they have used half of it,
+ * so the peer never has to stop and wait for us if the window is big enough.
+ */
+
+void
+lws_h2_rx_window_sample(struct lws *nwsi, struct lws *swsi, int len)
+{
+	struct lws_context_per_thread *pt = &nwsi->context->pt[(int)nwsi->tsi];
+	struct lws_h2_netconn *h2n = nwsi->h2.h2n;
+	struct lws_h2_protocol_send *pps;
+
+	if (swsi->txc.peer_tx_cr_est <= 0 || nwsi->txc.peer_tx_cr_est <= 0)
+		lws_stats_bump(pt, LWSSTATS_C_H2_RX_WINDOW_STALLS, 1);
+
+	h2n->bdp_bytes += (uint32_t)len;
+
+	if (h2n->bdp_ping_us || h2n->rx_window >= nwsi->vhost->h2.rx_window_max)
+		return;
+
+	pps = lws_h2_new_pps(LWS_H2_PPS_PING);
+	if (!pps)
+		return;
+
+	h2n->bdp_ping_us = lws_now_usecs();
+	h2n->bdp_bytes = 0;
+	memcpy(pps->u.ping.ping_payload, &h2n->bdp_ping_us, 8);
+	lws_pps_schedule(nwsi, pps);
+}
+
+void
+lws_h2_rx_window_ping_ack(struct lws *nwsi)
+{
+	struct lws_context_per_thread *pt = &nwsi->context->pt[(int)nwsi->tsi];
+	struct lws_h2_netconn *h2n = nwsi->h2.h2n;
+	uint32_t rtt;
+	uint64_t w;
+
+	if (!h2n->bdp_ping_us ||
+	    memcmp(h2n->ping_payload, &h2n->bdp_ping_us, 8))
+		/* not our BDP PING, eg, a keepalive one */
+		return;
+
+	rtt = (uint32_t)(lws_now_usecs() - h2n->bdp_ping_us);
+	h2n->bdp_ping_us = 0;
+	h2n->srtt_us = h2n->srtt_us ? (7 * h2n->srtt_us + rtt) / 8 : rtt;
+
+	if ((uint64_t)h2n->bdp_bytes * 3 < (uint64_t)h2n->rx_window * 2)
+		return;
+
+	w = (uint64_t)h2n->bdp_bytes * 2;
+	if (w > nwsi->vhost->h2.rx_window_max)
+		w = nwsi->vhost->h2.rx_window_max;
+	if (w <= h2n->rx_window)
+		return;
+
+	lwsl_info("%s: %p: rx window %u -> %u (bdp %u, srtt %uus)\n",
+		  __func__, nwsi, (unsigned int)h2n->rx_window,
+		  (unsigned int)w, (unsigned int)h2n->bdp_bytes,
+		  (unsigned int)h2n->srtt_us);
+
+	h2n->rx_window = (uint32_t)w;
+	lws_stats_bump(pt, LWSSTATS_C_H2_RX_WINDOW_GROWN, 1);
+}
+
+int
+lws_h2_rx_window_top_up(struct lws *swsi, int sid)
 {
-	if (wsi->txc.peer_tx_cr_est > threshold)
+	struct lws_h2_netconn *h2n = lws_get_network_wsi(swsi)->h2.h2n;
+	int32_t est = swsi->txc.peer_tx_cr_est;
+
+	if (est >= (int32_t)(h2n->rx_window / 2))
 		return 0;
 
-	return lws_h2_update_peer_txcredit(wsi, sid, bump);
+	return lws_h2_update_peer_txcredit(swsi, sid,
+					   (int)(h2n->rx_window - (uint32_t)est));
 }
 
 struct lws *
@@ -472,6 +556,14 @@ lws_h2_settings(struct lws *wsi, struct http2_settings *settings,
 
 		switch (a) {
 		case H2SET_HEADER_TABLE_SIZE:
+			/*
+			 * Our encoder assumes the default 4096 table, if the
+			 * peer wants it smaller, flush it with a size update
+			 * on the next header block and stop indexing
+			 */
+			if (b < LWS_H2_HPACK_ENC_TABLE_SIZE &&
+			    !nwsi->h2.h2n->hpack_enc_off)
+				nwsi->h2.h2n->hpack_enc_resize = 1;
 			break;
 		case H2SET_ENABLE_PUSH:
 			if (b > 1) {
@@ -609,6 +701,136 @@ lws_h2_tx_cr_consume(struct lws *wsi, int consumed)
 
 	if (nwsi != wsi)
 		nwsi->txc.tx_cr -= consumed;
+
+	if (consumed && (wsi->txc.tx_cr <= 0 || nwsi->txc.tx_cr <= 0))
+		lws_stats_bump(&nwsi->context->pt[(int)nwsi->tsi],
+			       LWSSTATS_C_H2_TX_WINDOW_STALLS, 1);
+}
+
+/*
+ * RFC7540 5.3 stream priority
+ *
+ * Streams wanting POLLOUT are served by start-time fair queueing.  Each
+ * stream has a virtual "pass" time, advanced by the bytes it writes scaled
+ * inversely by its weight, and the stream with the lowest pass goes next.  So
+ * concurrently busy streams get bandwidth in proportion to their weights, and
+ * a stream that just woke up goes ahead of any stream that has been sending
+ * bulk data for a while.
+ *
+ * A stream whose parent in the dependency tree is also waiting to write gives
+ * way to it.  A stream whose parent has gone away depends on its
+ * grandparent.
+ */
+
+void
+lws_h2_sched_set_priority(struct lws *nwsi, struct lws *wsi, uint32_t dep,
+			  uint8_t weight)
+{
+	uint32_t dsid = dep & ~(1u << 31);
+	struct lws *p = lws_wsi_mux_from_id(nwsi, dsid), *a = p;
+	unsigned int depth = 0;
+
+	/*
+	 * 5.3.3: if we are being made dependent on one of our own
+	 * dependents, first it moves up to take our old place
+	 */
+
+	while (a && depth++ < nwsi->mux.child_count) {
+		if (a == wsi) {
+			p->h2.sched_dep = wsi->h2.sched_dep;
+			break;
+		}
+		a = a->h2.sched_dep ? lws_wsi_mux_from_id(nwsi,
+						a->h2.sched_dep) : NULL;
+	}
+
+	/* exclusive: we adopt all the other dependents of our new parent */
+
+	if (dep & (1u << 31))
+		lws_start_foreach_ll(struct lws *, w, nwsi->mux.child_list) {
+			if (w != wsi && w->h2.sched_dep == dsid)
+				w->h2.sched_dep = wsi->mux.my_sid;
+		} lws_end_foreach_ll(w, mux.sibling_list);
+
+	wsi->h2.sched_dep = dsid;
+	/* on the wire, weight is sent as 0 .. 255 meaning 1 .. 256 */
+	wsi->h2.sched_weight = (uint16_t)(weight + 1);
+
+	lwsl_info("%s: sid %u: dep %u%s, weight %d\n", __func__,
+		  wsi->mux.my_sid, (unsigned int)dsid,
+		  dep & (1u << 31) ? " (excl)" : "", wsi->h2.sched_weight);
+}
+
+void
+lws_h2_sched_charge(struct lws *wsi, unsigned int len)
+{
+	struct lws *nwsi = lws_get_network_wsi(wsi);
+	uint16_t w = wsi->h2.sched_weight;
+
+	if (nwsi == wsi || !nwsi->h2.h2n)
+		return;
+
+	if (!w)
+		w = LWS_H2_SCHED_DEFAULT_WEIGHT;
+
+	wsi->h2.sched_pass += ((uint64_t)len << 8) / w;
+	nwsi->h2.h2n->sched_tx += len;
+}
+
+struct lws **
+lws_h2_sched_pick(struct lws *nwsi)
+{
+	struct lws_h2_netconn *h2n = nwsi->h2.h2n;
+	struct lws **best = NULL, **any = NULL;
+
+	lws_start_foreach_llp(struct lws **, w, nwsi->mux.child_list) {
+		if ((*w)->mux.requested_POLLOUT) {
+			struct lws *p = NULL;
+
+			/* a stream that was idle doesn't get to bank turns */
+			if ((*w)->h2.sched_pass < h2n->sched_vt)
+				(*w)->h2.sched_pass = h2n->sched_vt;
+
+			if (!any || (*w)->h2.sched_pass < (*any)->h2.sched_pass)
+				any = w;
+
+			if ((*w)->h2.sched_dep)
+				p = lws_wsi_mux_from_id(nwsi,
+							(*w)->h2.sched_dep);
+
+			/* if our parent wants to write, it goes first */
+
+			if ((!p || !p->mux.requested_POLLOUT) &&
+			    (!best ||
+			     (*w)->h2.sched_pass < (*best)->h2.sched_pass))
+				best = w;
+		}
+	} lws_end_foreach_llp(w, mux.sibling_list);
+
+	if (!best)
+		/* everybody waiting is blocked by a dependency loop */
+		best = any;
+
+	if (best)
+		h2n->sched_vt = (*best)->h2.sched_pass;
+
+	return best;
+}
+
+void
+lws_h2_sched_remove(struct lws *wsi)
+{
+	struct lws *nwsi = wsi->mux.parent_wsi;
+
+	if (!nwsi)
+		return;
+
+	/* 5.3.4: our dependents now depend on our parent */
+
+	lws_start_foreach_ll(struct lws *, w, nwsi->mux.child_list) {
+		if (w->h2.sched_dep == wsi->mux.my_sid)
+			w->h2.sched_dep = wsi->h2.sched_dep;
+	} lws_end_foreach_ll(w, mux.sibling_list);
 }
 
 int lws_h2_frame_write(struct lws *wsi, int type, int flags,
@@ -643,6 +865,8 @@ int lws_h2_frame_write(struct lws *wsi, int type, int flags,
 		lws_h2_tx_cr_consume(wsi, len);
 	}
 
+	lws_h2_sched_charge(wsi, len + LWS_H2_FRAME_HEADER_LENGTH);
+
 	n = lws_issue_raw(nwsi, &buf[-LWS_H2_FRAME_HEADER_LENGTH],
 			  len + LWS_H2_FRAME_HEADER_LENGTH);
 	if (n < 0)
@@ -1470,6 +1694,11 @@ lws_h2_parse_end_of_frame(struct lws *wsi)
 		if (!h2n->swsi)
 			break;
 
+		if (h2n->type == LWS_H2_FRAME_TYPE_HEADERS &&
+		    h2n->collected_priority)
+			lws_h2_sched_set_priority(wsi, h2n->swsi, h2n->dep,
+						  h2n->weight_temp);
+
 		/* service the http request itself */
 
 		if (h2n->last_action_dyntable_resize) {
@@ -1695,9 +1924,10 @@ lws_h2_parse_end_of_frame(struct lws *wsi)
 		break;
 
 	case LWS_H2_FRAME_TYPE_PING:
-		if (h2n->flags & LWS_H2_FLAG_SETTINGS_ACK)
+		if (h2n->flags & LWS_H2_FLAG_SETTINGS_ACK) {
 			lws_validity_confirmed(wsi);
-		else {
+			lws_h2_rx_window_ping_ack(wsi);
+		} else {
 			/* they're sending us a ping request */
 			struct lws_h2_protocol_send *pps =
 					lws_h2_new_pps(LWS_H2_PPS_PONG);
@@ -1795,6 +2025,13 @@ lws_h2_parse_end_of_frame(struct lws *wsi)
 
 		return 1;
 
+	case LWS_H2_FRAME_TYPE_PRIORITY:
+		/* dep and weight are only valid once the payload is in */
+		if (h2n->swsi && (h2n->dep & ~(1u << 31)) != h2n->sid)
+			lws_h2_sched_set_priority(wsi, h2n->swsi, h2n->dep,
+						  h2n->weight_temp);
+		break;
+
 	case LWS_H2_FRAME_TYPE_RST_STREAM:
 		lwsl_info("LWS_H2_FRAME_TYPE_RST_STREAM: sid %u: reason 0x%x\n",
 			  (unsigned int)h2n->sid,
@@ -2041,6 +2278,8 @@ lws_h2_parser(struct lws *wsi, unsigned char *in, lws_filepos_t inlen,
 					} else {
 						h2n->swsi->txc.peer_tx_cr_est -= n;
 						wsi->txc.peer_tx_cr_est -= n;
+						lws_h2_rx_window_sample(wsi,
+								h2n->swsi, n);
 						lws_wsi_txc_describe(&h2n->swsi->txc,
 							__func__,
 							h2n->swsi->mux.my_sid);
@@ -2063,7 +2302,16 @@ lws_h2_parser(struct lws *wsi, unsigned char *in, lws_filepos_t inlen,
 						goto close_swsi_and_return;
 					}
 
-					break;
+					/*
+					 * Manual rxflow streams return credit
+					 * for both the stream and the nwsi via
+					 * lws_wsi_tx_credit() themselves
+					 */
+					if (h2n->swsi->flags &
+						       LCCSCF_H2_MANUAL_RXFLOW)
+						break;
+
+					goto do_windows;
 				}
 #endif
 
@@ -2127,6 +2375,7 @@ lws_h2_parser(struct lws *wsi, unsigned char *in, lws_filepos_t inlen,
 				h2n->count += n - 1;
 				h2n->swsi->txc.peer_tx_cr_est -= n;
 				wsi->txc.peer_tx_cr_est -= n;
+				lws_h2_rx_window_sample(wsi, h2n->swsi, n);
 
 do_windows:
 
@@ -2137,16 +2386,15 @@ do_windows:
 					/*
 					 * The default behaviour is we just keep
 					 * cranking the other side's tx credit
-					 * back up, for simple bulk transfer as
-					 * fast as we can take it
+					 * back up to the auto-tuned window, for
+					 * simple bulk transfer as fast as we can
+					 * take it
 					 */
 
-					m = n; //(2 * h2n->length) + 65536;
-
 					/* update both the stream and nwsi */
 
-					lws_h2_update_peer_txcredit_thresh(h2n->swsi,
-								    h2n->sid, m, m);
+					lws_h2_rx_window_top_up(h2n->swsi,
+								h2n->sid);
 				}
 #if defined(LWS_WITH_CLIENT)
 				else {
@@ -2188,12 +2436,10 @@ do_windows:
 				break;
 
 			case LWS_H2_FRAME_TYPE_PING:
-				if (h2n->flags & LWS_H2_FLAG_SETTINGS_ACK) { // ack
-				} else { /* they're sending us a ping request */
-					if (h2n->count > 8)
-						return 1;
-					h2n->ping_payload[h2n->count - 1] = c;
-				}
+				/* ack payload is checked for our BDP PING */
+				if (h2n->count > 8)
+					return 1;
+				h2n->ping_payload[h2n->count - 1] = c;
 				break;
 
 			case LWS_H2_FRAME_TYPE_WINDOW_UPDATE:
@@ -441,6 +441,8 @@ rops_write_role_protocol_h2(struct lws *wsi, unsigned char *buf, size_t len,
 	n = LWS_H2_FRAME_TYPE_DATA;
 	if (base == LWS_WRITE_HTTP_HEADERS) {
 		n = LWS_H2_FRAME_TYPE_HEADERS;
+		/* the peer will see whatever this block added to its table */
+		lws_hpack_enc_block_sent(wsi);
 		if (!((*wp) & LWS_WRITE_NO_FIN))
 			flags = LWS_H2_FLAG_END_HEADERS;
 		if (wsi->h2.send_END_STREAM ||
@@ -539,6 +541,13 @@ rops_init_vhost_h2(struct lws_vhost *vh,
 			vh->h2.set.s[n] = info->http2_settings[n];
 	}
 
+	vh->h2.rx_window_max = LWS_H2_RX_WINDOW_MAX;
+	if (info->h2_rx_window_max)
+		vh->h2.rx_window_max = info->h2_rx_window_max;
+	/* an h2 window can't be more than 2^31 - 1 */
+	if (vh->h2.rx_window_max > 0x7fffffff)
+		vh->h2.rx_window_max = 0x7fffffff;
+
 	return 0;
 }
 
@@ -634,8 +643,10 @@ rops_destroy_role_h2(struct lws *wsi)
 	if (wsi->upgraded_to_http2 || wsi->mux_substream) {
 		lws_hpack_destroy_dynamic_header(wsi);
 
-		if (wsi->h2.h2n)
+		if (wsi->h2.h2n) {
+			lws_hpack_enc_destroy(wsi->h2.h2n);
 			lws_free_set_NULL(wsi->h2.h2n);
+		}
 	}
 
 	return 0;
@@ -700,6 +711,10 @@ rops_close_kill_connection_h2(struct lws *wsi, enum lws_close_status reason)
 #endif
 			wsi->mux_substream) &&
 	     wsi->mux.parent_wsi) {
+		lws_h2_sched_remove(wsi);
+		if (wsi->mux.parent_wsi->h2.h2n &&
+		    wsi->mux.parent_wsi->h2.h2n->hpack_enc_wsi == wsi)
+			wsi->mux.parent_wsi->h2.h2n->hpack_enc_wsi = NULL;
 		lws_wsi_mux_sibling_disconnect(wsi);
 		if (wsi->h2.pending_status_body)
 			lws_free_set_NULL(wsi->h2.pending_status_body);
@@ -805,11 +820,15 @@ lws_h2_bind_for_post_before_action(struct lws *wsi)
 /*
  * we are the 'network wsi' for potentially many muxed child wsi with
  * no network connection of their own, who have to use us for all their
- * network actions.  So we use a round-robin scheme to share out the
- * POLLOUT notifications to our children.
+ * network actions.  So we share out the POLLOUT notifications to our
+ * children using the RFC7540 5.3 priorities: lws_h2_sched_pick() chooses
+ * the waiting child with the least weighted fair queueing virtual time,
+ * except a child whose parent in the dependency tree is also waiting
+ * gives way to it.  Bytes a child writes are charged to it in inverse
+ * proportion to its weight.
  *
- * But because any child could exhaust the socket's ability to take
- * writes, we can only let one child get notified each time.
+ * We keep picking children until the socket is choked, we wrote
+ * LWS_H2_SCHED_QUANTUM bytes, or we did child_count + 1 services.
  *
  * In addition children may be closed / deleted / added between POLLOUT
  * notifications, so we can't hold pointers
@@ -818,10 +837,13 @@ lws_h2_bind_for_post_before_action(struct lws *wsi)
 static int
 rops_perform_user_POLLOUT_h2(struct lws *wsi)
 {
+	struct lws_h2_netconn *h2n;
+	unsigned int budget;
 	struct lws **wsi2;
 #if defined(LWS_ROLE_WS)
 	int write_type = LWS_WRITE_PONG;
 #endif
+	uint64_t tx0;
 	int n;
 
 	wsi = lws_get_network_wsi(wsi);
@@ -834,30 +856,38 @@ rops_perform_user_POLLOUT_h2(struct lws *wsi)
 
 	lws_wsi_mux_dump_waiting_children(wsi);
 
-	wsi2 = &wsi->mux.child_list;
-	if (!*wsi2)
+	if (!wsi->mux.child_list)
 		return 0;
 
+	/*
+	 * Keep servicing whichever waiting child the priority scheduler says
+	 * is next, until the connection is choked or we wrote the quantum.
+	 * The number of services is also capped at the number of children,
+	 * in case some keep asking for writeable without writing anything.
+	 */
+
+	h2n = wsi->h2.h2n;
+	tx0 = h2n->sched_tx;
+	budget = wsi->mux.child_count + 1;
+
 	do {
-		struct lws *w, **wa;
+		struct lws *w;
 
-		wa = &(*wsi2)->mux.sibling_list;
-		if (!(*wsi2)->mux.requested_POLLOUT)
-			goto next_child;
+		wsi2 = lws_h2_sched_pick(wsi);
+		if (!wsi2)
+			break;
 
 		/*
 		 * we're going to do writable callback for this child.
-		 * move him to be the last child
+		 * move him to be the last child, so equal-priority children
+		 * are serviced round-robin
 		 */
 
 		lwsl_debug("servicing child %p\n", *wsi2);
 
 		w = lws_wsi_mux_move_child_to_tail(wsi2);
-
-		if (!w) {
-			wa = &wsi->mux.child_list;
-			goto next_child;
-		}
+		if (!w)
+			break;
 
 		lwsl_info("%s: child %p (wsistate 0x%x)\n", __func__, w,
 			  (unsigned int)w->wsistate);
@@ -870,11 +900,9 @@ rops_perform_user_POLLOUT_h2(struct lws *wsi)
 				lwsl_info("%s signalling to close\n", __func__);
 				lws_close_free_wsi(w, LWS_CLOSE_STATUS_NOSTATUS,
 						   "h2 end stream 1");
-				wa = &wsi->mux.child_list;
 				goto next_child;
 			}
 			lws_callback_on_writable(w);
-			wa = &wsi->mux.child_list;
 			goto next_child;
 		}
 
@@ -896,7 +924,6 @@ rops_perform_user_POLLOUT_h2(struct lws *wsi)
 						   "comp write fail");
 			}
 			lws_callback_on_writable(w);
-			wa = &wsi->mux.child_list;
 			goto next_child;
 		}
 #endif
@@ -907,7 +934,6 @@ rops_perform_user_POLLOUT_h2(struct lws *wsi)
 			w->socket_is_permanently_unusable = 1;
 			lws_close_free_wsi(w, LWS_CLOSE_STATUS_NOSTATUS,
 					   "h2 end stream 1");
-			wa = &wsi->mux.child_list;
 			goto next_child;
 		}
 
@@ -924,7 +950,6 @@ rops_perform_user_POLLOUT_h2(struct lws *wsi)
 			lws_free_set_NULL(w->h2.pending_status_body);
 			lws_close_free_wsi(w, LWS_CLOSE_STATUS_NOSTATUS,
 					   "h2 end stream 1");
-			wa = &wsi->mux.child_list;
 			goto next_child;
 		}
 
@@ -971,12 +996,8 @@ rops_perform_user_POLLOUT_h2(struct lws *wsi)
 				lwsl_info("closing stream after h2 action\n");
 				lws_close_free_wsi(w, LWS_CLOSE_STATUS_NOSTATUS,
 						   "h2 end stream");
-				wa = &wsi->mux.child_list;
 			}
 
-			if (n < 0)
-				wa = &wsi->mux.child_list;
-
 			goto next_child;
 		}
 
@@ -986,7 +1007,6 @@ rops_perform_user_POLLOUT_h2(struct lws *wsi)
 
 			if (lws_wsi_txc_check_skint(&w->txc,
 						    lws_h2_tx_cr_get(w))) {
-				wa = &wsi->mux.child_list;
 				goto next_child;
 			}
 
@@ -1009,7 +1029,6 @@ rops_perform_user_POLLOUT_h2(struct lws *wsi)
 				lwsl_debug("Closing POLLOUT child %p\n", w);
 				lws_close_free_wsi(w, LWS_CLOSE_STATUS_NOSTATUS,
 						   "h2 end stream file");
-				wa = &wsi->mux.child_list;
 				goto next_child;
 			}
 			if (n > 0)
@@ -1072,7 +1091,6 @@ rops_perform_user_POLLOUT_h2(struct lws *wsi)
 				lwsi_set_state(w, LRS_RETURNED_CLOSE);
 				lws_close_free_wsi(w, LWS_CLOSE_STATUS_NOSTATUS,
 						   "returned close packet");
-				wa = &wsi->mux.child_list;
 				goto next_child;
 			}
 
@@ -1112,14 +1130,14 @@ rops_perform_user_POLLOUT_h2(struct lws *wsi)
 				  w->h2.send_END_STREAM);
 			lws_close_free_wsi(w, LWS_CLOSE_STATUS_NOSTATUS,
 					   "h2 pollout handle");
-			wa = &wsi->mux.child_list;
 		} else
 			 if (w->h2.send_END_STREAM)
 				lws_h2_state(w, LWS_H2_STATE_HALF_CLOSED_LOCAL);
 
 next_child:
-		wsi2 = wa;
-	} while (wsi2 && *wsi2 && !lws_send_pipe_choked(wsi));
+		;
+	} while (--budget && !lws_send_pipe_choked(wsi) &&
+		 h2n->sched_tx - tx0 < h2n->sched_quantum);
 
 	// lws_wsi_mux_dump_waiting_children(wsi);
 
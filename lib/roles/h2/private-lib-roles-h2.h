@@ -31,6 +31,7 @@ struct http2_settings {
 
 struct lws_vhost_role_h2 {
 	struct http2_settings set;
+	uint32_t rx_window_max;
 };
 
 enum lws_h2_wellknown_frame_types {
@@ -141,6 +142,10 @@ void
 lws_h2_state(struct lws *wsi, enum lws_h2_states s);
 
 #define LWS_H2_STREAM_ID_MASTER 0
+#define LWS_H2_SCHED_QUANTUM 16384
+#define LWS_H2_SCHED_DEFAULT_WEIGHT 16
+#define LWS_H2_RX_WINDOW_INITIAL (4 * 65536)
+#define LWS_H2_RX_WINDOW_MAX (16 * 1024 * 1024)
 #define LWS_H2_SETTINGS_LEN 6
 #define LWS_H2_FLAG_SETTINGS_ACK 1
 
@@ -194,6 +199,28 @@ struct hpack_dynamic_table {
 	uint16_t num_entries;
 };
 
+/*
+ * Our HPACK encoder's view of the peer decoder's dynamic table.  We never ask
+ * for more than the 4096 default, so at 32 bytes' overhead per entry it can
+ * never hold more than LWS_H2_HPACK_ENC_ENTRIES.
+ */
+
+#define LWS_H2_HPACK_ENC_TABLE_SIZE	4096
+#define LWS_H2_HPACK_ENC_ENTRIES	(LWS_H2_HPACK_ENC_TABLE_SIZE / 32)
+
+struct hpack_enc_entry {
+	char *nv; /* malloc'd: lowercased name then value, no NULs */
+	uint16_t name_len;
+	uint16_t value_len;
+};
+
+struct hpack_enc_table {
+	struct hpack_enc_entry *entries; /* malloc'd on first use */
+	uint32_t virtual_payload_usage;
+	uint16_t pos; /* next slot to fill, newest is at pos - 1 */
+	uint16_t used_entries;
+};
+
 enum lws_h2_protocol_send_type {
 	LWS_PPS_NONE,
 	LWS_H2_PPS_MY_SETTINGS,
@@ -252,11 +279,13 @@ struct lws_h2_netconn {
 	struct http2_settings our_set;
 	struct http2_settings peer_set;
 	struct hpack_dynamic_table hpack_dyn_table;
+	struct hpack_enc_table hpack_enc_table;
 	uint8_t	ping_payload[8];
 	uint8_t one_setting[LWS_H2_SETTINGS_LEN];
 	char goaway_str[32]; /* for rx */
 	struct lws *swsi;
 	struct lws_h2_protocol_send *pps; /* linked list */
+	struct lws *hpack_enc_wsi; /* stream whose open tx block owns the table */
 
 	enum http2_hpack_state hpack;
 	enum http2_hpack_type hpack_type;
@@ -272,6 +301,9 @@ struct lws_h2_netconn {
 	unsigned int is_first_header_char:1;
 	unsigned int zero_huff_padding:1;
 	unsigned int last_action_dyntable_resize:1;
+	unsigned int hpack_enc_resize:1; /* peer shrank its table: tell it */
+	unsigned int hpack_enc_off:1; /* stop indexing our tx headers */
+	unsigned int hpack_enc_pending:1; /* open block indexed something */
 
 	uint32_t hdr_idx;
 	uint32_t hpack_len;
@@ -288,6 +320,15 @@ struct lws_h2_netconn {
 	uint32_t goaway_last_sid;
 	uint32_t goaway_err;
 	uint32_t hpack_hdr_len;
+	uint32_t sched_quantum; /* stream bytes per POLLOUT before yielding */
+
+	uint64_t sched_vt; /* virtual time of the last stream picked */
+	uint64_t sched_tx; /* stream frame bytes written, for the quantum */
+	uint64_t bdp_ping_us; /* payload of our BDP PING in flight, or 0 */
+
+	uint32_t bdp_bytes; /* DATA received since the BDP PING went out */
+	uint32_t rx_window; /* auto-tuned window we top streams back up to */
+	uint32_t srtt_us; /* smoothed RTT from BDP PINGs */
 
 	uint16_t hpack_pos;
 
@@ -308,6 +349,10 @@ struct _lws_h2_related {
 
 	char			*pending_status_body;
 
+	uint64_t		sched_pass; /* virtual time of our next turn */
+	uint32_t		sched_dep; /* sid we depend on, 0 = root */
+	uint16_t		sched_weight; /* 1 .. 256, 0 = default */
+
 	uint8_t			h2_state; /* RFC7540 state of the connection */
 
 	uint8_t			END_STREAM:1;
@@ -356,12 +401,31 @@ LWS_EXTERN void
 lws_hpack_destroy_dynamic_header(struct lws *wsi);
 LWS_EXTERN int
 lws_hpack_dynamic_size(struct lws *wsi, int size);
+LWS_EXTERN void
+lws_hpack_enc_destroy(struct lws_h2_netconn *h2n);
+LWS_EXTERN void
+lws_hpack_enc_block_sent(struct lws *wsi);
 LWS_EXTERN int
 lws_h2_goaway(struct lws *wsi, uint32_t err, const char *reason);
 LWS_EXTERN int
 lws_h2_tx_cr_get(struct lws *wsi);
 LWS_EXTERN void
 lws_h2_tx_cr_consume(struct lws *wsi, int consumed);
+LWS_EXTERN void
+lws_h2_rx_window_sample(struct lws *nwsi, struct lws *swsi, int len);
+LWS_EXTERN void
+lws_h2_rx_window_ping_ack(struct lws *nwsi);
+LWS_EXTERN int
+lws_h2_rx_window_top_up(struct lws *swsi, int sid);
+LWS_EXTERN void
+lws_h2_sched_set_priority(struct lws *nwsi, struct lws *wsi, uint32_t dep,
+			  uint8_t weight);
+LWS_EXTERN void
+lws_h2_sched_charge(struct lws *wsi, unsigned int len);
+LWS_EXTERN struct lws **
+lws_h2_sched_pick(struct lws *nwsi);
+LWS_EXTERN void
+lws_h2_sched_remove(struct lws *wsi);
 LWS_EXTERN int
 lws_hdr_extant(struct lws *wsi, enum lws_token_indexes h);
 LWS_EXTERN void
@@ -334,6 +334,158 @@ failed:
 	return NULL;
 }
 
+/*
+ * Pick the next dns result to try, preferring one of a different address
+ * family to the last attempt so a broken ipv6 or ipv4 path costs us at most
+ * one stagger interval
+ */
+
+static const struct addrinfo *
+lws_client_he_next(struct lws *wsi)
+{
+	const struct addrinfo *ai = wsi->dns_results, *pick = NULL;
+	int n = 0, pn = 0;
+
+	while (ai && n < 32) {
+		if (!(wsi->he_tried & (1u << n))) {
+			if (!pick) {
+				pick = ai;
+				pn = n;
+			}
+			if (ai->ai_family != wsi->he_family) {
+				pick = ai;
+				pn = n;
+				break;
+			}
+		}
+		ai = ai->ai_next;
+		n++;
+	}
+
+	if (pick) {
+		wsi->he_tried |= 1u << pn;
+		wsi->he_family = (uint8_t)pick->ai_family;
+	}
+
+	return pick;
+}
+
+static int
+lws_client_he_untried(struct lws *wsi)
+{
+	const struct addrinfo *ai = wsi->dns_results;
+	int n = 0;
+
+	while (ai && n < 32) {
+		if (!(wsi->he_tried & (1u << n)))
+			return 1;
+		ai = ai->ai_next;
+		n++;
+	}
+
+	return 0;
+}
+
+/* take a parked attempt off the list, which is kept oldest first */
+
+static lws_sockfd_type
+lws_client_he_unpark(struct lws *wsi, int idx)
+{
+	lws_sockfd_type fd = wsi->he_fds[idx];
+
+	wsi->he_parked--;
+	memmove(&wsi->he_fds[idx], &wsi->he_fds[idx + 1],
+		(unsigned int)(wsi->he_parked - idx) * sizeof(fd));
+
+	return fd;
+}
+
+/*
+ * Make a parked connect attempt the one we poll on, closing the current one
+ * if any.  Returns nonzero if the wsi needs closing.
+ */
+
+static int
+lws_client_he_promote(struct lws *wsi, int idx)
+{
+	lws_sockfd_type fd = lws_client_he_unpark(wsi, idx);
+
+	if (lws_socket_is_valid(wsi->desc.sockfd)) {
+		__remove_wsi_socket_from_fds(wsi);
+		compatible_close(wsi->desc.sockfd);
+	}
+
+	wsi->desc.sockfd = fd;
+	if (__insert_wsi_socket_into_fds(wsi->context, wsi))
+		return 1;
+
+	/* if it already connected, POLLOUT completes it as usual */
+
+	return lws_change_pollfd(wsi, 0, LWS_POLLIN | LWS_POLLOUT);
+}
+
+static void
+lws_client_he_stagger_cb(lws_sorted_usec_list_t *sul)
+{
+	struct lws *wsi = lws_container_of(sul, struct lws,
+					   sul_connect_stagger);
+	struct sockaddr_storage ss;
+	socklen_t sl;
+	int n = 0, e;
+
+	if (lwsi_state(wsi) != LRS_WAITING_CONNECT)
+		return;
+
+	/* did any of the parked attempts finish meanwhile? */
+
+	while (n < wsi->he_parked) {
+		sl = sizeof(e);
+		e = 0;
+		if (getsockopt(wsi->he_fds[n], SOL_SOCKET, SO_ERROR,
+#if defined(WIN32)
+			       (char *)
+#endif
+			       &e, &sl) || e) {
+			/* that one failed */
+			compatible_close(lws_client_he_unpark(wsi, n));
+			continue;
+		}
+
+		sl = sizeof(ss);
+		if (!getpeername(wsi->he_fds[n], (struct sockaddr *)&ss, &sl)) {
+			lwsl_info("%s: %p: parked attempt %d won\n", __func__,
+				  wsi, n);
+			if (lws_client_he_promote(wsi, n))
+				lws_close_free_wsi(wsi, LWS_CLOSE_STATUS_NOSTATUS,
+						   "he promote");
+			return;
+		}
+		n++;
+	}
+
+	if (lws_client_he_untried(wsi)) {
+		if (wsi->he_parked == LWS_CLIENT_HE_PARKED)
+			/* no room to park another, give up on the oldest */
+			compatible_close(lws_client_he_unpark(wsi, 0));
+
+		/* park the current attempt and start the next alongside it */
+		wsi->client_he_stagger = 1;
+		lws_client_connect_3_connect(wsi,
+				lws_wsi_client_stash_item(wsi, CIS_ADDRESS,
+					_WSI_TOKEN_CLIENT_PEER_ADDRESS),
+				NULL, 0, NULL);
+
+		return;
+	}
+
+	if (wsi->he_parked)
+		/* nothing more to start, keep checking the parked ones */
+		lws_sul_schedule(wsi->context, wsi->tsi,
+				 &wsi->sul_connect_stagger,
+				 lws_client_he_stagger_cb,
+				 LWS_CLIENT_HE_STAGGER_US);
+}
+
 struct lws *
 lws_client_connect_3_connect(struct lws *wsi, const char *ads,
 			     const struct addrinfo *result, int n, void *opaque)
@@ -366,6 +518,20 @@ lws_client_connect_3_connect(struct lws *wsi, const char *ads,
 
 	if (!lws_dll2_is_detached(&wsi->dll2_cli_txn_queue))
 		return wsi;
+
+	if (wsi->client_he_stagger) {
+		/*
+		 * The stagger interval passed without the current attempt
+		 * completing... leave it connecting in the background and
+		 * start on the next result
+		 */
+		wsi->client_he_stagger = 0;
+		__remove_wsi_socket_from_fds(wsi);
+		wsi->he_fds[wsi->he_parked++] = wsi->desc.sockfd;
+		wsi->desc.sockfd = LWS_SOCK_INVALID;
+
+		goto try_next_result;
+	}
 #if 0
 	if (!ads && !result) {
 		cce = "dns resolution failed";
@@ -441,7 +607,11 @@ lws_client_connect_3_connect(struct lws *wsi, const char *ads,
 #endif
 
 	if (!wsi->dns_results) {
-		wsi->dns_results_next = wsi->dns_results = result;
+		wsi->dns_results = result;
+		wsi->he_tried = 0;
+		/* so the first pick prefers ipv6 if we can use it */
+		wsi->he_family = wsi->ipv6 ? AF_INET : 0;
+		wsi->dns_results_next = lws_client_he_next(wsi);
 		if (result)
 			lwsl_debug("%s: result %p result->ai_next %p\n",
 					__func__, result, result->ai_next);
@@ -698,6 +868,21 @@ ads_known:
 		if (lws_change_pollfd(wsi, 0, LWS_POLLOUT))
 			goto try_next_result_fds;
 
+		/*
+		 * With the default event loop, if there are more results to
+		 * try, don't wait for this attempt to fail before starting
+		 * the next one
+		 */
+		if (!wsi->context->event_loop_ops->sock_accept &&
+#if defined(LWS_WITH_UNIX_SOCK)
+		    !wsi->unix_skt &&
+#endif
+		    (wsi->he_parked || lws_client_he_untried(wsi)))
+			lws_sul_schedule(wsi->context, wsi->tsi,
+					 &wsi->sul_connect_stagger,
+					 lws_client_he_stagger_cb,
+					 LWS_CLIENT_HE_STAGGER_US);
+
 		return wsi;
 	}
 
@@ -765,10 +950,23 @@ try_next_result_closesock:
 
 try_next_result:
 	if (wsi->dns_results_next) {
-		wsi->dns_results_next = wsi->dns_results_next->ai_next;
+		wsi->dns_results_next = lws_client_he_next(wsi);
 		if (wsi->dns_results_next)
 			goto next_result;
 	}
+
+	if (wsi->he_parked) {
+		/* nothing left to start, but earlier attempts are ongoing */
+		if (lws_client_he_promote(wsi, wsi->he_parked - 1))
+			goto failed1;
+		lws_sul_schedule(wsi->context, wsi->tsi,
+				 &wsi->sul_connect_stagger,
+				 lws_client_he_stagger_cb,
+				 LWS_CLIENT_HE_STAGGER_US);
+
+		return wsi;
+	}
+
 	lws_addrinfo_clean(wsi);
 	cce = "Unable to connect";
 
@@ -0,0 +1,452 @@
+/* generated by minihash.c, do not edit */
+
+#define LWS_LEXHASH_BUCKETS 64
+#define LWS_LEXHASH_SLOTS 128
+#define lws_lexhash(h, c) (((h) ^ (uint8_t)(c)) * 16777619u)
+
+#if LWS_LEXHASH_MAX_KEY != 32
+#error LWS_LEXHASH_MAX_KEY must match minihash.c
+#endif
+
+#if !defined(LWS_WITH_HTTP_UNCOMMON_HEADERS) && !defined(LWS_ROLE_WS) && !defined(LWS_ROLE_H2)
+/* 49 names */
+#define LWS_LEXHASH_SEED 0x811c9dc5u
+static const uint8_t lexhash_disp[] = {
+	0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x02, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x01, 0x00, 0x00, 0x00,
+	0x00, 0x01, 0x00, 0x00,
+};
+static const uint8_t lexhash_tok[] = {
+	0x23, 0x20, 0xff, 0x24, 0xff, 0x15, 0xff, 0xff, 0xff, 0xff, 0xff, 0x0f,
+	0x21, 0xff, 0x1c, 0xff, 0xff, 0xff, 0xff, 0x2b, 0xff, 0xff, 0x27, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0x2a, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0x29, 0xff, 0xff, 0xff, 0xff, 0x17, 0xff, 0xff, 0xff, 0x07,
+	0x01, 0xff, 0x2d, 0xff, 0xff, 0x03, 0xff, 0x31, 0xff, 0xff, 0x26, 0xff,
+	0x19, 0xff, 0xff, 0x2e, 0xff, 0xff, 0x30, 0xff, 0x1f, 0xff, 0x16, 0xff,
+	0xff, 0xff, 0x25, 0x10, 0x0a, 0x28, 0xff, 0xff, 0x13, 0xff, 0x18, 0xff,
+	0xff, 0xff, 0xff, 0x1e, 0x1b, 0xff, 0xff, 0x0e, 0xff, 0xff, 0x22, 0x02,
+	0x05, 0xff, 0x1a, 0x2f, 0x1d, 0x12, 0xff, 0xff, 0x11, 0x14, 0xff, 0x00,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0x0b, 0x08, 0xff, 0xff, 0xff, 0xff, 0x09,
+	0x04, 0xff, 0xff, 0xff, 0x0d, 0x06, 0x0c, 0xff,
+};
+static const uint8_t lexhash_klen[] = {
+	0x14, 0x05, 0x00, 0x0e, 0x00, 0x0e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0e,
+	0x09, 0x00, 0x0e, 0x00, 0x00, 0x00, 0x00, 0x12, 0x00, 0x00, 0x08, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x0b, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x09,
+	0x05, 0x00, 0x09, 0x00, 0x00, 0x0b, 0x00, 0x0d, 0x00, 0x00, 0x09, 0x00,
+	0x11, 0x00, 0x00, 0x10, 0x00, 0x00, 0x05, 0x00, 0x08, 0x00, 0x04, 0x00,
+	0x00, 0x00, 0x05, 0x07, 0x0e, 0x0c, 0x00, 0x00, 0x05, 0x00, 0x14, 0x00,
+	0x00, 0x00, 0x00, 0x07, 0x11, 0x00, 0x00, 0x0e, 0x00, 0x00, 0x09, 0x05,
+	0x07, 0x00, 0x11, 0x08, 0x05, 0x0d, 0x00, 0x00, 0x0f, 0x06, 0x00, 0x04,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x07, 0x00, 0x00, 0x00, 0x00, 0x12,
+	0x08, 0x00, 0x00, 0x00, 0x07, 0x02, 0x10, 0x00,
+};
+#endif
+
+#if  defined(LWS_WITH_HTTP_UNCOMMON_HEADERS) && !defined(LWS_ROLE_WS) && !defined(LWS_ROLE_H2)
+/* 69 names */
+#define LWS_LEXHASH_SEED 0x811c9dc6u
+static const uint8_t lexhash_disp[] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x00, 0x00, 0x01, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x03, 0x00, 0x01, 0x03, 0x00, 0x00,
+	0x02, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x01, 0x01, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04,
+	0x00, 0x01, 0x00, 0x00,
+};
+static const uint8_t lexhash_tok[] = {
+	0xff, 0x17, 0x1c, 0xff, 0xff, 0x07, 0x2b, 0xff, 0x2a, 0x18, 0x25, 0xff,
+	0xff, 0xff, 0x00, 0xff, 0x10, 0x04, 0x15, 0x0a, 0xff, 0x0e, 0xff, 0xff,
+	0xff, 0x23, 0x3b, 0x26, 0x19, 0x40, 0xff, 0xff, 0x13, 0x14, 0xff, 0x37,
+	0x36, 0xff, 0xff, 0xff, 0x09, 0x16, 0xff, 0x2c, 0x3d, 0x32, 0x0b, 0x30,
+	0x3e, 0x42, 0x22, 0x45, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0x35, 0xff, 0xff, 0x02, 0x20, 0xff, 0xff, 0xff, 0xff, 0xff, 0x24, 0x05,
+	0x33, 0x39, 0xff, 0x44, 0xff, 0x2e, 0xff, 0xff, 0x1a, 0xff, 0x3f, 0x0c,
+	0x08, 0x01, 0xff, 0x06, 0xff, 0x43, 0xff, 0x28, 0x38, 0x27, 0xff, 0xff,
+	0xff, 0xff, 0x1f, 0x1e, 0xff, 0x2d, 0xff, 0xff, 0x12, 0xff, 0x2f, 0xff,
+	0x31, 0x3a, 0x41, 0x29, 0x03, 0xff, 0xff, 0x0f, 0xff, 0xff, 0x1b, 0xff,
+	0xff, 0x1d, 0x21, 0x0d, 0xff, 0xff, 0x11, 0x34,
+};
+static const uint8_t lexhash_klen[] = {
+	0x00, 0x08, 0x06, 0x00, 0x00, 0x02, 0x09, 0x00, 0x05, 0x0f, 0x05, 0x00,
+	0x00, 0x00, 0x04, 0x00, 0x0e, 0x0b, 0x05, 0x1f, 0x00, 0x10, 0x00, 0x00,
+	0x00, 0x07, 0x87, 0x09, 0x0e, 0x10, 0x00, 0x00, 0x0f, 0x0d, 0x00, 0x04,
+	0x05, 0x00, 0x00, 0x00, 0x07, 0x06, 0x00, 0x0d, 0x06, 0x0b, 0x12, 0x0c,
+	0x0a, 0x05, 0x05, 0x0d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x0b, 0x00, 0x00, 0x08, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x08,
+	0x1a, 0x86, 0x00, 0x0d, 0x00, 0x14, 0x00, 0x00, 0x1c, 0x00, 0x09, 0x0e,
+	0x09, 0x05, 0x00, 0x07, 0x00, 0x03, 0x00, 0x14, 0x11, 0x09, 0x00, 0x00,
+	0x00, 0x00, 0x11, 0x11, 0x00, 0x13, 0x00, 0x00, 0x07, 0x00, 0x08, 0x00,
+	0x07, 0x84, 0x08, 0x0e, 0x05, 0x00, 0x00, 0x07, 0x00, 0x00, 0x04, 0x00,
+	0x00, 0x14, 0x0e, 0x10, 0x00, 0x00, 0x0e, 0x12,
+};
+#endif
+
+#if !defined(LWS_WITH_HTTP_UNCOMMON_HEADERS) &&  defined(LWS_ROLE_WS) && !defined(LWS_ROLE_H2)
+/* 59 names */
+#define LWS_LEXHASH_SEED 0x811c9dc5u
+static const uint8_t lexhash_disp[] = {
+	0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+	0x00, 0x00, 0x02, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x03, 0x01, 0x00, 0x00, 0x01,
+	0x00, 0x02, 0x00, 0x00,
+};
+static const uint8_t lexhash_tok[] = {
+	0x2d, 0x2a, 0xff, 0x2e, 0xff, 0x1f, 0xff, 0xff, 0xff, 0xff, 0xff, 0x16,
+	0xff, 0x2b, 0x26, 0xff, 0xff, 0xff, 0x1d, 0x35, 0xff, 0xff, 0x31, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0x34, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0x33, 0xff, 0xff, 0xff, 0x08, 0x21, 0xff, 0xff, 0x1e, 0x0e,
+	0x01, 0xff, 0x37, 0xff, 0xff, 0x03, 0xff, 0x3b, 0xff, 0xff, 0x30, 0xff,
+	0xff, 0x23, 0x0c, 0x0d, 0x38, 0xff, 0x3a, 0xff, 0xff, 0x29, 0x20, 0x0a,
+	0xff, 0xff, 0x2f, 0x17, 0x32, 0x11, 0xff, 0x09, 0x1a, 0xff, 0x22, 0xff,
+	0xff, 0xff, 0xff, 0x28, 0x25, 0xff, 0xff, 0x15, 0xff, 0xff, 0x2c, 0x02,
+	0x05, 0xff, 0x1c, 0x39, 0x27, 0x24, 0x19, 0xff, 0x18, 0x1b, 0xff, 0x00,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0x12, 0x0f, 0xff, 0xff, 0xff, 0xff, 0x10,
+	0x06, 0x04, 0x0b, 0xff, 0x14, 0x07, 0x13, 0xff,
+};
+static const uint8_t lexhash_klen[] = {
+	0x14, 0x05, 0x00, 0x0e, 0x00, 0x0e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0e,
+	0x00, 0x09, 0x0e, 0x00, 0x00, 0x00, 0x16, 0x12, 0x00, 0x00, 0x08, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x0b, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x19, 0x06, 0x00, 0x00, 0x15, 0x09,
+	0x05, 0x00, 0x09, 0x00, 0x00, 0x0b, 0x00, 0x0d, 0x00, 0x00, 0x09, 0x00,
+	0x00, 0x11, 0x15, 0x14, 0x10, 0x00, 0x05, 0x00, 0x00, 0x08, 0x04, 0x13,
+	0x00, 0x00, 0x05, 0x07, 0x0c, 0x0e, 0x00, 0x13, 0x05, 0x00, 0x14, 0x00,
+	0x00, 0x00, 0x00, 0x07, 0x11, 0x00, 0x00, 0x0e, 0x00, 0x00, 0x09, 0x05,
+	0x07, 0x00, 0x12, 0x08, 0x05, 0x11, 0x0d, 0x00, 0x0f, 0x06, 0x00, 0x04,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x07, 0x00, 0x00, 0x00, 0x00, 0x12,
+	0x14, 0x08, 0x17, 0x00, 0x07, 0x02, 0x10, 0x00,
+};
+#endif
+
+#if  defined(LWS_WITH_HTTP_UNCOMMON_HEADERS) &&  defined(LWS_ROLE_WS) && !defined(LWS_ROLE_H2)
+/* 79 names */
+#define LWS_LEXHASH_SEED 0x811c9dc6u
+static const uint8_t lexhash_disp[] = {
+	0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x03, 0x04, 0x00, 0x0a, 0x00, 0x03,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+	0x03, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+	0x00, 0x01, 0x01, 0x00,
+};
+static const uint8_t lexhash_tok[] = {
+	0xff, 0xff, 0xff, 0x0d, 0x1e, 0x26, 0x35, 0x08, 0x34, 0x2f, 0x22, 0xff,
+	0xff, 0xff, 0x00, 0x17, 0x04, 0x11, 0x1c, 0xff, 0xff, 0x15, 0xff, 0xff,
+	0xff, 0x2d, 0x45, 0x30, 0x23, 0x4a, 0xff, 0x1a, 0x40, 0x1b, 0xff, 0x41,
+	0x09, 0xff, 0x10, 0xff, 0xff, 0x1d, 0xff, 0x36, 0x47, 0x3c, 0x12, 0x3a,
+	0x0a, 0x1f, 0x4f, 0x4c, 0x0b, 0x21, 0x2c, 0x48, 0xff, 0xff, 0xff, 0xff,
+	0x3f, 0xff, 0xff, 0x02, 0x2a, 0xff, 0xff, 0xff, 0xff, 0x05, 0x2e, 0x43,
+	0x3d, 0x0e, 0x20, 0x38, 0xff, 0xff, 0x4e, 0x24, 0xff, 0x49, 0x13, 0x0f,
+	0xff, 0x01, 0xff, 0x07, 0x06, 0x4d, 0xff, 0x32, 0x42, 0x31, 0xff, 0xff,
+	0xff, 0x29, 0xff, 0x28, 0xff, 0x37, 0xff, 0xff, 0x19, 0xff, 0x4b, 0x39,
+	0xff, 0x44, 0x3b, 0x33, 0x03, 0xff, 0xff, 0x16, 0xff, 0xff, 0x25, 0xff,
+	0x0c, 0x27, 0x14, 0xff, 0xff, 0x2b, 0x18, 0x3e,
+};
+static const uint8_t lexhash_klen[] = {
+	0x00, 0x00, 0x00, 0x15, 0x08, 0x06, 0x09, 0x02, 0x05, 0x05, 0x0f, 0x00,
+	0x00, 0x00, 0x04, 0x0e, 0x0b, 0x1f, 0x05, 0x00, 0x00, 0x10, 0x00, 0x00,
+	0x00, 0x07, 0x87, 0x09, 0x0e, 0x10, 0x00, 0x0f, 0x05, 0x0d, 0x00, 0x04,
+	0x19, 0x00, 0x07, 0x00, 0x00, 0x06, 0x00, 0x0d, 0x06, 0x0b, 0x12, 0x0c,
+	0x13, 0x12, 0x0d, 0x05, 0x13, 0x15, 0x05, 0x0a, 0x00, 0x00, 0x00, 0x00,
+	0x0b, 0x00, 0x00, 0x08, 0x11, 0x00, 0x00, 0x00, 0x00, 0x08, 0x08, 0x86,
+	0x1a, 0x14, 0x16, 0x14, 0x00, 0x00, 0x0d, 0x1c, 0x00, 0x09, 0x0e, 0x09,
+	0x00, 0x05, 0x00, 0x14, 0x07, 0x03, 0x00, 0x14, 0x11, 0x09, 0x00, 0x00,
+	0x00, 0x11, 0x00, 0x11, 0x00, 0x13, 0x00, 0x00, 0x07, 0x00, 0x08, 0x08,
+	0x00, 0x84, 0x07, 0x0e, 0x05, 0x00, 0x00, 0x07, 0x00, 0x00, 0x04, 0x00,
+	0x17, 0x14, 0x10, 0x00, 0x00, 0x0e, 0x0e, 0x12,
+};
+#endif
+
+#if !defined(LWS_WITH_HTTP_UNCOMMON_HEADERS) && !defined(LWS_ROLE_WS) &&  defined(LWS_ROLE_H2)
+/* 69 names */
+#define LWS_LEXHASH_SEED 0x811c9dc6u
+static const uint8_t lexhash_disp[] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x00, 0x00, 0x01, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x02,
+	0x00, 0x00, 0x00, 0x00,
+};
+static const uint8_t lexhash_tok[] = {
+	0xff, 0x16, 0x20, 0xff, 0xff, 0x06, 0x2f, 0xff, 0x2e, 0x1c, 0x29, 0xff,
+	0xff, 0xff, 0x00, 0xff, 0x0f, 0x03, 0xff, 0x14, 0xff, 0x0d, 0xff, 0xff,
+	0xff, 0x27, 0xff, 0x2a, 0x1d, 0x3f, 0xff, 0xff, 0x3a, 0x13, 0x12, 0x3b,
+	0xff, 0xff, 0xff, 0xff, 0x09, 0x15, 0x44, 0x30, 0xff, 0x36, 0x0a, 0x34,
+	0x41, 0x45, 0x26, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x39,
+	0xff, 0xff, 0x17, 0x24, 0xff, 0xff, 0x19, 0xff, 0xff, 0xff, 0x28, 0x04,
+	0x37, 0xff, 0xff, 0x43, 0xff, 0x32, 0x18, 0x1e, 0xff, 0xff, 0x3e, 0x07,
+	0x08, 0x0b, 0x01, 0x05, 0xff, 0x42, 0xff, 0x2c, 0x3c, 0x2b, 0xff, 0xff,
+	0xff, 0xff, 0x23, 0x22, 0xff, 0x31, 0xff, 0x1a, 0x11, 0xff, 0x40, 0x33,
+	0x35, 0x02, 0xff, 0x2d, 0xff, 0xff, 0xff, 0x0e, 0xff, 0xff, 0x1f, 0xff,
+	0xff, 0x21, 0x25, 0x0c, 0x1b, 0xff, 0x10, 0x38,
+};
+static const uint8_t lexhash_klen[] = {
+	0x00, 0x08, 0x06, 0x00, 0x00, 0x02, 0x09, 0x00, 0x05, 0x0f, 0x05, 0x00,
+	0x00, 0x00, 0x04, 0x00, 0x0e, 0x0b, 0x00, 0x05, 0x00, 0x10, 0x00, 0x00,
+	0x00, 0x07, 0x00, 0x09, 0x0e, 0x10, 0x00, 0x00, 0x05, 0x0d, 0x0f, 0x04,
+	0x00, 0x00, 0x00, 0x00, 0x07, 0x06, 0x8a, 0x0d, 0x00, 0x0b, 0x12, 0x0c,
+	0x05, 0x0d, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0b,
+	0x00, 0x00, 0x8b, 0x11, 0x00, 0x00, 0x86, 0x00, 0x00, 0x00, 0x08, 0x08,
+	0x1a, 0x00, 0x00, 0x0d, 0x00, 0x14, 0x88, 0x1c, 0x00, 0x00, 0x09, 0x09,
+	0x0f, 0x0e, 0x05, 0x07, 0x00, 0x03, 0x00, 0x14, 0x11, 0x09, 0x00, 0x00,
+	0x00, 0x00, 0x11, 0x11, 0x00, 0x13, 0x00, 0x88, 0x07, 0x00, 0x08, 0x08,
+	0x07, 0x05, 0x00, 0x0e, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x04, 0x00,
+	0x00, 0x14, 0x0e, 0x10, 0x88, 0x00, 0x0e, 0x12,
+};
+#endif
+
+#if  defined(LWS_WITH_HTTP_UNCOMMON_HEADERS) && !defined(LWS_ROLE_WS) &&  defined(LWS_ROLE_H2)
+/* 76 names */
+#define LWS_LEXHASH_SEED 0x811c9dc6u
+static const uint8_t lexhash_disp[] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x00, 0x00, 0x01, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x03, 0x03, 0x00, 0x00,
+	0x02, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00,
+	0x01, 0x00, 0x00, 0x00, 0x02, 0x01, 0x00, 0x00, 0x02, 0x00, 0x00, 0x04,
+	0x00, 0x01, 0x01, 0x00,
+};
+static const uint8_t lexhash_tok[] = {
+	0xff, 0x18, 0x22, 0xff, 0xff, 0x07, 0x31, 0xff, 0x30, 0x1e, 0x2b, 0xff,
+	0xff, 0xff, 0x00, 0xff, 0x11, 0x04, 0x0b, 0xff, 0x16, 0x0f, 0xff, 0xff,
+	0xff, 0x29, 0x41, 0x2c, 0x1f, 0x46, 0xff, 0xff, 0x3c, 0x15, 0x14, 0x3d,
+	0xff, 0xff, 0xff, 0xff, 0x0a, 0x17, 0x4b, 0x32, 0x43, 0x38, 0x0c, 0x36,
+	0x44, 0x48, 0x28, 0x4c, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0x3b, 0xff, 0x19, 0x02, 0x26, 0xff, 0x1b, 0xff, 0xff, 0xff, 0x2a, 0x05,
+	0x39, 0x3f, 0xff, 0x4a, 0xff, 0x34, 0x1a, 0x20, 0xff, 0xff, 0x45, 0x08,
+	0xff, 0x0d, 0x09, 0x01, 0x06, 0x49, 0xff, 0x2e, 0x3e, 0x2d, 0xff, 0xff,
+	0xff, 0xff, 0x25, 0x24, 0xff, 0x33, 0xff, 0x1c, 0x13, 0xff, 0x47, 0x35,
+	0x37, 0x40, 0x03, 0x2f, 0xff, 0xff, 0xff, 0x10, 0xff, 0xff, 0x21, 0xff,
+	0xff, 0x23, 0x27, 0x0e, 0x1d, 0xff, 0x12, 0x3a,
+};
+static const uint8_t lexhash_klen[] = {
+	0x00, 0x08, 0x06, 0x00, 0x00, 0x02, 0x09, 0x00, 0x05, 0x0f, 0x05, 0x00,
+	0x00, 0x00, 0x04, 0x00, 0x0e, 0x0b, 0x1f, 0x00, 0x05, 0x10, 0x00, 0x00,
+	0x00, 0x07, 0x87, 0x09, 0x0e, 0x10, 0x00, 0x00, 0x05, 0x0d, 0x0f, 0x04,
+	0x00, 0x00, 0x00, 0x00, 0x07, 0x06, 0x8a, 0x0d, 0x06, 0x0b, 0x12, 0x0c,
+	0x0a, 0x05, 0x05, 0x0d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x0b, 0x00, 0x8b, 0x08, 0x11, 0x00, 0x86, 0x00, 0x00, 0x00, 0x08, 0x08,
+	0x1a, 0x86, 0x00, 0x0d, 0x00, 0x14, 0x88, 0x1c, 0x00, 0x00, 0x09, 0x09,
+	0x00, 0x0e, 0x0f, 0x05, 0x07, 0x03, 0x00, 0x14, 0x11, 0x09, 0x00, 0x00,
+	0x00, 0x00, 0x11, 0x11, 0x00, 0x13, 0x00, 0x88, 0x07, 0x00, 0x08, 0x08,
+	0x07, 0x84, 0x05, 0x0e, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x04, 0x00,
+	0x00, 0x14, 0x0e, 0x10, 0x88, 0x00, 0x0e, 0x12,
+};
+#endif
+
+#if !defined(LWS_WITH_HTTP_UNCOMMON_HEADERS) &&  defined(LWS_ROLE_WS) &&  defined(LWS_ROLE_H2)
+/* 79 names */
+#define LWS_LEXHASH_SEED 0x811c9dc6u
+static const uint8_t lexhash_disp[] = {
+	0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x01, 0x02, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x01, 0x01, 0x00, 0x02, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x00, 0x00, 0x01, 0x03,
+	0x00, 0x02, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+	0x02, 0x00, 0x00, 0x04, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08,
+	0x00, 0x00, 0x00, 0x00,
+};
+static const uint8_t lexhash_tok[] = {
+	0xff, 0xff, 0xff, 0x0c, 0x1d, 0x2a, 0x07, 0x39, 0x38, 0x33, 0x26, 0xff,
+	0xff, 0xff, 0x00, 0x16, 0x03, 0xff, 0x1b, 0xff, 0xff, 0x14, 0xff, 0xff,
+	0xff, 0x31, 0xff, 0x34, 0x27, 0x49, 0xff, 0x19, 0x44, 0x1a, 0xff, 0x45,
+	0x08, 0xff, 0x10, 0xff, 0x4e, 0x1c, 0xff, 0x3a, 0xff, 0xff, 0x0a, 0x11,
+	0x09, 0x40, 0x4b, 0x3e, 0x30, 0x20, 0x1e, 0x4f, 0xff, 0xff, 0xff, 0x43,
+	0xff, 0xff, 0x21, 0x2e, 0xff, 0xff, 0x23, 0xff, 0xff, 0x04, 0x32, 0xff,
+	0xff, 0x41, 0x0d, 0x3c, 0x1f, 0xff, 0x4d, 0x28, 0x22, 0x48, 0x12, 0x0e,
+	0x0f, 0x01, 0xff, 0x05, 0x06, 0x4c, 0xff, 0xff, 0x36, 0x35, 0x46, 0xff,
+	0xff, 0x2d, 0xff, 0x2c, 0xff, 0x3b, 0xff, 0x24, 0x18, 0xff, 0x4a, 0x3d,
+	0xff, 0x3f, 0x02, 0x37, 0xff, 0xff, 0xff, 0x15, 0xff, 0xff, 0x29, 0x0b,
+	0xff, 0x2b, 0x13, 0x25, 0xff, 0x2f, 0x17, 0x42,
+};
+static const uint8_t lexhash_klen[] = {
+	0x00, 0x00, 0x00, 0x15, 0x08, 0x06, 0x02, 0x09, 0x05, 0x05, 0x0f, 0x00,
+	0x00, 0x00, 0x04, 0x0e, 0x0b, 0x00, 0x05, 0x00, 0x00, 0x10, 0x00, 0x00,
+	0x00, 0x07, 0x00, 0x09, 0x0e, 0x10, 0x00, 0x0f, 0x05, 0x0d, 0x00, 0x04,
+	0x19, 0x00, 0x07, 0x00, 0x8a, 0x06, 0x00, 0x0d, 0x00, 0x00, 0x13, 0x12,
+	0x13, 0x0b, 0x05, 0x0c, 0x05, 0x15, 0x12, 0x0d, 0x00, 0x00, 0x00, 0x0b,
+	0x00, 0x00, 0x8b, 0x11, 0x00, 0x00, 0x86, 0x00, 0x00, 0x08, 0x08, 0x00,
+	0x00, 0x1a, 0x14, 0x14, 0x16, 0x00, 0x0d, 0x1c, 0x88, 0x09, 0x0e, 0x09,
+	0x0f, 0x05, 0x00, 0x07, 0x14, 0x03, 0x00, 0x00, 0x14, 0x09, 0x11, 0x00,
+	0x00, 0x11, 0x00, 0x11, 0x00, 0x13, 0x00, 0x88, 0x07, 0x00, 0x08, 0x08,
+	0x00, 0x07, 0x05, 0x0e, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x04, 0x17,
+	0x00, 0x14, 0x10, 0x88, 0x00, 0x0e, 0x0e, 0x12,
+};
+#endif
+
+#if  defined(LWS_WITH_HTTP_UNCOMMON_HEADERS) &&  defined(LWS_ROLE_WS) &&  defined(LWS_ROLE_H2)
+/* 86 names */
+#define LWS_LEXHASH_SEED 0x811c9dc6u
+static const uint8_t lexhash_disp[] = {
+	0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x04, 0x00, 0x0a, 0x04, 0x03,
+	0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+	0x01, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05,
+	0x00, 0x01, 0x01, 0x00,
+};
+static const uint8_t lexhash_tok[] = {
+	0xff, 0xff, 0xff, 0x0d, 0x1f, 0x2c, 0x3b, 0x08, 0x3a, 0x35, 0x28, 0xff,
+	0xff, 0xff, 0x00, 0x18, 0x04, 0x12, 0x1d, 0xff, 0xff, 0x16, 0xff, 0xff,
+	0xff, 0x33, 0x4b, 0x36, 0x29, 0x50, 0xff, 0x1b, 0x46, 0x1c, 0xff, 0x47,
+	0x09, 0xff, 0x11, 0xff, 0x55, 0x1e, 0xff, 0x3c, 0x4d, 0x42, 0x0b, 0x40,
+	0x0a, 0x52, 0x13, 0x20, 0x56, 0x22, 0x32, 0x4e, 0xff, 0xff, 0xff, 0xff,
+	0x45, 0xff, 0x23, 0x02, 0x30, 0xff, 0x25, 0xff, 0xff, 0x05, 0x34, 0x49,
+	0xff, 0x0e, 0x21, 0x3e, 0x43, 0xff, 0x54, 0x2a, 0x24, 0x4f, 0x14, 0x0f,
+	0x10, 0x01, 0xff, 0x07, 0x06, 0x53, 0xff, 0x38, 0x48, 0x37, 0xff, 0xff,
+	0xff, 0x2f, 0xff, 0x2e, 0xff, 0x3d, 0xff, 0x26, 0x1a, 0xff, 0x51, 0x3f,
+	0xff, 0x4a, 0x41, 0x39, 0x03, 0xff, 0xff, 0x17, 0xff, 0xff, 0x2b, 0xff,
+	0x0c, 0x2d, 0x15, 0x27, 0xff, 0x31, 0x19, 0x44,
+};
+static const uint8_t lexhash_klen[] = {
+	0x00, 0x00, 0x00, 0x15, 0x08, 0x06, 0x09, 0x02, 0x05, 0x05, 0x0f, 0x00,
+	0x00, 0x00, 0x04, 0x0e, 0x0b, 0x1f, 0x05, 0x00, 0x00, 0x10, 0x00, 0x00,
+	0x00, 0x07, 0x87, 0x09, 0x0e, 0x10, 0x00, 0x0f, 0x05, 0x0d, 0x00, 0x04,
+	0x19, 0x00, 0x07, 0x00, 0x8a, 0x06, 0x00, 0x0d, 0x06, 0x0b, 0x13, 0x0c,
+	0x13, 0x05, 0x12, 0x12, 0x0d, 0x15, 0x05, 0x0a, 0x00, 0x00, 0x00, 0x00,
+	0x0b, 0x00, 0x8b, 0x08, 0x11, 0x00, 0x86, 0x00, 0x00, 0x08, 0x08, 0x86,
+	0x00, 0x14, 0x16, 0x14, 0x1a, 0x00, 0x0d, 0x1c, 0x88, 0x09, 0x0e, 0x09,
+	0x0f, 0x05, 0x00, 0x14, 0x07, 0x03, 0x00, 0x14, 0x11, 0x09, 0x00, 0x00,
+	0x00, 0x11, 0x00, 0x11, 0x00, 0x13, 0x00, 0x88, 0x07, 0x00, 0x08, 0x08,
+	0x00, 0x84, 0x07, 0x0e, 0x05, 0x00, 0x00, 0x07, 0x00, 0x00, 0x04, 0x00,
+	0x17, 0x14, 0x10, 0x88, 0x00, 0x0e, 0x0e, 0x12,
+};
+#endif
+
+static const uint32_t lexhash_pos[LWS_LEXHASH_MAX_KEY][8] = {
+	{
+		0x00002000, 0x04000000, 0x00000000, 0x01fdb3fa,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000400, 0x00002000, 0x00000000, 0x01bdb2ea,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04002000, 0x00000000, 0x01bdd2ea,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04002001, 0x00000000, 0x0375fbba,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x0404a001, 0x00000000, 0x029de36a,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04022001, 0x00000000, 0x02bcf37a,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04006001, 0x00000000, 0x001c83be,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04032001, 0x00000000, 0x04bcdb78,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04002001, 0x00000000, 0x0015f332,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04000000, 0x00000000, 0x0214cb6a,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04000000, 0x00000000, 0x001dcab8,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04002000, 0x00000000, 0x002dc2ba,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04000000, 0x00000000, 0x0039d3fa,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04002000, 0x00000000, 0x0418d392,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04002000, 0x00000000, 0x005dcaba,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04000000, 0x00000000, 0x0114c2aa,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04002000, 0x00000000, 0x0214d2aa,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04060000, 0x00000000, 0x001a90e8,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04000000, 0x00000000, 0x0031c220,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04000000, 0x00000000, 0x0098c028,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04002000, 0x00000000, 0x0028c200,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04000000, 0x00000000, 0x00149000,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04002000, 0x00000000, 0x00044200,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x00000000, 0x00000000, 0x00180300,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04000000, 0x00000000, 0x020000a0,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04000000, 0x00000000, 0x00000202,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x00000000, 0x00000000, 0x00004010,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04000000, 0x00000000, 0x00000020,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x00000000, 0x00000000, 0x00040000,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x00000000, 0x00000000, 0x00080000,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x04000000, 0x00000000, 0x00000000,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+	{
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	},
+};
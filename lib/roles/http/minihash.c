@@ -0,0 +1,462 @@
+/*
+ * minihash.c
+ *
+ * Perfect hash over the http header names lws knows
+ *
+ * Copyright (C)2011-2020 Andy Green <andy@warmcat.com>
+ *
+ * Licensed under MIT
+ *
+ * Usage: gcc minihash.c -o minihash && ./minihash > lexhash.h
+ *
+ * Then build it again with -DBENCH and run it to check every name decodes
+ * and compare the hash against the lextable.h walk over a corpus of real
+ * request header names on stderr.  The parser no longer uses lextable.h, it
+ * and minilex.c are kept as the baseline for this comparison.
+ *
+ * minimal-examples/api-tests/api-test-h1-parse checks names are classified
+ * correctly by the parser itself.
+ *
+ * Like minilex, there are eight variants of the token set depending on the
+ * UNCOMMON, WS and H2 build options, so we make a table for each, selected
+ * by the appropriate #if defined().
+ *
+ * The key for a name is the string from lextable-strings.h including the
+ * delimiter the parser sees when the name is complete, ':', ' ' or, for the
+ * empty line ending the headers, '\x0a'.  The pseudoheaders and some methods
+ * have no delimiter in the string set, those get ':' or ' ' implied.
+ *
+ * The hash is FNV-1a from a per-variant seed, computed incrementally as the
+ * name comes.  The low bits pick a bucket, its displacement plus the high
+ * bits picks a slot, which holds the only token the name can be.  So the
+ * name is classified with one hash and one compare against the token string.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#if defined(BENCH)
+#include <time.h>
+#endif
+
+#define BUCKETS		64
+#define SLOTS		128
+#define MAX_KEY		32
+
+#define lws_lexhash(h, c) (((h) ^ (uint8_t)(c)) * 16777619u)
+
+#define set set0
+#include "lextable-strings.h"
+#undef set
+#define LWS_WITH_HTTP_UNCOMMON_HEADERS
+#define set set1
+#include "lextable-strings.h"
+#undef set
+#undef LWS_WITH_HTTP_UNCOMMON_HEADERS
+#define LWS_ROLE_WS
+#define set set2
+#include "lextable-strings.h"
+#undef set
+#define LWS_WITH_HTTP_UNCOMMON_HEADERS
+#define set set3
+#include "lextable-strings.h"
+#undef set
+#undef LWS_WITH_HTTP_UNCOMMON_HEADERS
+#undef LWS_ROLE_WS
+#define LWS_ROLE_H2
+#define set set4
+#include "lextable-strings.h"
+#undef set
+#define LWS_WITH_HTTP_UNCOMMON_HEADERS
+#define set set5
+#include "lextable-strings.h"
+#undef set
+#undef LWS_WITH_HTTP_UNCOMMON_HEADERS
+#define LWS_ROLE_WS
+#define set set6
+#include "lextable-strings.h"
+#undef set
+#define LWS_WITH_HTTP_UNCOMMON_HEADERS
+#define set set7
+#include "lextable-strings.h"
+#undef set
+
+static const struct {
+	const char * const *set;
+	int count;
+} sets[] = {
+	{ set0, sizeof(set0) / sizeof(set0[0]) },
+	{ set1, sizeof(set1) / sizeof(set1[0]) },
+	{ set2, sizeof(set2) / sizeof(set2[0]) },
+	{ set3, sizeof(set3) / sizeof(set3[0]) },
+	{ set4, sizeof(set4) / sizeof(set4[0]) },
+	{ set5, sizeof(set5) / sizeof(set5[0]) },
+	{ set6, sizeof(set6) / sizeof(set6[0]) },
+	{ set7, sizeof(set7) / sizeof(set7[0]) },
+};
+
+struct key {
+	char k[MAX_KEY + 1];
+	int len;
+	int tok;
+	int implied;
+	uint32_t h;
+};
+
+static struct key keys[200];
+static int nkeys;
+
+static int
+make_keys(int version)
+{
+	const char * const *s = sets[version].set;
+	int n, l;
+
+	nkeys = 0;
+	for (n = 0; n < sets[version].count; n++) {
+		/* "uri-args" is only for internal storage */
+		if (!s[n][0] || !strcmp(s[n], "uri-args"))
+			continue;
+
+		l = strlen(s[n]);
+		strcpy(keys[nkeys].k, s[n]);
+		keys[nkeys].implied = 0;
+		if (s[n][l - 1] != ':' && s[n][l - 1] != ' ' &&
+		    s[n][l - 1] != '\x0a') {
+			keys[nkeys].k[l++] = s[n][0] == ':' ? ':' : ' ';
+			keys[nkeys].k[l] = '\0';
+			keys[nkeys].implied = 1;
+		}
+		if (l > MAX_KEY) {
+			fprintf(stderr, "%s too long\n", s[n]);
+			return 1;
+		}
+		keys[nkeys].len = l;
+		keys[nkeys].tok = n;
+		nkeys++;
+	}
+
+	return 0;
+}
+
+#if !defined(BENCH)
+
+static uint8_t disp[BUCKETS], tok[SLOTS], klen[SLOTS];
+static uint32_t posmask[MAX_KEY][8];
+
+static uint32_t
+hash(uint32_t seed, const char *p, int len)
+{
+	while (len--)
+		seed = lws_lexhash(seed, *p++);
+
+	return seed;
+}
+
+static int
+try_seed(uint32_t seed)
+{
+	int bsize[BUCKETS], order[BUCKETS], n, m, j, d, t, slot[MAX_KEY];
+
+	memset(bsize, 0, sizeof(bsize));
+	memset(disp, 0, sizeof(disp));
+	memset(tok, 0xff, sizeof(tok));
+	memset(klen, 0, sizeof(klen));
+
+	for (n = 0; n < nkeys; n++) {
+		keys[n].h = hash(seed, keys[n].k, keys[n].len);
+		bsize[keys[n].h % BUCKETS]++;
+	}
+
+	/* place the biggest buckets first */
+
+	for (n = 0; n < BUCKETS; n++)
+		order[n] = n;
+	for (n = 0; n < BUCKETS; n++)
+		for (m = n + 1; m < BUCKETS; m++)
+			if (bsize[order[m]] > bsize[order[n]]) {
+				t = order[n];
+				order[n] = order[m];
+				order[m] = t;
+			}
+
+	for (n = 0; n < BUCKETS && bsize[order[n]]; n++) {
+		for (d = 0; d < SLOTS; d++) {
+			j = 0;
+			for (m = 0; m < nkeys; m++) {
+				if (keys[m].h % BUCKETS != (uint32_t)order[n])
+					continue;
+				slot[j] = ((keys[m].h >> 16) + d) % SLOTS;
+				if (tok[slot[j]] != 0xff)
+					break;
+				for (t = 0; t < j; t++)
+					if (slot[t] == slot[j])
+						break;
+				if (t != j)
+					break;
+				j++;
+			}
+			if (m == nkeys)
+				break;
+		}
+		if (d == SLOTS)
+			return 1;
+
+		disp[order[n]] = d;
+		for (m = 0; m < nkeys; m++) {
+			if (keys[m].h % BUCKETS != (uint32_t)order[n])
+				continue;
+			t = ((keys[m].h >> 16) + d) % SLOTS;
+			tok[t] = keys[m].tok;
+			klen[t] = keys[m].len | (keys[m].implied << 7);
+		}
+	}
+
+	return 0;
+}
+
+static void
+dump(const char *name, const uint8_t *p, int len)
+{
+	int n;
+
+	printf("static const uint8_t %s[] = {", name);
+	for (n = 0; n < len; n++)
+		printf("%s0x%02x,", n % 12 ? " " : "\n\t", p[n]);
+	printf("\n};\n");
+}
+
+static int
+issue(int version)
+{
+	uint32_t seed = 0x811c9dc5;
+	unsigned char c;
+	int n, m;
+
+	if (make_keys(version))
+		return 1;
+
+	for (n = 0; n < nkeys; n++)
+		for (m = 0; m < keys[n].len; m++) {
+			c = keys[n].k[m];
+			posmask[m][c >> 5] |= 1u << (c & 31);
+		}
+
+	while (try_seed(seed))
+		seed++;
+
+	printf("#if %cdefined(LWS_WITH_HTTP_UNCOMMON_HEADERS) && "
+		 "%cdefined(LWS_ROLE_WS) && "
+		 "%cdefined(LWS_ROLE_H2)\n", version & 1 ? ' ' : '!',
+		     version & 2 ? ' ' : '!', version & 4 ? ' ' : '!');
+	printf("/* %d names */\n", nkeys);
+	printf("#define LWS_LEXHASH_SEED 0x%08xu\n", seed);
+	dump("lexhash_disp", disp, BUCKETS);
+	dump("lexhash_tok", tok, SLOTS);
+	dump("lexhash_klen", klen, SLOTS);
+	printf("#endif\n\n");
+
+	fprintf(stderr, "variant %d: %d names, seed 0x%08x\n", version,
+		nkeys, seed);
+
+	return 0;
+}
+
+int main(void)
+{
+	int n, m;
+
+	printf("/* generated by minihash.c, do not edit */\n\n");
+	printf("#define LWS_LEXHASH_BUCKETS %d\n", BUCKETS);
+	printf("#define LWS_LEXHASH_SLOTS %d\n", SLOTS);
+	printf("#define lws_lexhash(h, c) (((h) ^ (uint8_t)(c)) * "
+	       "16777619u)\n\n");
+	printf("#if LWS_LEXHASH_MAX_KEY != %d\n"
+	       "#error LWS_LEXHASH_MAX_KEY must match minihash.c\n"
+	       "#endif\n\n", MAX_KEY);
+
+	for (n = 0; n < 8; n++)
+		if (issue(n))
+			return 1;
+
+	/*
+	 * Which chars can appear at each position of any name in any variant,
+	 * lets the parser give up on names it can't know quickly
+	 */
+
+	printf("static const uint32_t "
+	       "lexhash_pos[LWS_LEXHASH_MAX_KEY][8] = {\n");
+	for (n = 0; n < MAX_KEY; n++) {
+		printf("\t{");
+		for (m = 0; m < 8; m++)
+			printf("%s0x%08x,", m % 4 ? " " : "\n\t\t",
+			       posmask[n][m]);
+		printf("\n\t},\n");
+	}
+	printf("};\n");
+
+	fprintf(stderr, "did all the variants\n");
+
+	return 0;
+}
+
+#else /* BENCH */
+
+/*
+ * Compare against the lextable walk using the variant with everything, with
+ * names from real browser and curl requests, including some we don't know
+ */
+
+#define LWS_WITH_HTTP_UNCOMMON_HEADERS
+#define LWS_ROLE_WS
+#define LWS_ROLE_H2
+#define LWS_LEXHASH_MAX_KEY MAX_KEY
+#include "lexhash.h"
+
+static const unsigned char lextable[] = {
+	#include "lextable.h"
+};
+
+#define FAIL_CHAR 0x08
+
+static const char * const corpus[] = {
+	"get ", "host:", "connection:", "cache-control:",
+	"upgrade-insecure-requests:", "user-agent:", "accept:",
+	"sec-fetch-site:", "sec-fetch-mode:", "sec-fetch-user:",
+	"sec-fetch-dest:", "accept-encoding:", "accept-language:",
+	"cookie:", "if-none-match:", "if-modified-since:", "\x0d\x0a",
+	"post ", "host:", "connection:", "content-length:", "origin:",
+	"content-type:", "referer:", "x-forwarded-for:", "dnt:",
+	"authorization:", "sec-ch-ua:", "sec-ch-ua-mobile:", "pragma:",
+	"get ", "host:", "upgrade:", "connection:", "sec-websocket-key:",
+	"sec-websocket-version:", "sec-websocket-extensions:",
+	"sec-websocket-protocol:", "x-requested-with:", "\x0d\x0a",
+	"http/1.1 ", "date:", "server:", "content-type:", "etag:",
+	"set-cookie:", "strict-transport-security:", "vary:",
+	"transfer-encoding:", "x-content-type-options:", "\x0d\x0a",
+};
+
+static int
+walk(const char *p)
+{
+	int pos = 0;
+	unsigned char c;
+
+	while ((c = *p++)) {
+		while (1) {
+			if (lextable[pos] & (1 << 7)) {
+				if ((lextable[pos] & 0x7f) != c)
+					return -1;
+				pos++;
+				if (lextable[pos] == FAIL_CHAR)
+					return -1;
+				break;
+			}
+			if (lextable[pos] == FAIL_CHAR)
+				return -1;
+			if (lextable[pos] < FAIL_CHAR)
+				return (lextable[pos] << 8) | lextable[pos + 1];
+			if (lextable[pos] == c) {
+				pos += lextable[pos + 1] +
+				       (lextable[pos + 2] << 8);
+				break;
+			}
+			pos += 3;
+		}
+		if (lextable[pos] < FAIL_CHAR)
+			return (lextable[pos] << 8) | lextable[pos + 1];
+	}
+
+	return -1;
+}
+
+static int
+lookup(const char *p)
+{
+	uint32_t h = LWS_LEXHASH_SEED;
+	const char *s;
+	int n, len = 0, slot;
+	unsigned char c;
+
+	while ((c = p[len])) {
+		if (len == LWS_LEXHASH_MAX_KEY ||
+		    !(lexhash_pos[len][c >> 5] & (1u << (c & 31))))
+			return -1;
+		h = lws_lexhash(h, c);
+		len++;
+		if (!((c == ':' && len > 1) || c == ' ' || c == '\x0a'))
+			continue;
+
+		slot = ((h >> 16) + lexhash_disp[h % LWS_LEXHASH_BUCKETS]) %
+							LWS_LEXHASH_SLOTS;
+		n = lexhash_tok[slot];
+		if (n == 0xff || (lexhash_klen[slot] & 0x7f) != len)
+			return -1;
+		s = set7[n];
+		if (lexhash_klen[slot] & 0x80) {
+			if (p[len - 1] != (s[0] == ':' ? ':' : ' '))
+				return -1;
+			len--;
+		}
+
+		return memcmp(s, p, len) ? -1 : n;
+	}
+
+	return -1;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+	int n, m, r = 0, loops = 1000000, nc = sizeof(corpus) /
+					       sizeof(corpus[0]);
+	char k[MAX_KEY + 2];
+	double t;
+
+	make_keys(7);
+	for (n = 0; n < nkeys; n++) {
+		strcpy(k, keys[n].k);
+		if (lookup(k) != keys[n].tok) {
+			fprintf(stderr, "failed to decode '%s'\n", k);
+			return 1;
+		}
+	}
+	fprintf(stderr, "All %d names decode OK\n", nkeys);
+
+	for (n = 0; n < nc; n++)
+		if (walk(corpus[n]) != lookup(corpus[n])) {
+			fprintf(stderr, "disagree on '%s': %d %d\n", corpus[n],
+				walk(corpus[n]), lookup(corpus[n]));
+			return 1;
+		}
+
+	t = now();
+	for (m = 0; m < loops; m++)
+		for (n = 0; n < nc; n++)
+			r += walk(corpus[n]);
+	t = now() - t;
+	fprintf(stderr, "lextable walk: %.1fns / name\n",
+		(t * 1e9) / ((double)loops * nc));
+
+	t = now();
+	for (m = 0; m < loops; m++)
+		for (n = 0; n < nc; n++)
+			r += lookup(corpus[n]);
+	t = now() - t;
+	fprintf(stderr, "perfect hash:  %.1fns / name\n",
+		(t * 1e9) / ((double)loops * nc));
+
+	return r == 1;
+}
+
+#endif
@@ -24,11 +24,13 @@
 
 #include "private-lib-core.h"
 
-static const unsigned char lextable_h1[] = {
-	#include "lextable.h"
-};
+#include "lexhash.h"
 
-#define FAIL_CHAR 0x08
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 #if defined(LWS_WITH_CUSTOM_HEADERS)
 
@@ -957,6 +959,157 @@ static const unsigned char methods[] = {
  * possible returns:, -1 fail, 0 ok or 2, transition to raw
  */
 
+/*
+ * name is a complete lower-case header name with its delimiter, len is its
+ * length and h its lws_lexhash() from LWS_LEXHASH_SEED.  There's only one
+ * token it can be, so one compare tells us if it is that or unknown.
+ */
+
+static int
+lws_lexhash_lookup(const char *name, int len, uint32_t h)
+{
+	int slot = (int)(((h >> 16) + lexhash_disp[h % LWS_LEXHASH_BUCKETS]) %
+							LWS_LEXHASH_SLOTS);
+	int tok = lexhash_tok[slot];
+	const char *s;
+
+	if (tok == 0xff || (lexhash_klen[slot] & 0x7f) != len)
+		return -1;
+
+	s = (const char *)lws_token_to_string((enum lws_token_indexes)tok);
+	if (lexhash_klen[slot] & 0x80) {
+		/* the set has no delimiter for pseudoheaders and some methods */
+		if (name[len - 1] != (s[0] == ':' ? ':' : ' '))
+			return -1;
+		len--;
+	}
+
+	return memcmp(s, name, len) ? -1 : tok;
+}
+
+int
+lws_http_name_to_token(const char *name, int len)
+{
+	uint32_t h = LWS_LEXHASH_SEED;
+	int n;
+
+	if (len > LWS_LEXHASH_MAX_KEY)
+		return -1;
+
+	for (n = 0; n < len; n++)
+		h = lws_lexhash(h, name[n]);
+
+	return lws_lexhash_lookup(name, len, h);
+}
+
+/*
+ * How many bytes from p before the first control char, ie, the ones a header
+ * value state would just take without looking at them.  Checks 16 or 8 at a
+ * time where it can.
+ */
+
+static int
+lws_parse_run(const unsigned char *p, int len)
+{
+	int n = 0;
+#if defined(__SSE2__)
+	const __m128i lim = _mm_set1_epi8(0x1f);
+	__m128i v;
+	int m;
+
+	while (n + 16 <= len) {
+		/* bytes <= 0x1f are unchanged by min with 0x1f */
+		v = _mm_loadu_si128((const __m128i *)(p + n));
+		m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, lim), v));
+		if (m)
+			return n + __builtin_ctz((unsigned int)m);
+		n += 16;
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	const uint8x16_t lim = vdupq_n_u8(0x20);
+
+	while (n + 16 <= len &&
+	       !vmaxvq_u8(vcltq_u8(vld1q_u8(p + n), lim)))
+		n += 16;
+#else
+	uint64_t w;
+
+	/* nonzero if any byte in w is < 0x20 */
+	while (n + 8 <= len) {
+		memcpy(&w, p + n, 8);
+		if ((w - 0x2020202020202020ull) & ~w & 0x8080808080808080ull)
+			break;
+		n += 8;
+	}
+#endif
+
+	while (n < len && p[n] >= 0x20)
+		n++;
+
+	return n;
+}
+
+/*
+ * Most of the bytes are header values that the state machine copies one at a
+ * time until it sees the CR.  If we're in the middle of one, take the run up
+ * to the next control char in one go, within the same limits issue_char()
+ * applies, and leave the rest to the state machine.  Returns how many bytes
+ * were consumed.
+ */
+
+static int
+lws_parse_bulk(struct lws *wsi, const unsigned char *buf, int len)
+{
+	struct allocated_headers *ah = wsi->http.ah;
+	int n, room, m;
+
+	switch (ah->parser_state) {
+	case WSI_TOKEN_SKIPPING:
+		return lws_parse_run(buf, len);
+
+#if defined(LWS_WITH_CUSTOM_HEADERS)
+	case WSI_TOKEN_UNKNOWN_VALUE_PART:
+		/* leading whitespace trimming is done bytewise */
+		if (ah->pos == ah->unk_value_pos)
+			return 0;
+		room = wsi->context->max_http_header_data - (int)ah->pos;
+		n = lws_parse_run(buf, len < room ? len : room);
+		memcpy(&ah->data[ah->pos], buf, n);
+		ah->pos += n;
+
+		return n;
+#endif
+
+	default:
+		if (ah->parser_state >= WSI_TOKEN_COUNT ||
+		    ah->parser_state == WSI_TOKEN_CHALLENGE ||
+		    !ah->frags[ah->frag_index[ah->parser_state]].len)
+			return 0;
+
+		/* the URI has its own processing */
+		for (m = 0; m < (int)LWS_ARRAY_SIZE(methods); m++)
+			if (ah->parser_state == methods[m])
+				return 0;
+
+		room = wsi->context->max_http_header_data - (int)ah->pos;
+		if (ah->current_token_limit) {
+			m = (int)ah->current_token_limit -
+					ah->frags[ah->nfrag].len;
+			if (m < room)
+				room = m;
+		}
+		if (room <= 0)
+			return 0;
+
+		n = lws_parse_run(buf, len < room ? len : room);
+		memcpy(&ah->data[ah->pos], buf, n);
+		ah->pos += n;
+		ah->frags[ah->nfrag].len += n;
+
+		return n;
+	}
+}
+
 lws_parser_return_t LWS_WARN_UNUSED_RESULT
 lws_parse(struct lws *wsi, unsigned char *buf, int *len)
 {
@@ -969,6 +1122,12 @@ lws_parse(struct lws *wsi, unsigned char *buf, int *len)
 	assert(wsi->http.ah);
 
 	do {
+		r = lws_parse_bulk(wsi, buf, *len);
+		buf += r;
+		*len -= r;
+		if (!*len)
+			break;
+
 		(*len)--;
 		c = *buf++;
 
@@ -1133,6 +1292,7 @@ swallow:
 				char dotstar[64];
 				int uhlen;
 #endif
+unknown_hdr_name:
 
 				/*
 				 * process unknown headers
@@ -1179,55 +1339,43 @@ swallow:
 			if (pos < 0)
 				break;
 
-			while (1) {
-				if (lextable_h1[pos] & (1 << 7)) {
-					/* 1-byte, fail on mismatch */
-					if ((lextable_h1[pos] & 0x7f) != c) {
-nope:
-						ah->lextable_pos = -1;
-						break;
-					}
-					/* fall thru */
-					pos++;
-					if (lextable_h1[pos] == FAIL_CHAR)
-						goto nope;
+			/*
+			 * lextable_pos counts the name chars so far.  Give up
+			 * as soon as no name we know has this char here,
+			 * otherwise when we reach the delimiter, the perfect
+			 * hash says what it is.
+			 */
 
-					ah->lextable_pos = pos;
-					break;
+			r = -1;
+			if (pos >= LWS_LEXHASH_MAX_KEY ||
+			    !(lexhash_pos[pos][c >> 5] & (1u << (c & 31))))
+				ah->lextable_pos = -1;
+			else {
+				if (!pos)
+					ah->lexhash = LWS_LEXHASH_SEED;
+				ah->lexhash = lws_lexhash(ah->lexhash, c);
+				ah->lexname[pos++] = (char)c;
+				ah->lextable_pos = (int16_t)pos;
+
+				if ((c == ':' && pos > 1) || c == ' ' ||
+				    c == '\x0a') {
+					r = lws_lexhash_lookup(ah->lexname, pos,
+							       ah->lexhash);
+					if (r < 0)
+						ah->lextable_pos = -1;
 				}
+			}
 
-				if (lextable_h1[pos] == FAIL_CHAR)
-					goto nope;
-
-				/* b7 = 0, end or 3-byte */
-				if (lextable_h1[pos] < FAIL_CHAR) {
 #if defined(LWS_WITH_CUSTOM_HEADERS)
-					if (!wsi->mux_substream) {
-						/*
-						 * We hit a terminal marker, so
-						 * we recognized this header...
-						 * drop the speculative name
-						 * part storage
-						 */
-						ah->pos = ah->unk_pos;
-						ah->unk_pos = 0;
-					}
-#endif
-					ah->lextable_pos = pos;
-					break;
-				}
-
-				if (lextable_h1[pos] == c) { /* goto */
-					ah->lextable_pos = pos +
-						(lextable_h1[pos + 1]) +
-						(lextable_h1[pos + 2] << 8);
-					break;
-				}
-
-				/* fall thru goto */
-				pos += 3;
-				/* continue */
+			if (r >= 0 && !wsi->mux_substream) {
+				/*
+				 * We recognized this header... drop the
+				 * speculative name part storage
+				 */
+				ah->pos = ah->unk_pos;
+				ah->unk_pos = 0;
 			}
+#endif
 
 			/*
 			 * If it's h1, server needs to be on the look out for
@@ -1298,11 +1446,10 @@ nope:
 				break;
 			}
 
-			if (lextable_h1[ah->lextable_pos] < FAIL_CHAR) {
-				/* terminal state */
+			if (r >= 0) {
+				/* we know it */
 
-				n = ((unsigned int)lextable_h1[ah->lextable_pos] << 8) |
-						lextable_h1[ah->lextable_pos + 1];
+				n = (unsigned int)r;
 
 				lwsl_parser("known hdr %d\n", n);
 				for (m = 0; m < LWS_ARRAY_SIZE(methods); m++)
@@ -1344,8 +1491,12 @@ nope:
 unknown_hdr:
 			//ah->parser_state = WSI_TOKEN_SKIPPING;
 			//break;
-			if (!wsi->mux_substream)
+			if (!wsi->mux_substream) {
+				if (c == ':')
+					/* we only knew it at the delimiter */
+					goto unknown_hdr_name;
 				break;
+			}
 #endif
 
 start_fragment:
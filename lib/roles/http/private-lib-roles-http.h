@@ -94,6 +94,9 @@ void
 lws_ranges_reset(struct lws_range_parsing *rp);
 #endif
 
+/* longest header name we know, with its delimiter, see minihash.c */
+#define LWS_LEXHASH_MAX_KEY 32
+
 /*
  * these are assigned from a pool held in the context.
  * Both client and server mode uses them for http header analysis
@@ -134,7 +137,9 @@ struct allocated_headers {
 	ah_data_idx_t unk_ll_tail;
 #endif
 
+	uint32_t lexhash; /* of the header name so far */
 	int16_t lextable_pos;
+	char lexname[LWS_LEXHASH_MAX_KEY]; /* the header name so far */
 
 	uint8_t in_use;
 	uint8_t nfrag;
@@ -314,6 +319,9 @@ lws_read_h1(struct lws *wsi, unsigned char *buf, lws_filepos_t len);
 void
 _lws_header_table_reset(struct allocated_headers *ah);
 
+int
+lws_http_name_to_token(const char *name, int len);
+
 LWS_EXTERN int
 _lws_destroy_ah(struct lws_context_per_thread *pt, struct allocated_headers *ah);
 
@@ -66,21 +66,88 @@ typedef struct {
 	uint16_t		file_com_len;
 } lws_fops_zip_hdr_t;
 
+/*
+ * The central directory of each zip is read once, and indexed by a hash of
+ * the names.  The zip is kept open for all the files opened inside it for as
+ * long as it doesn't change, so opening a file inside it costs a stat() and a
+ * hash lookup, rather than a scan of the whole directory.
+ *
+ * The zip is not mapped, since a mapping of a file that is rewritten or
+ * truncated in place faults on access.  Replace served zips by renaming a new
+ * one over them; files already open keep reading the old one.
+ */
+
+#define LWS_FZ_NO_ENTRY 0xffffffffu
+
+/*
+ * Deflated files served to clients that can't take gzip are inflated whole
+ * the first time, and kept in an LRU shared by all the zips, up to
+ * LWS_FOPS_ZIP_INFLATED_CACHE bytes.  Files bigger than
+ * LWS_FOPS_ZIP_INFLATED_MAX are inflated piecemeal for each client as before.
+ */
+
+#ifndef LWS_FOPS_ZIP_INFLATED_CACHE
+#define LWS_FOPS_ZIP_INFLATED_CACHE (1024 * 1024)
+#endif
+#ifndef LWS_FOPS_ZIP_INFLATED_MAX
+#define LWS_FOPS_ZIP_INFLATED_MAX (LWS_FOPS_ZIP_INFLATED_CACHE / 4)
+#endif
+
+struct lws_fops_zip_entry;
+
+typedef struct {
+	lws_dll2_t		list;	/* in the lru while cached */
+	struct lws_fops_zip_entry *e; /* the entry it was inflated from */
+	size_t			len;
+	unsigned int		refcount; /* open files + 1 while cached */
+	/* the inflated content follows */
+} lws_fops_zip_inflated_t;
+
+typedef struct lws_fops_zip_entry {
+	lws_fops_zip_hdr_t	hdr;
+	const char		*name;	/* in the central directory, no NUL */
+	lws_fops_zip_inflated_t	*inflated; /* NULL unless cached */
+	lws_filepos_t		content_start; /* 0 until first opened */
+	uint32_t		hash;
+	uint32_t		next;	/* in the hash chain, or LWS_FZ_NO_ENTRY */
+} lws_fops_zip_entry_t;
+
+typedef struct {
+	lws_dll2_t		list;	/* in the cache while it's current */
+	const struct lws_plat_file_ops *fops; /* opened the zip with these */
+	lws_fop_fd_t		zip_fop_fd; /* the zip itself, shared */
+	lws_fops_zip_entry_t	*entries;
+	uint32_t		*buckets;
+	uint8_t			*cd;	/* the central directory */
+	lws_filepos_t		len;
+#if defined(LWS_PLAT_UNIX)
+	time_t			mtime;	/* what the zip was when we indexed */
+	off_t			size;
+	ino_t			ino;
+#endif
+	unsigned int		refcount; /* open files + 1 while cached */
+	uint32_t		count;
+	uint32_t		nbuckets; /* a power of 2 */
+	char			native; /* platform fops, we can pread() */
+	char			path[1]; /* overallocated */
+} lws_fops_zip_archive_t;
+
 typedef struct {
 	struct lws_fop_fd	fop_fd; /* MUST BE FIRST logical fop_fd into
 	 	 	 	 	 * file inside zip: fops_zip fops */
-	lws_fop_fd_t		zip_fop_fd; /* logical fop fd on to zip file
-	 	 	 	 	     * itself: using platform fops */
+	lws_fops_zip_archive_t	*za;	/* the zip the file is in */
+	lws_fops_zip_entry_t	*e;	/* the file's entry in the zip */
+	lws_fops_zip_inflated_t	*zi;	/* NULL, or serve it from here */
 	lws_fops_zip_hdr_t	hdr;
 	z_stream		inflate;
 	lws_filepos_t		content_start;
+	lws_filepos_t		zpos;	/* next compressed byte to inflate */
 	lws_filepos_t		exp_uncomp_pos;
 	union {
 		uint8_t		trailer8[8];
 		uint32_t	trailer32[2];
 	} u;
 	uint8_t			rbuf[128]; /* decompression chunk size */
-	int			entry_count;
 
 	unsigned int		decompress:1; /* 0 = direct from file */
 	unsigned int		add_gzip_container:1;
@@ -122,6 +189,8 @@ enum {
 	ZE_ZIP_COMMENT_LENGTH 			= 20,
 	ZE_DIRECTORY_LENGTH 			= 22,
 
+	ZL_SIGNATURE				= 0,
+	ZL_FILE_NAME_LENGTH			= 26,
 	ZL_REL_OFFSET_CONTENT			= 28,
 	ZL_HEADER_LENGTH			= 30,
 
@@ -160,130 +229,407 @@ get_u32(void *p)
 	return (uint32_t)((c[0] | (c[1] << 8) | (c[2] << 16) | (c[3] << 24)));
 }
 
-int
-lws_fops_zip_scan(lws_fops_zip_t priv, const char *name, int len)
+#if LWS_MAX_SMP > 1
+/* the cache is shared by all contexts and service threads in the process */
+static pthread_mutex_t lws_fops_zip_lock = PTHREAD_MUTEX_INITIALIZER;
+#define lws_fops_zip_lock_take() pthread_mutex_lock(&lws_fops_zip_lock)
+#define lws_fops_zip_lock_give() pthread_mutex_unlock(&lws_fops_zip_lock)
+#else
+#define lws_fops_zip_lock_take()
+#define lws_fops_zip_lock_give()
+#endif
+
+static lws_dll2_owner_t lws_fops_zip_cache;
+static lws_dll2_owner_t lws_fops_zip_lru; /* inflated files, oldest first */
+static size_t lws_fops_zip_lru_size;
+
+static uint32_t
+lws_fops_zip_hash(const char *name, size_t len)
 {
-	lws_filepos_t amount;
-	uint8_t buf[96];
-	int i;
+	uint32_t h = 0x811c9dc5u;
 
-	if (lws_vfs_file_seek_end(priv->zip_fop_fd, -ZE_DIRECTORY_LENGTH) < 0)
-		return LWS_FZ_ERR_SEEK_END_RECORD;
+	while (len--)
+		h = (h ^ (uint8_t)*name++) * 16777619u;
 
-	if (lws_vfs_file_read(priv->zip_fop_fd, &amount, buf,
-			      ZE_DIRECTORY_LENGTH))
-		return LWS_FZ_ERR_READ_END_RECORD;
+	return h;
+}
+
+/* read from an offset in the zip, non-native zips need the lock held */
+
+static int
+__lws_fops_zip_pread(lws_fops_zip_archive_t *za, lws_filepos_t ofs,
+		     uint8_t *buf, lws_filepos_t len, lws_filepos_t *amount)
+{
+	*amount = 0;
+	if (ofs >= za->len)
+		return 0;
+	if (len > za->len - ofs)
+		len = za->len - ofs;
+
+#if defined(LWS_PLAT_UNIX)
+	if (za->native) {
+		ssize_t n = pread(za->zip_fop_fd->fd, buf, (size_t)len,
+				  (off_t)ofs);
+
+		if (n < 0)
+			return 1;
+		*amount = (lws_filepos_t)n;
+
+		return 0;
+	}
+#endif
+
+	if (lws_vfs_file_seek_set(za->zip_fop_fd, (lws_fileofs_t)ofs) < 0)
+		return 1;
 
-	if (amount != ZE_DIRECTORY_LENGTH)
+	return lws_vfs_file_read(za->zip_fop_fd, amount, buf, len);
+}
+
+static int
+lws_fops_zip_pread(lws_fops_zip_archive_t *za, lws_filepos_t ofs,
+		   uint8_t *buf, lws_filepos_t len, lws_filepos_t *amount)
+{
+	int n;
+
+	if (za->native)
+		return __lws_fops_zip_pread(za, ofs, buf, len, amount);
+
+	lws_fops_zip_lock_take();
+	n = __lws_fops_zip_pread(za, ofs, buf, len, amount);
+	lws_fops_zip_lock_give();
+
+	return n;
+}
+
+static void
+__lws_fops_zip_inflated_unref(lws_fops_zip_inflated_t *zi)
+{
+	if (!--zi->refcount)
+		lws_free(zi);
+}
+
+static void
+__lws_fops_zip_inflated_evict(lws_fops_zip_inflated_t *zi)
+{
+	lws_dll2_remove(&zi->list);
+	lws_fops_zip_lru_size -= zi->len;
+	zi->e->inflated = NULL;
+	__lws_fops_zip_inflated_unref(zi);
+}
+
+static void
+__lws_fops_zip_archive_unref(lws_fops_zip_archive_t *za)
+{
+	lws_fops_zip_inflated_t *zi;
+
+	if (--za->refcount)
+		return;
+
+	/* drop anything still in the lru that was inflated from this zip */
+
+	lws_start_foreach_dll_safe(struct lws_dll2 *, d, d1,
+				   lws_dll2_get_head(&lws_fops_zip_lru)) {
+		zi = lws_container_of(d, lws_fops_zip_inflated_t, list);
+
+		if (zi->e >= za->entries && zi->e < za->entries + za->count)
+			__lws_fops_zip_inflated_evict(zi);
+	} lws_end_foreach_dll_safe(d, d1);
+
+	lws_free(za->cd);
+	lws_free(za->entries);
+	lws_free(za->buckets);
+	if (za->zip_fop_fd)
+		lws_vfs_file_close(&za->zip_fop_fd);
+	lws_free(za);
+}
+
+static void
+lws_fops_zip_archive_unref(lws_fops_zip_archive_t *za)
+{
+	lws_fops_zip_lock_take();
+	__lws_fops_zip_archive_unref(za);
+	lws_fops_zip_lock_give();
+}
+
+/*
+ * Read the central directory in one go and index it.  We require the zip to
+ * have the end record right at the end, Linux zip always does this if there's
+ * no zip comment.
+ */
+
+static int
+lws_fops_zip_index(lws_fops_zip_archive_t *za)
+{
+	uint8_t end[ZE_DIRECTORY_LENGTH], *p, *cd_end;
+	lws_filepos_t amount, cd_ofs, cd_len;
+	lws_fops_zip_entry_t *e;
+	size_t step;
+	uint32_t n;
+
+	if (za->len < ZE_DIRECTORY_LENGTH)
+		return LWS_FZ_ERR_SEEK_END_RECORD;
+
+	if (__lws_fops_zip_pread(za, za->len - ZE_DIRECTORY_LENGTH, end,
+				 ZE_DIRECTORY_LENGTH, &amount) ||
+	    amount != ZE_DIRECTORY_LENGTH)
 		return LWS_FZ_ERR_READ_END_RECORD;
 
-	/*
-	 * We require the zip to have the last record right at the end
-	 * Linux zip always does this if no zip comment.
-	 */
-	if (buf[0] != 'P' || buf[1] != 'K' || buf[2] != 5 || buf[3] != 6)
+	if (end[0] != 'P' || end[1] != 'K' || end[2] != 5 || end[3] != 6)
 		return LWS_FZ_ERR_END_RECORD_MAGIC;
 
-	i = get_u16(buf + ZE_NUM_ENTRIES);
+	za->count = get_u16(end + ZE_NUM_ENTRIES);
+	cd_len = get_u32(end + ZE_CENTRAL_DIRECTORY_SIZE);
+	cd_ofs = get_u32(end + ZE_CENTRAL_DIR_OFFSET);
 
-	if (get_u16(buf + ZE_DESK_NUMBER) ||
-	    get_u16(buf + ZE_CENTRAL_DIRECTORY_DISK_NUMBER) ||
-	    i != get_u16(buf + ZE_NUM_ENTRIES_THIS_DISK))
+	if (get_u16(end + ZE_DESK_NUMBER) ||
+	    get_u16(end + ZE_CENTRAL_DIRECTORY_DISK_NUMBER) ||
+	    za->count != get_u16(end + ZE_NUM_ENTRIES_THIS_DISK) ||
+	    cd_ofs + cd_len > za->len - ZE_DIRECTORY_LENGTH)
 		return LWS_FZ_ERR_END_RECORD_SANITY;
 
-	/* end record is OK... look for our file in the central dir */
+	za->cd = lws_malloc((size_t)cd_len + 1, __func__);
+	if (!za->cd)
+		return LWS_FZ_ERR_CENTRAL_READ;
+	if (__lws_fops_zip_pread(za, cd_ofs, za->cd, cd_len, &amount) ||
+	    amount != cd_len)
+		return LWS_FZ_ERR_CENTRAL_READ;
 
-	if (lws_vfs_file_seek_set(priv->zip_fop_fd,
-				  get_u32(buf + ZE_CENTRAL_DIR_OFFSET)) < 0)
-		return LWS_FZ_ERR_CENTRAL_SEEK;
+	za->nbuckets = 1;
+	while (za->nbuckets < za->count)
+		za->nbuckets <<= 1;
 
-	while (i--) {
-		priv->content_start = lws_vfs_tell(priv->zip_fop_fd);
+	za->entries = lws_zalloc(sizeof(*e) * (za->count + 1), __func__);
+	za->buckets = lws_malloc(sizeof(uint32_t) * za->nbuckets, __func__);
+	if (!za->entries || !za->buckets)
+		return LWS_FZ_ERR_CENTRAL_READ;
 
-		if (lws_vfs_file_read(priv->zip_fop_fd, &amount, buf,
-				      ZC_DIRECTORY_LENGTH))
-			return LWS_FZ_ERR_CENTRAL_READ;
+	p = za->cd;
+	cd_end = za->cd + cd_len;
 
-		if (amount != ZC_DIRECTORY_LENGTH)
-			return LWS_FZ_ERR_CENTRAL_READ;
+	for (n = 0; n < za->count; n++) {
+		e = &za->entries[n];
 
-		if (get_u32(buf + ZC_SIGNATURE) != 0x02014B50)
+		if (lws_ptr_diff(cd_end, p) < ZC_DIRECTORY_LENGTH ||
+		    get_u32(p + ZC_SIGNATURE) != 0x02014B50)
 			return LWS_FZ_ERR_CENTRAL_SANITY;
 
-               lwsl_debug("cstart 0x%lx\n", (unsigned long)priv->content_start);
-
-		priv->hdr.filename_len = get_u16(buf + ZC_FILE_NAME_LENGTH);
-		priv->hdr.extra = get_u16(buf + ZC_EXTRA_FIELD_LENGTH);
-		priv->hdr.filename_start = lws_vfs_tell(priv->zip_fop_fd);
-
-		priv->hdr.method = get_u16(buf + ZC_COMPRESSION_METHOD);
-		priv->hdr.crc32 = get_u32(buf + ZC_CRC32);
-		priv->hdr.comp_size = get_u32(buf + ZC_COMPRESSED_SIZE);
-		priv->hdr.uncomp_size = get_u32(buf + ZC_UNCOMPRESSED_SIZE);
-		priv->hdr.offset = get_u32(buf + ZC_REL_OFFSET_LOCAL_HEADER);
-		priv->hdr.mod_time = get_u32(buf + ZC_LAST_MOD_FILE_TIME);
-		priv->hdr.file_com_len = get_u16(buf + ZC_FILE_COMMENT_LENGTH);
-
-		if (priv->hdr.filename_len != len)
-			goto next;
-
-		if (len >= (int)sizeof(buf) - 1)
-			return LWS_FZ_ERR_NAME_TOO_LONG;
-
-		if (priv->zip_fop_fd->fops->LWS_FOP_READ(priv->zip_fop_fd,
-							&amount, buf, len))
-			return LWS_FZ_ERR_NAME_READ;
-		if ((int)amount != len)
-			return LWS_FZ_ERR_NAME_READ;
-
-		buf[len] = '\0';
-		lwsl_debug("check %s vs %s\n", buf, name);
-
-		if (strcmp((const char *)buf, name))
-			goto next;
-
-		/* we found a match */
-		if (lws_vfs_file_seek_set(priv->zip_fop_fd, priv->hdr.offset) < 0)
-			return LWS_FZ_ERR_NAME_SEEK;
-		if (priv->zip_fop_fd->fops->LWS_FOP_READ(priv->zip_fop_fd,
-							&amount, buf,
-							ZL_HEADER_LENGTH))
-			return LWS_FZ_ERR_NAME_READ;
-		if (amount != ZL_HEADER_LENGTH)
-			return LWS_FZ_ERR_NAME_READ;
-
-		priv->content_start = priv->hdr.offset +
-				      ZL_HEADER_LENGTH +
-				      priv->hdr.filename_len +
-				      get_u16(buf + ZL_REL_OFFSET_CONTENT);
+		e->hdr.filename_len = get_u16(p + ZC_FILE_NAME_LENGTH);
+		e->hdr.extra = get_u16(p + ZC_EXTRA_FIELD_LENGTH);
+		e->hdr.file_com_len = get_u16(p + ZC_FILE_COMMENT_LENGTH);
+		e->hdr.method = get_u16(p + ZC_COMPRESSION_METHOD);
+		e->hdr.crc32 = get_u32(p + ZC_CRC32);
+		e->hdr.comp_size = get_u32(p + ZC_COMPRESSED_SIZE);
+		e->hdr.uncomp_size = get_u32(p + ZC_UNCOMPRESSED_SIZE);
+		e->hdr.offset = get_u32(p + ZC_REL_OFFSET_LOCAL_HEADER);
+		e->hdr.mod_time = get_u32(p + ZC_LAST_MOD_FILE_TIME);
+		e->hdr.filename_start = cd_ofs + (lws_filepos_t)
+				lws_ptr_diff(p, za->cd) + ZC_DIRECTORY_LENGTH;
+
+		step = (size_t)ZC_DIRECTORY_LENGTH + e->hdr.filename_len +
+		       e->hdr.extra + e->hdr.file_com_len;
+		if (step > (size_t)lws_ptr_diff(cd_end, p))
+			return LWS_FZ_ERR_CENTRAL_SANITY;
 
-		lwsl_debug("content supposed to start at 0x%lx\n",
-                          (unsigned long)priv->content_start);
+		e->name = (const char *)p + ZC_DIRECTORY_LENGTH;
+		e->hash = lws_fops_zip_hash(e->name, e->hdr.filename_len);
 
-		if (priv->content_start > priv->zip_fop_fd->len)
-			return LWS_FZ_ERR_CONTENT_SANITY;
+		p += step;
+	}
 
-		if (lws_vfs_file_seek_set(priv->zip_fop_fd,
-					  priv->content_start) < 0)
-			return LWS_FZ_ERR_CONTENT_SEEK;
+	/* chain them backwards, so the first of any duplicates is found */
 
-		/* we are aligned at the start of the content */
+	memset(za->buckets, 0xff, sizeof(uint32_t) * za->nbuckets);
+	n = za->count;
+	while (n--) {
+		e = &za->entries[n];
+		e->next = za->buckets[e->hash & (za->nbuckets - 1)];
+		za->buckets[e->hash & (za->nbuckets - 1)] = n;
+	}
 
-		priv->exp_uncomp_pos = 0;
+	return 0;
+}
 
-		return 0;
+/*
+ * Find the cached, current index for the zip at path, or make one.  The
+ * caller gets a reference on it.
+ */
 
-next:
-		if (i && lws_vfs_file_seek_set(priv->zip_fop_fd,
-					       priv->content_start +
-					       ZC_DIRECTORY_LENGTH +
-					       priv->hdr.filename_len +
-					       priv->hdr.extra +
-					       priv->hdr.file_com_len) < 0)
-			return LWS_FZ_ERR_SCAN_SEEK;
+static lws_fops_zip_archive_t *
+lws_fops_zip_archive_get(const struct lws_plat_file_ops *fops, const char *path)
+{
+	lws_fop_flags_t local_flags = 0;
+	lws_fops_zip_archive_t *za;
+	size_t pl = strlen(path);
+	int m;
+#if defined(LWS_PLAT_UNIX)
+	/* we can only check and pread() zips opened by the platform fops */
+	int native = fops->LWS_FOP_OPEN == _lws_plat_file_open;
+	struct stat s;
+
+	if (native && stat(path, &s))
+		s.st_ino = 0;
+#endif
+
+	lws_fops_zip_lock_take();
+
+	lws_start_foreach_dll_safe(struct lws_dll2 *, d, d1,
+				   lws_dll2_get_head(&lws_fops_zip_cache)) {
+		za = lws_container_of(d, lws_fops_zip_archive_t, list);
+
+		if (za->fops == fops && !strcmp(za->path, path)) {
+#if defined(LWS_PLAT_UNIX)
+			if (native && (!s.st_ino || s.st_ino != za->ino ||
+				       s.st_mtime != za->mtime ||
+				       s.st_size != za->size)) {
+				/*
+				 * The zip changed... files already open in the
+				 * old one keep its fd until they close, which
+				 * only helps if it was replaced by rename
+				 */
+				lwsl_info("%s: %s changed\n", __func__, path);
+				lws_dll2_remove(&za->list);
+				__lws_fops_zip_archive_unref(za);
+				break;
+			}
+#endif
+			za->refcount++;
+			lws_fops_zip_lock_give();
+
+			return za;
+		}
+	} lws_end_foreach_dll_safe(d, d1);
+
+	za = lws_zalloc(sizeof(*za) + pl, __func__);
+	if (!za)
+		goto bail;
+
+	za->refcount = 1;
+	za->fops = fops;
+	memcpy(za->path, path, pl + 1);
+
+	/* open the zip file itself using the incoming fops, not fops_zip */
+
+	za->zip_fop_fd = fops->LWS_FOP_OPEN(fops, path, NULL, &local_flags);
+	if (!za->zip_fop_fd) {
+		lwsl_err("unable to open zip %s\n", path);
+		goto bail1;
 	}
+	za->len = za->zip_fop_fd->len;
+
+#if defined(LWS_PLAT_UNIX)
+	if (native && !fstat(za->zip_fop_fd->fd, &s)) {
+		za->mtime = s.st_mtime;
+		za->size = s.st_size;
+		za->ino = s.st_ino;
+		za->native = 1;
+	}
+#endif
 
-	return LWS_FZ_ERR_NOT_FOUND;
+	m = lws_fops_zip_index(za);
+	if (m) {
+		lwsl_err("%s: unable to index zip %s: %d\n", __func__, path, m);
+		goto bail1;
+	}
+
+	lwsl_info("%s: %s: %u entries\n", __func__, path,
+		  (unsigned int)za->count);
+
+	za->refcount++; /* the cache's */
+	lws_dll2_add_tail(&za->list, &lws_fops_zip_cache);
+	lws_fops_zip_lock_give();
+
+	return za;
+
+bail1:
+	__lws_fops_zip_archive_unref(za);
+bail:
+	lws_fops_zip_lock_give();
+
+	return NULL;
+}
+
+void
+lws_fops_zip_cache_purge(const struct lws_plat_file_ops *fops)
+{
+	lws_fops_zip_archive_t *za;
+
+	lws_fops_zip_lock_take();
+
+	lws_start_foreach_dll_safe(struct lws_dll2 *, d, d1,
+				   lws_dll2_get_head(&lws_fops_zip_cache)) {
+		za = lws_container_of(d, lws_fops_zip_archive_t, list);
+
+		if (za->fops == fops) {
+			lws_dll2_remove(&za->list);
+			__lws_fops_zip_archive_unref(za);
+		}
+	} lws_end_foreach_dll_safe(d, d1);
+
+	lws_fops_zip_lock_give();
+}
+
+static int
+lws_fops_zip_find(lws_fops_zip_t priv, const char *name, size_t len)
+{
+	lws_fops_zip_archive_t *za = priv->za;
+	uint32_t h = lws_fops_zip_hash(name, len), n;
+	uint8_t lh[ZL_HEADER_LENGTH];
+	lws_fops_zip_entry_t *e = NULL;
+	lws_filepos_t amount;
+	int ret = 0;
+
+	n = za->buckets[h & (za->nbuckets - 1)];
+	while (n != LWS_FZ_NO_ENTRY) {
+		e = &za->entries[n];
+		if (e->hash == h && e->hdr.filename_len == len &&
+		    !memcmp(e->name, name, len))
+			break;
+		n = e->next;
+	}
+	if (n == LWS_FZ_NO_ENTRY)
+		return LWS_FZ_ERR_NOT_FOUND;
+
+	lws_fops_zip_lock_take();
+
+	if (!e->content_start) {
+		/* the first time, we have to look at its local header */
+
+		if (__lws_fops_zip_pread(za, e->hdr.offset, lh, sizeof(lh),
+					 &amount) || amount != sizeof(lh) ||
+		    get_u32(lh + ZL_SIGNATURE) != 0x04034B50) {
+			ret = LWS_FZ_ERR_NAME_READ;
+			goto bail;
+		}
+
+		amount = (lws_filepos_t)e->hdr.offset + ZL_HEADER_LENGTH +
+			 get_u16(lh + ZL_FILE_NAME_LENGTH) +
+			 get_u16(lh + ZL_REL_OFFSET_CONTENT);
+
+		lwsl_debug("content supposed to start at 0x%lx\n",
+			   (unsigned long)amount);
+
+		/* what we serve must be inside the zip */
+
+		if (amount + e->hdr.comp_size > za->len ||
+		    (e->hdr.method == ZIP_COMPRESSION_METHOD_STORE &&
+		     e->hdr.comp_size != e->hdr.uncomp_size)) {
+			ret = LWS_FZ_ERR_CONTENT_SANITY;
+			goto bail;
+		}
+
+		e->content_start = amount;
+	}
+
+	priv->e = e;
+	priv->hdr = e->hdr;
+	priv->content_start = e->content_start;
+	priv->zpos = priv->content_start;
+	priv->exp_uncomp_pos = 0;
+
+bail:
+	lws_fops_zip_lock_give();
+
+	return ret;
 }
 
 static int
@@ -303,21 +649,127 @@ lws_fops_zip_reset_inflate(lws_fops_zip_t priv)
 		return LWS_FZ_ERR_ZLIB_INIT;
 	}
 
-	if (lws_vfs_file_seek_set(priv->zip_fop_fd, priv->content_start) < 0)
-		return LWS_FZ_ERR_CONTENT_SEEK;
-
+	priv->zpos = priv->content_start;
 	priv->exp_uncomp_pos = 0;
 
 	return 0;
 }
 
+/*
+ * Find the deflated file in the lru, or inflate the whole of it into the lru,
+ * if it's small enough.  Returns nonzero if the caller should inflate it
+ * piecemeal instead.
+ */
+
+static int
+lws_fops_zip_inflated_get(lws_fops_zip_t priv)
+{
+	lws_fops_zip_archive_t *za = priv->za;
+	lws_fops_zip_inflated_t *zi;
+	lws_filepos_t ofs, end, amount;
+	uint8_t buf[512];
+	z_stream z;
+	int n;
+
+	if (!priv->hdr.uncomp_size ||
+	    priv->hdr.uncomp_size > LWS_FOPS_ZIP_INFLATED_MAX)
+		return 1;
+
+	lws_fops_zip_lock_take();
+	zi = priv->e->inflated;
+	if (zi) {
+		/* it's the most recently used now */
+		lws_dll2_remove(&zi->list);
+		lws_dll2_add_tail(&zi->list, &lws_fops_zip_lru);
+		zi->refcount++;
+		priv->zi = zi;
+	}
+	lws_fops_zip_lock_give();
+
+	if (zi)
+		return 0;
+
+	zi = lws_malloc(sizeof(*zi) + priv->hdr.uncomp_size, __func__);
+	if (!zi)
+		return 1;
+
+	memset(zi, 0, sizeof(*zi));
+	memset(&z, 0, sizeof(z));
+	if (inflateInit2(&z, -MAX_WBITS) != Z_OK) {
+		lws_free(zi);
+
+		return 1;
+	}
+
+	z.next_out = (uint8_t *)&zi[1];
+	z.avail_out = priv->hdr.uncomp_size;
+	ofs = priv->content_start;
+	end = ofs + priv->hdr.comp_size;
+	n = Z_OK;
+
+	while (n == Z_OK && ofs != end) {
+		amount = end - ofs;
+		if (amount > sizeof(buf))
+			amount = sizeof(buf);
+		if (lws_fops_zip_pread(za, ofs, buf, amount, &amount) ||
+		    !amount)
+			break;
+		z.next_in = buf;
+
+		z.avail_in = (unsigned int)amount;
+		ofs += amount;
+		n = inflate(&z, Z_NO_FLUSH);
+	}
+	inflateEnd(&z);
+
+	if (n != Z_STREAM_END || z.avail_out ||
+	    crc32(0, (uint8_t *)&zi[1], priv->hdr.uncomp_size) !=
+							priv->hdr.crc32) {
+		lwsl_err("%s: %.*s failed to inflate\n", __func__,
+			 (int)priv->hdr.filename_len, priv->e->name);
+		lws_free(zi);
+
+		return 1;
+	}
+
+	zi->e = priv->e;
+	zi->len = priv->hdr.uncomp_size;
+	zi->refcount = 1;
+
+	lws_fops_zip_lock_take();
+
+	if (priv->e->inflated) {
+		/* somebody else inflated it meanwhile, use theirs */
+		lws_free(zi);
+		zi = priv->e->inflated;
+	} else {
+		/* make space by evicting the least recently used */
+		while (lws_fops_zip_lru.head &&
+		       lws_fops_zip_lru_size + zi->len >
+						LWS_FOPS_ZIP_INFLATED_CACHE)
+			__lws_fops_zip_inflated_evict(lws_container_of(
+				lws_fops_zip_lru.head,
+				lws_fops_zip_inflated_t, list));
+
+		lws_dll2_add_tail(&zi->list, &lws_fops_zip_lru);
+		lws_fops_zip_lru_size += zi->len;
+		priv->e->inflated = zi;
+	}
+	zi->refcount++;
+	priv->zi = zi;
+
+	lws_fops_zip_lock_give();
+
+	return 0;
+}
+
 static lws_fop_fd_t
 lws_fops_zip_open(const struct lws_plat_file_ops *fops, const char *vfs_path,
 		  const char *vpath, lws_fop_flags_t *flags)
 {
-	lws_fop_flags_t local_flags = 0;
 	lws_fops_zip_t priv;
 	char rp[192];
+	size_t vl;
 	int m;
 
 	/*
@@ -337,29 +789,44 @@ lws_fops_zip_open(const struct lws_plat_file_ops *fops, const char *vfs_path,
 		m = lws_ptr_diff(vpath, vfs_path) - 1;
 	lws_strncpy(rp, vfs_path, m + 1);
 
-	/* open the zip file itself using the incoming fops, not fops_zip */
-
-	priv->zip_fop_fd = fops->LWS_FOP_OPEN(fops, rp, NULL, &local_flags);
-	if (!priv->zip_fop_fd) {
-		lwsl_err("unable to open zip %s\n", rp);
+	priv->za = lws_fops_zip_archive_get(fops, rp);
+	if (!priv->za)
 		goto bail1;
-	}
 
 	if (*vpath == '/')
 		vpath++;
+	vl = strlen(vpath);
+
+	/*
+	 * If the client can take brotli, and the zip has a brotli-compressed
+	 * version of the file alongside it as "name.br", serve that instead
+	 */
 
-	m = lws_fops_zip_scan(priv, vpath, (int)strlen(vpath));
+	if ((*flags & LWS_FOP_FLAG_COMPR_ACCEPTABLE_BR) &&
+	    vl + 3 < sizeof(rp)) {
+		memcpy(rp, vpath, vl);
+		memcpy(rp + vl, ".br", 3);
+
+		if (!lws_fops_zip_find(priv, rp, vl + 3)) {
+			lwsl_info("%s: serving %s.br\n", __func__, vpath);
+			*flags |= LWS_FOP_FLAG_COMPR_IS_BR;
+			goto found;
+		}
+	}
+
+	m = lws_fops_zip_find(priv, vpath, vl);
 	if (m) {
 		lwsl_err("unable to find record matching '%s' %d\n", vpath, m);
 		goto bail2;
 	}
 
+found:
 	/* the directory metadata tells us modification time, so pass it on */
 	priv->fop_fd.mod_time = priv->hdr.mod_time;
 	*flags |= LWS_FOP_FLAG_MOD_TIME_VALID | LWS_FOP_FLAG_VIRTUAL;
 	priv->fop_fd.flags = *flags;
 
-	/* The zip fop_fd is left pointing at the start of the content.
+	/* We know where the content starts inside the zip.
 	 *
 	 * 1) Content could be uncompressed (STORE), and we can always serve
 	 *    that directly
@@ -371,8 +838,8 @@ lws_fops_zip_open(const struct lws_plat_file_ops *fops, const char *vfs_path,
 	 *    headers.
 	 *
 	 * 3) Content could be compressed (GZIP) but the client can't handle
-	 *    receiving GZIP... we can decompress it and serve as it is
-	 *    inflated piecemeal.
+	 *    receiving GZIP... we can decompress it and serve it from the
+	 *    inflated cache, or if it's too big, as it is inflated piecemeal.
 	 *
 	 * 4) Content may be compressed some unknown way... fail
 	 *
@@ -391,7 +858,9 @@ lws_fops_zip_open(const struct lws_plat_file_ops *fops, const char *vfs_path,
 		return &priv->fop_fd;
 	}
 
-	if ((*flags & LWS_FOP_FLAG_COMPR_ACCEPTABLE_GZIP) &&
+	if ((*flags & (LWS_FOP_FLAG_COMPR_ACCEPTABLE_GZIP |
+		       LWS_FOP_FLAG_COMPR_IS_BR)) ==
+					LWS_FOP_FLAG_COMPR_ACCEPTABLE_GZIP &&
 	    priv->hdr.method == ZIP_COMPRESSION_METHOD_DEFLATE) {
 
 		/*
@@ -437,10 +906,16 @@ lws_fops_zip_open(const struct lws_plat_file_ops *fops, const char *vfs_path,
 
 		/* we must decompress it to serve it */
 
-		lwsl_info("decompressed zip serving\n");
-
 		priv->fop_fd.len = priv->hdr.uncomp_size;
 
+		if (!lws_fops_zip_inflated_get(priv)) {
+			lwsl_info("inflated zip serving (cached)\n");
+
+			return &priv->fop_fd;
+		}
+
+		lwsl_info("decompressed zip serving\n");
+
 		if (lws_fops_zip_reset_inflate(priv)) {
 			lwsl_err("inflate init failed\n");
 			goto bail2;
@@ -457,9 +932,9 @@ lws_fops_zip_open(const struct lws_plat_file_ops *fops, const char *vfs_path,
 		 priv->hdr.method);
 
 bail2:
-	lws_vfs_file_close(&priv->zip_fop_fd);
+	lws_fops_zip_archive_unref(priv->za);
 bail1:
-	free(priv);
+	lws_free(priv);
 
 	return NULL;
 }
@@ -474,9 +949,13 @@ lws_fops_zip_close(lws_fop_fd_t *fd)
 	if (priv->decompress)
 		inflateEnd(&priv->inflate);
 
-	lws_vfs_file_close(&priv->zip_fop_fd); /* close the gzip fop_fd */
+	lws_fops_zip_lock_take();
+	if (priv->zi)
+		__lws_fops_zip_inflated_unref(priv->zi);
+	__lws_fops_zip_archive_unref(priv->za); /* it may stay cached */
+	lws_fops_zip_lock_give();
 
-	free(priv);
+	lws_free(priv);
 	*fd = NULL;
 
 	return 0;
@@ -495,12 +974,33 @@ lws_fops_zip_read(lws_fop_fd_t fd, lws_filepos_t *amount, uint8_t *buf,
 		  lws_filepos_t len)
 {
 	lws_fops_zip_t priv = fop_fd_to_priv(fd);
-	lws_filepos_t ramount, rlen, cur = lws_vfs_tell(fd);
+	lws_filepos_t ramount, rlen, cur;
 	int ret;
 
+	*amount = 0;
+	if (!len)
+		return 0;
+
+	if (priv->zi) {
+		/* it's already inflated in the cache */
+
+		if (fd->pos >= priv->zi->len)
+			return 0;
+		if (len > priv->zi->len - fd->pos)
+			len = priv->zi->len - fd->pos;
+
+		memcpy(buf, (uint8_t *)&priv->zi[1] + fd->pos, (size_t)len);
+		*amount = len;
+		fd->pos += len;
+
+		return 0;
+	}
+
 	if (priv->decompress) {
 
 		if (priv->exp_uncomp_pos != fd->pos) {
+			lws_filepos_t target = fd->pos;
+
 			/*
 			 *  there has been a seek in the uncompressed fop_fd
 			 * we have to restart the decompression and loop eating
@@ -508,13 +1008,16 @@ lws_fops_zip_read(lws_fop_fd_t fd, lws_filepos_t *amount, uint8_t *buf,
 			 */
 			lwsl_info("seek in decompressed\n");
 
-			lws_fops_zip_reset_inflate(priv);
+			if (lws_fops_zip_reset_inflate(priv))
+				return LWS_FZ_ERR_SEEK_COMPRESSED;
+			fd->pos = 0;
 
-			while (priv->exp_uncomp_pos != fd->pos) {
+			while (fd->pos != target) {
 				rlen = len;
-				if (rlen > fd->pos - priv->exp_uncomp_pos)
-					rlen = fd->pos - priv->exp_uncomp_pos;
-				if (lws_fops_zip_read(fd, amount, buf, rlen))
+				if (rlen > target - fd->pos)
+					rlen = target - fd->pos;
+				if (lws_fops_zip_read(fd, amount, buf, rlen) ||
+				    !*amount)
 					return LWS_FZ_ERR_SEEK_COMPRESSED;
 			}
 			*amount = 0;
@@ -525,22 +1028,24 @@ lws_fops_zip_read(lws_fop_fd_t fd, lws_filepos_t *amount, uint8_t *buf,
 
 spin:
 		if (!priv->inflate.avail_in) {
-			rlen = sizeof(priv->rbuf);
-			if (rlen > priv->hdr.comp_size -
-				   (cur - priv->content_start))
-				rlen = priv->hdr.comp_size -
-				       (priv->hdr.comp_size -
-					priv->content_start);
-
-			if (priv->zip_fop_fd->fops->LWS_FOP_READ(
-					priv->zip_fop_fd, &ramount, priv->rbuf,
-					rlen))
-				return LWS_FZ_ERR_READ_CONTENT;
+			rlen = priv->content_start + priv->hdr.comp_size -
+			       priv->zpos;
+
+			if (rlen > sizeof(priv->rbuf))
+				rlen = sizeof(priv->rbuf);
 
-			cur += ramount;
+			if (lws_fops_zip_pread(priv->za, priv->zpos,
+					       priv->rbuf, rlen, &ramount))
+				return LWS_FZ_ERR_READ_CONTENT;
 
-			priv->inflate.avail_in = (unsigned int)ramount;
+			rlen = ramount;
 			priv->inflate.next_in = priv->rbuf;
+
+			if (!rlen)
+				return LWS_FZ_ERR_READ_CONTENT;
+
+			priv->zpos += rlen;
+			priv->inflate.avail_in = (unsigned int)rlen;
 		}
 
 		ret = inflate(&priv->inflate, Z_NO_FLUSH);
@@ -558,7 +1063,7 @@ spin:
 		}
 
 		if (!priv->inflate.avail_in && priv->inflate.avail_out &&
-		     cur != priv->content_start + priv->hdr.comp_size)
+		     priv->zpos != priv->content_start + priv->hdr.comp_size)
 			goto spin;
 
 		*amount = len - priv->inflate.avail_out;
@@ -593,22 +1098,18 @@ spin:
 		if (len && fd->pos >= sizeof(hd) &&
 		    fd->pos < priv->hdr.comp_size + sizeof(hd)) {
 
-			rlen = priv->hdr.comp_size - (priv->zip_fop_fd->pos -
-						      priv->content_start);
+			cur = fd->pos - sizeof(hd);
+			rlen = priv->hdr.comp_size - cur;
 			if (rlen > len)
 				rlen = len;
 
-			if (rlen &&
-			    priv->zip_fop_fd->pos < (priv->hdr.comp_size +
-					    	     priv->content_start)) {
-				if (lws_vfs_file_read(priv->zip_fop_fd,
-						      &ramount, buf, rlen))
-					return LWS_FZ_ERR_READ_CONTENT;
-				*amount += ramount;
-				fd->pos += ramount; // virtual pos
-				buf += ramount;
-				len -= ramount;
-			}
+			if (lws_fops_zip_pread(priv->za, priv->content_start +
+					       cur, buf, rlen, &ramount))
+				return LWS_FZ_ERR_READ_CONTENT;
+			*amount += ramount;
+			fd->pos += ramount; // virtual pos
+			buf += ramount;
+			len -= ramount;
 		}
 
 		/* place the prepared trailer at the end */
@@ -632,14 +1133,19 @@ spin:
 
 	lwsl_info("%s: store\n", __func__);
 
-	if (len > priv->hdr.uncomp_size - (cur - priv->content_start))
-		len = priv->hdr.comp_size - (priv->hdr.comp_size -
-					     priv->content_start);
+	*amount = 0;
+	if (fd->pos >= priv->hdr.uncomp_size)
+		return 0;
+
+	if (len > priv->hdr.uncomp_size - fd->pos)
+		len = priv->hdr.uncomp_size - fd->pos;
 
-	if (priv->zip_fop_fd->fops->LWS_FOP_READ(priv->zip_fop_fd,
-						 amount, buf, len))
+	if (lws_fops_zip_pread(priv->za, priv->content_start + fd->pos, buf,
+			       len, amount))
 		return LWS_FZ_ERR_READ_CONTENT;
 
+	fd->pos += *amount;
+
 	return 0;
 }
 
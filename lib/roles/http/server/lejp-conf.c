@@ -94,6 +94,8 @@ static const char * const paths_vhosts[] = {
 	"vhosts[].mounts[].cache-intermediaries",
 	"vhosts[].mounts[].extra-mimetypes.*",
 	"vhosts[].mounts[].interpret.*",
+	"vhosts[].mounts[].fastcgi-conns",
+	"vhosts[].mounts[].fastcgi-queue",
 	"vhosts[].ws-protocols[].*.*",
 	"vhosts[].ws-protocols[].*",
 	"vhosts[].ws-protocols[]",
@@ -162,6 +164,8 @@ enum lejp_vhost_paths {
 	LEJPVP_MOUNT_CACHE_INTERMEDIARIES,
 	LEJPVP_MOUNT_EXTRA_MIMETYPES,
 	LEJPVP_MOUNT_INTERPRET,
+	LEJPVP_MOUNT_FASTCGI_CONNS,
+	LEJPVP_MOUNT_FASTCGI_QUEUE,
 	LEJPVP_PROTOCOL_NAME_OPT,
 	LEJPVP_PROTOCOL_NAME,
 	LEJPVP_PROTOCOL,
@@ -562,6 +566,7 @@ lejp_vhosts_cb(struct lejp_ctx *ctx, char reason)
 			">https://",
 			"callback://",
 			"gzip://",
+			"fastcgi://",
 		};
 
 		if (!a->fresh_mount)
@@ -678,6 +683,12 @@ lejp_vhosts_cb(struct lejp_ctx *ctx, char reason)
 	case LEJPVP_CGI_TIMEOUT:
 		a->m.cgi_timeout = atoi(ctx->buf);
 		return 0;
+	case LEJPVP_MOUNT_FASTCGI_CONNS:
+		a->m.fastcgi_conns = (unsigned short)atoi(ctx->buf);
+		return 0;
+	case LEJPVP_MOUNT_FASTCGI_QUEUE:
+		a->m.fastcgi_queue = (unsigned short)atoi(ctx->buf);
+		return 0;
 	case LEJPVP_KEEPALIVE_TIMEOUT:
 		a->info->keepalive_timeout = atoi(ctx->buf);
 		return 0;
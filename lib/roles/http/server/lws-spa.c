@@ -66,6 +66,8 @@ struct lws_urldecode_stateful {
 	char content_disp[32];
 	char content_disp_filename[256];
 	char mime_boundary[128];
+	uint8_t bmh_skip[256];	/* Boyer-Moore-Horspool shifts for boundary */
+	int mime_boundary_len;
 	int out_len;
 	int pos;
 	int hdr_idx;
@@ -100,7 +102,7 @@ lws_urldecode_s_create(struct lws_spa *spa, struct lws *wsi, char *out,
 {
 	struct lws_urldecode_stateful *s;
 	char buf[205], *p;
-	int m = 0;
+	int m = 0, n;
 
 	if (spa->i.ac)
 		s = lwsac_use_zero(spa->i.ac, sizeof(*s), spa->i.ac_chunk_size);
@@ -142,6 +144,16 @@ lws_urldecode_s_create(struct lws_spa *spa, struct lws *wsi, char *out,
 				       *p && *p != ' ' && *p != ';')
 					s->mime_boundary[m++] = *p++;
 				s->mime_boundary[m] = '\0';
+				s->mime_boundary_len = m;
+
+				/*
+				 * how far we can move along if the last char
+				 * we compared against the boundary is c
+				 */
+				memset(s->bmh_skip, m, sizeof(s->bmh_skip));
+				for (n = 0; n < m - 1; n++)
+					s->bmh_skip[(uint8_t)s->mime_boundary[n]] =
+								(uint8_t)(m - 1 - n);
 
 				lwsl_notice("boundary '%s'\n", s->mime_boundary);
 			}
@@ -151,6 +163,84 @@ lws_urldecode_s_create(struct lws_spa *spa, struct lws *wsi, char *out,
 	return s;
 }
 
+/*
+ * Multipart part content is where almost all of an upload is, and until we
+ * reach something that might be the start of the boundary, it can only be
+ * content.  Look ahead over what we were given for the boundary using
+ * Boyer-Moore-Horspool, and deal with the content before it in one go.
+ *
+ * File content is passed to the callback directly from the input, other
+ * content is copied into the param storage as much as fits.  Returns how much
+ * was consumed as content, the rest, starting with a possible boundary, goes
+ * through the per-char state machine.
+ */
+
+static int
+lws_urldecode_s_mp_content(struct lws_urldecode_stateful *s, const char *in,
+			   int len)
+{
+	const uint8_t *p = (const uint8_t *)in;
+	int bl = s->mime_boundary_len, k = 0, span;
+	const char *cr;
+	char *dp;
+
+	if (!bl)
+		return 0;
+
+	while (k + bl <= len) {
+		if (p[k + bl - 1] == (uint8_t)s->mime_boundary[bl - 1] &&
+		    !memcmp(p + k, s->mime_boundary, (size_t)bl - 1))
+			break;
+		k += s->bmh_skip[p[k + bl - 1]];
+	}
+
+	if (k + bl <= len)
+		span = k;
+	else {
+		/*
+		 * No whole boundary, but one may start in the tail and
+		 * continue in the next input
+		 */
+		span = len - bl + 1;
+		if (span < 0)
+			span = 0;
+		cr = memchr(in + span, '\x0d', (size_t)(len - span));
+		span = cr ? lws_ptr_diff(cr, in) : len;
+	}
+
+	if (!span)
+		return 0;
+
+	if (s->content_disp_filename[0]) {
+		/* keep the order if the state machine left us something */
+		if (s->pos) {
+			if (s->output(s->data, s->name, &s->out, s->pos,
+				      LWS_UFS_CONTENT))
+				return -1;
+			s->pos = 0;
+		}
+
+		dp = (char *)in;
+		if (s->output(s->data, s->name, &dp, span, LWS_UFS_CONTENT))
+			return -1;
+
+		return span;
+	}
+
+	/* the per-char path will flush it when it's full */
+
+	k = s->out_len - 1 - s->pos;
+	if (k <= 0)
+		return 0;
+	if (span > k)
+		span = k;
+
+	memcpy(s->out + s->pos, in, (size_t)span);
+	s->pos += span;
+
+	return span;
+}
+
 static int
 lws_urldecode_s_process(struct lws_urldecode_stateful *s, const char *in,
 			int len)
@@ -244,6 +334,16 @@ lws_urldecode_s_process(struct lws_urldecode_stateful *s, const char *in,
 		/* states for multipart / mime style */
 
 		case MT_LOOK_BOUND_IN:
+			if (!s->mp) {
+				n = lws_urldecode_s_mp_content(s, in, len + 1);
+				if (n < 0)
+					return -1;
+				if (n) {
+					in += n;
+					len -= n - 1;
+					continue;
+				}
+			}
 retry_as_first:
 			if (*in == s->mime_boundary[s->mp] &&
 			    s->mime_boundary[s->mp]) {
@@ -484,6 +484,12 @@ lws_vfs_prepare_flags(struct lws *wsi)
 		f |= LWS_FOP_FLAG_COMPR_ACCEPTABLE_GZIP;
 	}
 
+	if (strstr(lws_hdr_simple_ptr(wsi, WSI_TOKEN_HTTP_ACCEPT_ENCODING),
+		   "br")) {
+		lwsl_info("client indicates brotli is acceptable\n");
+		f |= LWS_FOP_FLAG_COMPR_ACCEPTABLE_BR;
+	}
+
 	return f;
 }
 
@@ -785,6 +791,7 @@ lws_find_mount(struct lws *wsi, const char *uri_ptr, int uri_len)
 		    ) {
 			if (hm->origin_protocol == LWSMPRO_CALLBACK ||
 			    ((hm->origin_protocol == LWSMPRO_CGI ||
+			     hm->origin_protocol == LWSMPRO_FASTCGI ||
 			     lws_hdr_total_length(wsi, WSI_TOKEN_GET_URI) ||
 			     lws_hdr_total_length(wsi, WSI_TOKEN_POST_URI) ||
 			     lws_hdr_total_length(wsi, WSI_TOKEN_HEAD_URI) ||
@@ -1316,6 +1323,7 @@ lws_http_redirect_hit(struct lws_context_per_thread *pt, struct lws *wsi,
 	     (hit->origin_protocol == LWSMPRO_REDIR_HTTP ||
 	      hit->origin_protocol == LWSMPRO_REDIR_HTTPS)) &&
 	    (hit->origin_protocol != LWSMPRO_CGI &&
+	     hit->origin_protocol != LWSMPRO_FASTCGI &&
 	     hit->origin_protocol != LWSMPRO_CALLBACK)) {
 		unsigned char *start = pt->serv_buf + LWS_PRE, *p = start,
 			      *end = p + wsi->context->pt_serv_buf_size -
@@ -1669,6 +1677,27 @@ lws_http_action(struct lws *wsi)
 	}
 #endif
 
+#if defined(LWS_WITH_FASTCGI)
+	/* ... or a fastcgi:// one? */
+	if (hit->origin_protocol == LWSMPRO_FASTCGI) {
+		lwsl_debug("%s: fastcgi\n", __func__);
+
+		n = 5;
+		if (hit->cgi_timeout)
+			n = hit->cgi_timeout;
+
+		if (lws_fastcgi(wsi, hit, n)) {
+			lwsl_err("%s: fastcgi failed\n", __func__);
+			return -1;
+		}
+
+		if (!wsi->http.rx_content_length)
+			return 0;
+
+		goto deal_body;
+	}
+#endif
+
 	n = uri_len - lws_ptr_diff(s, uri_ptr);
 	if (s[0] == '\0' || (n == 1 && s[n - 1] == '/'))
 		s = (char *)hit->def;
@@ -2549,6 +2578,14 @@ lws_serve_http_file(struct lws *wsi, const char *file, const char *content_type,
 			(unsigned char *)"gzip", 4, &p, end))
 			goto bail;
 		lwsl_info("file is being provided in gzip\n");
+	} else if ((wsi->http.fop_fd->flags & (LWS_FOP_FLAG_COMPR_ACCEPTABLE_BR |
+		       LWS_FOP_FLAG_COMPR_IS_BR)) ==
+	    (LWS_FOP_FLAG_COMPR_ACCEPTABLE_BR | LWS_FOP_FLAG_COMPR_IS_BR)) {
+		if (lws_add_http_header_by_token(wsi,
+			WSI_TOKEN_HTTP_CONTENT_ENCODING,
+			(unsigned char *)"br", 2, &p, end))
+			goto bail;
+		lwsl_info("file is being provided in brotli\n");
 	}
 #if defined(LWS_WITH_HTTP_STREAM_COMPRESSION)
 	else {
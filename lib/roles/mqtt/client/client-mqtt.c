@@ -120,6 +120,7 @@ lws_create_client_mqtt_object(const struct lws_client_connect_info *i,
 		c->conn_flags = LMQCFT_CLEAN_START;
 
 	c->keep_alive_secs = cp->keep_alive;
+	c->publish_window = cp->publish_window;
 
 	if (cp->will_param.topic &&
 	    *cp->will_param.topic) {
@@ -280,25 +280,195 @@ lws_mqtt_set_client_established(struct lws *wsi)
 	return 0;
 }
 
+static uint32_t
+lws_mqtt_level_hash(const char *p, size_t len)
+{
+	uint32_t h = 0x811c9dc5;
+
+	while (len--) {
+		h ^= (uint8_t)*p++;
+		h *= 0x01000193;
+	}
+
+	return h;
+}
+
+/*
+ * Find the child of n for one topic level, creating it if asked to.  The
+ * wildcard levels have their own slots, literal levels are found by hash on
+ * the list of n's literal children.
+ */
+
+static lws_mqtt_sub_node_t *
+lws_mqtt_sub_node_child(lws_mqtt_sub_node_t *n, const char *p, size_t len,
+			int create)
+{
+	lws_mqtt_sub_node_t **pc, *c;
+	uint32_t h = 0;
+
+	if (len == 1 && *p == '+')
+		pc = &n->plus;
+	else
+		if (len == 1 && *p == '#')
+			pc = &n->hash;
+		else {
+			h = lws_mqtt_level_hash(p, len);
+			pc = &n->child;
+			while (*pc) {
+				if ((*pc)->h == h && (*pc)->len == len &&
+				    !memcmp((*pc)->level, p, len))
+					return *pc;
+				pc = &(*pc)->sibling;
+			}
+		}
+
+	if (*pc || !create)
+		return *pc;
+
+	c = lws_zalloc(sizeof(*c) + len, "mqtt sub node");
+	if (!c)
+		return NULL;
+
+	c->parent = n;
+	c->h = h;
+	c->len = (uint16_t)len;
+	memcpy(c->level, p, len);
+	*pc = c;
+
+	return c;
+}
+
+/* find the trie node for a subscription topic, literally including wildcards */
+
+static lws_mqtt_sub_node_t *
+lws_mqtt_sub_node_walk(struct _lws_mqtt_related *mqtt, const char *topic,
+		       int create)
+{
+	lws_mqtt_sub_node_t *n;
+	const char *e;
+
+	if (!mqtt->subs_trie) {
+		if (!create)
+			return NULL;
+		mqtt->subs_trie = lws_zalloc(sizeof(*mqtt->subs_trie),
+					     "mqtt sub trie");
+		if (!mqtt->subs_trie)
+			return NULL;
+	}
+
+	n = mqtt->subs_trie;
+	do {
+		e = strchr(topic, '/');
+		if (!e)
+			e = topic + strlen(topic);
+		n = lws_mqtt_sub_node_child(n, topic,
+					    (size_t)lws_ptr_diff(e, topic),
+					    create);
+		topic = e + 1;
+	} while (n && *e);
+
+	return n;
+}
+
 lws_mqtt_subs_t *
 lws_mqtt_find_sub(struct _lws_mqtt_related *mqtt, const char *topic)
 {
-	lws_mqtt_subs_t *s = mqtt->subs_head;
+	lws_mqtt_sub_node_t *n = lws_mqtt_sub_node_walk(mqtt, topic, 0);
 
-	while (s) {
-		if (!strcmp((const char *)s->topic, topic))
-			return s;
-		s = s->next;
+	return n ? n->sub : NULL;
+}
+
+/*
+ * t points to the current level of the received topic, or is NULL once all
+ * its levels were consumed.  Wildcards don't match a first level starting
+ * with '$'.
+ */
+
+static int
+lws_mqtt_sub_trie_match(const lws_mqtt_sub_node_t *n, const char *t, int first)
+{
+	const lws_mqtt_sub_node_t *c;
+	const char *e;
+	uint32_t h;
+	size_t len;
+
+	while (n) {
+		/* '#' also matches the parent level, ie, zero levels */
+		if (n->hash && n->hash->sub && !(first && *t == '$'))
+			return 1;
+
+		if (!t)
+			return !!n->sub;
+
+		e = strchr(t, '/');
+		if (!e)
+			e = t + strlen(t);
+		len = (size_t)lws_ptr_diff(e, t);
+
+		if (n->plus && !(first && *t == '$') &&
+		    lws_mqtt_sub_trie_match(n->plus, *e ? e + 1 : NULL, 0))
+			return 1;
+
+		h = lws_mqtt_level_hash(t, len);
+		c = n->child;
+		while (c && (c->h != h || c->len != len ||
+			     memcmp(c->level, t, len)))
+			c = c->sibling;
+
+		n = c;
+		t = *e ? e + 1 : NULL;
+		first = 0;
 	}
 
-	return NULL;
+	return 0;
+}
+
+int
+lws_mqtt_match_sub(struct _lws_mqtt_related *mqtt, const char *topic)
+{
+	if (!mqtt->subs_trie)
+		return 0;
+
+	return lws_mqtt_sub_trie_match(mqtt->subs_trie, topic, 1);
+}
+
+void
+lws_mqtt_sub_trie_destroy(lws_mqtt_sub_node_t **pn)
+{
+	lws_mqtt_sub_node_t *n = *pn, *c, *c1;
+
+	if (!n)
+		return;
+
+	c = n->child;
+	while (c) {
+		c1 = c->sibling;
+		lws_mqtt_sub_trie_destroy(&c);
+		c = c1;
+	}
+	lws_mqtt_sub_trie_destroy(&n->plus);
+	lws_mqtt_sub_trie_destroy(&n->hash);
+
+	lws_free_set_NULL(*pn);
 }
 
 static lws_mqtt_subs_t *
 lws_mqtt_create_sub(struct _lws_mqtt_related *mqtt, const char *topic)
 {
+	lws_mqtt_sub_node_t *n;
 	lws_mqtt_subs_t *mysub;
 
+	n = lws_mqtt_sub_node_walk(mqtt, topic, 1);
+	if (!n)
+		return NULL;
+
+	if (n->sub) {
+		/* the same topic again, just take another reference */
+		n->sub->ref_count++;
+
+		return n->sub;
+	}
+
 	mysub = lws_malloc(sizeof(*mysub) + strlen(topic) + 1, "sub");
 	if (!mysub)
 		return NULL;
@@ -307,6 +477,8 @@ lws_mqtt_create_sub(struct _lws_mqtt_related *mqtt, const char *topic)
 	mqtt->subs_head = mysub;
 	memcpy(mysub->topic, topic, strlen(topic) + 1);
 	mysub->ref_count = 1;
+	mysub->node = n;
+	n->sub = mysub;
 
 	lwsl_info("%s: Created mysub %p for wsi->mqtt %p\n",
 		  __func__, mysub, mqtt);
@@ -314,30 +486,164 @@ lws_mqtt_create_sub(struct _lws_mqtt_related *mqtt, const char *topic)
 	return mysub;
 }
 
+/* unlink the sub from the list and trie, pruning trie nodes it leaves empty */
+
+static void
+lws_mqtt_destroy_sub(struct _lws_mqtt_related *mqtt, lws_mqtt_subs_t *sub)
+{
+	lws_mqtt_sub_node_t *n = sub->node, *p, **pc;
+
+	lws_start_foreach_llp(lws_mqtt_subs_t **, ps, mqtt->subs_head) {
+		if (*ps == sub) {
+			*ps = sub->next;
+			break;
+		}
+	} lws_end_foreach_llp(ps, next);
+
+	n->sub = NULL;
+	while (n->parent && !n->sub && !n->child && !n->plus && !n->hash) {
+		p = n->parent;
+		if (p->plus == n)
+			p->plus = NULL;
+		else
+			if (p->hash == n)
+				p->hash = NULL;
+			else {
+				pc = &p->child;
+				while (*pc != n)
+					pc = &(*pc)->sibling;
+				*pc = n->sibling;
+			}
+		lws_free(n);
+		n = p;
+	}
+
+	lwsl_info("%s: Removing sub %p from wsi->mqtt %p\n",
+		  __func__, sub, mqtt);
+
+	lws_free(sub);
+}
+
 static int
 lws_mqtt_client_remove_subs(struct _lws_mqtt_related *mqtt)
 {
-	lws_mqtt_subs_t *s = mqtt->subs_head;
-	lws_mqtt_subs_t *temp = NULL;
-
+	lws_mqtt_subs_t *s = mqtt->subs_head, *s1;
+	int n = 1;
 
 	lwsl_info("%s: Called to remove subs from wsi->mqtt %p\n",
 		  __func__, mqtt);
 
-	while (s && s->next) {
-		if (s->next->ref_count == 0)
-			break;
-		s = s->next;
+	while (s) {
+		s1 = s->next;
+		if (!s->ref_count) {
+			lws_mqtt_destroy_sub(mqtt, s);
+			n = 0;
+		}
+		s = s1;
 	}
 
-	if (s && s->next) {
-		temp = s->next;
-		lwsl_info("%s: Removing sub %p from wsi->mqtt %p\n",
-			  __func__, temp, mqtt);
-		s->next = temp->next;
-		lws_free(temp);
-		return 0;
+	return n;
+}
+
+/*
+ * The network wsi keeps the QoS1 PUBLISH awaiting PUBACK from all its children
+ * in an array sized to the publish window.  The window is small, so a linear
+ * search by packet ID is fine.
+ */
+
+static lws_mqtt_inflight_t *
+lws_mqtt_inflight_find(struct _lws_mqtt_related *nmqtt, uint16_t pkt_id)
+{
+	int n;
+
+	for (n = 0; n < nmqtt->inflight_max; n++)
+		if (nmqtt->inflight[n].wsi &&
+		    nmqtt->inflight[n].pkt_id == pkt_id)
+			return &nmqtt->inflight[n];
+
+	return NULL;
+}
+
+static lws_mqtt_inflight_t *
+lws_mqtt_inflight_claim(struct _lws_mqtt_related *nmqtt, struct lws *wsi,
+			uint16_t pkt_id)
+{
+	int n;
+
+	for (n = 0; n < nmqtt->inflight_max; n++)
+		if (!nmqtt->inflight[n].wsi) {
+			nmqtt->inflight[n].wsi = wsi;
+			nmqtt->inflight[n].pkt_id = pkt_id;
+			nmqtt->inflight_count++;
+
+			return &nmqtt->inflight[n];
+		}
+
+	return NULL;
+}
+
+static void
+lws_mqtt_inflight_release(struct lws *nwsi, lws_mqtt_inflight_t *inf)
+{
+	struct lws_context_per_thread *pt = &nwsi->context->pt[(int)nwsi->tsi];
+
+	__lws_sul_insert(&pt->pt_sul_owner, &inf->sul,
+			 LWS_SET_TIMER_USEC_CANCEL);
+	inf->wsi = NULL;
+	nwsi->mqtt->inflight_count--;
+}
+
+/*
+ * A slot in the publish window became free, let any children who were held
+ * back by it have another go
+ */
+
+static void
+lws_mqtt_publish_window_wake(struct lws *nwsi)
+{
+	lws_start_foreach_ll(struct lws *, w, nwsi->mux.child_list) {
+		if (w->mqtt && w->mqtt->publish_blocked) {
+			w->mqtt->publish_blocked = 0;
+			lws_callback_on_writable(w);
+		}
+	} lws_end_foreach_ll(w, mux.sibling_list);
+}
+
+/*
+ * Forget the QoS1 PUBLISH wsi has outstanding, or if wsi is the network wsi,
+ * all of them and the window itself
+ */
+
+void
+lws_mqtt_inflight_destroy(struct lws *nwsi, struct lws *wsi)
+{
+	struct _lws_mqtt_related *nmqtt = nwsi->mqtt;
+	int n;
+
+	if (!nmqtt || !nmqtt->inflight)
+		return;
+
+	for (n = 0; n < nmqtt->inflight_max; n++)
+		if (nmqtt->inflight[n].wsi &&
+		    (wsi == nwsi || nmqtt->inflight[n].wsi == wsi))
+			lws_mqtt_inflight_release(nwsi, &nmqtt->inflight[n]);
+
+	if (wsi == nwsi) {
+		lws_free_set_NULL(nmqtt->inflight);
+		nmqtt->inflight_max = 0;
 	}
+}
+
+int
+lws_mqtt_client_publish_window_full(struct lws *wsi)
+{
+	struct lws *nwsi = lws_get_network_wsi(wsi);
+
+	if (nwsi->mqtt->inflight_count < nwsi->mqtt->inflight_max)
+		return 0;
+
+	wsi->mqtt->publish_blocked = 1;
+
 	return 1;
 }
 
@@ -345,6 +651,7 @@ int
 _lws_mqtt_rx_parser(struct lws *wsi, lws_mqtt_parser_t *par,
 		    const uint8_t *buf, size_t len)
 {
+	lws_mqtt_inflight_t *inf;
 	struct lws *w;
 	int n;
 
@@ -1022,6 +1329,24 @@ cmd_completion:
 				wsi->mqtt = lws_zalloc(sizeof(*wsi->mqtt), "nwsi mqtt");
 				if (!wsi->mqtt)
 					return -1;
+
+				/*
+				 * The network connection holds the window of
+				 * QoS1 PUBLISH awaiting PUBACK for all the
+				 * streams using it
+				 */
+				n = w->mqtt->client.publish_window;
+				if (!n)
+					n = LWS_MQTT_DEFAULT_PUBLISH_WINDOW;
+				if (w->mqtt->peer_receive_max &&
+				    n > w->mqtt->peer_receive_max)
+					n = w->mqtt->peer_receive_max;
+				wsi->mqtt->inflight = lws_zalloc(
+					sizeof(*wsi->mqtt->inflight) * n,
+					"mqtt inflight");
+				if (!wsi->mqtt->inflight)
+					return -1;
+				wsi->mqtt->inflight_max = n;
 				w->mqtt->wsi = w;
 				w->protocol = wsi->protocol;
 				if (w->user_space &&
@@ -1085,52 +1410,37 @@ bail1:
 						__func__);
 
 				/*
-				 * Figure out which child asked for this
+				 * Figure out which child asked for this, from
+				 * the publish window
 				 */
 
-				n = 0;
-				lws_start_foreach_ll(struct lws *, w,
-						      wsi->mux.child_list) {
-					if (w->mqtt->unacked_publish &&
-					    w->mqtt->ack_pkt_id == par->cpkt_id) {
-						char requested_close = 0;
-
-						w->mqtt->unacked_publish = 0;
-						if (user_callback_handle_rxflow(
-							    w->protocol->callback,
-							    w, LWS_CALLBACK_MQTT_ACK,
-							    w->user_space, NULL, 0) < 0) {
-							lwsl_info("%s: MQTT_ACK requests close\n",
-								 __func__);
-							requested_close = 1;
-						}
-						n = 1;
-
-						/*
-						 * We got an assertive PUBACK,
-						 * no need for ACK timeout wait
-						 * any more
-						 */
-						lws_sul_schedule(lws_get_context(w), 0,
-							&w->mqtt->sul_qos1_puback_wait, NULL,
-							LWS_SET_TIMER_USEC_CANCEL);
-
-						if (requested_close) {
-							__lws_close_free_wsi(w,
-								0, "ack cb");
-							break;
-						}
-
-						break;
-					}
-				} lws_end_foreach_ll(w, mux.sibling_list);
-
-				if (!n) {
+				inf = lws_mqtt_inflight_find(wsi->mqtt,
+							     par->cpkt_id);
+				if (!inf) {
 					lwsl_err("%s: unsolicited PUBACK\n",
 							__func__);
 					return -1;
 				}
 
+				/*
+				 * We got an assertive PUBACK, no need for ACK
+				 * timeout wait any more, and there's room in
+				 * the window for another
+				 */
+				w = inf->wsi;
+				lws_mqtt_inflight_release(wsi, inf);
+				lws_mqtt_publish_window_wake(wsi);
+
+				if (user_callback_handle_rxflow(
+					    w->protocol->callback,
+					    w, LWS_CALLBACK_MQTT_ACK,
+					    w->user_space, NULL,
+					    par->cpkt_id) < 0) {
+					lwsl_info("%s: MQTT_ACK requests close\n",
+						 __func__);
+					__lws_close_free_wsi(w, 0, "ack cb");
+				}
+
 				/*
 				 * If we published something and it was acked,
 				 * our connection is definitely working in both
@@ -1275,8 +1585,8 @@ bail1:
 
 				lws_start_foreach_ll(struct lws *, w,
 						      wsi->mux.child_list) {
-					if (lws_mqtt_find_sub(w->mqtt,
-							      pub->topic))
+					if (lws_mqtt_match_sub(w->mqtt,
+							       pub->topic))
 						if (w->protocol->callback(
 							    w, n,
 							    w->user_space,
@@ -1432,6 +1742,17 @@ bail1:
 			case LMSPR_COMPLETED:
 				if (lws_mqtt_pconsume(par, par->vbit.consumed))
 					goto send_protocol_error_and_close;
+				/*
+				 * The server's Receive Maximum limits our
+				 * publish window when the streams bind
+				 */
+				if (par->prop_id == LMQPROP_RECEIVE_MAXIMUM &&
+				    ctl_pkt_type(par) == LMQCP_STOC_CONNACK) {
+					if (!par->vbit.value)
+						goto send_protocol_error_and_close;
+					wsi->mqtt->peer_receive_max =
+						(uint16_t)par->vbit.value;
+				}
 				break;
 			default:
 				goto send_protocol_error_and_close;
@@ -1582,14 +1903,20 @@ lws_mqtt_fill_fixed_header(uint8_t *p, lws_mqtt_control_packet_t ctrl_pkt_type,
 static void
 lws_mqtt_publish_resend(struct lws_sorted_usec_list *sul)
 {
-	struct _lws_mqtt_related *mqtt = lws_container_of(sul,
-			struct _lws_mqtt_related, sul_qos1_puback_wait);
+	lws_mqtt_inflight_t *inf = lws_container_of(sul, lws_mqtt_inflight_t,
+						    sul);
+	struct lws *wsi = inf->wsi, *nwsi = lws_get_network_wsi(wsi);
+	uint16_t pkt_id = inf->pkt_id;
 
-	lwsl_notice("%s: wsi %p\n", __func__, mqtt->wsi);
+	lwsl_notice("%s: wsi %p, pkt id %d\n", __func__, wsi, pkt_id);
 
-	if (mqtt->wsi->protocol->callback(mqtt->wsi, LWS_CALLBACK_MQTT_RESEND,
-				mqtt->wsi->user_space, NULL, 0))
-		lws_set_timeout(mqtt->wsi, 1, LWS_TO_KILL_ASYNC);
+	/* the user code decides about resending it, in a new slot */
+	lws_mqtt_inflight_release(nwsi, inf);
+	lws_mqtt_publish_window_wake(nwsi);
+
+	if (wsi->protocol->callback(wsi, LWS_CALLBACK_MQTT_RESEND,
+				    wsi->user_space, NULL, pkt_id))
+		lws_set_timeout(wsi, 1, LWS_TO_KILL_ASYNC);
 }
 
 int
@@ -1601,6 +1928,8 @@ lws_mqtt_client_send_publish(struct lws *wsi, lws_mqtt_publish_param_t *pub,
 	struct lws *nwsi = lws_get_network_wsi(wsi);
 	lws_mqtt_str_t mqtt_vh_payload;
 	uint32_t vh_len, rem_len;
+	lws_mqtt_inflight_t *inf;
+	int claim = 0;
 
 	assert(pub->topic);
 
@@ -1627,6 +1956,12 @@ lws_mqtt_client_send_publish(struct lws *wsi, lws_mqtt_publish_param_t *pub,
 		goto do_write;
 	}
 
+	if (pub->qos != QOS0 &&
+	    nwsi->mqtt->inflight_count >= nwsi->mqtt->inflight_max) {
+		lwsl_err("%s: wsi %p: publish window full\n", __func__, wsi);
+		return 1;
+	}
+
 	start = b + LWS_PRE;
 	p = start;
 	/*
@@ -1634,7 +1969,8 @@ lws_mqtt_client_send_publish(struct lws *wsi, lws_mqtt_publish_param_t *pub,
 	 * payload (if any)
 	 */
 	if (lws_mqtt_fill_fixed_header(p++, LMQCP_PUBLISH,
-				       0, pub->qos, 0)) {
+				       pub->dup && pub->packet_id,
+				       pub->qos, 0)) {
 		lwsl_err("%s: Failed to fill fixed header\n", __func__);
 		return 1;
 	}
@@ -1679,9 +2015,13 @@ lws_mqtt_client_send_publish(struct lws *wsi, lws_mqtt_publish_param_t *pub,
 	/* Packet ID */
 	if (pub->qos != QOS0) {
 		p = lws_mqtt_str_next(&mqtt_vh_payload, NULL);
-		wsi->mqtt->ack_pkt_id = pub->packet_id = ++nwsi->mqtt->pkt_id;
+		/* a retry may reuse the packet id it had before */
+		if (!pub->dup || !pub->packet_id)
+			pub->packet_id = ++nwsi->mqtt->pkt_id;
 		lwsl_debug("%s: pkt_id = %d\n", __func__,
-			   (int)wsi->mqtt->ack_pkt_id);
+			   (int)pub->packet_id);
+		/* it takes a slot in the window once it's on the wire */
+		claim = 1;
 		lws_ser_wu16be(p, pub->packet_id);
 		if (lws_mqtt_str_advance(&mqtt_vh_payload, 2)) {
 			lwsl_err("%s: b\n", __func__);
@@ -1710,9 +2050,19 @@ do_write:
 	if (lws_write(nwsi, start, lws_ptr_diff(p, start), LWS_WRITE_BINARY) !=
 			lws_ptr_diff(p, start)) {
 		lwsl_err("%s: write failed\n", __func__);
+		/* a later chunk failed, give up the slot the first one took */
+		if (!claim && pub->qos != QOS0) {
+			inf = lws_mqtt_inflight_find(nwsi->mqtt,
+						     pub->packet_id);
+			if (inf)
+				lws_mqtt_inflight_release(nwsi, inf);
+		}
 		return 1;
 	}
 
+	if (claim)
+		lws_mqtt_inflight_claim(nwsi->mqtt, wsi, pub->packet_id);
+
 	if (!is_complete) {
 		/* still some more chunks to come... */
 		lws_callback_on_writable(wsi);
@@ -1722,9 +2072,6 @@ do_write:
 
 	wsi->mqtt->inside_payload = nwsi->mqtt->inside_payload = 0;
 
-	if (pub->qos != QOS0)
-		wsi->mqtt->unacked_publish = 1;
-
 	/* this was the last part of the publish message */
 
 	if (pub->qos == QOS0) {
@@ -1744,9 +2091,15 @@ do_write:
 
 	/* For QoS1, if no PUBACK coming after 3s, we must RETRY the publish */
 
-	wsi->mqtt->sul_qos1_puback_wait.cb = lws_mqtt_publish_resend;
-	__lws_sul_insert(&pt->pt_sul_owner, &wsi->mqtt->sul_qos1_puback_wait,
-			 3 * LWS_USEC_PER_SEC);
+	inf = lws_mqtt_inflight_find(nwsi->mqtt, pub->packet_id);
+	if (!inf) {
+		lwsl_err("%s: pkt id %d not in window\n", __func__,
+			 pub->packet_id);
+		return 1;
+	}
+
+	inf->sul.cb = lws_mqtt_publish_resend;
+	__lws_sul_insert(&pt->pt_sul_owner, &inf->sul, 3 * LWS_USEC_PER_SEC);
 
 	return 0;
 }
@@ -1953,6 +2306,12 @@ lws_mqtt_client_send_unsubcribe(struct lws *wsi,
 		orphaned = 0;
 		memset(&send_unsub, 0, sizeof(send_unsub));
 		for (n = 0; n < unsub->num_topics; n++) {
+			/* the stream itself stops receiving the topic */
+			mysub = lws_mqtt_find_sub(wsi->mqtt,
+						  unsub->topic[n].name);
+			if (mysub && !--mysub->ref_count)
+				lws_mqtt_destroy_sub(wsi->mqtt, mysub);
+
 			mysub = lws_mqtt_find_sub(nwsi->mqtt,
 						  unsub->topic[n].name);
 			assert(mysub);
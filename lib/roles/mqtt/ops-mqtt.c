@@ -422,8 +422,8 @@ rops_close_role_mqtt(struct lws_context_per_thread *pt, struct lws *wsi)
 
 	c = &wsi->mqtt->client;
 
-	__lws_sul_insert(&pt->pt_sul_owner, &wsi->mqtt->sul_qos1_puback_wait,
-			 LWS_SET_TIMER_USEC_CANCEL);
+	/* forget any QoS1 PUBLISH still awaiting PUBACK */
+	lws_mqtt_inflight_destroy(nwsi, wsi);
 
 	lws_mqtt_str_free(&c->username);
 	lws_mqtt_str_free(&c->password);
@@ -440,15 +440,17 @@ rops_close_role_mqtt(struct lws_context_per_thread *pt, struct lws *wsi)
 		/*
 		 * Account for children no longer using nwsi subscription
 		 */
-		mysub = lws_mqtt_find_sub(nwsi->mqtt, (const char *)&s[1]);
+		mysub = lws_mqtt_find_sub(nwsi->mqtt, s->topic);
 //		assert(mysub); /* if child subscribed, nwsi must feel the same */
-		if (mysub) {
-			assert(mysub->ref_count);
-			mysub->ref_count--;
+		if (mysub && mysub != s) {
+			assert(mysub->ref_count >= s->ref_count);
+			mysub->ref_count = (uint8_t)(mysub->ref_count -
+						     s->ref_count);
 		}
 		lws_free(s);
 		s = s1;
 	}
+	lws_mqtt_sub_trie_destroy(&wsi->mqtt->subs_trie);
 
 	lws_mqtt_publish_param_t *pub =
 			(lws_mqtt_publish_param_t *)
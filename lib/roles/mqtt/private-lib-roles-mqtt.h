@@ -289,8 +289,11 @@ typedef struct lws_mqtt_parser_st {
 
 } lws_mqtt_parser_t;
 
+struct lws_mqtt_sub_node;
+
 typedef struct lws_mqtt_subs {
 	struct lws_mqtt_subs	*next;
+	struct lws_mqtt_sub_node *node; /* where it is in the topic trie */
 
 	uint8_t			ref_count; /* number of children referencing */
 
@@ -298,6 +301,28 @@ typedef struct lws_mqtt_subs {
 	char			topic[];
 } lws_mqtt_subs_t;
 
+/*
+ * Subscriptions are also indexed by a trie with one node per topic level, so
+ * matching a received topic against them, including '+' and '#' wildcards,
+ * costs in proportion to the topic depth rather than the number of
+ * subscriptions.  The wildcard children of a node are held separately from
+ * its literal children.
+ */
+
+typedef struct lws_mqtt_sub_node {
+	struct lws_mqtt_sub_node *parent;
+	struct lws_mqtt_sub_node *sibling; /* next literal child of parent */
+	struct lws_mqtt_sub_node *child;   /* first literal child */
+	struct lws_mqtt_sub_node *plus;    /* '+' child */
+	struct lws_mqtt_sub_node *hash;    /* '#' child */
+	lws_mqtt_subs_t		*sub;	   /* subscription ending here */
+	uint32_t		h;	   /* hash of level name */
+	uint16_t		len;
+
+	/* level name overallocated here, not NUL terminated */
+	char			level[];
+} lws_mqtt_sub_node_t;
+
 typedef struct lws_mqtts {
 	lws_mqtt_parser_t	par;
 	lwsgs_mqtt_states_t	estate;
@@ -318,15 +343,34 @@ typedef struct lws_mqttc {
 		uint8_t		retain;
 	} will;
 	uint16_t		keep_alive_secs;
+	uint16_t		publish_window;
 	uint8_t			conn_flags;
 } lws_mqttc_t;
 
+/* publish window if lws_mqtt_client_connect_param_t.publish_window is 0 */
+#define LWS_MQTT_DEFAULT_PUBLISH_WINDOW 16
+
+/*
+ * One of these per QoS1 PUBLISH awaiting PUBACK, the network wsi holds an
+ * array of them sized to the publish window.  A slot with NULL wsi is free.
+ */
+
+typedef struct lws_mqtt_inflight {
+	lws_sorted_usec_list_t	sul;	/* QoS1 puback wait TO */
+	struct lws		*wsi;	/* child stream that published */
+	uint16_t		pkt_id;
+} lws_mqtt_inflight_t;
+
 struct _lws_mqtt_related {
 	lws_mqttc_t		client;
-	lws_sorted_usec_list_t	sul_qos1_puback_wait; /* QoS1 puback wait TO */
 	struct lws		*wsi; /**< so sul can use lws_container_of */
 	lws_mqtt_subs_t		*subs_head; /**< Linked-list of heap-allocated subscription objects */
+	lws_mqtt_sub_node_t	*subs_trie; /**< topic level index of subs_head */
 	void			*rx_cpkt_param;
+	lws_mqtt_inflight_t	*inflight; /**< nwsi: QoS1 PUBLISH awaiting PUBACK */
+	uint16_t		inflight_max;
+	uint16_t		inflight_count;
+	uint16_t		peer_receive_max; /**< from CONNACK, 0 = none */
 	uint16_t		pkt_id;
 	uint16_t		ack_pkt_id;
 	uint16_t		sub_size;
@@ -339,7 +383,7 @@ struct _lws_mqtt_related {
 	uint8_t			inside_subscribe:1;
 	uint8_t			inside_unsubscribe:1;
 	uint8_t 		send_puback:1;
-	uint8_t			unacked_publish:1;
+	uint8_t			publish_blocked:1;
 
 	uint8_t			done_subscribe:1;
 };
@@ -394,5 +438,14 @@ lws_wsi_mqtt_adopt(struct lws *parent_wsi, struct lws *wsi);
 lws_mqtt_subs_t *
 lws_mqtt_find_sub(struct _lws_mqtt_related *mqtt, const char *topic);
 
+int
+lws_mqtt_match_sub(struct _lws_mqtt_related *mqtt, const char *topic);
+
+void
+lws_mqtt_sub_trie_destroy(lws_mqtt_sub_node_t **pn);
+
+void
+lws_mqtt_inflight_destroy(struct lws *nwsi, struct lws *wsi);
+
 #endif /* _PRIVATE_LIB_ROLES_MQTT */
 
@@ -22,8 +22,202 @@
  * IN THE SOFTWARE.
  */
 
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <private-lib-core.h>
 
+#if defined(LWS_HAVE_SPLICE)
+#include <fcntl.h>
+
+/* the most we move from a socket into the pipe at a time */
+#define LWS_SPLICE_CHUNK (64 * 1024)
+
+int
+lws_raw_proxy_splice(struct lws *wsi, struct lws *peer)
+{
+	struct lws *w[2] = { wsi, peer };
+	int n;
+
+	for (n = 0; n < 2; n++)
+		if (!lwsi_role_raw_proxy(w[n]) || w[n]->splice ||
+		    lwsi_state(w[n]) != LRS_ESTABLISHED ||
+		    w[n]->desc.sockfd == LWS_SOCK_INVALID ||
+#if defined(LWS_WITH_TLS)
+		    lws_is_ssl(w[n]) ||
+#endif
+#if defined(LWS_WITH_UDP)
+		    w[n]->udp ||
+#endif
+		    w[n]->buflist || lws_has_buffered_out(w[n]))
+			return 1;
+
+	for (n = 0; n < 2; n++) {
+		w[n]->splice = lws_zalloc(sizeof(*w[n]->splice), __func__);
+		if (!w[n]->splice)
+			goto bail;
+
+		if (pipe(w[n]->splice->pipe_fds)) {
+			lws_free_set_NULL(w[n]->splice);
+			goto bail;
+		}
+		lws_plat_apply_FD_CLOEXEC(w[n]->splice->pipe_fds[0]);
+		lws_plat_apply_FD_CLOEXEC(w[n]->splice->pipe_fds[1]);
+		/* the pipe must never block the event loop */
+		fcntl(w[n]->splice->pipe_fds[0], F_SETFL, O_NONBLOCK);
+		fcntl(w[n]->splice->pipe_fds[1], F_SETFL, O_NONBLOCK);
+		w[n]->splice->peer = w[n ^ 1];
+	}
+
+	lwsl_info("%s: %p <-> %p\n", __func__, wsi, peer);
+
+	return 0;
+
+bail:
+	while (n--) {
+		close(w[n]->splice->pipe_fds[0]);
+		close(w[n]->splice->pipe_fds[1]);
+		lws_free_set_NULL(w[n]->splice);
+	}
+
+	return 1;
+}
+
+/*
+ * Send what is waiting in our pipe.  Returns 0 if it went or the socket
+ * can't take more right now, or -1 if the connection is dead.
+ */
+
+static int
+lws_raw_proxy_splice_drain(struct lws *wsi)
+{
+	struct lws_raw_proxy_splice *sp = wsi->splice;
+	ssize_t n;
+
+	while (sp->pending) {
+		n = splice(sp->pipe_fds[0], NULL, wsi->desc.sockfd, NULL,
+			   sp->pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (n < 0) {
+			if (LWS_ERRNO == LWS_EAGAIN || LWS_ERRNO == LWS_EINTR)
+				return 0;
+
+			return -1;
+		}
+		if (!n)
+			return -1;
+
+		sp->pending -= (size_t)n;
+		lws_stats_bump(&wsi->context->pt[(int)wsi->tsi],
+			       LWSSTATS_B_WRITE, (uint64_t)n);
+	}
+
+	return 0;
+}
+
+/*
+ * While spliced, we only wait for rx if our peer's pipe is empty, and only for
+ * POLLOUT if our own pipe isn't, so there is only ever one pipe's worth in
+ * flight in each direction and a slow destination backpressures the source.
+ */
+
+static int
+lws_raw_proxy_splice_service(struct lws_context_per_thread *pt,
+			     struct lws *wsi, struct lws_pollfd *pollfd)
+{
+	struct lws_raw_proxy_splice *sp = wsi->splice, *psp;
+	ssize_t n;
+
+	if (pollfd->revents & LWS_POLLOUT) {
+		if (lws_raw_proxy_splice_drain(wsi))
+			return -1;
+
+		if (!sp->pending) {
+			if (!sp->peer)
+				/* he's gone and we sent everything he sent */
+				return -1;
+
+			if (lws_change_pollfd(wsi, LWS_POLLOUT, 0) ||
+			    lws_rx_flow_control(sp->peer,
+					LWS_RXFLOW_REASON_APPLIES_ENABLE |
+					LWS_RXFLOW_REASON_SPLICE |
+					LWS_RXFLOW_REASON_FLAG_PROCESS_NOW))
+				return -1;
+		}
+	}
+
+	if (!(pollfd->revents & pollfd->events & LWS_POLLIN) || !sp->peer)
+		return 0;
+
+	psp = sp->peer->splice;
+	n = splice(wsi->desc.sockfd, NULL, psp->pipe_fds[1], NULL,
+		   LWS_SPLICE_CHUNK, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if (n < 0)
+		return LWS_ERRNO == LWS_EAGAIN || LWS_ERRNO == LWS_EINTR ?
+								0 : -1;
+	if (!n) {
+		lwsl_info("%s: %p: closed\n", __func__, wsi);
+		wsi->seen_zero_length_recv = 1;
+
+		return -1;
+	}
+
+	psp->pending += (size_t)n;
+	lws_stats_bump(pt, LWSSTATS_B_READ, (uint64_t)n);
+
+	/* usually the peer can take it immediately */
+
+	if (lws_raw_proxy_splice_drain(sp->peer) || !psp->pending)
+		return 0;
+
+	if (lws_rx_flow_control(wsi, LWS_RXFLOW_REASON_APPLIES_DISABLE |
+				     LWS_RXFLOW_REASON_SPLICE) ||
+	    lws_change_pollfd(sp->peer, 0, LWS_POLLOUT))
+		return -1;
+
+	return 0;
+}
+
+static int
+rops_close_role_raw_proxy(struct lws_context_per_thread *pt, struct lws *wsi)
+{
+	struct lws_raw_proxy_splice *sp = wsi->splice;
+	struct lws *peer;
+
+	if (!sp)
+		return 0;
+
+	peer = sp->peer;
+	if (peer) {
+		peer->splice->peer = NULL;
+		if (!peer->splice->pending)
+			/* there's nothing more for him to send */
+			lws_set_timeout(peer, PENDING_TIMEOUT_KILLED_BY_PARENT,
+					LWS_TO_KILL_ASYNC);
+		else
+			/*
+			 * He only has our leftovers to send now, there's
+			 * nowhere for his rx to go
+			 */
+			lws_rx_flow_control(peer,
+					    LWS_RXFLOW_REASON_APPLIES_DISABLE |
+					    LWS_RXFLOW_REASON_SPLICE);
+	}
+
+	close(sp->pipe_fds[0]);
+	close(sp->pipe_fds[1]);
+	lws_free_set_NULL(wsi->splice);
+
+	return 0;
+}
+#else
+int
+lws_raw_proxy_splice(struct lws *wsi, struct lws *peer)
+{
+	return 1;
+}
+#endif
+
 static int
 rops_handle_POLLIN_raw_proxy(struct lws_context_per_thread *pt, struct lws *wsi,
 			     struct lws_pollfd *pollfd)
@@ -31,6 +225,15 @@ rops_handle_POLLIN_raw_proxy(struct lws_context_per_thread *pt, struct lws *wsi,
 	struct lws_tokens ebuf;
 	int n, buffered;
 
+#if defined(LWS_HAVE_SPLICE)
+	if (wsi->splice) {
+		if (lws_raw_proxy_splice_service(pt, wsi, pollfd))
+			goto fail;
+
+		return LWS_HPI_RET_HANDLED;
+	}
+#endif
+
 	/* pending truncated sends have uber priority */
 
 	if (lws_has_buffered_out(wsi)) {
@@ -129,9 +332,15 @@ rops_adoption_bind_raw_proxy(struct lws *wsi, int type,
 {
 	/* no http but socket... must be raw skt */
 	if ((type & LWS_ADOPT_HTTP) || !(type & LWS_ADOPT_SOCKET) ||
-	    (!(type & LWS_ADOPT_FLAG_RAW_PROXY)) || (type & _LWS_ADOPT_FINISH))
+	    (type & _LWS_ADOPT_FINISH))
 		return 0; /* no match */
 
+	/* ...and we only want it if asked for, or the vhost binds to us */
+	if (!(type & LWS_ADOPT_FLAG_RAW_PROXY) &&
+	    (!wsi->vhost->listen_accept_role ||
+	     strcmp(wsi->vhost->listen_accept_role, "raw-proxy")))
+		return 0;
+
 #if defined(LWS_WITH_UDP)
 	if (type & LWS_ADOPT_FLAG_UDP)
 		/*
@@ -208,7 +417,11 @@ const struct lws_role_ops role_ops_raw_proxy = {
 	/* encapsulation_parent */	NULL,
 	/* alpn_negotiated */		NULL,
 	/* close_via_role_protocol */	NULL,
+#if defined(LWS_HAVE_SPLICE)
+	/* close_role */		rops_close_role_raw_proxy,
+#else
 	/* close_role */		NULL,
+#endif
 	/* close_kill_connection */	NULL,
 	/* destroy_role */		NULL,
 	/* adoption_bind */		rops_adoption_bind_raw_proxy,
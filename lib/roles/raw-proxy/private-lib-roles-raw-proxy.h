@@ -28,6 +28,18 @@ extern const struct lws_role_ops role_ops_raw_proxy;
 
 #define lwsi_role_raw_proxy(wsi) (wsi->role_ops == &role_ops_raw_proxy)
 
+#if defined(LWS_HAVE_SPLICE)
+/*
+ * A spliced raw proxy connection, see lws_raw_proxy_splice().  Each side
+ * owns the pipe holding what the peer received for it to send.
+ */
+struct lws_raw_proxy_splice {
+	struct lws		*peer;	/* NULL once the peer closed */
+	int			pipe_fds[2];
+	size_t			pending; /* in our pipe, waiting to be sent */
+};
+#endif
+
 #if 0
 struct lws_vhost_role_ws {
 	const struct lws_extension *extensions;
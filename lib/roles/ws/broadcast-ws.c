@@ -0,0 +1,265 @@
+/*
+ * libwebsockets - small server side websockets and web server implementation
+ *
+ * Copyright (C) 2010 - 2020 Andy Green <andy@warmcat.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * A broadcast message is framed once when it is created, and if any recipient
+ * negotiated permessage-deflate in a way that lets it take a message deflated
+ * from a fresh stream, deflated and framed once more the first time such a
+ * recipient is written.  After that, sending it to another connection is just
+ * issuing the prepared bytes, and whatever it can't take at once is queued as
+ * a reference rather than a copy.  Connections that can't use either prepared
+ * frame get it through lws_write_refbuf().
+ */
+
+#include "private-lib-core.h"
+
+struct lws_ws_bcast {
+	struct lws_refbuf	*rb;	/* payload, header in front in LWS_PRE */
+	uint8_t			*frame;	/* plain frame: header + payload */
+	size_t			frame_len;
+#if !defined(LWS_WITHOUT_EXTENSIONS)
+	struct lws_refbuf	*drb;	/* deflated payload, header in front */
+	uint8_t			*dframe; /* deflated frame with RSV1 set */
+	size_t			dframe_len;
+	int			defl_wbits;
+	char			defl_failed;
+#endif
+	unsigned int		refcount;
+	uint8_t			opcode;
+	uint8_t			wp;
+};
+
+/*
+ * Write a server (unmasked), FIN frame header ending just before payload and
+ * return how long it was.  pre must have room for 10 bytes.
+ *
+ * If the plain refbuf is later sent via lws_write() on a server connection,
+ * eg, for a context-takeover deflate peer, or ws-over-h2, the ws header lws
+ * writes in front of the payload is identical to this one, and anything the
+ * role adds goes in front of that.
+ */
+
+static size_t
+lws_ws_bcast_header(uint8_t *payload, size_t len, uint8_t b0)
+{
+	uint8_t *p;
+
+	if (len < 126) {
+		p = payload - 2;
+		p[1] = (uint8_t)len;
+	} else if (len < 65536) {
+		p = payload - 4;
+		p[1] = 126;
+		lws_ser_wu16be(&p[2], (uint16_t)len);
+	} else {
+		p = payload - 10;
+		p[1] = 127;
+		lws_ser_wu64be(&p[2], (uint64_t)len);
+	}
+	p[0] = b0;
+
+	return (size_t)lws_ptr_diff(payload, p);
+}
+
+struct lws_ws_bcast *
+lws_ws_bcast_create(const void *buf, size_t len, enum lws_write_protocol wp)
+{
+	struct lws_ws_bcast *b;
+	uint8_t *payload, opc;
+	size_t hl;
+
+	switch ((int)wp) {
+	case LWS_WRITE_TEXT:
+		opc = LWSWSOPC_TEXT_FRAME;
+		break;
+	case LWS_WRITE_BINARY:
+		opc = LWSWSOPC_BINARY_FRAME;
+		break;
+	default:
+		lwsl_err("%s: only whole TEXT or BINARY messages\n", __func__);
+		return NULL;
+	}
+
+	b = lws_zalloc(sizeof(*b), __func__);
+	if (!b)
+		return NULL;
+
+	b->rb = lws_refbuf_create(buf, len);
+	if (!b->rb) {
+		lws_free(b);
+
+		return NULL;
+	}
+
+	payload = lws_refbuf_payload(b->rb);
+	hl = lws_ws_bcast_header(payload, len, 0x80 | opc);
+
+	b->frame = payload - hl;
+	b->frame_len = hl + len;
+	b->opcode = opc;
+	b->wp = (uint8_t)wp;
+	b->refcount = 1;
+
+	return b;
+}
+
+struct lws_ws_bcast *
+lws_ws_bcast_ref(struct lws_ws_bcast *b)
+{
+	b->refcount++;
+
+	return b;
+}
+
+void
+lws_ws_bcast_unref(struct lws_ws_bcast **pb)
+{
+	struct lws_ws_bcast *b = *pb;
+
+	if (!b)
+		return;
+
+	*pb = NULL;
+	assert(b->refcount);
+	if (--b->refcount)
+		return;
+
+	/* connections still sending from them hold their own references */
+
+	lws_refbuf_unref(&b->rb);
+#if !defined(LWS_WITHOUT_EXTENSIONS)
+	lws_refbuf_unref(&b->drb);
+#endif
+	lws_free(b);
+}
+
+#if !defined(LWS_WITHOUT_EXTENSIONS)
+
+/*
+ * If the only active extension is permessage-deflate and it can take a
+ * message from a fresh stream, return the shared deflated frame, producing it
+ * from this connection's settings if nobody needed it before.  A smaller
+ * window than the peer allows is always acceptable to it.
+ */
+
+static int
+lws_ws_bcast_deflated(struct lws *wsi, struct lws_ws_bcast *b)
+{
+	size_t hl;
+	int wbits;
+
+	if (wsi->ws->count_act_ext != 1 ||
+	    wsi->ws->active_extensions[0]->callback !=
+				lws_extension_callback_pm_deflate ||
+	    lws_pmd_tx_shareable(wsi, wsi->ws->act_ext_user[0], &wbits))
+		return 1;
+
+	if (b->dframe)
+		return wbits < b->defl_wbits;
+
+	if (b->defl_failed)
+		return 1;
+
+	b->drb = lws_pmd_deflate_once(wsi, wsi->ws->act_ext_user[0],
+				      lws_refbuf_payload(b->rb),
+				      lws_refbuf_len(b->rb));
+	if (!b->drb) {
+		b->defl_failed = 1;
+
+		return 1;
+	}
+
+	hl = lws_ws_bcast_header(lws_refbuf_payload(b->drb),
+				 lws_refbuf_len(b->drb),
+				 0x80 | 0x40 | b->opcode);
+	b->dframe = lws_refbuf_payload(b->drb) - hl;
+	b->dframe_len = hl + lws_refbuf_len(b->drb);
+	b->defl_wbits = wbits;
+
+	return 0;
+}
+#endif
+
+int
+lws_ws_bcast_write(struct lws *wsi, struct lws_ws_bcast *b)
+{
+	struct lws_context_per_thread *pt = &wsi->context->pt[(int)wsi->tsi];
+	struct lws_refbuf *rb = b->rb;
+	size_t frame_len = b->frame_len;
+	uint8_t *frame = b->frame;
+	int n;
+
+	if (!lwsi_role_ws(wsi) || !wsi->ws)
+		return -1;
+
+#if !defined(LWS_WITHOUT_EXTENSIONS)
+	if (wsi->ws->tx_draining_ext) {
+		/* user writeable is held off until the tx ext has drained */
+		lwsl_err("%s: tx ext still draining\n", __func__);
+
+		return -1;
+	}
+#endif
+
+	/*
+	 * The prepared frames are for a server on its own connection, with
+	 * nothing of a previous message still to go out ahead of them
+	 */
+
+	if (lwsi_role_client(wsi) || wsi->mux_substream ||
+	    wsi->ws->inside_frame || wsi->ws->stashed_write_pending)
+		goto fallback;
+
+#if !defined(LWS_WITHOUT_EXTENSIONS)
+	if (wsi->ws->count_act_ext) {
+		if (lws_ws_bcast_deflated(wsi, b))
+			goto fallback;
+
+		rb = b->drb;
+		frame = b->dframe;
+		frame_len = b->dframe_len;
+	}
+#endif
+
+	lws_stats_bump(pt, LWSSTATS_C_API_LWS_WRITE, 1);
+	lws_stats_bump(pt, LWSSTATS_B_WRITE, lws_refbuf_len(b->rb));
+#if defined(LWS_WITH_SERVER_STATUS)
+	if (wsi->vhost)
+		wsi->vhost->conn_stats.tx += lws_refbuf_len(b->rb);
+#endif
+
+	/*
+	 * anything the socket doesn't take now is queued on buflist_out as a
+	 * reference on the shared frame
+	 */
+
+	pt->tx_refbuf = rb;
+	n = lws_issue_raw(wsi, frame, frame_len);
+	pt->tx_refbuf = NULL;
+	if (n < 0)
+		return -1;
+
+	return (int)lws_refbuf_len(b->rb);
+
+fallback:
+	return lws_write_refbuf(wsi, b->rb, (enum lws_write_protocol)b->wp);
+}
@@ -547,3 +547,86 @@ lws_extension_callback_pm_deflate(struct lws_context *context,
 	return 0;
 }
 
+
+/*
+ * A message deflated from a fresh stream can be sent on this connection in
+ * place of running it through the connection's own tx stream, if that stream
+ * holds no history the peer's window would have to match afterwards.  That's
+ * the case before the first compressed message, and after every message when
+ * the stream is reset at FIN for no context takeover.
+ *
+ * Returns 0 and the window bits the peer allows us if so, else nonzero.
+ */
+
+int
+lws_pmd_tx_shareable(struct lws *wsi, void *_priv, int *wbits)
+{
+	struct lws_ext_pm_deflate_priv *priv =
+				     (struct lws_ext_pm_deflate_priv *)_priv;
+
+	if (!priv || priv->tx_init || priv->compressed_out)
+		return 1;
+
+	*wbits = priv->args[PMD_SERVER_MAX_WINDOW_BITS +
+			    (wsi->vhost->listen_port <= 0)];
+
+	return 0;
+}
+
+/*
+ * Deflate a whole message from a fresh stream using the connection's
+ * settings, into a new refbuf.  The trailing 00 00 ff ff of the sync flush is
+ * removed as RFC7692 requires.
+ */
+
+struct lws_refbuf *
+lws_pmd_deflate_once(struct lws *wsi, void *_priv, const uint8_t *in,
+		     size_t len)
+{
+	struct lws_ext_pm_deflate_priv *priv =
+				     (struct lws_ext_pm_deflate_priv *)_priv;
+	struct lws_refbuf *rb;
+	uint8_t *out;
+	size_t bound;
+	z_stream z;
+	int wbits;
+
+	if (lws_pmd_tx_shareable(wsi, priv, &wbits))
+		return NULL;
+
+	memset(&z, 0, sizeof(z));
+	if (deflateInit2(&z, priv->args[PMD_COMP_LEVEL], Z_DEFLATED, -wbits,
+			 priv->args[PMD_MEM_LEVEL], Z_DEFAULT_STRATEGY) != Z_OK)
+		return NULL;
+
+	/* the bound is for Z_FINISH, a sync flush may add a couple of blocks */
+	bound = deflateBound(&z, (unsigned long)len) + 16;
+	rb = lws_refbuf_create(NULL, bound);
+	if (!rb)
+		goto bail;
+
+	out = lws_refbuf_payload(rb);
+	z.next_in = (unsigned char *)in;
+	z.avail_in = (unsigned int)len;
+	z.next_out = out;
+	z.avail_out = (unsigned int)bound;
+
+	if (deflate(&z, Z_SYNC_FLUSH) != Z_OK || z.avail_in || !z.avail_out)
+		goto bail1;
+
+	rb->len = bound - z.avail_out;
+	if (rb->len < 4 || memcmp(out + rb->len - 4, trail, 4))
+		goto bail1;
+	rb->len -= 4;
+
+	(void)deflateEnd(&z);
+
+	return rb;
+
+bail1:
+	lws_refbuf_unref(&rb);
+bail:
+	(void)deflateEnd(&z);
+
+	return NULL;
+}
@@ -1346,6 +1346,9 @@ int rops_handle_POLLOUT_ws(struct lws *wsi)
 		lwsl_ext("SERVICING TX EXT DRAINING\n");
 		if (lws_write(wsi, NULL, 0, LWS_WRITE_CONTINUATION) < 0)
 			return LWS_HP_RET_BAIL_DIE;
+		if (!wsi->ws->tx_draining_ext)
+			/* the ext has taken in all of any refbuf payload */
+			lws_refbuf_unref(&wsi->ws->tx_hold);
 		/* leave POLLOUT active */
 		return LWS_HP_RET_BAIL_OK;
 	}
@@ -2004,6 +2007,10 @@ rops_destroy_role_ws(struct lws *wsi)
 #if defined(LWS_WITH_HTTP_PROXY)
 	lws_dll2_foreach_safe(&wsi->ws->proxy_owner, NULL, ws_destroy_proxy_buf);
 #endif
+#if !defined(LWS_WITHOUT_EXTENSIONS)
+	if (wsi->ws)
+		lws_refbuf_unref(&wsi->ws->tx_hold);
+#endif
 
 	lws_free_set_NULL(wsi->ws);
 
@@ -94,6 +94,7 @@ struct _lws_websocket_related {
 	void *act_ext_user[LWS_MAX_EXTENSIONS_ACTIVE];
 	struct lws *rx_draining_ext_list;
 	struct lws *tx_draining_ext_list;
+	struct lws_refbuf *tx_hold; /* tx ext may still be reading from it */
 #endif
 
 #if defined(LWS_WITH_HTTP_PROXY)
@@ -176,6 +177,11 @@ lws_ext_cb_active(struct lws *wsi, int reason, void *buf, int len);
 LWS_EXTERN int
 lws_ext_cb_all_exts(struct lws_context *context, struct lws *wsi, int reason,
 		    void *arg, int len);
+int
+lws_pmd_tx_shareable(struct lws *wsi, void *priv, int *wbits);
+struct lws_refbuf *
+lws_pmd_deflate_once(struct lws *wsi, void *priv, const uint8_t *in,
+		     size_t len);
 #endif
 
 int
@@ -91,6 +91,7 @@ static const char * const lejp_tokens_policy[] = {
 	"s[].*.mqtt_will_message",
 	"s[].*.mqtt_will_qos",
 	"s[].*.mqtt_will_retain",
+	"s[].*.mqtt_publish_window",
 	"s[].*",
 };
 
@@ -154,6 +155,7 @@ typedef enum {
 	LSSPPT_MQTT_WILL_MESSAGE,
 	LSSPPT_MQTT_WILL_QOS,
 	LSSPPT_MQTT_WILL_RETAIN,
+	LSSPPT_MQTT_PUBLISH_WINDOW,
 	LSSPPT_STREAMTYPES
 } policy_token_t;
 
@@ -177,6 +179,7 @@ struct policy_cb_args {
 	struct lejp_ctx jctx;
 	struct lws_context *context;
 	struct lwsac *ac;
+	struct lejp_path_index *pidx;
 
 	const char *socks5_proxy;
 
@@ -188,6 +191,7 @@ struct policy_cb_args {
 	uint8_t *p;
 
 	int count;
+	char compiling; /* for lws_ss_policy_compile(), not to be set */
 };
 
 #define POL_AC_INITIAL	2048
@@ -208,10 +212,129 @@ static const char *protonames[] = {
 	"mqtt",		/* LWSSSP_MQTT */
 };
 
+/*
+ * Streamtype and metadata names are looked up through open-addressed hash
+ * tables built once at the end of policy parsing, so the cost doesn't grow
+ * with the size of the policy.  If they couldn't be built, we fall back to
+ * walking the lists.
+ */
+
+static uint32_t
+lws_ss_policy_name_hash(const char *name)
+{
+	uint32_t h = 0x811c9dc5;
+
+	while (*name)
+		h = (h ^ (uint8_t)*name++) * 0x01000193;
+
+	return h;
+}
+
+/* power of two at least twice count, so probe chains stay short */
+
+static uint32_t
+lws_ss_policy_hash_size(uint32_t count)
+{
+	uint32_t n = 4;
+
+	while (n < count * 2)
+		n <<= 1;
+
+	return n;
+}
+
+static int
+lws_ss_policy_hash_build(struct lws_context *context, struct lwsac **ac,
+			 lws_ss_policy_t *head)
+{
+	lws_ss_policy_t *p = head, *q;
+	lws_ss_metadata_t *pmd, **mi;
+	const lws_ss_policy_t **pt;
+	uint32_t n = 0, size, h;
+	uint8_t *mt;
+
+	context->pss_policy_hash = NULL;
+
+	while (p) {
+		n++;
+
+		if (p->metadata_count) {
+			/* index of the policy's metadata by handle slot */
+
+			mi = lwsac_use_zero(ac, p->metadata_count * sizeof(*mi),
+					    POL_AC_GRAIN);
+			size = lws_ss_policy_hash_size(p->metadata_count);
+			mt = lwsac_use_zero(ac, size, POL_AC_GRAIN);
+			if (!mi || !mt)
+				return 1;
+
+			/*
+			 * The list is newest-first and the linear lookup
+			 * returns the first match, so a later duplicate name
+			 * only goes in the hash if it's not already there
+			 */
+
+			pmd = p->metadata;
+			while (pmd) {
+				mi[pmd->length] = pmd;
+				h = lws_ss_policy_name_hash(pmd->name);
+				while (mt[h & (size - 1)] && strcmp(pmd->name,
+					    mi[mt[h & (size - 1)] - 1]->name))
+					h++;
+				if (!mt[h & (size - 1)])
+					mt[h & (size - 1)] =
+						(uint8_t)(pmd->length + 1);
+				pmd = pmd->next;
+			}
+
+			p->metadata_index = mi;
+			p->metadata_hash = mt;
+			p->metadata_hash_mask = (uint16_t)(size - 1);
+		}
+
+		p = p->next;
+	}
+
+	size = lws_ss_policy_hash_size(n);
+	pt = lwsac_use_zero(ac, size * sizeof(*pt), POL_AC_GRAIN);
+	if (!pt)
+		return 1;
+
+	q = head;
+	while (q) {
+		h = lws_ss_policy_name_hash(q->streamtype);
+		while (pt[h & (size - 1)] &&
+		       strcmp(pt[h & (size - 1)]->streamtype, q->streamtype))
+			h++;
+		if (!pt[h & (size - 1)])
+			pt[h & (size - 1)] = q;
+		q = q->next;
+	}
+
+	context->pss_policy_hash = pt;
+	context->pss_policy_hash_mask = size - 1;
+
+	return 0;
+}
+
 lws_ss_metadata_t *
 lws_ss_policy_metadata(const lws_ss_policy_t *p, const char *name)
 {
 	lws_ss_metadata_t *pmd = p->metadata;
+	uint32_t h;
+
+	if (p->metadata_hash) {
+		h = lws_ss_policy_name_hash(name);
+		while (p->metadata_hash[h & p->metadata_hash_mask]) {
+			pmd = p->metadata_index[
+			       p->metadata_hash[h & p->metadata_hash_mask] - 1];
+			if (!strcmp(name, pmd->name))
+				return pmd;
+			h++;
+		}
+
+		return NULL;
+	}
 
 	while (pmd) {
 		if (pmd->name && !strcmp(name, pmd->name))
@@ -227,6 +350,10 @@ lws_ss_policy_metadata_index(const lws_ss_policy_t *p, size_t index)
 {
 	lws_ss_metadata_t *pmd = p->metadata;
 
+	if (p->metadata_index)
+		return index < p->metadata_count ? p->metadata_index[index] :
+						   NULL;
+
 	while (pmd) {
 		if (pmd->length == index)
 			return pmd;
@@ -503,6 +630,15 @@ lws_ss_policy_parser_cb(struct lejp_ctx *ctx, char reason)
 
 			goto oom;
 		}
+		if (a->compiling) {
+			/*
+			 * Plugins are bound by name when the binary policy is
+			 * loaded, until then keep the name in plugins_info
+			 */
+			pp = (char **)&a->curr[LTY_POLICY].p->plugins_info[
+								a->count++];
+			goto string2;
+		}
 		if (!pin)
 			break;
 		while (*pin) {
@@ -692,6 +828,9 @@ lws_ss_policy_parser_cb(struct lejp_ctx *ctx, char reason)
 		a->curr[LTY_POLICY].p->u.mqtt.will_retain =
 						reason == LEJPCB_VAL_TRUE;
 		break;
+	case LSSPPT_MQTT_PUBLISH_WINDOW:
+		a->curr[LTY_POLICY].p->u.mqtt.publish_window = atoi(ctx->buf);
+		break;
 
 	case LSSPPT_PROTOCOL:
 		a->curr[LTY_POLICY].p->protocol = 0xff;
@@ -770,8 +909,17 @@ lws_ss_policy_parse_begin(struct lws_context *context)
 		return -1;
 	}
 	*p = 0;
-	lejp_construct(&args->jctx, lws_ss_policy_parser_cb, args,
-		       lejp_tokens_policy, LWS_ARRAY_SIZE(lejp_tokens_policy));
+
+	/* the policy has a lot of paths, match them through an index */
+	args->pidx = lejp_path_index_create(lejp_tokens_policy,
+				LWS_ARRAY_SIZE(lejp_tokens_policy), 0);
+	if (args->pidx)
+		lejp_construct_indexed(&args->jctx, lws_ss_policy_parser_cb,
+				       args, args->pidx);
+	else
+		lejp_construct(&args->jctx, lws_ss_policy_parser_cb, args,
+			       lejp_tokens_policy,
+			       LWS_ARRAY_SIZE(lejp_tokens_policy));
 
 	return 0;
 }
@@ -782,6 +930,7 @@ lws_ss_policy_parse_abandon(struct lws_context *context)
 	struct policy_cb_args *args = (struct policy_cb_args *)context->pol_args;
 
 	lejp_destruct(&args->jctx);
+	lejp_path_index_destroy(&args->pidx);
 	lws_free_set_NULL(context->pol_args);
 
 	return 0;
@@ -804,72 +953,74 @@ lws_ss_policy_parse(struct lws_context *context, const uint8_t *buf, size_t len)
 	return m;
 }
 
-int
-lws_ss_policy_set(struct lws_context *context, const char *name)
+/*
+ * Retire the policy in force, if any, so that another can replace it
+ */
+
+static void
+lws_ss_policy_retire(struct lws_context *context)
 {
-	struct policy_cb_args *args = (struct policy_cb_args *)context->pol_args;
-	lws_ss_trust_store_t *ts;
 	struct lws_vhost *v;
-	lws_ss_x509_t *x;
-	char buf[16];
-	int m, ret = 0;
+
+	if (!context->ac_policy && !context->pol_bin)
+		return;
 
 	/*
-	 * Parsing seems to have succeeded, and we're going to use the new
-	 * policy that's laid out in args->ac
+	 * So this is a bit fun-filled, we already had a policy in
+	 * force, perhaps it was the default policy that's just good for
+	 * fetching the real policy, and we're doing that now.
+	 *
+	 * We can destroy all the policy-related direct allocations
+	 * easily because they're cleanly in a single lwsac, or the binary
+	 * policy blob...
 	 */
+	lwsac_free(&context->ac_policy);
+	lws_ss_policy_bin_free(context);
+	context->pss_policy_hash = NULL;
 
-	lejp_destruct(&args->jctx);
-
-	if (context->ac_policy) {
-
-		/*
-		 * So this is a bit fun-filled, we already had a policy in
-		 * force, perhaps it was the default policy that's just good for
-		 * fetching the real policy, and we're doing that now.
-		 *
-		 * We can destroy all the policy-related direct allocations
-		 * easily because they're cleanly in a single lwsac...
-		 */
-		lwsac_free(&context->ac_policy);
-
-		/*
-		 * ...but when we did the trust stores, we created vhosts for
-		 * each.  We need to destroy those now too, and recreate new
-		 * ones from the new policy, perhaps with different X.509s.
-		 */
+	/*
+	 * ...but when we did the trust stores, we created vhosts for
+	 * each.  We need to destroy those now too, and recreate new
+	 * ones from the new policy, perhaps with different X.509s.
+	 */
 
-		v = context->vhost_list;
-		while (v) {
-			if (v->from_ss_policy) {
-				struct lws_vhost *vh = v->vhost_next;
-				lwsl_debug("%s: destroying vh %p\n", __func__, v);
-				lws_vhost_destroy(v);
-				v = vh;
-				continue;
-			}
-			v = v->vhost_next;
+	v = context->vhost_list;
+	while (v) {
+		if (v->from_ss_policy) {
+			struct lws_vhost *vh = v->vhost_next;
+			lwsl_debug("%s: destroying vh %p\n", __func__, v);
+			lws_vhost_destroy(v);
+			v = vh;
+			continue;
 		}
-
-		lws_check_deferred_free(context, 0, 1);
+		v = v->vhost_next;
 	}
 
-	context->pss_policies = args->heads[LTY_POLICY].p;
-	context->ac_policy = args->ac;
+	lws_check_deferred_free(context, 0, 1);
+}
 
-	lws_humanize(buf, sizeof(buf), lwsac_total_alloc(args->ac),
-			humanize_schema_si_bytes);
-	if (lwsac_total_alloc(args->ac))
-		m = (int)((lwsac_total_overhead(args->ac) * 100) /
-				lwsac_total_alloc(args->ac));
-	else
-		m = 0;
+/*
+ * Bring a parsed or loaded policy into force, the allocations in *ac become
+ * owned by the context
+ */
 
-	lwsl_notice("%s: %s, pad %d%c: %s\n", __func__, buf, m, '%', name);
+static int
+lws_ss_policy_install(struct lws_context *context, struct lwsac **ac,
+		      lws_ss_policy_t *policies,
+		      const lws_ss_trust_store_t *ts, const char *socks5_proxy)
+{
+	struct lws_vhost *v;
+	int ret = 0;
+
+	if (lws_ss_policy_hash_build(context, ac, policies))
+		/* not fatal, lookups will walk the lists instead */
+		lwsl_warn("%s: OOM building policy hashes\n", __func__);
+
+	context->pss_policies = policies;
+	context->ac_policy = *ac;
 
 	/* Create vhosts for each type of trust store */
 
-	ts = args->heads[LTY_TRUSTSTORE].t;
 	while (ts) {
 		struct lws_context_creation_info i;
 
@@ -929,17 +1080,53 @@ lws_ss_policy_set(struct lws_context *context, const char *name)
 
 	v = context->vhost_list;
 	while (v) {
-		lws_set_socks(v, args->socks5_proxy);
+		lws_set_socks(v, socks5_proxy);
 		v = v->vhost_next;
 	}
 	if (context->vhost_system)
-		lws_set_socks(context->vhost_system, args->socks5_proxy);
+		lws_set_socks(context->vhost_system, socks5_proxy);
 
-	if (args->socks5_proxy)
+	if (socks5_proxy)
 		lwsl_notice("%s: global socks5 proxy: %s\n", __func__,
-			    args->socks5_proxy);
+			    socks5_proxy);
 #endif
 
+	return ret;
+}
+
+int
+lws_ss_policy_set(struct lws_context *context, const char *name)
+{
+	struct policy_cb_args *args = (struct policy_cb_args *)context->pol_args;
+	lws_ss_x509_t *x;
+	char buf[16];
+	int m, ret;
+
+	/*
+	 * Parsing seems to have succeeded, and we're going to use the new
+	 * policy that's laid out in args->ac
+	 */
+
+	lejp_destruct(&args->jctx);
+	lejp_path_index_destroy(&args->pidx);
+
+	lws_ss_policy_retire(context);
+
+	lws_humanize(buf, sizeof(buf), lwsac_total_alloc(args->ac),
+			humanize_schema_si_bytes);
+	if (lwsac_total_alloc(args->ac))
+		m = (int)((lwsac_total_overhead(args->ac) * 100) /
+				lwsac_total_alloc(args->ac));
+	else
+		m = 0;
+
+	lwsl_notice("%s: %s, pad %d%c: %s\n", __func__, buf, m, '%', name);
+
+	ret = lws_ss_policy_install(context, &args->ac,
+				    args->heads[LTY_POLICY].p,
+				    args->heads[LTY_TRUSTSTORE].t,
+				    args->socks5_proxy);
+
 	/* now we processed the x.509 CAs, we can free all of our originals */
 
 	x = args->heads[LTY_X509].x;
@@ -960,14 +1147,698 @@ lws_ss_policy_set(struct lws_context *context, const char *name)
 	return ret;
 }
 
+/*
+ * Binary policy
+ *
+ * lws_ss_policy_compile() lays the parsed policy objects out in one blob in
+ * their native struct layout, with every pointer member holding an offset
+ * from the start of the blob instead, or 0 for NULL.  The blob ends with a
+ * table of where those pointer members are, so the loader only has to add
+ * the address it mapped the blob at to each one to use the objects in place.
+ *
+ * Since the layout is that of the writer's build, the header carries a hash
+ * of the lws version, byte order and struct sizes and the blob is only used
+ * if it matches ours and its checksum is good.
+ */
+
+#define LWS_SS_POLICY_BIN_VERSION	1
+#define PBW_ALIGN			8
+
+typedef struct lws_ss_policy_bin_hdr {
+	char			magic[4];	/* "LWSP" */
+	uint32_t		abi;		/* lws_ss_policy_bin_abi() */
+	uint32_t		len;		/* whole blob, including hdr */
+	uint32_t		csum;		/* fnv-1a of all after hdr */
+	uint32_t		policies;	/* first lws_ss_policy_t */
+	uint32_t		trust_stores;	/* first lws_ss_trust_store_t */
+	uint32_t		socks5_proxy;	/* global socks5 proxy string */
+	uint32_t		relocs;		/* uint32_t pointer offsets */
+	uint32_t		count_relocs;
+	uint32_t		plugins;	/* uint32_t slot, name pairs */
+	uint32_t		count_plugins;
+} lws_ss_policy_bin_hdr_t;
+
+static uint32_t
+lws_ss_policy_fnv(uint32_t h, const void *p, size_t len)
+{
+	const uint8_t *b = (const uint8_t *)p;
+
+	while (len--)
+		h = (h ^ *b++) * 0x01000193;
+
+	return h;
+}
+
+static uint32_t
+lws_ss_policy_bin_abi(void)
+{
+	const uint32_t sz[] = {
+		LWS_SS_POLICY_BIN_VERSION,
+		1, /* the hash sees the byte order of this */
+		sizeof(void *),
+		sizeof(lws_ss_policy_t),
+		sizeof(lws_ss_metadata_t),
+		sizeof(lws_ss_trust_store_t),
+		sizeof(lws_ss_x509_t),
+		sizeof(lws_retry_bo_t),
+	};
+
+	return lws_ss_policy_fnv(lws_ss_policy_name_hash(LWS_LIBRARY_VERSION),
+				 sz, sizeof(sz));
+}
+
+typedef struct lws_ss_pbw_map {
+	const void		*orig;
+	uint32_t		ofs;
+} lws_ss_pbw_map_t;
+
+struct lws_ss_pbw {
+	uint8_t			*buf;
+	uint32_t		*relocs;
+	uint32_t		*plugins;
+	lws_ss_pbw_map_t	*map;
+
+	size_t			len;
+	size_t			alloc;
+	size_t			count_relocs;
+	size_t			alloc_relocs;
+	size_t			count_plugins;
+	size_t			alloc_plugins;
+	size_t			count_map;
+	size_t			alloc_map;
+
+	char			oom;
+};
+
+static int
+pbw_grow(struct lws_ss_pbw *w, void **p, size_t *alloc, size_t need,
+	 size_t esize)
+{
+	size_t n = *alloc ? *alloc : 64;
+	void *np;
+
+	if (w->oom)
+		return 1;
+	if (need <= *alloc)
+		return 0;
+
+	while (n < need)
+		n <<= 1;
+
+	np = lws_realloc(*p, n * esize, __func__);
+	if (!np) {
+		w->oom = 1;
+		return 1;
+	}
+
+	*p = np;
+	*alloc = n;
+
+	return 0;
+}
+
+/* returns the offset of a zeroed allocation in the blob, 0 means OOM */
+
+static uint32_t
+pbw_alloc(struct lws_ss_pbw *w, size_t size, size_t align)
+{
+	size_t o = (w->len + align - 1) & ~(align - 1);
+
+	if (o + size > 0x7fffffff ||
+	    pbw_grow(w, (void **)&w->buf, &w->alloc, o + size, 1))
+		return 0;
+
+	memset(w->buf + w->len, 0, o + size - w->len);
+	w->len = o + size;
+
+	return (uint32_t)o;
+}
+
+/* set the pointer member at slot to point to target, 0 is NULL */
+
+static void
+pbw_ptr(struct lws_ss_pbw *w, uint32_t slot, uint32_t target)
+{
+	if (w->oom)
+		return;
+
+	*(uintptr_t *)(w->buf + slot) = target;
+
+	if (!target || pbw_grow(w, (void **)&w->relocs, &w->alloc_relocs,
+				w->count_relocs + 1, sizeof(uint32_t)))
+		return;
+
+	w->relocs[w->count_relocs++] = slot;
+}
+
+/* objects already in the blob are found by their original address */
+
+static uint32_t
+pbw_find(struct lws_ss_pbw *w, const void *orig)
+{
+	size_t n;
+
+	for (n = 0; n < w->count_map; n++)
+		if (w->map[n].orig == orig)
+			return w->map[n].ofs;
+
+	return 0;
+}
+
+static void
+pbw_map(struct lws_ss_pbw *w, const void *orig, uint32_t ofs)
+{
+	if (pbw_grow(w, (void **)&w->map, &w->alloc_map, w->count_map + 1,
+		     sizeof(*w->map)))
+		return;
+
+	w->map[w->count_map].orig = orig;
+	w->map[w->count_map++].ofs = ofs;
+}
+
+static uint32_t
+pbw_blob(struct lws_ss_pbw *w, const void *src, size_t len, size_t align,
+	 int nul)
+{
+	uint32_t o;
+
+	if (!src)
+		return 0;
+
+	o = pbw_find(w, src);
+	if (o)
+		return o;
+
+	o = pbw_alloc(w, len + !!nul, align);
+	if (!o)
+		return 0;
+
+	memcpy(w->buf + o, src, len);
+	pbw_map(w, src, o);
+
+	return o;
+}
+
+/*
+ * Strings the parser folded together are the same string in the blob too,
+ * since we find them by address
+ */
+
+#define pbw_str(_w, _s) pbw_blob(_w, _s, _s ? strlen(_s) : 0, 1, 1)
+#define PBW_STR(_w, _o, _type, _m, _s) \
+	pbw_ptr(_w, (uint32_t)((_o) + offsetof(_type, _m)), pbw_str(_w, _s))
+#define PBW_PTR(_w, _o, _type, _m, _t) \
+	pbw_ptr(_w, (uint32_t)((_o) + offsetof(_type, _m)), _t)
+
+static uint32_t
+pbw_object(struct lws_ss_pbw *w, const void *src, size_t size)
+{
+	uint32_t o = pbw_alloc(w, size, PBW_ALIGN);
+
+	if (o) {
+		memcpy(w->buf + o, src, size);
+		pbw_map(w, src, o);
+	}
+
+	return o;
+}
+
+static uint32_t
+pbw_retry(struct lws_ss_pbw *w, const lws_retry_bo_t *r)
+{
+	uint32_t o;
+
+	if (!r)
+		return 0;
+
+	o = pbw_find(w, r);
+	if (o)
+		return o;
+
+	o = pbw_object(w, r, sizeof(*r));
+	if (o)
+		PBW_PTR(w, o, lws_retry_bo_t, retry_ms_table,
+			pbw_blob(w, r->retry_ms_table,
+				 r->retry_ms_table_count * sizeof(uint32_t),
+				 sizeof(uint32_t), 0));
+
+	return o;
+}
+
+static uint32_t
+pbw_x509(struct lws_ss_pbw *w, const lws_ss_x509_t *x)
+{
+	uint32_t o;
+
+	if (!x)
+		return 0;
+
+	o = pbw_find(w, x);
+	if (o)
+		return o;
+
+	o = pbw_object(w, x, sizeof(*x));
+	if (!o)
+		return 0;
+
+	/* the x509 list isn't needed, trust stores point to their certs */
+	PBW_PTR(w, o, lws_ss_x509_t, next, 0);
+	PBW_STR(w, o, lws_ss_x509_t, vhost_name, x->vhost_name);
+	PBW_PTR(w, o, lws_ss_x509_t, ca_der,
+		pbw_blob(w, x->ca_der, x->ca_der_len, 1, 0));
+
+	return o;
+}
+
+static uint32_t
+pbw_trust_store(struct lws_ss_pbw *w, const lws_ss_trust_store_t *ts)
+{
+	uint32_t o = pbw_object(w, ts, sizeof(*ts));
+	size_t n;
+
+	if (!o)
+		return 0;
+
+	PBW_PTR(w, o, lws_ss_trust_store_t, next, 0);
+	PBW_STR(w, o, lws_ss_trust_store_t, name, ts->name);
+	for (n = 0; n < LWS_ARRAY_SIZE(ts->ssx509); n++)
+		PBW_PTR(w, o, lws_ss_trust_store_t, ssx509[n],
+			pbw_x509(w, ts->ssx509[n]));
+
+	return o;
+}
+
+static uint32_t
+pbw_policy(struct lws_ss_pbw *w, const lws_ss_policy_t *p)
+{
+	const lws_ss_metadata_t *pmd;
+	uint32_t o, m, prev = 0;
+	size_t n;
+
+	o = pbw_object(w, p, sizeof(*p));
+	if (!o)
+		return 0;
+
+	PBW_PTR(w, o, lws_ss_policy_t, next, 0);
+	PBW_STR(w, o, lws_ss_policy_t, streamtype, p->streamtype);
+	PBW_STR(w, o, lws_ss_policy_t, endpoint, p->endpoint);
+	PBW_STR(w, o, lws_ss_policy_t, rideshare_streamtype,
+		p->rideshare_streamtype);
+	PBW_STR(w, o, lws_ss_policy_t, payload_fmt, p->payload_fmt);
+	PBW_STR(w, o, lws_ss_policy_t, socks5_proxy, p->socks5_proxy);
+
+	/* which pointers the union holds depends on the protocol */
+
+	if (p->protocol == LWSSSP_MQTT) {
+		PBW_STR(w, o, lws_ss_policy_t, u.mqtt.topic, p->u.mqtt.topic);
+		PBW_STR(w, o, lws_ss_policy_t, u.mqtt.subscribe,
+			p->u.mqtt.subscribe);
+		PBW_STR(w, o, lws_ss_policy_t, u.mqtt.will_topic,
+			p->u.mqtt.will_topic);
+		PBW_STR(w, o, lws_ss_policy_t, u.mqtt.will_message,
+			p->u.mqtt.will_message);
+	} else {
+		PBW_STR(w, o, lws_ss_policy_t, u.http.method,
+			p->u.http.method);
+		PBW_STR(w, o, lws_ss_policy_t, u.http.url, p->u.http.url);
+		PBW_STR(w, o, lws_ss_policy_t, u.http.multipart_name,
+			p->u.http.multipart_name);
+		PBW_STR(w, o, lws_ss_policy_t, u.http.multipart_filename,
+			p->u.http.multipart_filename);
+		PBW_STR(w, o, lws_ss_policy_t, u.http.multipart_content_type,
+			p->u.http.multipart_content_type);
+		for (n = 0; n < LWS_ARRAY_SIZE(p->u.http.blob_header); n++)
+			PBW_STR(w, o, lws_ss_policy_t, u.http.blob_header[n],
+				p->u.http.blob_header[n]);
+		PBW_STR(w, o, lws_ss_policy_t, u.http.auth_preamble,
+			p->u.http.auth_preamble);
+		PBW_STR(w, o, lws_ss_policy_t, u.http.u.ws.subprotocol,
+			p->u.http.u.ws.subprotocol);
+	}
+
+	/* the compiling parser left the plugin names in plugins_info */
+
+	for (n = 0; n < LWS_ARRAY_SIZE(p->plugins); n++) {
+		PBW_PTR(w, o, lws_ss_policy_t, plugins[n], 0);
+		PBW_PTR(w, o, lws_ss_policy_t, plugins_info[n], 0);
+		if (!p->plugins_info[n] ||
+		    pbw_grow(w, (void **)&w->plugins, &w->alloc_plugins,
+			     w->count_plugins + 2, sizeof(uint32_t)))
+			continue;
+		w->plugins[w->count_plugins++] =
+			(uint32_t)(o + offsetof(lws_ss_policy_t, plugins[n]));
+		w->plugins[w->count_plugins++] =
+			pbw_str(w, (const char *)p->plugins_info[n]);
+	}
+
+	PBW_PTR(w, o, lws_ss_policy_t, trust_store,
+		pbw_find(w, p->trust_store));
+	PBW_PTR(w, o, lws_ss_policy_t, retry_bo, pbw_retry(w, p->retry_bo));
+
+	/* the loader makes these again, they're allocated separately */
+	PBW_PTR(w, o, lws_ss_policy_t, metadata_index, 0);
+	PBW_PTR(w, o, lws_ss_policy_t, metadata_hash, 0);
+
+	PBW_PTR(w, o, lws_ss_policy_t, metadata, 0);
+	pmd = p->metadata;
+	while (pmd) {
+		m = pbw_object(w, pmd, sizeof(*pmd));
+		if (!m)
+			return 0;
+		PBW_PTR(w, m, lws_ss_metadata_t, next, 0);
+		PBW_STR(w, m, lws_ss_metadata_t, name, pmd->name);
+		PBW_STR(w, m, lws_ss_metadata_t, value,
+			(const char *)pmd->value);
+		if (prev)
+			PBW_PTR(w, prev, lws_ss_metadata_t, next, m);
+		else
+			PBW_PTR(w, o, lws_ss_policy_t, metadata, m);
+		prev = m;
+		pmd = pmd->next;
+	}
+
+	return o;
+}
+
+static int
+lws_ss_policy_compile_args(struct policy_cb_args *a, const char *path)
+{
+	const lws_ss_trust_store_t *ts = a->heads[LTY_TRUSTSTORE].t;
+	const lws_ss_policy_t *p = a->heads[LTY_POLICY].p;
+	uint32_t o, prev = 0, first_ts = 0, first = 0, socks5, rel, plu;
+	lws_ss_policy_bin_hdr_t *hdr;
+	struct lws_ss_pbw w;
+	int ret = 1;
+
+	memset(&w, 0, sizeof(w));
+
+	/* the header is at offset 0, so no object can have offset 0 */
+
+	pbw_alloc(&w, sizeof(*hdr), PBW_ALIGN);
+
+	/* trust stores come first, so policies can find them */
+
+	while (ts) {
+		o = pbw_trust_store(&w, ts);
+		if (prev)
+			PBW_PTR(&w, prev, lws_ss_trust_store_t, next, o);
+		else
+			first_ts = o;
+		prev = o;
+		ts = ts->next;
+	}
+
+	prev = 0;
+	while (p) {
+		o = pbw_policy(&w, p);
+		if (prev)
+			PBW_PTR(&w, prev, lws_ss_policy_t, next, o);
+		else
+			first = o;
+		prev = o;
+		p = p->next;
+	}
+
+	socks5 = pbw_str(&w, a->socks5_proxy);
+
+	rel = pbw_alloc(&w, w.count_relocs * sizeof(uint32_t),
+			sizeof(uint32_t));
+	plu = pbw_alloc(&w, w.count_plugins * sizeof(uint32_t),
+			sizeof(uint32_t));
+	if (w.oom)
+		goto bail;
+
+	memcpy(w.buf + rel, w.relocs, w.count_relocs * sizeof(uint32_t));
+	memcpy(w.buf + plu, w.plugins, w.count_plugins * sizeof(uint32_t));
+
+	hdr = (lws_ss_policy_bin_hdr_t *)w.buf;
+	memcpy(hdr->magic, "LWSP", 4);
+	hdr->abi		= lws_ss_policy_bin_abi();
+	hdr->len		= (uint32_t)w.len;
+	hdr->policies		= first;
+	hdr->trust_stores	= first_ts;
+	hdr->socks5_proxy	= socks5;
+	hdr->relocs		= rel;
+	hdr->count_relocs	= (uint32_t)w.count_relocs;
+	hdr->plugins		= plu;
+	hdr->count_plugins	= (uint32_t)w.count_plugins / 2;
+	hdr->csum		= lws_ss_policy_fnv(0x811c9dc5, hdr + 1,
+						w.len - sizeof(*hdr));
+
+	ret = lws_plat_write_file(path, w.buf, (int)w.len);
+	if (ret)
+		lwsl_err("%s: unable to write %s\n", __func__, path);
+	else
+		lwsl_notice("%s: %s: %u bytes, %u relocations\n", __func__,
+			    path, hdr->len, hdr->count_relocs);
+
+bail:
+	if (w.oom)
+		lwsl_err("%s: OOM\n", __func__);
+
+	lws_free(w.buf);
+	lws_free(w.relocs);
+	lws_free(w.plugins);
+	lws_free(w.map);
+
+	return ret;
+}
+
+int
+lws_ss_policy_compile(struct lws_context *context, const char *json,
+		      size_t len, const char *path)
+{
+	struct policy_cb_args *args;
+	lws_ss_x509_t *x;
+	int n;
+
+	if (lws_ss_policy_parse_begin(context))
+		return 1;
+
+	args = (struct policy_cb_args *)context->pol_args;
+	args->compiling = 1;
+
+	n = lws_ss_policy_parse(context, (const uint8_t *)json, len);
+	if (n != LEJP_CONTINUE && n < 0)
+		/* the failed parse already abandoned args */
+		return 1;
+
+	n = lws_ss_policy_compile_args(args, path);
+
+	x = args->heads[LTY_X509].x;
+	while (x) {
+		lws_free((void *)x->ca_der);
+		x = x->next;
+	}
+	lwsac_free(&args->ac);
+	lws_ss_policy_parse_abandon(context);
+
+	return n;
+}
+
+/*
+ * Check the blob is ours and intact, then turn its offsets into pointers and
+ * bind its plugins by name
+ */
+
+static int
+lws_ss_policy_bin_relocate(struct lws_context *context, uint8_t *blob,
+			   size_t len)
+{
+	lws_ss_policy_bin_hdr_t *hdr = (lws_ss_policy_bin_hdr_t *)blob;
+	const lws_ss_plugin_t **pin;
+	const uint32_t *t;
+	uintptr_t *slot;
+	const char *pn;
+	uint32_t n;
+
+	if (len < sizeof(*hdr) || memcmp(hdr->magic, "LWSP", 4)) {
+		lwsl_warn("%s: not a binary policy\n", __func__);
+		return 1;
+	}
+
+	if (hdr->abi != lws_ss_policy_bin_abi()) {
+		lwsl_warn("%s: binary policy is from a different lws build\n",
+			  __func__);
+		return 1;
+	}
+
+	if (hdr->len != len || hdr->csum != lws_ss_policy_fnv(0x811c9dc5,
+					hdr + 1, len - sizeof(*hdr))) {
+		lwsl_warn("%s: binary policy is damaged\n", __func__);
+		return 1;
+	}
+
+	if (hdr->relocs + ((size_t)hdr->count_relocs * 4) > len ||
+	    hdr->plugins + ((size_t)hdr->count_plugins * 8) > len ||
+	    hdr->policies >= len || hdr->trust_stores >= len ||
+	    hdr->socks5_proxy >= len)
+		return 1;
+
+	t = (const uint32_t *)(blob + hdr->relocs);
+	for (n = 0; n < hdr->count_relocs; n++) {
+		if (t[n] > len - sizeof(*slot) || (t[n] & (sizeof(*slot) - 1)))
+			return 1;
+		slot = (uintptr_t *)(blob + t[n]);
+		if (*slot >= len)
+			return 1;
+		*slot += (uintptr_t)blob;
+	}
+
+	t = (const uint32_t *)(blob + hdr->plugins);
+	for (n = 0; n < hdr->count_plugins; n++, t += 2) {
+		if (t[0] > len - sizeof(*slot) ||
+		    (t[0] & (sizeof(*slot) - 1)) || t[1] >= len)
+			return 1;
+		pn = (const char *)blob + t[1];
+
+		/* like the JSON parser, no plugins means ignore them */
+
+		pin = context->pss_plugins;
+		if (!pin)
+			continue;
+		while (*pin && strcmp((*pin)->name, pn))
+			pin++;
+		if (!*pin) {
+			lwsl_err("%s: unknown plugin %s\n", __func__, pn);
+			return 1;
+		}
+		*(const lws_ss_plugin_t **)(blob + t[0]) = *pin;
+	}
+
+	return 0;
+}
+
+void
+lws_ss_policy_bin_free(struct lws_context *context)
+{
+	if (!context->pol_bin)
+		return;
+
+#if defined(LWS_PLAT_UNIX)
+	if (context->pol_bin_mapped)
+		munmap(context->pol_bin, context->pol_bin_len);
+	else
+#endif
+		lws_free(context->pol_bin);
+
+	context->pol_bin = NULL;
+	context->pol_bin_len = 0;
+	context->pol_bin_mapped = 0;
+}
+
+int
+lws_ss_policy_bin_load(struct lws_context *context, const char *path)
+{
+	lws_ss_policy_bin_hdr_t *hdr;
+	struct lwsac *ac = NULL;
+	uint8_t *blob = NULL;
+	size_t len = 0;
+	char mapped = 0;
+	int ret;
+
+#if defined(LWS_PLAT_UNIX)
+	{
+		struct stat s;
+		int fd = lws_open(path, O_RDONLY);
+
+		if (fd < 0) {
+			lwsl_notice("%s: no binary policy at %s\n", __func__,
+				    path);
+			return 1;
+		}
+
+		/*
+		 * A private writable mapping, the pages we relocate become
+		 * ours and the rest are shared with the page cache
+		 */
+
+		if (!fstat(fd, &s) && s.st_size >= (off_t)sizeof(*hdr)) {
+			len = (size_t)s.st_size;
+			blob = mmap(NULL, len, PROT_READ | PROT_WRITE,
+				    MAP_PRIVATE, fd, 0);
+			if (blob == MAP_FAILED)
+				blob = NULL;
+			mapped = 1;
+		}
+		close(fd);
+	}
+#else
+	lws_ss_policy_bin_hdr_t h;
+
+	/* learn the length from the header, then read it all */
+
+	if (lws_plat_read_file(path, &h, sizeof(h)) == (int)sizeof(h) &&
+	    h.len >= sizeof(h)) {
+		len = h.len;
+		blob = lws_malloc(len, __func__);
+		if (blob && lws_plat_read_file(path, blob, (int)len) !=
+								(int)len) {
+			lws_free(blob);
+			blob = NULL;
+		}
+	}
+#endif
+
+	if (!blob) {
+		lwsl_warn("%s: unable to load %s\n", __func__, path);
+		return 1;
+	}
+
+	if (lws_ss_policy_bin_relocate(context, blob, len)) {
+		lwsl_warn("%s: rejecting %s\n", __func__, path);
+#if defined(LWS_PLAT_UNIX)
+		if (mapped)
+			munmap(blob, len);
+		else
+#endif
+			lws_free(blob);
+
+		return 1;
+	}
+
+	lws_ss_policy_retire(context);
+
+	context->pol_bin = blob;
+	context->pol_bin_len = len;
+	context->pol_bin_mapped = (uint8_t)mapped;
+
+	hdr = (lws_ss_policy_bin_hdr_t *)blob;
+
+	ret = lws_ss_policy_install(context, &ac,
+		hdr->policies ? (lws_ss_policy_t *)(blob + hdr->policies) :
+									NULL,
+		hdr->trust_stores ? (lws_ss_trust_store_t *)
+					(blob + hdr->trust_stores) : NULL,
+		hdr->socks5_proxy ? (const char *)blob + hdr->socks5_proxy :
+									NULL);
+
+	lwsl_notice("%s: %u bytes: %s\n", __func__, (unsigned int)len, path);
+
+	return ret;
+}
+
 const lws_ss_policy_t *
 lws_ss_policy_lookup(const struct lws_context *context, const char *streamtype)
 {
 	const lws_ss_policy_t *p = context->pss_policies;
+	uint32_t h;
 
 	if (!streamtype)
 		return NULL;
 
+	if (context->pss_policy_hash) {
+		h = lws_ss_policy_name_hash(streamtype);
+		while ((p = context->pss_policy_hash[
+					h & context->pss_policy_hash_mask])) {
+			if (!strcmp(p->streamtype, streamtype))
+				return p;
+			h++;
+		}
+
+		return NULL;
+	}
+
 	while (p) {
 		if (!strcmp(p->streamtype, streamtype))
 			return p;
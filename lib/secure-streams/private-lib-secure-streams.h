@@ -177,6 +177,7 @@ struct lws_ss_serialization_parser {
 
 	int32_t			txcr_out;
 	int32_t			txcr_in;
+	uint32_t		shm_size;
 	uint16_t		rem;
 
 	uint8_t			type;
@@ -184,8 +185,101 @@ struct lws_ss_serialization_parser {
 	uint8_t			slen;
 	uint8_t			rsl_pos;
 	uint8_t			rsl_idx;
+	uint8_t			shm_req;   /* proxy: client sent SHM_REQ */
+	uint8_t			shm_offer; /* client: proxy sent SHM_OFFER */
 };
 
+/*
+ * Several serialized frames may be coalesced into one write on the proxy
+ * connection, these count how well that is working on each side
+ */
+
+typedef struct lws_ss_ser_stats {
+	uint32_t		writes;	   /* writes carrying frames */
+	uint32_t		msgs;	   /* frames carried by those writes */
+	uint16_t		max_batch; /* most frames seen in one write */
+} lws_ss_ser_stats_t;
+
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+
+/*
+ * Optional shared memory rings between a proxy client stream and the proxy,
+ * see secure-streams-shm.c.  The ring header keeps the producer and consumer
+ * indexes on separate cachelines.
+ *
+ * Frames only go in the ring whole, so the smallest ring must be able to hold
+ * the biggest frame the 16-bit length allows, 3 + 0xffff bytes.
+ */
+
+#define LWS_SS_SHM_PAD		0
+#define LWS_SS_SHM_FRAME_MAX	(3 + 0xffff)
+#define LWS_SS_SHM_RING_MIN	(128 * 1024)
+#define LWS_SS_SHM_RING_MAX	(16 * 1024 * 1024)
+
+typedef struct lws_ss_shm_ring {
+	uint32_t		head;	/* free-running, set by producer */
+	uint32_t		consumer_idle; /* consumer wants a doorbell */
+	uint8_t			pad1[56];
+	uint32_t		tail;	/* free-running, set by consumer */
+	uint32_t		producer_blocked; /* producer wants a doorbell */
+	uint8_t			pad2[56];
+} lws_ss_shm_ring_t;
+
+typedef struct lws_ss_shm {
+	uint8_t			*map;
+	size_t			map_len;
+
+	lws_ss_shm_ring_t	*tx;	/* the ring we produce into */
+	lws_ss_shm_ring_t	*rx;	/* the ring we consume from */
+	uint8_t			*tx_data;
+	uint8_t			*rx_data;
+
+	struct lws		*wsi_efd; /* adopted eventfd the peer wakes us on */
+	int			efd_peer; /* eventfd we wake the peer with */
+
+	uint32_t		size;	 /* of each ring, power of 2 */
+	uint32_t		tx_head; /* our copy of tx->head */
+	uint32_t		rx_tail; /* our copy of rx->tail */
+} lws_ss_shm_t;
+
+typedef int (*lws_ss_shm_frame_cb)(void *opaque, const uint8_t *frame,
+				   size_t len);
+
+int
+lws_ss_shm_create(uint32_t *size, int *fds);
+
+int
+lws_ss_shm_attach(lws_ss_shm_t *shm, struct lws *parent, void *opaque,
+		  uint32_t size, const int *fds, int client);
+
+void
+lws_ss_shm_detach(lws_ss_shm_t *shm);
+
+uint8_t *
+lws_ss_shm_tx_reserve(lws_ss_shm_t *shm, size_t need, size_t *avail);
+
+void
+lws_ss_shm_tx_commit(lws_ss_shm_t *shm, size_t len);
+
+int
+lws_ss_shm_tx(lws_ss_shm_t *shm, const uint8_t *pre, size_t prelen,
+	      const uint8_t *buf, size_t len);
+
+void
+lws_ss_shm_doorbell_ack(lws_ss_shm_t *shm);
+
+int
+lws_ss_shm_rx(lws_ss_shm_t *shm, lws_ss_shm_frame_cb cb, void *opaque);
+
+int
+lws_ss_shm_send_fds(int sockfd, const uint8_t *buf, size_t len, const int *fds,
+		    int nfds);
+
+ssize_t
+lws_ss_shm_recv_fds(int sockfd, uint8_t *buf, size_t len, int *fds, int *nfds);
+
+#endif
+
 /*
  * Unlike locally-fulfilled SS, SSS doesn't have to hold metadata on client side
  * but pass it through to the proxy.  The client side doesn't know the real
@@ -227,6 +321,13 @@ typedef struct lws_sspc_handle {
 	struct lws_dsh		*dsh;
 	struct lws_context	*context;
 
+	lws_ss_ser_stats_t	stats;
+
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	lws_ss_shm_t		shm;
+	lws_sorted_usec_list_t	sul_shm; /* give up waiting for shm offer */
+#endif
+
 	lws_usec_t		us_earliest_write_req;
 
 	lws_ss_conn_states_t	state;
@@ -240,6 +341,10 @@ typedef struct lws_sspc_handle {
 	uint8_t			rsidx;
 
 	uint8_t			destroying:1;
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	uint8_t			shm_asked:1;
+	uint8_t			shm_tx_wait:1;
+#endif
 } lws_sspc_handle_t;
 
 int
@@ -248,6 +353,12 @@ lws_ss_deserialize_parse(struct lws_ss_serialization_parser *par,
 			 struct lws_dsh *dsh, const uint8_t *cp, size_t len,
 			 lws_ss_conn_states_t *state, void *parconn,
 			 lws_ss_handle_t **pss, lws_ss_info_t *ssi, char client);
+void
+lws_ss_serialize_stats_add(lws_ss_ser_stats_t *st, int msgs);
+void
+lws_ss_serialize_stats_dump(const lws_ss_ser_stats_t *st, const char *tag);
+int
+lws_ss_serialize_rx_pre(uint8_t *pre, size_t len, int flags, const char *rsp);
 int
 lws_ss_serialize_rx_payload(struct lws_dsh *dsh, const uint8_t *buf,
 			    size_t len, int flags, const char *rsp);
@@ -285,6 +396,12 @@ lws_ss_policy_set(struct lws_context *context, const char *name);
 int
 lws_ss_policy_parse_abandon(struct lws_context *context);
 
+int
+lws_ss_policy_bin_load(struct lws_context *context, const char *path);
+
+void
+lws_ss_policy_bin_free(struct lws_context *context);
+
 int
 lws_ss_sys_fetch_policy(struct lws_context *context);
 
@@ -142,6 +142,14 @@ secstream_mqtt(struct lws *wsi, enum lws_callback_reasons reason, void *user,
 		}
 
 
+		/*
+		 * A new QoS1 publish has to wait for a PUBACK to open the
+		 * window... we'll get another WRITEABLE when that happens
+		 */
+		if (h->policy->u.mqtt.qos && !wsi->mqtt->inside_payload &&
+		    lws_mqtt_client_publish_window_full(wsi))
+			return 0;
+
 		buflen = sizeof(buf) - LWS_PRE;
 		if (h->info.tx(ss_to_userobj(h),  h->txord++, buf + LWS_PRE,
 				&buflen, &f))
@@ -210,6 +218,7 @@ secstream_connect_munge_mqtt(lws_ss_handle_t *h, char *buf, size_t len,
 	ct->ccp.will_param.message	= h->policy->u.mqtt.will_message;
 	ct->ccp.will_param.qos		= h->policy->u.mqtt.will_qos;
 	ct->ccp.will_param.retain	= h->policy->u.mqtt.will_retain;
+	ct->ccp.publish_window		= h->policy->u.mqtt.publish_window;
 
 	lwsl_notice("%s\n", __func__);
 
@@ -19,6 +19,13 @@
  */
 #include <private-lib-core.h>
 
+/*
+ * We stop adding more payload frames to one write to the proxy when there's
+ * less than this much room left, rather than have the user code fragment its
+ * next message into a tiny piece
+ */
+#define LWS_SSPC_BATCH_MIN_ROOM 128
+
 static void
 lws_sspc_sul_retry_cb(lws_sorted_usec_list_t *sul)
 {
@@ -95,6 +102,94 @@ lws_sspc_serialize_metadata(lws_sspc_metadata_t *md, uint8_t *p)
 	return n;
 }
 
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+
+static int
+lws_sspc_shm_rx_frame(void *opaque, const uint8_t *frame, size_t len)
+{
+	lws_sspc_handle_t *h = (lws_sspc_handle_t *)opaque;
+
+	/* the parser passes the payload to ssi.rx in place in the ring */
+
+	return lws_ss_deserialize_parse(&h->parser, h->context, h->dsh, frame,
+					len, &h->state, h,
+					(lws_ss_handle_t **)&h[1], &h->ssi, 1);
+}
+
+/*
+ * We asked the proxy for shared memory rings.  Its offer comes back with the
+ * fds as ancillary data, which the read on cwsi keeps for us while
+ * rx_fds_wanted is set.  If it doesn't turn up in time, we stop waiting and
+ * carry on using the socket.
+ */
+
+static void
+lws_sspc_sul_shm_cb(lws_sorted_usec_list_t *sul)
+{
+	lws_sspc_handle_t *h = lws_container_of(sul, lws_sspc_handle_t, sul_shm);
+
+	if (!h->cwsi || !h->cwsi->rx_fds_wanted)
+		return;
+
+	lwsl_notice("%s: no shm offer from proxy\n", __func__);
+
+	h->cwsi->rx_fds_wanted = 0;
+	while (h->cwsi->rx_nfds)
+		close(h->cwsi->rx_fds[--h->cwsi->rx_nfds]);
+}
+
+static int
+lws_sspc_shm_take_offer(lws_sspc_handle_t *h, struct lws *wsi)
+{
+	int n;
+
+	h->parser.shm_offer = 0;
+	lws_sul_schedule(h->context, 0, &h->sul_shm, NULL,
+			 LWS_SET_TIMER_USEC_CANCEL);
+
+	if (!wsi->rx_fds_wanted) {
+		if (!h->parser.shm_size)
+			return 0;
+
+		/* too late, or not asked for... we don't have the fds */
+		lwsl_err("%s: unexpected shm offer\n", __func__);
+
+		return -1;
+	}
+
+	wsi->rx_fds_wanted = 0;
+
+	if (!h->parser.shm_size) {
+		lwsl_notice("%s: proxy declined shm\n", __func__);
+		if (wsi->rx_nfds)
+			goto bail;
+
+		return 0;
+	}
+
+	if (wsi->rx_nfds != 3)
+		goto bail;
+
+	wsi->rx_nfds = 0;
+	n = lws_ss_shm_attach(&h->shm, wsi, h, h->parser.shm_size,
+			      wsi->rx_fds, 1);
+	close(wsi->rx_fds[0]); /* the mapping keeps it alive */
+	if (n)
+		return -1;
+
+	lwsl_info("%s: using %u byte shared rings\n", __func__,
+		  (unsigned int)h->parser.shm_size);
+
+	return 0;
+
+bail:
+	while (wsi->rx_nfds)
+		close(wsi->rx_fds[--wsi->rx_nfds]);
+
+	return -1;
+}
+#endif
+
 static int
 callback_sspc_client(struct lws *wsi, enum lws_callback_reasons reason,
 		     void *user, void *in, size_t len)
@@ -103,8 +198,11 @@ callback_sspc_client(struct lws *wsi, enum lws_callback_reasons reason,
 	uint8_t s[32], pkt[LWS_PRE + 1400], *p = pkt + LWS_PRE;
 	void *m = (void *)((uint8_t *)&h[1]);
 	const uint8_t *cp;
-	lws_usec_t us;
-	int flags, n;
+	lws_usec_t us, ewr;
+	int flags, n, msgs = 1;
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	size_t avail;
+#endif
 
 	switch (reason) {
 	case LWS_CALLBACK_PROTOCOL_INIT:
@@ -141,6 +239,12 @@ callback_sspc_client(struct lws *wsi, enum lws_callback_reasons reason,
 		 */
 		lwsl_notice("%s: LWS_CALLBACK_RAW_CLOSE: proxy conn down\n", __func__);
 		h->cwsi = NULL;
+		lws_ss_serialize_stats_dump(&h->stats, "client");
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+		lws_sul_schedule(h->context, 0, &h->sul_shm, NULL,
+				 LWS_SET_TIMER_USEC_CANCEL);
+		lws_ss_shm_detach(&h->shm);
+#endif
 		//lws_sspc_destroy(&h);
 		break;
 
@@ -158,11 +262,50 @@ callback_sspc_client(struct lws *wsi, enum lws_callback_reasons reason,
 					     (lws_ss_handle_t **)m, &h->ssi, 1))
 			return -1;
 
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+		if (h->parser.shm_offer && lws_sspc_shm_take_offer(h, wsi))
+			return -1;
+#else
+		if (h->parser.shm_offer && h->parser.shm_size) {
+			lwsl_err("%s: unexpected shm offer\n", __func__);
+
+			return -1;
+		}
+#endif
+
 		if (wsi && h->state == LPCS_LOCAL_CONNECTED)
 			lws_set_timeout(wsi, 0, 0);
 
 		break;
 
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	case LWS_CALLBACK_RAW_RX_FILE:
+		/*
+		 * The proxy rang our shared memory doorbell
+		 */
+		if (!h || !h->cwsi)
+			break;
+
+		lws_ss_shm_doorbell_ack(&h->shm);
+		if (lws_ss_shm_rx(&h->shm, lws_sspc_shm_rx_frame, h)) {
+			lwsl_err("%s: shm rx failed\n", __func__);
+			lws_set_timeout(h->cwsi, 1, LWS_TO_KILL_ASYNC);
+			break;
+		}
+
+		/* it may have made space for tx we were holding */
+		if (h->shm_tx_wait) {
+			h->shm_tx_wait = 0;
+			lws_callback_on_writable(h->cwsi);
+		}
+		break;
+
+	case LWS_CALLBACK_RAW_CLOSE_FILE:
+		if (h)
+			h->shm.wsi_efd = NULL;
+		break;
+#endif
+
 	case LWS_CALLBACK_RAW_WRITEABLE:
 
 		/*
@@ -178,6 +321,23 @@ callback_sspc_client(struct lws *wsi, enum lws_callback_reasons reason,
 		n = 0;
 		cp = s;
 		s[1] = 0;
+
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+		if (h->shm.map) {
+			/*
+			 * Frames are built in place in the shared ring, make
+			 * sure there's room for the biggest one we may write
+			 */
+			p = lws_ss_shm_tx_reserve(&h->shm, sizeof(pkt) - LWS_PRE,
+						  &avail);
+			if (!p) {
+				/* the proxy will wake us when there's space */
+				h->shm_tx_wait = 1;
+				break;
+			}
+		}
+#endif
+
 		switch (h->state) {
 		case LPCS_SENDING_INITIAL_TX:
 			n = strlen(h->ssi.streamtype) + 4;
@@ -192,6 +352,24 @@ callback_sspc_client(struct lws *wsi, enum lws_callback_reasons reason,
 			break;
 
 		case LPCS_LOCAL_CONNECTED:
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+			if (h->ssi.proxy_shm_ring_size && !h->shm_asked) {
+				h->shm_asked = 1;
+				/* keep the fds the offer will bring */
+				wsi->rx_fds_wanted = 1;
+				lws_sul_schedule(h->context, 0, &h->sul_shm,
+						 lws_sspc_sul_shm_cb,
+						 LWS_US_PER_SEC);
+				s[0] = LWSSS_SER_TXPRE_SHM_REQ;
+				lws_ser_wu16be(&s[1], 4);
+				lws_ser_wu32be(&s[3], h->ssi.proxy_shm_ring_size);
+				n = 7;
+
+				/* in case anything else to write */
+				lws_callback_on_writable(h->cwsi);
+				break;
+			}
+#endif
 			if (!h->conn_req)
 				break;
 
@@ -257,29 +435,50 @@ callback_sspc_client(struct lws *wsi, enum lws_callback_reasons reason,
 				break;
 			}
 
-			len = sizeof(pkt) - LWS_PRE - 19;
-			flags = 0;
-			if (h->ssi.tx(m, h->ord++, pkt + LWS_PRE + 19, &len, &flags))
-				break;
-
-			h->txc.tx_cr -= len;
+			/*
+			 * While the user code asks for more tx from inside its
+			 * tx() callback and there's still useful room, keep
+			 * adding payload frames to the packet, so a run of
+			 * small messages goes to the proxy in one write
+			 */
 
 			cp = p;
-			n = len + 19;
-			us = lws_now_usecs();
-			p[0] = LWSSS_SER_TXPRE_TX_PAYLOAD;
-			lws_ser_wu16be(&p[1], len + 19 - 3);
-			lws_ser_wu32be(&p[3], flags);
-			/* time spent here waiting to send this */
-			lws_ser_wu32be(&p[7], us - h->us_earliest_write_req);
-			/* ust that the client write happened */
-			lws_ser_wu64be(&p[11], us);
-			h->us_earliest_write_req = 0;
-
-			if (flags & LWSSS_FLAG_EOM)
-				if (h->rsidx + 1 < (int)LWS_ARRAY_SIZE(h->rideshare_ofs) &&
-				    h->rideshare_ofs[h->rsidx + 1])
-					h->rsidx++;
+			msgs = 0;
+			do {
+				ewr = h->us_earliest_write_req;
+				h->us_earliest_write_req = 0;
+
+				len = sizeof(pkt) - LWS_PRE - n - 19;
+				flags = 0;
+				if (h->ssi.tx(m, h->ord++, p + n + 19, &len,
+					      &flags)) {
+					if (!h->us_earliest_write_req)
+						h->us_earliest_write_req = ewr;
+					break;
+				}
+
+				h->txc.tx_cr -= len;
+
+				us = lws_now_usecs();
+				p[n] = LWSSS_SER_TXPRE_TX_PAYLOAD;
+				lws_ser_wu16be(&p[n + 1], len + 19 - 3);
+				lws_ser_wu32be(&p[n + 3], flags);
+				/* time spent here waiting to send this */
+				lws_ser_wu32be(&p[n + 7], us - ewr);
+				/* ust that the client write happened */
+				lws_ser_wu64be(&p[n + 11], us);
+
+				n += len + 19;
+				msgs++;
+
+				if (flags & LWSSS_FLAG_EOM)
+					if (h->rsidx + 1 < (int)LWS_ARRAY_SIZE(h->rideshare_ofs) &&
+					    h->rideshare_ofs[h->rsidx + 1])
+						h->rsidx++;
+
+			} while (h->us_earliest_write_req && h->txc.tx_cr > 0 &&
+				 sizeof(pkt) - LWS_PRE - n >=
+						19 + LWS_SSPC_BATCH_MIN_ROOM);
 
 			break;
 		default:
@@ -291,12 +490,24 @@ callback_sspc_client(struct lws *wsi, enum lws_callback_reasons reason,
 
 		// lwsl_hexdump_notice(cp, n);
 
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+		if (h->shm.map) {
+			if (cp != p)
+				memcpy(p, cp, n);
+			lws_ss_shm_tx_commit(&h->shm, n);
+			lws_ss_serialize_stats_add(&h->stats, msgs);
+			break;
+		}
+#endif
+
 		n = lws_write(wsi, (uint8_t *)cp, n, LWS_WRITE_RAW);
 		if (n < 0) {
 			lwsl_notice("%s: WRITEABLE: %d\n", __func__, n);
 
 			goto hangup;
 		}
+		lws_ss_serialize_stats_add(&h->stats, msgs);
+
 		break;
 
 	default:
@@ -332,6 +543,16 @@ lws_sspc_create(struct lws_context *context, int tsi, const lws_ss_info_t *ssi,
 
 	lwsl_notice("%s: streamtype %s\n", __func__, ssi->streamtype);
 
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	if (ssi->proxy_shm_ring_size &&
+	    ssi->proxy_shm_ring_size < LWS_SS_SHM_RING_MIN) {
+		lwsl_err("%s: proxy_shm_ring_size must be at least %u\n",
+			 __func__, (unsigned int)LWS_SS_SHM_RING_MIN);
+
+		return 1;
+	}
+#endif
+
 	/* allocate the handle (including ssi), the user alloc,
 	 * and the streamname */
 
@@ -410,6 +631,11 @@ lws_sspc_destroy(lws_sspc_handle_t **ph)
 		h->cwsi = NULL;
 		lws_set_timeout(wsi, 1, LWS_TO_KILL_SYNC);
 	}
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	lws_sul_schedule(h->context, 0, &h->sul_shm, NULL,
+			 LWS_SET_TIMER_USEC_CANCEL);
+	lws_ss_shm_detach(&h->shm);
+#endif
 
 	/* clean out any pending metadata changes that didn't make it */
 
@@ -64,6 +64,10 @@ struct conn {
 	lws_dsh_t		*dsh;	/* unified buffer for both sides */
 	struct lws		*wsi;	/* the client side */
 	lws_ss_handle_t		*ss;	/* the onward, ss side */
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	lws_ss_shm_t		shm;	/* optional rings shared with client */
+#endif
+	lws_ss_ser_stats_t	stats;
 
 	lws_ss_conn_states_t	state;
 };
@@ -81,6 +85,160 @@ typedef struct ss_proxy_onward {
 	struct conn		*conn;
 } ss_proxy_t;
 
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+
+/*
+ * Move what we queued for the client into the shared ring, as far as it will
+ * go.  If it doesn't all fit, the client will wake us when it made space.
+ *
+ * Returns nonzero if a queued frame is too big to ever go in the ring.
+ */
+
+static int
+ss_proxy_shm_flush(struct conn *conn)
+{
+	size_t si, avail;
+	uint8_t *p, *d;
+
+	while (!lws_dsh_get_head(conn->dsh, KIND_SS_TO_P, (void **)&p, &si)) {
+		if (si > LWS_SS_SHM_FRAME_MAX) {
+			/* its length can't have been serialized either */
+			lwsl_err("%s: frame too large %u\n", __func__,
+				 (unsigned int)si);
+
+			return 1;
+		}
+
+		d = lws_ss_shm_tx_reserve(&conn->shm, si, &avail);
+		if (!d)
+			break;
+
+		memcpy(d, p, si);
+		lws_dsh_free((void **)&p);
+
+#if defined(LWS_WITH_DETAILED_LATENCY)
+		if (d[0] == LWSSS_SER_RXPRE_RX_PAYLOAD &&
+		    conn->wsi->context->detailed_latency_cb) {
+			lws_usec_t us = lws_now_usecs();
+
+			/* see the socket case in the WRITEABLE handler */
+			lws_ser_wu32be(&d[7], us - lws_ser_ru64be(&d[11]));
+			lws_ser_wu64be(&d[11], us);
+		}
+#endif
+
+		lws_ss_shm_tx_commit(&conn->shm, si);
+	}
+
+	return 0;
+}
+
+static int
+ss_proxy_shm_rx_frame(void *opaque, const uint8_t *frame, size_t len)
+{
+	struct conn *conn = (struct conn *)opaque;
+	size_t si;
+	void *p;
+
+	/*
+	 * Payload is left in the ring until the onward stream took what we
+	 * already gave it, so a fast client is held back by the ring filling
+	 * rather than overflowing the dsh
+	 */
+
+	if (frame[0] == LWSSS_SER_TXPRE_TX_PAYLOAD &&
+	    !lws_dsh_get_head(conn->dsh, KIND_C_TO_P, &p, &si))
+		return 1;
+
+	return lws_ss_deserialize_parse(&conn->parser,
+					lws_get_context(conn->wsi), conn->dsh,
+					frame, len, &conn->state, conn,
+					&conn->ss, NULL, 0);
+}
+#endif
+
+/*
+ * Fix up the latency fields of a queued frame as it goes out to the client
+ */
+
+static void
+ss_proxy_ser_latency(struct lws *wsi, uint8_t *p, size_t si)
+{
+#if defined(LWS_WITH_DETAILED_LATENCY)
+	lws_usec_t us;
+
+	if (p[0] != LWSSS_SER_RXPRE_RX_PAYLOAD ||
+	    !wsi->context->detailed_latency_cb)
+		return;
+
+	/*
+	 * we're fulfilling rx that came in on ss
+	 * by sending it back out to the client on
+	 * the Unix Domain Socket
+	 *
+	 * +  7  u32  write will compute latency here...
+	 * + 11  u32  ust we received from ss
+	 *
+	 * lws_write will report it and fill in
+	 * LAT_DUR_PROXY_CLIENT_REQ_TO_WRITE
+	 */
+
+	us = lws_now_usecs();
+	lws_ser_wu32be(&p[7], us - lws_ser_ru64be(&p[11]));
+	lws_ser_wu64be(&p[11], us);
+
+	wsi->detlat.acc_size = wsi->detlat.req_size = si - 19;
+	/* time proxy held it */
+	wsi->detlat.latencies[LAT_DUR_PROXY_RX_TO_ONWARD_TX] =
+							lws_ser_ru32be(&p[7]);
+#endif
+}
+
+/*
+ * Coalesce as many frames queued for the client as will fit into the pt
+ * serv_buf, so a run of small payloads, state changes and credit updates
+ * goes out in one write and is parsed from one rx at the client.  A frame
+ * too big for serv_buf is sent alone straight from the dsh, in that case
+ * *pay is set and the caller frees it after the write.
+ */
+
+static int
+ss_proxy_batch(struct lws *wsi, struct conn *conn, uint8_t **pp, int *pay,
+	       int *msgs)
+{
+	struct lws_context_per_thread *pt = &wsi->context->pt[(int)wsi->tsi];
+	size_t si, room = wsi->context->pt_serv_buf_size - LWS_PRE;
+	uint8_t *p, *b = pt->serv_buf + LWS_PRE;
+	int n = 0;
+
+	*pay = 0;
+	*msgs = 0;
+
+	if (lws_dsh_get_head(conn->dsh, KIND_SS_TO_P, (void **)&p, &si))
+		return 0;
+
+	if (si > room) {
+		ss_proxy_ser_latency(wsi, p, si);
+		*pp = p;
+		*pay = 1;
+		*msgs = 1;
+
+		return (int)si;
+	}
+
+	do {
+		memcpy(b + n, p, si);
+		ss_proxy_ser_latency(wsi, b + n, si);
+		lws_dsh_free((void **)&p);
+		n += (int)si;
+		(*msgs)++;
+	} while (!lws_dsh_get_head(conn->dsh, KIND_SS_TO_P, (void **)&p,
+				   &si) && n + si <= room);
+
+	*pp = b;
+
+	return n;
+}
 
 /* secure streams payload interface */
 
@@ -100,6 +258,26 @@ ss_proxy_onward_rx(void *userobj, const uint8_t *buf, size_t len, int flags)
 		flags |= LWSSS_FLAG_RIDESHARE;
 	}
 
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	if (m->conn->shm.map && m->conn->wsi) {
+		uint8_t pre[128];
+		size_t si;
+		void *p;
+
+		/*
+		 * If nothing is queued ahead of it, it can go straight into
+		 * the ring we share with the client, without being buffered
+		 * or written to the socket
+		 */
+
+		if (lws_dsh_get_head(m->conn->dsh, KIND_SS_TO_P, &p, &si) &&
+		    !lws_ss_shm_tx(&m->conn->shm, pre,
+				   lws_ss_serialize_rx_pre(pre, len, flags, rsp),
+				   buf, len))
+			return 0;
+	}
+#endif
+
 	n = lws_ss_serialize_rx_payload(m->conn->dsh, buf, len, flags, rsp);
 	if (n)
 		return n;
@@ -140,6 +318,16 @@ ss_proxy_onward_tx(void *userobj, lws_ss_tx_ordinal_t ord, uint8_t *buf,
 
 	if (!lws_dsh_get_head(m->conn->dsh, KIND_C_TO_P, (void **)&p, &si))
 		lws_ss_request_tx(m->conn->ss);
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	else
+		/* we can take the next payload waiting in the ring now */
+		if (m->conn->shm.map && m->conn->wsi &&
+		    lws_ss_shm_rx(&m->conn->shm, ss_proxy_shm_rx_frame,
+				  m->conn)) {
+			lwsl_err("%s: shm rx failed\n", __func__);
+			lws_set_timeout(m->conn->wsi, 1, LWS_TO_KILL_ASYNC);
+		}
+#endif
 
 	if (!*len && !*flags)
 		return 1; /* we don't actually want to send anything */
@@ -178,6 +366,10 @@ ss_proxy_onward_state(void *userobj, void *sh,
 			 * connection has already gone away... destroy the conn.
 			 */
 			lwsl_info("%s: Destroying conn\n", __func__);
+			lws_ss_serialize_stats_dump(&m->conn->stats, "proxy");
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+			lws_ss_shm_detach(&m->conn->shm);
+#endif
 			lws_dsh_destroy(&m->conn->dsh);
 			free(m->conn);
 			m->conn = NULL;
@@ -217,6 +409,63 @@ ss_proxy_onward_txcr(void *userobj, int bump)
 		lws_callback_on_writable(m->conn->wsi);
 }
 
+/*
+ * The client asked to move the stream to shared memory rings.  If we can, the
+ * offer is sent with the fds here directly, and after it everything for the
+ * client goes in the ring.  Otherwise s is filled with an offer declining it,
+ * to be written normally.
+ *
+ * Returns -1 if the conn is unusable, 0 if the offer went out, or the length
+ * of the frame in s to write.
+ */
+
+static int
+ss_proxy_shm_offer(struct conn *conn, uint8_t *s)
+{
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	uint32_t size = conn->parser.shm_size;
+	int fds[3], n;
+
+	/* too small a ring could never hold the biggest frames */
+
+	if (size < LWS_SS_SHM_RING_MIN) {
+		lwsl_notice("%s: ring size %u too small\n", __func__,
+			    (unsigned int)size);
+		goto decline;
+	}
+
+	if (!lws_ss_shm_create(&size, fds)) {
+		if (lws_ss_shm_attach(&conn->shm, conn->wsi, conn, size,
+				      fds, 0)) {
+			close(fds[0]);
+			goto decline;
+		}
+
+		s[0] = LWSSS_SER_RXPRE_SHM_OFFER;
+		lws_ser_wu16be(&s[1], 4);
+		lws_ser_wu32be(&s[3], size);
+
+		n = lws_ss_shm_send_fds(lws_get_socket_fd(conn->wsi), s, 7,
+					fds, 3);
+		close(fds[0]);
+		if (n)
+			return -1;
+
+		lwsl_info("%s: using %u byte shared rings\n", __func__,
+			  (unsigned int)size);
+
+		return 0;
+	}
+
+decline:
+#endif
+	s[0] = LWSSS_SER_RXPRE_SHM_OFFER;
+	lws_ser_wu16be(&s[1], 4);
+	lws_ser_wu32be(&s[3], 0);
+
+	return 7;
+}
+
 /*
  * Client - Proxy connection on unix domain socket
  */
@@ -230,15 +479,11 @@ callback_ss_proxy(struct lws *wsi, enum lws_callback_reasons reason,
 	const lws_ss_policy_t *rsp;
 	struct conn *conn = NULL;
 	lws_ss_info_t ssi;
+	int n, pay, msgs = 0;
 	const uint8_t *cp;
-#if defined(LWS_WITH_DETAILED_LATENCY)
-	lws_usec_t us;
-#endif
 	char s[128];
 	uint8_t *p;
 	size_t si;
-	char pay;
-	int n;
 
 	if (pss)
 		conn = pss->conn;
@@ -311,6 +556,10 @@ callback_ss_proxy(struct lws *wsi, enum lws_callback_reasons reason,
 			 * There's no onward secure stream and our client
 			 * connection is closing.  Destroy the conn.
 			 */
+			lws_ss_serialize_stats_dump(&conn->stats, "proxy");
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+			lws_ss_shm_detach(&conn->shm);
+#endif
 			lws_dsh_destroy(&conn->dsh);
 			free(conn);
 			pss->conn = NULL;
@@ -349,11 +598,39 @@ callback_ss_proxy(struct lws *wsi, enum lws_callback_reasons reason,
 		}
 
 		if (conn->state == LPCS_REPORTING_FAIL ||
-		    conn->state == LPCS_REPORTING_OK)
+		    conn->state == LPCS_REPORTING_OK || conn->parser.shm_req)
 			lws_callback_on_writable(conn->wsi);
 
 		break;
 
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+	case LWS_CALLBACK_RAW_RX_FILE:
+		/*
+		 * The client rang our shared memory doorbell
+		 */
+		conn = (struct conn *)lws_get_opaque_user_data(wsi);
+		if (!conn || !conn->wsi)
+			break;
+
+		lws_ss_shm_doorbell_ack(&conn->shm);
+		if (lws_ss_shm_rx(&conn->shm, ss_proxy_shm_rx_frame, conn)) {
+			lwsl_err("%s: shm rx failed\n", __func__);
+			lws_set_timeout(conn->wsi, 1, LWS_TO_KILL_ASYNC);
+			break;
+		}
+
+		/* it may have made space for something we are holding */
+		if (!lws_dsh_get_head(conn->dsh, KIND_SS_TO_P, (void **)&p, &si))
+			lws_callback_on_writable(conn->wsi);
+		break;
+
+	case LWS_CALLBACK_RAW_CLOSE_FILE:
+		conn = (struct conn *)lws_get_opaque_user_data(wsi);
+		if (conn)
+			conn->shm.wsi_efd = NULL;
+		break;
+#endif
+
 	case LWS_CALLBACK_RAW_WRITEABLE:
 		// lwsl_notice("LWS_CALLBACK_RAW_PROXY_SRV_WRITEABLE\n");
 
@@ -400,43 +677,24 @@ callback_ss_proxy(struct lws *wsi, enum lws_callback_reasons reason,
 			lws_set_timeout(wsi, 0, 0);
 			break;
 		case LPCS_OPERATIONAL:
-			if (lws_dsh_get_head(conn->dsh, KIND_SS_TO_P,
-					     (void **)&p, &si))
+			if (conn->parser.shm_req) {
+				conn->parser.shm_req = 0;
+				n = ss_proxy_shm_offer(conn, (uint8_t *)s);
+				if (n < 0)
+					goto hangup;
+				/* anything already queued goes after it */
+				lws_callback_on_writable(wsi);
+				break;
+			}
+#if defined(LWS_WITH_SECURE_STREAMS_PROXY_SHM)
+			if (conn->shm.map) {
+				if (ss_proxy_shm_flush(conn))
+					goto hangup;
 				break;
-			cp = p;
-
-#if defined(LWS_WITH_DETAILED_LATENCY)
-			if (cp[0] == LWSSS_SER_RXPRE_RX_PAYLOAD &&
-			    wsi->context->detailed_latency_cb) {
-
-				/*
-				 * we're fulfilling rx that came in on ss
-				 * by sending it back out to the client on
-				 * the Unix Domain Socket
-				 *
-				 * +  7  u32  write will compute latency here...
-				 * + 11  u32  ust we received from ss
-				 *
-				 * lws_write will report it and fill in
-				 * LAT_DUR_PROXY_CLIENT_REQ_TO_WRITE
-				 */
-
-				us = lws_now_usecs();
-				lws_ser_wu32be(&p[7], us -
-						      lws_ser_ru64be(&p[11]));
-				lws_ser_wu64be(&p[11], us);
-
-				wsi->detlat.acc_size =
-					wsi->detlat.req_size = si - 19;
-				/* time proxy held it */
-				wsi->detlat.latencies[
-				            LAT_DUR_PROXY_RX_TO_ONWARD_TX] =
-							lws_ser_ru32be(&p[7]);
 			}
 #endif
-
-			pay = 1;
-			n = (int)si;
+			n = ss_proxy_batch(wsi, conn, &p, &pay, &msgs);
+			cp = p;
 			break;
 		default:
 			break;
@@ -456,14 +714,16 @@ again:
 		case LPCS_REPORTING_FAIL:
 			goto hangup;
 		case LPCS_OPERATIONAL:
+			if (msgs)
+				lws_ss_serialize_stats_add(&conn->stats, msgs);
 			if (pay)
 				lws_dsh_free((void **)&p);
 			if (!lws_dsh_get_head(conn->dsh, KIND_SS_TO_P,
 					     (void **)&p, &si)) {
 				if (!lws_send_pipe_choked(wsi)) {
+					n = ss_proxy_batch(wsi, conn, &p, &pay,
+							   &msgs);
 					cp = p;
-					pay = 1;
-					n = (int)si;
 					goto again;
 				}
 				lws_callback_on_writable(wsi);
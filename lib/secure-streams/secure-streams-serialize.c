@@ -79,6 +79,8 @@ typedef enum {
 	RPAR_ORD2,
 	RPAR_ORD1,
 	RPAR_ORD0,
+
+	RPAR_SHM0,
 } rx_parser_t;
 
 #if defined(_DEBUG)
@@ -109,16 +111,14 @@ lws_ss_serialize_state_transition(lws_ss_conn_states_t *state, int new_state)
 
 
 /*
- * event loop received something and is queueing it for the foreign side of
- * the dsh to consume later as serialized rx
+ * Prepare the serialization header for some rx the event loop received, in
+ * pre[] which must be at least 128 bytes.  Returns the header length.
  */
 
 int
-lws_ss_serialize_rx_payload(struct lws_dsh *dsh, const uint8_t *buf,
-			    size_t len, int flags, const char *rsp)
+lws_ss_serialize_rx_pre(uint8_t *pre, size_t len, int flags, const char *rsp)
 {
 	lws_usec_t us = lws_now_usecs();
-	uint8_t pre[128];
 	int est = 19, l = 0;
 
 	if (flags & LWSSS_FLAG_RIDESHARE) {
@@ -151,6 +151,23 @@ lws_ss_serialize_rx_payload(struct lws_dsh *dsh, const uint8_t *buf,
 		memcpy(&pre[20], rsp, l);
 	}
 
+	return est;
+}
+
+/*
+ * event loop received something and is queueing it for the foreign side of
+ * the dsh to consume later as serialized rx
+ */
+
+int
+lws_ss_serialize_rx_payload(struct lws_dsh *dsh, const uint8_t *buf,
+			    size_t len, int flags, const char *rsp)
+{
+	uint8_t pre[128];
+	int est;
+
+	est = lws_ss_serialize_rx_pre(pre, len, flags, rsp);
+
 	if (lws_dsh_alloc_tail(dsh, KIND_SS_TO_P, pre, est, buf, len)) {
 		lwsl_err("%s: unable to alloc in dsh 1\n", __func__);
 
@@ -290,10 +307,34 @@ lws_ss_serialize_txcr(struct lws_dsh *dsh, int txcr)
 	return 0;
 }
 
+/*
+ * Account for one write on the proxy connection that carried msgs frames
+ */
+
+void
+lws_ss_serialize_stats_add(lws_ss_ser_stats_t *st, int msgs)
+{
+	st->writes++;
+	st->msgs += msgs;
+	if (msgs > st->max_batch)
+		st->max_batch = msgs;
+}
+
+void
+lws_ss_serialize_stats_dump(const lws_ss_ser_stats_t *st, const char *tag)
+{
+	if (!st->writes)
+		return;
+
+	lwsl_info("%s: %s: %u msgs in %u writes (%u.%02u / write, max %u)\n",
+		  __func__, tag, st->msgs, st->writes, st->msgs / st->writes,
+		  ((st->msgs % st->writes) * 100) / st->writes, st->max_batch);
+}
+
 /*
  * event loop side is consuming serialized data from the client via dsh, parse
  * it using a bytewise parser for the serialization header(s)...
- * it's possibly coalesced
+ * it's possibly coalesced, ie, one buffer may hold a batch of frames
  */
 
 int
@@ -379,6 +420,16 @@ lws_ss_deserialize_parse(struct lws_ss_serialization_parser *par,
 				par->ctr = 0;
 				break;
 
+			case LWSSS_SER_TXPRE_SHM_REQ:
+				if (client)
+					goto hangup;
+				if (*state != LPCS_OPERATIONAL ||
+				    par->rem != 4)
+					goto hangup;
+				par->ps = RPAR_SHM0;
+				par->ctr = 0;
+				break;
+
 			/* client side */
 
 			case LWSSS_SER_RXPRE_RX_PAYLOAD:
@@ -427,6 +478,15 @@ lws_ss_deserialize_parse(struct lws_ss_serialization_parser *par,
 				par->ps = RPAR_RX_TXCR_UPDATE;
 				break;
 
+			case LWSSS_SER_RXPRE_SHM_OFFER:
+				if (!client)
+					goto hangup;
+				if (par->rem != 4)
+					goto hangup;
+				par->ps = RPAR_SHM0;
+				par->ctr = 0;
+				break;
+
 			default:
 				lwsl_notice("%s: bad type 0x%x\n", __func__,
 					    par->type);
@@ -435,9 +495,38 @@ lws_ss_deserialize_parse(struct lws_ss_serialization_parser *par,
 			break;
 
 			case RPAR_FLAG_B3:
+				/*
+				 * Usually the whole 16-byte payload header is
+				 * in this buffer, take it in one go rather
+				 * than stepping through it a byte at a time
+				 */
+				if (len < 15 || par->rem < 16)
+					goto bytewise;
+
+				par->flags = lws_ser_ru32be(cp);
+				par->usd_phandling = lws_ser_ru32be(cp + 4);
+				par->ust_pwait = lws_ser_ru64be(cp + 8);
+				cp += 16;
+				len -= 15;
+				par->rem -= 16;
+				par->frag1 = 1;
+
+				if (par->flags & LWSSS_FLAG_RIDESHARE)
+					par->ps = RPAR_RIDESHARE_LEN;
+				else
+					par->ps = RPAR_PAYLOAD;
+
+				if (par->rem)
+					break;
+
+				if (!(par->flags & LWSSS_FLAG_RIDESHARE))
+					goto payload_ff;
+				goto hangup;
+
 			case RPAR_FLAG_B2:
 			case RPAR_FLAG_B1:
 			case RPAR_FLAG_B0:
+bytewise:
 				par->flags <<= 8;
 				par->flags |= *cp++;
 				par->ps++;
@@ -690,6 +779,26 @@ payload_ff:
 			par->ps = RPAR_TYPE;
 			break;
 
+		case RPAR_SHM0:
+			/*
+			 * Shared memory ring size, requested by the client or
+			 * what the proxy offers it in response.  The parser's
+			 * owner follows up on it, since only it knows about
+			 * the connection and fds.
+			 */
+			par->temp32 = (par->temp32 << 8) | *cp++;
+			par->rem--;
+			if (++par->ctr < 4)
+				break;
+
+			par->shm_size = (uint32_t)par->temp32;
+			if (client)
+				par->shm_offer = 1;
+			else
+				par->shm_req = 1;
+			par->ps = RPAR_TYPE;
+			break;
+
 		case RPAR_METADATA_NAMELEN:
 			if (!--par->rem)
 				goto hangup;
@@ -0,0 +1,475 @@
+/*
+ * libwebsockets - small server side websockets and web server implementation
+ *
+ * Copyright (C) 2019 - 2020 Andy Green <andy@warmcat.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ *
+ * Optional shared memory transport between Secure Streams proxy clients and
+ * the proxy.
+ *
+ * The proxy creates a memfd holding two rings, proxy -> client first, then
+ * client -> proxy, and two eventfds, one to wake each side.  They're passed to
+ * the client over the proxy unix domain socket with SCM_RIGHTS.  Each side
+ * then produces into one ring and consumes from the other, and adopts the
+ * eventfd it's woken by into its event loop as a raw file wsi, as a child of
+ * the proxy socket wsi so it goes away with it.
+ *
+ * The rings carry the normal serialized frames, a whole frame at a time, so the
+ * usual parser consumes them in place.  Indexes are free-running u32, masked by
+ * the power-of-two ring size.  Doorbells are only rung if the other side said
+ * it was going idle (consumer) or ran out of space (producer), so a busy
+ * stream doesn't cost a syscall per frame.
+ */
+
+#include <private-lib-core.h>
+#include <sys/eventfd.h>
+
+static void
+lws_ss_shm_ring(lws_ss_shm_t *shm, uint32_t idx, lws_ss_shm_ring_t **r,
+		uint8_t **data)
+{
+	uint8_t *p = shm->map + idx * (sizeof(lws_ss_shm_ring_t) + shm->size);
+
+	*r = (lws_ss_shm_ring_t *)p;
+	*data = p + sizeof(lws_ss_shm_ring_t);
+}
+
+static void
+lws_ss_shm_doorbell(lws_ss_shm_t *shm)
+{
+	if (eventfd_write(shm->efd_peer, 1))
+		lwsl_info("%s: doorbell failed %d\n", __func__, errno);
+}
+
+/*
+ * Proxy side: create the memfd and the two eventfds for a new pair of rings.
+ * *size is adjusted to what we will actually use.
+ *
+ * fds[0] is the memfd, fds[1] wakes the client and fds[2] wakes the proxy.
+ */
+
+int
+lws_ss_shm_create(uint32_t *size, int *fds)
+{
+	uint32_t s = LWS_SS_SHM_RING_MIN;
+	lws_ss_shm_ring_t *r;
+	uint8_t *map;
+	size_t ml;
+
+	while (s < *size && s < LWS_SS_SHM_RING_MAX)
+		s <<= 1;
+	ml = 2 * (sizeof(lws_ss_shm_ring_t) + s);
+
+	fds[0] = memfd_create("lws-ss-shm", MFD_CLOEXEC);
+	if (fds[0] < 0) {
+		lwsl_err("%s: memfd_create failed %d\n", __func__, errno);
+
+		return 1;
+	}
+
+	if (ftruncate(fds[0], (off_t)ml))
+		goto bail;
+
+	/* both rings start out empty with the consumer asking to be woken */
+
+	map = mmap(NULL, ml, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+	if (map == MAP_FAILED)
+		goto bail;
+	r = (lws_ss_shm_ring_t *)map;
+	r->consumer_idle = 1;
+	r = (lws_ss_shm_ring_t *)(map + sizeof(*r) + s);
+	r->consumer_idle = 1;
+	munmap(map, ml);
+
+	fds[1] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (fds[1] < 0)
+		goto bail;
+	fds[2] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (fds[2] < 0) {
+		close(fds[1]);
+		goto bail;
+	}
+
+	*size = s;
+
+	return 0;
+
+bail:
+	lwsl_err("%s: failed %d\n", __func__, errno);
+	close(fds[0]);
+
+	return 1;
+}
+
+/*
+ * Either side: map the rings described by fds[] from lws_ss_shm_create() and
+ * adopt the eventfd that wakes us as a child of the proxy socket wsi.
+ *
+ * Ownership of fds[1] and fds[2] passes to shm even if we fail, fds[0] stays
+ * with the caller, who can close it once it no longer needs to pass it on.
+ */
+
+int
+lws_ss_shm_attach(lws_ss_shm_t *shm, struct lws *parent, void *opaque,
+		  uint32_t size, const int *fds, int client)
+{
+	lws_adopt_desc_t ad;
+	struct stat st;
+
+	memset(shm, 0, sizeof(*shm));
+	shm->efd_peer = fds[client ? 2 : 1];
+
+	if (size < LWS_SS_SHM_RING_MIN || size > LWS_SS_SHM_RING_MAX ||
+	    (size & (size - 1))) {
+		lwsl_err("%s: bad ring size %u\n", __func__, (unsigned int)size);
+		goto bail;
+	}
+
+	shm->size = size;
+	shm->map_len = 2 * (sizeof(lws_ss_shm_ring_t) + size);
+
+	/* the client doesn't take the proxy's word for how big the memfd is */
+
+	if (fstat(fds[0], &st) || (size_t)st.st_size < shm->map_len) {
+		lwsl_err("%s: memfd too small\n", __func__);
+		goto bail;
+	}
+
+	shm->map = mmap(NULL, shm->map_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+			fds[0], 0);
+	if (shm->map == MAP_FAILED) {
+		shm->map = NULL;
+		lwsl_err("%s: mmap failed %d\n", __func__, errno);
+		goto bail;
+	}
+
+	lws_ss_shm_ring(shm, !client, &shm->tx, &shm->tx_data);
+	lws_ss_shm_ring(shm, !!client, &shm->rx, &shm->rx_data);
+	shm->tx_head = __atomic_load_n(&shm->tx->head, __ATOMIC_ACQUIRE);
+	shm->rx_tail = __atomic_load_n(&shm->rx->tail, __ATOMIC_ACQUIRE);
+
+	memset(&ad, 0, sizeof(ad));
+	ad.vh = lws_get_vhost(parent);
+	ad.type = LWS_ADOPT_RAW_FILE_DESC;
+	ad.fd.filefd = fds[client ? 1 : 2];
+	ad.vh_prot_name = lws_get_protocol(parent)->name;
+	ad.parent = parent;
+	ad.opaque = opaque;
+
+	shm->wsi_efd = lws_adopt_descriptor_vhost_via_info(&ad);
+	if (!shm->wsi_efd) {
+		lwsl_err("%s: unable to adopt doorbell\n", __func__);
+		close(fds[client ? 1 : 2]);
+		lws_ss_shm_detach(shm);
+
+		return 1;
+	}
+
+	return 0;
+
+bail:
+	close(fds[1]);
+	close(fds[2]);
+	shm->efd_peer = -1;
+
+	return 1;
+}
+
+void
+lws_ss_shm_detach(lws_ss_shm_t *shm)
+{
+	if (shm->wsi_efd) {
+		struct lws *wsi = shm->wsi_efd;
+
+		shm->wsi_efd = NULL;
+		lws_set_opaque_user_data(wsi, NULL);
+		lws_set_timeout(wsi, 1, LWS_TO_KILL_ASYNC);
+	}
+
+	if (shm->map) {
+		munmap(shm->map, shm->map_len);
+		shm->map = NULL;
+		close(shm->efd_peer);
+		shm->efd_peer = -1;
+	}
+}
+
+/*
+ * Producer: find at least need contiguous bytes at the tx ring head, padding
+ * out the end of the ring if that's what it takes.  Returns NULL if the
+ * consumer has to make space first, it will ring our doorbell when it has.
+ */
+
+uint8_t *
+lws_ss_shm_tx_reserve(lws_ss_shm_t *shm, size_t need, size_t *avail)
+{
+	uint32_t tail, used, off, contig;
+	int retry = 0;
+
+again:
+	tail = __atomic_load_n(&shm->tx->tail, __ATOMIC_ACQUIRE);
+	used = shm->tx_head - tail;
+	if (used > shm->size)
+		/* the consumer side is not sane, we can't trust its tail */
+		return NULL;
+	off = shm->tx_head & (shm->size - 1);
+	contig = shm->size - off;
+
+	if (contig < need && shm->size - used >= contig) {
+		/* skip the reader to the start of the ring */
+		shm->tx_data[off] = LWS_SS_SHM_PAD;
+		shm->tx_head += contig;
+		__atomic_store_n(&shm->tx->head, shm->tx_head,
+				 __ATOMIC_RELEASE);
+		used += contig;
+		contig = shm->size;
+		off = 0;
+	}
+
+	if (contig >= need && shm->size - used >= need) {
+		*avail = shm->size - used;
+		if (*avail > contig)
+			*avail = contig;
+
+		return shm->tx_data + off;
+	}
+
+	if (retry)
+		return NULL;
+
+	/*
+	 * Ask to be told when there's space, then check again in case the
+	 * consumer already made some before it could see our flag
+	 */
+
+	__atomic_store_n(&shm->tx->producer_blocked, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	retry = 1;
+
+	goto again;
+}
+
+/*
+ * Producer: publish len bytes of whole frames written at the reserved space
+ */
+
+void
+lws_ss_shm_tx_commit(lws_ss_shm_t *shm, size_t len)
+{
+	shm->tx_head += (uint32_t)len;
+	__atomic_store_n(&shm->tx->head, shm->tx_head, __ATOMIC_RELEASE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (__atomic_exchange_n(&shm->tx->consumer_idle, 0, __ATOMIC_ACQ_REL))
+		lws_ss_shm_doorbell(shm);
+}
+
+/*
+ * Producer: copy in a frame made from a serialization header and its payload.
+ * Returns 1 if there's no space for it right now.
+ */
+
+int
+lws_ss_shm_tx(lws_ss_shm_t *shm, const uint8_t *pre, size_t prelen,
+	      const uint8_t *buf, size_t len)
+{
+	size_t avail;
+	uint8_t *p;
+
+	p = lws_ss_shm_tx_reserve(shm, prelen + len, &avail);
+	if (!p)
+		return 1;
+
+	memcpy(p, pre, prelen);
+	if (len)
+		memcpy(p + prelen, buf, len);
+
+	lws_ss_shm_tx_commit(shm, prelen + len);
+
+	return 0;
+}
+
+/*
+ * Consumer: the peer rang our doorbell, reset it before looking at the ring
+ */
+
+void
+lws_ss_shm_doorbell_ack(lws_ss_shm_t *shm)
+{
+	eventfd_t v;
+
+	if (shm->wsi_efd)
+		eventfd_read(lws_get_socket_fd(shm->wsi_efd), &v);
+}
+
+/*
+ * Consumer: pass each complete frame in the rx ring to cb in place, releasing
+ * the space after it returns 0.  If it returns 1, the frame is left where it
+ * is and we stop until we're called again.  Returns -1 if the ring content is
+ * not sane or cb failed.
+ */
+
+int
+lws_ss_shm_rx(lws_ss_shm_t *shm, lws_ss_shm_frame_cb cb, void *opaque)
+{
+	uint32_t head, off, flen;
+	int n;
+
+	do {
+		head = __atomic_load_n(&shm->rx->head, __ATOMIC_ACQUIRE);
+
+		while (shm->rx_tail != head) {
+			off = shm->rx_tail & (shm->size - 1);
+
+			if (head - shm->rx_tail > shm->size)
+				return -1;
+
+			if (shm->rx_data[off] == LWS_SS_SHM_PAD)
+				flen = shm->size - off;
+			else {
+				if (head - shm->rx_tail < 3 ||
+				    shm->size - off < 3)
+					return -1;
+				flen = 3u + lws_ser_ru16be(&shm->rx_data[off + 1]);
+				if (flen > head - shm->rx_tail ||
+				    flen > shm->size - off)
+					return -1;
+
+				n = cb(opaque, &shm->rx_data[off], flen);
+				if (n)
+					return n < 0 ? -1 : 0;
+			}
+
+			shm->rx_tail += flen;
+			__atomic_store_n(&shm->rx->tail, shm->rx_tail,
+					 __ATOMIC_RELEASE);
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+			if (__atomic_exchange_n(&shm->rx->producer_blocked, 0,
+						__ATOMIC_ACQ_REL))
+				lws_ss_shm_doorbell(shm);
+		}
+
+		/*
+		 * We're going idle, ask for a doorbell and check again in case
+		 * the producer committed something before it could see it
+		 */
+
+		__atomic_store_n(&shm->rx->consumer_idle, 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	} while (__atomic_load_n(&shm->rx->head, __ATOMIC_ACQUIRE) !=
+								shm->rx_tail);
+
+	return 0;
+}
+
+/*
+ * Pass the fds from lws_ss_shm_create() along with the offer frame
+ */
+
+int
+lws_ss_shm_send_fds(int sockfd, const uint8_t *buf, size_t len, const int *fds,
+		    int nfds)
+{
+	char cbuf[CMSG_SPACE(3 * sizeof(int))];
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+
+	if (nfds > 3)
+		return 1;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(cbuf, 0, sizeof(cbuf));
+	iov.iov_base = (void *)buf;
+	iov.iov_len = len;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+	memcpy(CMSG_DATA(cmsg), fds, nfds * sizeof(int));
+
+	if (sendmsg(sockfd, &msg, MSG_NOSIGNAL) != (ssize_t)len) {
+		lwsl_err("%s: sendmsg failed %d\n", __func__, errno);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Nonblocking read that also collects any fds that came with the data.
+ * Returns the amount read, 0 if the peer closed or -1 on error, including
+ * if there was nothing to read yet (errno is EAGAIN then).
+ */
+
+ssize_t
+lws_ss_shm_recv_fds(int sockfd, uint8_t *buf, size_t len, int *fds, int *nfds)
+{
+	char cbuf[CMSG_SPACE(3 * sizeof(int))];
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	ssize_t n;
+	int m;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = buf;
+	iov.iov_len = len;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+
+	*nfds = 0;
+	n = recvmsg(sockfd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+	if (n < 0)
+		return -1;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+		    cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+
+		/* cbuf only has room for 3, the kernel drops any others */
+		m = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+		if (m > 3 - *nfds)
+			m = 3 - *nfds;
+		memcpy(&fds[*nfds], CMSG_DATA(cmsg), (size_t)m * sizeof(int));
+		*nfds += m;
+	}
+
+	if (msg.msg_flags & MSG_CTRUNC) {
+		/* not something we asked for */
+		while (*nfds)
+			close(fds[--(*nfds)]);
+		*nfds = -1;
+	}
+
+	return n;
+}
@@ -394,10 +394,6 @@ skip:
 
 	q->tid &= 0xfffe;
 	q->asked = q->responded = 0;
-#if defined(LWS_WITH_IPV6)
-	q->sent[1] = 0;
-#endif
-	q->sent[0] = 0;
 	q->recursion++;
 	if (q->recursion == DNS_RECURSION_LIMIT) {
 		lwsl_err("%s: recursion overflow\n", __func__);
@@ -423,7 +419,9 @@ skip:
 		*cp = '\0';
 	}
 
-	lws_callback_on_writable(q->dns->wsi);
+	/* ask the servers afresh, starting with the best one */
+
+	lws_adns_q_start(q);
 
 	return 2;
 }
@@ -528,13 +526,15 @@ lws_async_dns_store(const char *name, void *opaque, uint32_t ttl,
  */
 
 void
-lws_adns_parse_udp(lws_async_dns_t *dns, const uint8_t *pkt, size_t len)
+lws_adns_parse_udp(lws_async_dns_t *dns, int srv, const uint8_t *pkt,
+		   size_t len)
 {
 	const char *nm, *nmcname;
 	lws_adns_cache_t *c;
 	struct adstore adst;
 	lws_adns_q_t *q;
 	int n, ncname;
+	lws_usec_t ttl;
 	size_t est;
 
 	// lwsl_hexdump_notice(pkt, len);
@@ -560,12 +560,20 @@ lws_adns_parse_udp(lws_async_dns_t *dns, const uint8_t *pkt, size_t len)
 		return;
 	}
 
-	/* we can get dups... drop any that have already happened */
+	/* even if it's a dup, it tells us how the server is doing */
+
+	if (srv >= 0)
+		lws_adns_server_answered(dns, q, srv);
+
+	/*
+	 * We can get dups, eg, when we asked more than one server... drop any
+	 * that have already happened, but the query itself is still alive
+	 */
 
 	n = 1 << (lws_ser_ru16be(pkt + DHO_TID) & 1);
 	if (q->responded & n) {
-		lwsl_notice("%s: dup\n", __func__);
-		goto fail_out;
+		lwsl_info("%s: dup\n", __func__);
+		return;
 	}
 
 	q->responded |= n;
@@ -673,10 +681,21 @@ lws_adns_parse_udp(lws_async_dns_t *dns, const uint8_t *pkt, size_t len)
 		 */
 
 		c->flags = adst.flags;
-		lws_dll2_add_head(&c->list, &dns->cached);
-		lws_sul_schedule(q->context, 0, &c->sul, sul_cb_expire,
-				 lws_now_usecs() +
-				 (adst.smallest_ttl * LWS_US_PER_SEC));
+		c->name = adst.name;
+		c->context = q->context;
+		c->qtype = q->qtype;
+		lws_adns_cache_register(dns, c);
+
+		/*
+		 * If refresh-ahead is enabled, the sul first fires when
+		 * prefetch_pc % of the TTL is left, and then again at expiry
+		 */
+
+		ttl = (lws_usec_t)adst.smallest_ttl * LWS_US_PER_SEC;
+		c->expiry = lws_now_usecs() + ttl;
+		if (dns->prefetch_pc && dns->prefetch_pc < 100)
+			ttl -= (ttl * dns->prefetch_pc) / 100;
+		lws_sul_schedule(q->context, 0, &c->sul, sul_cb_expire, ttl);
 	}
 
 	if (q->responded != q->asked)
@@ -687,7 +706,8 @@ lws_adns_parse_udp(lws_async_dns_t *dns, const uint8_t *pkt, size_t len)
 	 * addrinfo results, if any, to all interested wsi, if any...
 	 */
 
-	c->incomplete = 0;
+	q->firstcache->incomplete = 0;
+	lws_adns_cache_supersede(dns, q->firstcache);
 	lws_async_dns_complete(q, q->firstcache);
 
 	/*
@@ -69,9 +69,16 @@ lws_adns_get_query(lws_async_dns_t *dns, adns_query_type_t qtype,
 void
 lws_async_dns_drop_server(struct lws_context *context)
 {
-	context->async_dns.dns_server_set = 0;
-	lws_set_timeout(context->async_dns.wsi, 1, LWS_TO_KILL_ASYNC);
-	context->async_dns.wsi = NULL;
+	lws_async_dns_t *dns = &context->async_dns;
+	int n;
+
+	dns->dns_server_set = 0;
+	for (n = 0; n < dns->count_servers; n++)
+		if (dns->server[n].wsi) {
+			lws_set_timeout(dns->server[n].wsi, 1,
+					LWS_TO_KILL_ASYNC);
+			dns->server[n].wsi = NULL;
+		}
 }
 
 int
@@ -106,140 +113,285 @@ lws_async_dns_complete(lws_adns_q_t *q, lws_adns_cache_t *c)
 	return 0;
 }
 
-static void
-lws_async_dns_sul_cb_retry(struct lws_sorted_usec_list *sul)
+static int
+lws_adns_server_index(lws_async_dns_t *dns, struct lws *wsi)
 {
-	lws_adns_q_t *q = lws_container_of(sul, lws_adns_q_t, sul);
+	int n;
+
+	for (n = 0; n < dns->count_servers; n++)
+		if (dns->server[n].wsi == wsi)
+			return n;
+
+	return -1;
+}
+
+/*
+ * Servers are ranked by their smoothed rtt, doubled for each query they were
+ * recently slow or silent on, so a dead server sinks quickly and a recovered
+ * one comes back as soon as it answers something.
+ */
+
+static int
+lws_adns_server_best(lws_async_dns_t *dns, uint8_t exclude)
+{
+	lws_usec_t score, best = 0;
+	int n, b = -1;
+
+	for (n = 0; n < dns->count_servers; n++) {
+		lws_adns_server_t *s = &dns->server[n];
+
+		if (!s->wsi || (exclude & (1 << n)))
+			continue;
+
+		score = (s->srtt_us ? s->srtt_us : DNS_HEDGE_DEF_US) <<
+						(s->fails > 6 ? 6 : s->fails);
+		if (b < 0 || score < best) {
+			best = score;
+			b = n;
+		}
+	}
+
+	return b;
+}
+
+static lws_usec_t
+lws_adns_hedge_us(lws_adns_server_t *s)
+{
+	lws_usec_t us = s->srtt_us ? 2 * s->srtt_us : DNS_HEDGE_DEF_US;
 
-	// lwsl_notice("%s\n", __func__);
+	if (us < DNS_HEDGE_MIN_US)
+		return DNS_HEDGE_MIN_US;
 
-	lws_callback_on_writable(q->dns->wsi);
+	return us > DNS_HEDGE_MAX_US ? DNS_HEDGE_MAX_US : us;
+}
+
+void
+lws_adns_server_answered(lws_async_dns_t *dns, lws_adns_q_t *q, int srv)
+{
+	lws_adns_server_t *s = &dns->server[srv];
+	lws_usec_t rtt;
+
+	s->fails = 0;
+
+	/* like tcp, we can't tell which write a retransmit's answer is for */
+
+	if (!(q->srv_sent & (1 << srv)) || (q->srv_resent & (1 << srv)))
+		return;
+
+	rtt = lws_now_usecs() - q->us_sent[srv];
+	s->srtt_us = s->srtt_us ? (7 * s->srtt_us + rtt) / 8 : rtt;
 }
 
 static void
-lws_async_dns_writeable(struct lws *wsi, lws_adns_q_t *q)
+lws_adns_q_fail(lws_adns_q_t *q)
 {
-	uint8_t pkt[LWS_PRE + DNS_PACKET_LEN], *e = &pkt[sizeof(pkt)], *p, *pl;
-	int m, n, which;
-	const char *name;
+	lwsl_warn("%s: failing query doing NULL completion\n", __func__);
+	/*
+	 * in ipv6 case, we made a cache entry for the first response but
+	 * evidently the second response didn't come in time, purge the
+	 * incomplete cache entry
+	 */
+	if (q->firstcache)
+		lws_adns_cache_destroy(q->firstcache);
+	lws_async_dns_complete(q, NULL);
+	lws_adns_q_destroy(q);
+}
 
-	// lwsl_notice("%s: %p\n", __func__, q);
+static void
+lws_adns_q_send(lws_adns_q_t *q, int srv)
+{
+	q->srv_tx |= 1 << srv;
+	lws_callback_on_writable(q->dns->server[srv].wsi);
+}
+
+static void
+lws_async_dns_sul_cb_retry(struct lws_sorted_usec_list *sul)
+{
+	lws_adns_q_t *q = lws_container_of(sul, lws_adns_q_t, sul);
+	lws_async_dns_t *dns = q->dns;
+	unsigned int ms;
+	char conceal;
+	int n;
+
+	/* the servers we asked so far didn't answer in time */
+
+	for (n = 0; n < dns->count_servers; n++)
+		if ((q->srv_sent & ~q->srv_slow) & (1 << n)) {
+			q->srv_slow |= 1 << n;
+			if (dns->server[n].fails != 0xff)
+				dns->server[n].fails++;
+		}
 
 	/*
-	 * UDP is not reliable, it can be locally dropped, or dropped
-	 * by any intermediary or the remote peer.  So even though we
-	 * will do the write in a moment, we schedule another request
-	 * for rewrite according to the wsi retry policy.
-	 *
-	 * If the result came before, we'll cancel it as part of the
-	 * wsi close.
-	 *
-	 * If we have already reached the end of our concealed retries
-	 * in the policy, just close without another write.
+	 * If there's a server we didn't ask yet, race the best of those
+	 * against the ones we're already waiting on
 	 */
-	if (lws_dll2_is_detached(&q->sul.list) &&
-	    lws_retry_sul_schedule_retry_wsi(wsi, &q->sul,
-				       lws_async_dns_sul_cb_retry, &q->retry)) {
-		/* we have reached the end of our concealed retries */
+
+	n = lws_adns_server_best(dns, q->srv_sent);
+	if (n >= 0) {
+		lwsl_info("%s: hedging to server %d\n", __func__, n);
+		lws_adns_q_send(q, n);
+		lws_sul_schedule(q->context, q->tsi, &q->sul,
+				 lws_async_dns_sul_cb_retry,
+				 lws_adns_hedge_us(&dns->server[n]));
+
+		return;
+	}
+
+	/*
+	 * Everybody was asked.  UDP is not reliable, it can be locally
+	 * dropped, or dropped by any intermediary or the remote peer.  So we
+	 * ask them all again according to our retry policy, until we reach
+	 * the end of our concealed retries.
+	 */
+
+	ms = lws_retry_get_delay_ms(q->context, &retry_policy, &q->retry,
+				    &conceal);
+	if (!conceal) {
 		lwsl_notice("%s: failing query\n", __func__);
 		/*
 		 * our policy is to force reloading the dns server info
 		 * if our connection ever timed out, in case it or the
 		 * routing state changed
 		 */
-
 		lws_async_dns_drop_server(q->context);
-		goto qfail;
+		lws_adns_q_fail(q);
+
+		return;
 	}
 
-	name = (const char *)&q[1];
+	if (!dns->dns_server_set)
+		/* we lost them all, maybe the config changed */
+		lws_async_dns_init(q->context);
+
+	for (n = 0; n < dns->count_servers; n++)
+		if (dns->server[n].wsi) {
+			if (q->srv_sent & (1 << n))
+				q->srv_resent |= 1 << n;
+			lws_adns_q_send(q, n);
+		}
+
+	lws_sul_schedule(q->context, q->tsi, &q->sul,
+			 lws_async_dns_sul_cb_retry, ms * LWS_US_PER_MS);
+}
 
-	p = &pkt[LWS_PRE];
-	memset(p, 0, DHO_SIZEOF);
+/*
+ * (Re)start asking about the query, first writing to the best server we have
+ * right away, and arming the hedge timer for if it doesn't answer.
+ */
+
+void
+lws_adns_q_start(lws_adns_q_t *q)
+{
+	lws_async_dns_t *dns = q->dns;
+	int n;
+
+	q->srv_tx = q->srv_sent = q->srv_resent = q->srv_slow = 0;
+	q->retry = 0;
+
+	n = lws_adns_server_best(dns, 0);
+	if (n < 0) {
+		/* no usable server right now, go straight to the retry flow */
+		lws_sul_schedule(q->context, q->tsi, &q->sul,
+				 lws_async_dns_sul_cb_retry, 1);
+
+		return;
+	}
+
+	lws_adns_q_send(q, n);
+	lws_sul_schedule(q->context, q->tsi, &q->sul,
+			 lws_async_dns_sul_cb_retry,
+			 dns->count_servers > 1 ?
+				lws_adns_hedge_us(&dns->server[n]) :
+				/* nobody to hedge to, just use the policy */
+				retry_policy.retry_ms_table[0] * LWS_US_PER_MS);
+}
+
+static void
+lws_async_dns_writeable(struct lws *wsi, lws_adns_q_t *q, int srv)
+{
+	uint8_t pkt[LWS_PRE + DNS_PACKET_LEN], *e = &pkt[sizeof(pkt)], *p, *pl;
+	int m, n, which;
+	const char *name;
+
+	// lwsl_notice("%s: %p\n", __func__, q);
+
+	q->srv_tx &= ~(1 << srv);
+	q->srv_sent |= 1 << srv;
+	q->us_sent[srv] = lws_now_usecs();
 
 #if defined(LWS_WITH_IPV6)
-	if (!q->responded) {
-		/* must pick between ipv6 and ipv4 */
-		which = q->sent[0] >= q->sent[1];
-		q->sent[which]++;
-		q->asked = 3; /* want results for 4 & 6 before done */
-	} else
-		which = q->responded & 1;
+	q->asked = 3; /* want results for 4 & 6 before done */
 #else
-	which = 0;
 	q->asked = 1;
 #endif
 
-	/* we hack b0 of the tid to be 0 = A, 1 = AAAA */
+	/*
+	 * Ask for both A and AAAA back-to-back, skipping any we already have
+	 * the answer for
+	 */
 
-	lws_ser_wu16be(&p[DHO_TID],
-#if defined(LWS_WITH_IPV6)
-			which ? q->tid | 1 :
-#endif
-			q->tid);
-	lws_ser_wu16be(&p[DHO_FLAGS], (1 << 8));
-	lws_ser_wu16be(&p[DHO_NQUERIES], 1);
+	for (which = 0; which < 2; which++) {
 
-	p += DHO_SIZEOF;
+		if (!(q->asked & (1 << which)) || (q->responded & (1 << which)))
+			continue;
 
-	/* start of label-formatted qname */
+		name = (const char *)&q[1];
 
-	pl = p++;
+		p = &pkt[LWS_PRE];
+		memset(p, 0, DHO_SIZEOF);
 
-	do {
-		if (*name == '.' || !*name) {
-			*pl = lws_ptr_diff(p, pl + 1);
-			pl = p;
-			*p++ = 0; /* also serves as terminal length */
-			if (!*name++)
-				break;
-		} else
-			*p++ = *name++;
-	} while (p + 6 < e);
+		/* we hack b0 of the tid to be 0 = A, 1 = AAAA */
 
-	if (p + 6 >= e) {
-		assert(0);
-		lwsl_err("%s: name too big\n", __func__);
-		goto qfail;
-	}
+		lws_ser_wu16be(&p[DHO_TID], which ? q->tid | 1 : q->tid);
+		lws_ser_wu16be(&p[DHO_FLAGS], (1 << 8));
+		lws_ser_wu16be(&p[DHO_NQUERIES], 1);
 
-	lws_ser_wu16be(p, which ? LWS_ADNS_RECORD_AAAA :
-				     LWS_ADNS_RECORD_A);
-	p += 2;
+		p += DHO_SIZEOF;
 
-	lws_ser_wu16be(p, 1); /* IN class */
-	p += 2;
+		/* start of label-formatted qname */
 
-	assert(p < pkt + sizeof(pkt) - LWS_PRE);
-	n = lws_ptr_diff(p, pkt + LWS_PRE);
-	m = lws_write(wsi, pkt + LWS_PRE, n, 0);
-	if (m != n) {
-		lwsl_notice("%s: dns write failed %d %d\n", __func__,
-			    m, n);
-		goto qfail;
-	}
+		pl = p++;
 
-#if defined(LWS_WITH_IPV6)
-	if (!q->responded && q->sent[0] != q->sent[1])
-		lws_callback_on_writable(wsi);
-#endif
+		do {
+			if (*name == '.' || !*name) {
+				*pl = lws_ptr_diff(p, pl + 1);
+				pl = p;
+				*p++ = 0; /* also serves as terminal length */
+				if (!*name++)
+					break;
+			} else
+				*p++ = *name++;
+		} while (p + 6 < e);
 
-	/* if we did anything, check one more time */
-	lws_callback_on_writable(wsi);
+		if (p + 6 >= e) {
+			assert(0);
+			lwsl_err("%s: name too big\n", __func__);
+			lws_adns_q_fail(q);
 
-	return;
+			return;
+		}
 
-qfail:
-	lwsl_warn("%s: failing query doing NULL completion\n", __func__);
-	/*
-	 * in ipv6 case, we made a cache entry for the first response but
-	 * evidently the second response didn't come in time, purge the
-	 * incomplete cache entry
-	 */
-	if (q->firstcache)
-		lws_adns_cache_destroy(q->firstcache);
-	lws_async_dns_complete(q, NULL);
-	lws_adns_q_destroy(q);
+		lws_ser_wu16be(p, which ? LWS_ADNS_RECORD_AAAA :
+					  LWS_ADNS_RECORD_A);
+		p += 2;
+
+		lws_ser_wu16be(p, 1); /* IN class */
+		p += 2;
+
+		assert(p < pkt + sizeof(pkt) - LWS_PRE);
+		n = lws_ptr_diff(p, pkt + LWS_PRE);
+		m = lws_write(wsi, pkt + LWS_PRE, n, 0);
+		if (m != n) {
+			lwsl_notice("%s: dns write failed %d %d\n", __func__,
+				    m, n);
+			/* don't wait for the hedge timer to move on */
+			lws_sul_schedule(q->context, q->tsi, &q->sul,
+					 lws_async_dns_sul_cb_retry, 1);
+
+			return;
+		}
+	}
 }
 
 static int
@@ -247,6 +399,7 @@ callback_async_dns(struct lws *wsi, enum lws_callback_reasons reason,
 		   void *user, void *in, size_t len)
 {
 	struct lws_async_dns *dns = &(lws_get_context(wsi)->async_dns);
+	int n;
 
 	switch (reason) {
 
@@ -258,25 +411,56 @@ callback_async_dns(struct lws *wsi, enum lws_callback_reasons reason,
 
 	case LWS_CALLBACK_RAW_CLOSE:
 		// lwsl_user("LWS_CALLBACK_RAW_CLOSE\n");
+		n = lws_adns_server_index(dns, wsi);
+		if (n < 0)
+			break;
+
+		/*
+		 * Eg, an ICMP port unreachable came back on our connected
+		 * udp socket.  Queries waiting on this server can move on to
+		 * the next one now, rather than when their timer expires.
+		 */
+
+		lwsl_info("%s: lost server %d\n", __func__, n);
+		dns->server[n].wsi = NULL;
+		if (dns->server[n].fails != 0xff)
+			dns->server[n].fails++;
+		if (lws_adns_server_best(dns, 0) < 0)
+			dns->dns_server_set = 0;
+
+		lws_start_foreach_dll_safe(struct lws_dll2 *, d, d1,
+					   dns->waiting.head) {
+			lws_adns_q_t *q = lws_container_of(d, lws_adns_q_t,
+							   list);
+
+			q->srv_tx &= ~(1 << n);
+			if ((q->srv_sent & (1 << n)) &&
+			    lws_adns_server_best(dns, q->srv_sent) >= 0)
+				lws_sul_schedule(q->context, q->tsi, &q->sul,
+						 lws_async_dns_sul_cb_retry, 1);
+		} lws_end_foreach_dll_safe(d, d1);
 		break;
 
 	case LWS_CALLBACK_RAW_RX:
 		// lwsl_user("LWS_CALLBACK_RAW_RX (%d)\n", (int)len);
 		// lwsl_hexdump_level(LLL_NOTICE, in, len);
-		lws_adns_parse_udp(dns, in, len);
+		lws_adns_parse_udp(dns, lws_adns_server_index(dns, wsi),
+				   in, len);
 		break;
 
 	case LWS_CALLBACK_RAW_WRITEABLE:
 		// lwsl_notice("%s: WRITABLE\n", __func__);
+		n = lws_adns_server_index(dns, wsi);
+		if (n < 0)
+			break;
 
 		lws_start_foreach_dll_safe(struct lws_dll2 *, d, d1,
 					   dns->waiting.head) {
 			lws_adns_q_t *q = lws_container_of(d, lws_adns_q_t,
 							   list);
 
-			if (lws_dll2_is_detached(&q->sul.list) &&
-			    (!q->asked || q->responded != q->asked))
-				lws_async_dns_writeable(wsi, q);
+			if (q->srv_tx & (1 << n))
+				lws_async_dns_writeable(wsi, q, n);
 		} lws_end_foreach_dll_safe(d, d1);
 		break;
 
@@ -291,78 +475,195 @@ struct lws_protocols lws_async_dns_protocol = {
 	"lws-async-dns", callback_async_dns, 0, 0
 };
 
+int
+lws_async_dns_parse_servers(const char *list, lws_sockaddr46 *sa46, int max)
+{
+	int count = 0;
+	char ads[48];
+	size_t l;
+
+	while (*list && count < max) {
+		l = strcspn(list, ", ");
+		if (l && l < sizeof(ads)) {
+			memcpy(ads, list, l);
+			ads[l] = '\0';
+			if (!lws_sa46_parse_numeric_address(ads, &sa46[count]))
+				count++;
+			else
+				lwsl_warn("%s: ignoring '%s'\n", __func__, ads);
+		}
+		list += l;
+		list += strspn(list, ", ");
+	}
+
+	return count;
+}
+
 int
 lws_async_dns_init(struct lws_context *context)
 {
+	lws_adns_server_t old[LWS_ADNS_MAX_SERVERS];
+	lws_sockaddr46 sa46[LWS_ADNS_MAX_SERVERS];
 	lws_async_dns_t *dns = &context->async_dns;
+	int n, m, count = 0, ok = 0;
 	char ads[48];
-	int n;
 
-	memset(&dns->sa46, 0, sizeof(dns->sa46));
+	memset(sa46, 0, sizeof(sa46));
+
+	/* servers given at context creation take precedence */
+
+	if (dns->servers)
+		count = lws_async_dns_parse_servers(dns->servers, sa46,
+						    LWS_ARRAY_SIZE(sa46));
 
 #if defined(LWS_WITH_SYS_DHCP_CLIENT)
-	if (lws_dhcpc_status(context, &dns->sa46))
-		goto ok;
+	if (!count && lws_dhcpc_status(context, &sa46[0]))
+		count = 1;
 #endif
 
-	n = lws_plat_asyncdns_init(context, &dns->sa46);
-	if (n < 0) {
+	if (!count)
+		count = lws_plat_asyncdns_init(context, sa46,
+					       LWS_ARRAY_SIZE(sa46));
+	if (count <= 0) {
 		lwsl_warn("%s: no valid dns server, retry\n", __func__);
 
 		return 1;
 	}
 
-	if (n != LADNS_CONF_SERVER_CHANGED)
-		return 0;
+	/*
+	 * Keep what we learned about, and any socket we still have to,
+	 * servers that are still in the new list
+	 */
 
-#if defined(LWS_WITH_SYS_DHCP_CLIENT)
-ok:
-#endif
-	dns->sa46.sa4.sin_port = htons(53);
-	lws_write_numeric_address((uint8_t *)&dns->sa46.sa4.sin_addr.s_addr, 4,
-				  ads, sizeof(ads));
-
-	context->async_dns.wsi = lws_create_adopt_udp(context->vhost_list, ads,
-				      53, 0, lws_async_dns_protocol.name, NULL,
-				      NULL, NULL, &retry_policy);
-	if (!dns->wsi) {
-		lwsl_err("%s: foreign socket adoption failed\n", __func__);
-		return 1;
+	memcpy(old, dns->server, sizeof(old));
+	m = dns->count_servers;
+	memset(dns->server, 0, sizeof(dns->server));
+
+	for (n = 0; n < count; n++) {
+		lws_adns_server_t *s = &dns->server[n];
+		int i;
+
+		s->sa46 = sa46[n];
+		for (i = 0; i < m; i++)
+			if (!lws_sa46_compare_ads(&old[i].sa46, &s->sa46)) {
+				s->srtt_us = old[i].srtt_us;
+				s->wsi = old[i].wsi;
+				old[i].wsi = NULL;
+				break;
+			}
+
+		if (!s->wsi) {
+			lws_sa46_write_numeric_address(&s->sa46, ads,
+						       sizeof(ads));
+			s->wsi = lws_create_adopt_udp(context->vhost_list, ads,
+					53, 0, lws_async_dns_protocol.name,
+					NULL, NULL, NULL, &retry_policy);
+			if (!s->wsi) {
+				lwsl_err("%s: foreign socket adoption "
+					 "failed for %s\n", __func__, ads);
+				continue;
+			}
+		}
+		ok++;
 	}
+	dns->count_servers = count;
+
+	for (n = 0; n < m; n++)
+		if (old[n].wsi)
+			lws_set_timeout(old[n].wsi, 1, LWS_TO_KILL_ASYNC);
+
+	if (!ok)
+		return 1;
 
 	dns->dns_server_set = 1;
 
 	return 0;
 }
 
+/* case-insensitive fnv-1a, names are compared with strcasecmp() */
+
+static uint32_t
+lws_adns_name_hash(const char *name)
+{
+	uint32_t h = 0x811c9dc5;
+
+	while (*name) {
+		h ^= (uint8_t)tolower(*name++);
+		h *= 0x01000193;
+	}
+
+	return h;
+}
+
+void
+lws_adns_cache_register(lws_async_dns_t *dns, lws_adns_cache_t *c)
+{
+	c->hash = lws_adns_name_hash(c->name);
+
+	lws_dll2_add_head(&c->list, &dns->cached);
+	lws_dll2_add_head(&c->hash_list,
+			  &dns->cached_hash[c->hash & (LWS_ADNS_CACHE_HASH - 1)]);
+}
+
 lws_adns_cache_t *
 lws_adns_get_cache(lws_async_dns_t *dns, const char *name)
 {
 	lws_adns_cache_t *c;
-	const char *cn;
+	uint32_t h;
 
-	lws_start_foreach_dll_safe(struct lws_dll2 *, d, d1,
-				   lws_dll2_get_head(&dns->cached)) {
-		c = lws_container_of(d, lws_adns_cache_t, list);
-		cn = (const char *)&c[1];
+	if (!name)
+		return NULL;
+
+	h = lws_adns_name_hash(name);
 
-		if (name && !c->incomplete && !strcasecmp(name, cn)) {
+	lws_start_foreach_dll(struct lws_dll2 *, d,
+		lws_dll2_get_head(&dns->cached_hash[h & (LWS_ADNS_CACHE_HASH - 1)])) {
+		c = lws_container_of(d, lws_adns_cache_t, hash_list);
+
+		if (c->hash == h && !c->incomplete && !c->superseded &&
+		    !strcasecmp(name, c->name)) {
 			/* Keep sorted by LRU: move to the head */
 			lws_dll2_remove(&c->list);
 			lws_dll2_add_head(&c->list, &dns->cached);
 
 			return c;
 		}
-	} lws_end_foreach_dll_safe(d, d1);
+	} lws_end_foreach_dll(d);
 
 	return NULL;
 }
 
+/*
+ * c just completed for a name that may already have older cache entries, ie,
+ * it's the result of a refresh.  Drop the older ones, or if they're still
+ * referenced, stop handing them out and let them expire.
+ */
+
+void
+lws_adns_cache_supersede(lws_async_dns_t *dns, lws_adns_cache_t *c)
+{
+	lws_start_foreach_dll_safe(struct lws_dll2 *, d, d1,
+		lws_dll2_get_head(&dns->cached_hash[c->hash &
+						    (LWS_ADNS_CACHE_HASH - 1)])) {
+		lws_adns_cache_t *c1 = lws_container_of(d, lws_adns_cache_t,
+							hash_list);
+
+		if (c1 != c && c1->hash == c->hash &&
+		    !strcasecmp(c1->name, c->name)) {
+			if (c1->refcount)
+				c1->superseded = 1;
+			else
+				lws_adns_cache_destroy(c1);
+		}
+	} lws_end_foreach_dll_safe(d, d1);
+}
+
 void
 lws_adns_cache_destroy(lws_adns_cache_t *c)
 {
 	lws_dll2_remove(&c->sul.list);
 	lws_dll2_remove(&c->list);
+	lws_dll2_remove(&c->hash_list);
 	if (c->chain)
 		lws_free(c->chain);
 	lws_free(c);
@@ -376,10 +677,47 @@ cache_clean(struct lws_dll2 *d, void *user)
 	return 0;
 }
 
+static lws_async_dns_retcode_t
+lws_async_dns_lookup(struct lws_context *context, int tsi, const char *name,
+		     adns_query_type_t qtype, lws_async_dns_cb_t cb,
+		     struct lws *wsi, void *opaque, int prefetch);
+
+static struct lws *
+lws_adns_prefetch_cb(struct lws *wsi, const char *ads,
+		     const struct addrinfo *result, int n, void *opaque)
+{
+	/* the refreshed results are in the cache, we don't use them here */
+	lws_async_dns_freeaddrinfo(&result);
+
+	return NULL;
+}
+
 void
 sul_cb_expire(struct lws_sorted_usec_list *sul)
 {
 	lws_adns_cache_t *c = lws_container_of(sul, lws_adns_cache_t, sul);
+	lws_usec_t now = lws_now_usecs();
+
+	if (c->expiry > now) {
+		/*
+		 * This is the refresh-ahead point rather than the expiry.  If
+		 * the entry was used from the cache, look it up again in the
+		 * background so the refreshed result is there before this
+		 * one goes away.
+		 */
+		if (c->hits && !c->superseded) {
+			lwsl_info("%s: prefetching %s\n", __func__, c->name);
+			lws_stats_bump(&c->context->pt[0],
+				       LWSSTATS_C_ADNS_PREFETCH, 1);
+			lws_async_dns_lookup(c->context, 0, c->name,
+					     (adns_query_type_t)c->qtype,
+					     lws_adns_prefetch_cb, NULL, NULL, 1);
+		}
+		lws_sul_schedule(c->context, 0, &c->sul, sul_cb_expire,
+				 c->expiry - now);
+
+		return;
+	}
 
 	lws_adns_cache_destroy(c);
 }
@@ -521,10 +859,10 @@ struct temp_q {
 	char name[48];
 };
 
-lws_async_dns_retcode_t
-lws_async_dns_query(struct lws_context *context, int tsi, const char *name,
-		    adns_query_type_t qtype, lws_async_dns_cb_t cb,
-		    struct lws *wsi, void *opaque)
+static lws_async_dns_retcode_t
+lws_async_dns_lookup(struct lws_context *context, int tsi, const char *name,
+		     adns_query_type_t qtype, lws_async_dns_cb_t cb,
+		     struct lws *wsi, void *opaque, int prefetch)
 {
 	lws_async_dns_t *dns = &context->async_dns;
 	size_t nlen = strlen(name);
@@ -569,11 +907,18 @@ lws_async_dns_query(struct lws_context *context, int tsi, const char *name,
 		wsi->adns_cb = cb;
 	}
 
-	/* there's a done, cached query we can just reuse? */
+	/*
+	 * there's a done, cached query we can just reuse?  A prefetch wants
+	 * to go to the server even though it's still in the cache.
+	 */
 
-	c = lws_adns_get_cache(dns, name);
+	c = prefetch ? NULL : lws_adns_get_cache(dns, name);
 	if (c) {
-		lwsl_err("%s: using cached, c->results %p\n", __func__, c->results);
+		lwsl_info("%s: using cached, c->results %p\n", __func__,
+			  c->results);
+		lws_stats_bump(&context->pt[tsi], LWSSTATS_C_ADNS_CACHE_HIT, 1);
+		if (c->hits != 0xffff)
+			c->hits++;
 		m = c->results ? LADNS_RET_FOUND : LADNS_RET_FAILED;
 		if (c->results)
 			c->refcount++;
@@ -612,6 +957,8 @@ lws_async_dns_query(struct lws_context *context, int tsi, const char *name,
 		ai->ai_canonname = (char *)&sa46[1];
 
 		c->results = ai;
+		c->name = (const char *)&sa46[1];
+		c->context = context;
 		memset(&tmq.tq, 0, sizeof(tmq.tq));
 		tmq.tq.opaque = opaque;
 		if (wsi) {
@@ -621,9 +968,9 @@ lws_async_dns_query(struct lws_context *context, int tsi, const char *name,
 			tmq.tq.standalone_cb = cb;
 		lws_strncpy(tmq.name, name, sizeof(tmq.name));
 
-		lws_dll2_add_head(&c->list, &dns->cached);
+		lws_adns_cache_register(dns, c);
 		lws_sul_schedule(context, 0, &c->sul, sul_cb_expire,
-				 lws_now_usecs() + (3600ll * LWS_US_PER_SEC));
+				 3600ll * LWS_US_PER_SEC);
 	}
 
 	if (m == 4) {
@@ -650,6 +997,9 @@ lws_async_dns_query(struct lws_context *context, int tsi, const char *name,
 	}
 #endif
 
+	if (!prefetch)
+		lws_stats_bump(&context->pt[tsi], LWSSTATS_C_ADNS_CACHE_MISS, 1);
+
 	/*
 	 * to try anything else we need a remote server configured...
 	 */
@@ -715,11 +1065,6 @@ lws_async_dns_query(struct lws_context *context, int tsi, const char *name,
 	if (!wsi)
 		q->standalone_cb = cb;
 
-	/* schedule a retry according to the retry policy on the wsi */
-	if (lws_retry_sul_schedule_retry_wsi(dns->wsi, &q->sul,
-					 lws_async_dns_sul_cb_retry, &q->retry))
-		goto failed;
-
 	/*
 	 * We may rewrite the copy at +sizeof(*q) for CNAME recursion.  Keep
 	 * a second copy at + sizeof(*q) + DNS_MAX so we can create the cache
@@ -734,9 +1079,8 @@ lws_async_dns_query(struct lws_context *context, int tsi, const char *name,
 	*p = '\0';
 	p[DNS_MAX] = '\0';
 
-	lws_callback_on_writable(dns->wsi);
-
 	lws_dll2_add_head(&q->list, &dns->waiting);
+	lws_adns_q_start(q);
 
 	lwsl_debug("%s: created new query\n", __func__);
 
@@ -747,3 +1091,12 @@ failed:
 
 	return LADNS_RET_FAILED;
 }
+
+lws_async_dns_retcode_t
+lws_async_dns_query(struct lws_context *context, int tsi, const char *name,
+		    adns_query_type_t qtype, lws_async_dns_cb_t cb,
+		    struct lws *wsi, void *opaque)
+{
+	return lws_async_dns_lookup(context, tsi, name, qtype, cb, wsi,
+				    opaque, 0);
+}
@@ -29,6 +29,15 @@
 #define MAX_CACHE_ENTRIES	10	/* Dont cache more than that	*/
 #define DNS_QUERY_TIMEOUT	30	/* Query timeout, seconds	*/
 
+/*
+ * If the server we asked hasn't answered in 2 x its smoothed rtt, we also ask
+ * the next best one (the "hedge"), clamped to these.  Until we have an rtt
+ * for a server, we assume it's DNS_HEDGE_DEF_US.
+ */
+#define DNS_HEDGE_MIN_US	(20 * LWS_US_PER_MS)
+#define DNS_HEDGE_DEF_US	(250 * LWS_US_PER_MS)
+#define DNS_HEDGE_MAX_US	(1000 * LWS_US_PER_MS)
+
 /*
  * ... when we completed a query then the query object is destroyed and a
  * cache object below is created with the results in getaddrinfo format
@@ -38,14 +47,22 @@
 typedef struct lws_adns_cache {
 	lws_sorted_usec_list_t	sul;	/* for cache TTL management */
 	lws_dll2_t		list;
+	lws_dll2_t		hash_list; /* in dns->cached_hash[] bucket */
 
+	struct lws_context	*context;
 	struct lws_adns_cache	*firstcache;
 	struct lws_adns_cache	*chain;
 	struct addrinfo		*results;
+	const char		*name;	/* points into the overallocation */
+	lws_usec_t		expiry;	/* 0, or when the TTL runs out */
+	uint32_t		hash;	/* of name, case-insensitive */
+	uint16_t		hits;	/* times it was used from the cache */
+	uint16_t		qtype;
 	uint8_t			flags;	/* b0 = has ipv4, b1 = has ipv6 */
 	char			refcount;
 	char			incomplete;
-	/* name, and then result struct addrinfos overallocated here */
+	char			superseded; /* a refresh of it completed */
+	/* result struct addrinfos, and name, overallocated here */
 } lws_adns_cache_t;
 
 /*
@@ -53,7 +70,7 @@ typedef struct lws_adns_cache {
  */
 
 typedef struct {
-	lws_sorted_usec_list_t	sul;	/* per-query write retry timer */
+	lws_sorted_usec_list_t	sul;	/* per-query hedge / retry timer */
 	lws_dll2_t		list;
 
 	lws_dll2_owner_t	wsi_adns;
@@ -65,17 +82,20 @@ typedef struct {
 
 	lws_adns_cache_t	*firstcache;
 
+	lws_usec_t		us_sent[LWS_ADNS_MAX_SERVERS];
+
 	lws_async_dns_retcode_t	ret;
 	uint16_t		tid;
 	uint16_t		qtype;
 	uint16_t		retry;
 	uint8_t			tsi;
 
-#if defined(LWS_WITH_IPV6)
-	uint8_t			sent[2];
-#else
-	uint8_t			sent[1];
-#endif
+	/* bitmaps of dns->server[] indexes */
+	uint8_t			srv_tx;	  /* want to write to it */
+	uint8_t			srv_sent; /* written to it at least once */
+	uint8_t			srv_resent; /* written more than once */
+	uint8_t			srv_slow; /* charged it a fail already */
+
 	uint8_t			asked;
 	uint8_t			responded;
 
@@ -111,7 +131,20 @@ lws_adns_cache_t *
 lws_adns_get_cache(lws_async_dns_t *dns, const char *name);
 
 void
-lws_adns_parse_udp(lws_async_dns_t *dns, const uint8_t *pkt, size_t len);
+lws_adns_cache_register(lws_async_dns_t *dns, lws_adns_cache_t *c);
+
+void
+lws_adns_cache_supersede(lws_async_dns_t *dns, lws_adns_cache_t *c);
+
+void
+lws_adns_parse_udp(lws_async_dns_t *dns, int srv, const uint8_t *pkt,
+		   size_t len);
+
+void
+lws_adns_q_start(lws_adns_q_t *q);
+
+void
+lws_adns_server_answered(lws_async_dns_t *dns, lws_adns_q_t *q, int srv);
 
 lws_adns_q_t *
 lws_adns_get_query(lws_async_dns_t *dns, adns_query_type_t qtype,
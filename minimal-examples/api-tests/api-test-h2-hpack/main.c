@@ -0,0 +1,838 @@
+/*
+ * lws-api-test-h2-hpack
+ *
+ * Written in 2010-2020 by Andy Green <andy@warmcat.com>
+ *
+ * This file is made available under the Creative Commons CC0 1.0
+ * Universal Public Domain Dedication.
+ *
+ * This api test upgrades a socketpair connection to h2c and makes pairs of
+ * requests on it.  The server prepares the response headers of the first
+ * stream of each pair, sends the second stream's headers, and only then sends
+ * the first stream's, so the two header blocks are encoded in the opposite
+ * order to the one the peer decodes them in.  The client side decodes every
+ * header block with its own HPACK decoder and dynamic table and checks each
+ * stream got its own header values back.
+ */
+
+#include <libwebsockets.h>
+#include <sys/socket.h>
+#include <string.h>
+#include <signal.h>
+
+#define HPACK_TABLE_SIZE 4096
+
+static const char * const static_table[][2] = {
+	{ "", "" },
+	{ ":authority", "" },			{ ":method", "GET" },
+	{ ":method", "POST" },			{ ":path", "/" },
+	{ ":path", "/index.html" },		{ ":scheme", "http" },
+	{ ":scheme", "https" },			{ ":status", "200" },
+	{ ":status", "204" },			{ ":status", "206" },
+	{ ":status", "304" },			{ ":status", "400" },
+	{ ":status", "404" },			{ ":status", "500" },
+	{ "accept-charset", "" },		{ "accept-encoding",
+							"gzip, deflate" },
+	{ "accept-language", "" },		{ "accept-ranges", "" },
+	{ "accept", "" },			{ "access-control-allow-origin", "" },
+	{ "age", "" },				{ "allow", "" },
+	{ "authorization", "" },		{ "cache-control", "" },
+	{ "content-disposition", "" },		{ "content-encoding", "" },
+	{ "content-language", "" },		{ "content-length", "" },
+	{ "content-location", "" },		{ "content-range", "" },
+	{ "content-type", "" },			{ "cookie", "" },
+	{ "date", "" },				{ "etag", "" },
+	{ "expect", "" },			{ "expires", "" },
+	{ "from", "" },				{ "host", "" },
+	{ "if-match", "" },			{ "if-modified-since", "" },
+	{ "if-none-match", "" },		{ "if-range", "" },
+	{ "if-unmodified-since", "" },		{ "last-modified", "" },
+	{ "link", "" },				{ "location", "" },
+	{ "max-forwards", "" },			{ "proxy-authenticate", "" },
+	{ "proxy-authorization", "" },		{ "range", "" },
+	{ "referer", "" },			{ "refresh", "" },
+	{ "retry-after", "" },			{ "server", "" },
+	{ "set-cookie", "" },			{ "strict-transport-security", "" },
+	{ "transfer-encoding", "" },		{ "user-agent", "" },
+	{ "vary", "" },				{ "via", "" },
+	{ "www-authenticate", "" },
+};
+
+/*
+ * RFC7541 Appendix B code lengths for symbols 0 - 255 and EOS.  The code is
+ * canonical, so the codes themselves follow from the lengths.
+ */
+
+static const uint8_t huf_len[257] = {
+	13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28, 28, 28,
+	28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28, 6, 10, 10, 12,
+	13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6, 5, 5, 5, 6, 6, 6, 6, 6, 6, 6,
+	7, 8, 15, 6, 12, 10, 13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6, 15, 5, 6, 5, 6, 5,
+	6, 6, 6, 5, 7, 7, 6, 6, 6, 5, 6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11,
+	14, 13, 28, 20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24,
+	23, 24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24, 22,
+	21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23, 21, 21, 22,
+	21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23, 26, 26, 20, 19, 22,
+	23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25, 19, 21, 26, 27, 27, 26, 27,
+	24, 21, 21, 26, 26, 28, 27, 27, 27, 20, 24, 20, 21, 22, 21, 21, 23, 22,
+	22, 25, 25, 24, 24, 26, 23, 26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27,
+	27, 27, 27, 27, 26, 30
+};
+
+static uint32_t huf_first[31];
+static uint16_t huf_count[31], huf_offset[31], huf_sym[257];
+
+struct dyn_entry {
+	char *name;
+	char *value;
+};
+
+static struct dyn_entry dyn[HPACK_TABLE_SIZE / 32];
+static int dyn_used, dyn_size, dyn_max = HPACK_TABLE_SIZE;
+
+struct stream {
+	const char *which;
+	int got_status, got_type, got_cc, got_x, done;
+};
+
+static struct lws_context *context;
+static int interrupted, total = 16, round_no, fail, upgraded, need_preface,
+	   need_ack, need_round, held_written;
+static struct stream streams[2], upgrade_stream = { "u" };
+static lws_sorted_usec_list_t sul_timeout;
+static struct lws *held_wsi;
+static uint8_t rxbuf[32768];
+static size_t rxlen;
+
+static const char *upgrade_req =
+	"GET /u HTTP/1.1\r\n"
+	"Host: localhost\r\n"
+	"Connection: Upgrade, HTTP2-Settings\r\n"
+	"Upgrade: h2c\r\n"
+	"HTTP2-Settings: AAIAAAAA\r\n" /* ENABLE_PUSH = 0 */
+	"\r\n";
+
+static const char *preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+/* server side: each stream prepares its headers and maybe holds them */
+
+struct pss {
+	uint8_t buf[LWS_PRE + 512];
+	uint8_t *p;
+	char which;
+	char held;
+	char headers_done;
+};
+
+static int
+callback_http(struct lws *wsi, enum lws_callback_reasons reason, void *user,
+	      void *in, size_t len)
+{
+	struct pss *pss = (struct pss *)user;
+	uint8_t *start, *end, body[LWS_PRE + 1];
+	char cc[32], x[2];
+
+	switch (reason) {
+	case LWS_CALLBACK_HTTP:
+		pss->which = ((const char *)in)[1];
+		start = &pss->buf[LWS_PRE];
+		end = &pss->buf[sizeof(pss->buf) - 1];
+		pss->p = start;
+
+		lws_snprintf(cc, sizeof(cc), "private, stream-%c", pss->which);
+		x[0] = pss->which;
+		x[1] = '\0';
+
+		if (lws_add_http_common_headers(wsi, HTTP_STATUS_OK,
+						"text/plain", 1, &pss->p, end) ||
+		    lws_add_http_header_by_token(wsi,
+				WSI_TOKEN_HTTP_CACHE_CONTROL,
+				(unsigned char *)cc, (int)strlen(cc),
+				&pss->p, end) ||
+		    lws_add_http_header_by_name(wsi,
+				(unsigned char *)"x-stream:",
+				(unsigned char *)x, 1, &pss->p, end) ||
+		    lws_finalize_http_header(wsi, &pss->p, end))
+			return 1;
+
+		if (pss->which != 'u' && !held_wsi) {
+			/* first of the pair: keep it until the other is sent */
+			held_wsi = wsi;
+			pss->held = 1;
+			held_written = 0;
+
+			return 0;
+		}
+
+		if (lws_write(wsi, start, lws_ptr_diff(pss->p, start),
+			      LWS_WRITE_HTTP_HEADERS) !=
+					lws_ptr_diff(pss->p, start))
+			return 1;
+
+		pss->headers_done = 1;
+		if (held_wsi) {
+			held_written = 1;
+			lws_callback_on_writable(held_wsi);
+			held_wsi = NULL;
+		}
+		lws_callback_on_writable(wsi);
+
+		return 0;
+
+	case LWS_CALLBACK_HTTP_WRITEABLE:
+		if (pss->held) {
+			if (!held_written) {
+				lws_callback_on_writable(wsi);
+				return 0;
+			}
+			start = &pss->buf[LWS_PRE];
+			if (lws_write(wsi, start, lws_ptr_diff(pss->p, start),
+				      LWS_WRITE_HTTP_HEADERS) !=
+						lws_ptr_diff(pss->p, start))
+				return 1;
+			pss->held = 0;
+			pss->headers_done = 1;
+			lws_callback_on_writable(wsi);
+
+			return 0;
+		}
+
+		if (!pss->headers_done)
+			return 0;
+
+		body[LWS_PRE] = (uint8_t)pss->which;
+		if (lws_write(wsi, &body[LWS_PRE], 1, LWS_WRITE_HTTP_FINAL) != 1)
+			return 1;
+
+		if (lws_http_transaction_completed(wsi))
+			return -1;
+
+		return 0;
+
+	default:
+		break;
+	}
+
+	return lws_callback_http_dummy(wsi, reason, user, in, len);
+}
+
+/* client side: a minimal HPACK decoder */
+
+static void
+huf_init(void)
+{
+	uint32_t code = 0;
+	int l, s, n = 0;
+
+	for (l = 1; l <= 30; l++) {
+		huf_first[l] = code;
+		huf_offset[l] = (uint16_t)n;
+		for (s = 0; s < 257; s++)
+			if (huf_len[s] == l) {
+				huf_sym[n++] = (uint16_t)s;
+				huf_count[l]++;
+			}
+		code = (code + huf_count[l]) << 1;
+	}
+}
+
+static int
+huf_decode(const uint8_t *in, size_t len, char *out, size_t olen)
+{
+	uint32_t code = 0;
+	size_t n, o = 0;
+	int l = 0, b, ones = 1;
+
+	for (n = 0; n < len * 8; n++) {
+		b = (in[n / 8] >> (7 - (n % 8))) & 1;
+		code = (code << 1) | (uint32_t)b;
+		ones &= b;
+		l++;
+		if (l > 30)
+			return -1;
+		if (code - huf_first[l] >= huf_count[l])
+			continue;
+
+		b = huf_sym[huf_offset[l] + code - huf_first[l]];
+		if (b == 256 || o + 1 >= olen)
+			return -1;
+		out[o++] = (char)b;
+		code = 0;
+		l = 0;
+		ones = 1;
+	}
+
+	/* padding must be the msbs of EOS, and shorter than a byte */
+	if (l > 7 || !ones)
+		return -1;
+
+	out[o] = '\0';
+
+	return 0;
+}
+
+static int
+get_int(const uint8_t **p, const uint8_t *end, int prefix, uint32_t *v)
+{
+	uint32_t mask = (1u << prefix) - 1;
+	int shift = 0;
+
+	if (*p >= end)
+		return -1;
+
+	*v = *(*p)++ & mask;
+	if (*v < mask)
+		return 0;
+
+	do {
+		if (*p >= end || shift > 21)
+			return -1;
+		*v += (uint32_t)(**p & 0x7f) << shift;
+		shift += 7;
+	} while (*(*p)++ & 0x80);
+
+	return 0;
+}
+
+static int
+get_str(const uint8_t **p, const uint8_t *end, char *out, size_t olen)
+{
+	int huf = (**p) & 0x80;
+	uint32_t len;
+
+	if (get_int(p, end, 7, &len) || len > (uint32_t)(end - *p))
+		return -1;
+
+	if (huf) {
+		if (huf_decode(*p, len, out, olen))
+			return -1;
+	} else {
+		if (len >= olen)
+			return -1;
+		memcpy(out, *p, len);
+		out[len] = '\0';
+	}
+
+	*p += len;
+
+	return 0;
+}
+
+static void
+dyn_evict(void)
+{
+	struct dyn_entry *e = &dyn[dyn_used - 1];
+
+	dyn_size -= (int)(strlen(e->name) + strlen(e->value) + 32);
+	free(e->name);
+	free(e->value);
+	dyn_used--;
+}
+
+static int
+dyn_add(const char *name, const char *value)
+{
+	int size = (int)(strlen(name) + strlen(value) + 32);
+
+	while (dyn_used && dyn_size + size > dyn_max)
+		dyn_evict();
+
+	if (size > dyn_max)
+		return 0;
+
+	if (dyn_used == (int)LWS_ARRAY_SIZE(dyn))
+		return -1;
+
+	memmove(&dyn[1], &dyn[0], sizeof(dyn[0]) * (unsigned int)dyn_used);
+	dyn[0].name = strdup(name);
+	dyn[0].value = strdup(value);
+	dyn_used++;
+	dyn_size += size;
+
+	return 0;
+}
+
+static int
+lookup(uint32_t idx, const char **name, const char **value)
+{
+	if (!idx)
+		return -1;
+
+	if (idx < LWS_ARRAY_SIZE(static_table)) {
+		*name = static_table[idx][0];
+		*value = static_table[idx][1];
+
+		return 0;
+	}
+
+	idx -= (uint32_t)LWS_ARRAY_SIZE(static_table);
+	if (idx >= (uint32_t)dyn_used)
+		return -1;
+
+	*name = dyn[idx].name;
+	*value = dyn[idx].value;
+
+	return 0;
+}
+
+static void
+check_header(struct stream *s, const char *name, const char *value)
+{
+	char want[32];
+	int bad = 0;
+
+	if (!strcmp(name, ":status")) {
+		s->got_status = 1;
+		bad = strcmp(value, "200");
+	} else if (!strcmp(name, "content-type")) {
+		s->got_type = 1;
+		bad = strcmp(value, "text/plain");
+	} else if (!strcmp(name, "cache-control")) {
+		s->got_cc = 1;
+		lws_snprintf(want, sizeof(want), "private, stream-%s",
+			     s->which);
+		bad = strcmp(value, want);
+	} else if (!strcmp(name, "x-stream")) {
+		s->got_x = 1;
+		bad = strcmp(value, s->which);
+	}
+
+	if (bad) {
+		lwsl_err("%s: round %d stream %s: bad %s: '%s'\n", __func__,
+			 round_no, s->which, name, value);
+		fail++;
+	}
+}
+
+static int
+decode_block(struct stream *s, const uint8_t *p, const uint8_t *end)
+{
+	char nbuf[128], vbuf[256];
+	const char *name, *value;
+	uint32_t idx;
+	int incr;
+
+	while (p < end) {
+		if (*p & 0x80) { /* indexed */
+			if (get_int(&p, end, 7, &idx) ||
+			    lookup(idx, &name, &value))
+				return -1;
+			check_header(s, name, value);
+			continue;
+		}
+
+		if ((*p & 0xe0) == 0x20) { /* table size update */
+			if (get_int(&p, end, 5, &idx) ||
+			    idx > HPACK_TABLE_SIZE)
+				return -1;
+			dyn_max = (int)idx;
+			while (dyn_used && dyn_size > dyn_max)
+				dyn_evict();
+			continue;
+		}
+
+		/* literal, with incremental indexing or not */
+
+		incr = *p & 0x40;
+		if (incr) {
+			if (get_int(&p, end, 6, &idx))
+				return -1;
+		} else
+			if (get_int(&p, end, 4, &idx))
+				return -1;
+
+		if (idx) {
+			if (lookup(idx, &name, &value))
+				return -1;
+			lws_strncpy(nbuf, name, sizeof(nbuf));
+		} else
+			if (get_str(&p, end, nbuf, sizeof(nbuf)))
+				return -1;
+
+		if (get_str(&p, end, vbuf, sizeof(vbuf)))
+			return -1;
+
+		if (incr && dyn_add(nbuf, vbuf))
+			return -1;
+
+		check_header(s, nbuf, vbuf);
+	}
+
+	return 0;
+}
+
+static int
+frame(uint8_t *p, int type, int flags, uint32_t sid, size_t len)
+{
+	p[0] = (uint8_t)(len >> 16);
+	p[1] = (uint8_t)(len >> 8);
+	p[2] = (uint8_t)len;
+	p[3] = (uint8_t)type;
+	p[4] = (uint8_t)flags;
+	p[5] = (uint8_t)(sid >> 24);
+	p[6] = (uint8_t)(sid >> 16);
+	p[7] = (uint8_t)(sid >> 8);
+	p[8] = (uint8_t)sid;
+
+	return 9;
+}
+
+static size_t
+request(uint8_t *p, uint32_t sid, const char *path)
+{
+	uint8_t *b = p + 9, *q = b;
+
+	*q++ = 0x82; /* :method GET */
+	*q++ = 0x86; /* :scheme http */
+	*q++ = 0x04; /* :path, without indexing */
+	*q++ = (uint8_t)strlen(path);
+	memcpy(q, path, strlen(path));
+	q += strlen(path);
+	*q++ = 0x01; /* :authority, without indexing */
+	*q++ = 9;
+	memcpy(q, "localhost", 9);
+	q += 9;
+
+	frame(p, 1, 5 /* END_STREAM | END_HEADERS */, sid,
+	      (size_t)lws_ptr_diff(q, b));
+
+	return (size_t)lws_ptr_diff(q, p);
+}
+
+static struct stream *
+stream_from_sid(uint32_t sid)
+{
+	/* the h2c upgrade request is served on sid 1 */
+	if (sid == 1 && !upgrade_stream.done)
+		return &upgrade_stream;
+	if (sid == (uint32_t)(3 + (round_no * 4)))
+		return &streams[0];
+	if (sid == (uint32_t)(5 + (round_no * 4)))
+		return &streams[1];
+
+	lwsl_err("%s: unexpected sid %u\n", __func__, (unsigned int)sid);
+	fail++;
+
+	return NULL;
+}
+
+static void
+check_complete(struct stream *s)
+{
+	if (!s->got_status || !s->got_type || !s->got_cc || !s->got_x) {
+		lwsl_err("%s: round %d stream %s: missing headers\n",
+			 __func__, round_no, s->which);
+		fail++;
+	}
+}
+
+static int
+round_complete(void)
+{
+	if (!streams[0].done || !streams[1].done)
+		return 0;
+
+	check_complete(&streams[0]);
+	check_complete(&streams[1]);
+
+	return 1;
+}
+
+static int
+parse_frames(struct lws *wsi)
+{
+	size_t flen, used = 0;
+	struct stream *s;
+	uint32_t sid;
+	uint8_t *f;
+
+	while (rxlen - used >= 9) {
+		f = &rxbuf[used];
+		s = NULL;
+		flen = ((size_t)f[0] << 16) | ((size_t)f[1] << 8) | f[2];
+		if (rxlen - used < 9 + flen)
+			break;
+		sid = ((uint32_t)(f[5] & 0x7f) << 24) | ((uint32_t)f[6] << 16) |
+		      ((uint32_t)f[7] << 8) | f[8];
+
+		switch (f[3]) {
+		case 0: /* DATA */
+			s = stream_from_sid(sid);
+			if (!s)
+				return -1;
+			if (f[4] & 1)
+				s->done = 1;
+			break;
+
+		case 1: /* HEADERS */
+			s = stream_from_sid(sid);
+			if (!s)
+				return -1;
+			if (!(f[4] & 4) || (f[4] & 0x28)) {
+				lwsl_err("%s: unexpected HEADERS flags 0x%x\n",
+					 __func__, f[4]);
+				return -1;
+			}
+			if (decode_block(s, f + 9, f + 9 + flen)) {
+				lwsl_err("%s: round %d stream %s: "
+					 "undecodable header block\n", __func__,
+					 round_no, s->which);
+				return -1;
+			}
+			if (f[4] & 1)
+				s->done = 1;
+			break;
+
+		case 3: /* RST_STREAM */
+		case 7: /* GOAWAY */
+			lwsl_err("%s: peer sent frame type %d\n", __func__,
+				 f[3]);
+			return -1;
+
+		case 4: /* SETTINGS */
+			if (!(f[4] & 1)) {
+				need_ack = 1;
+				lws_callback_on_writable(wsi);
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		used += 9 + flen;
+
+		if (s == &upgrade_stream) {
+			if (s->done) {
+				/* start the pairs once sid 1 is out of the way */
+				check_complete(s);
+				need_round = 1;
+				lws_callback_on_writable(wsi);
+			}
+			continue;
+		}
+
+		if (round_complete()) {
+			if (++round_no == total) {
+				interrupted = 1;
+				lws_cancel_service(lws_get_context(wsi));
+				return 0;
+			}
+			memset(streams, 0, sizeof(streams));
+			/*
+			 * swap which path is on which sid each round, so the
+			 * block that's held back is sometimes one whose
+			 * headers are all already in the table
+			 */
+			streams[round_no & 1].which = "a";
+			streams[(round_no & 1) ^ 1].which = "b";
+			need_round = 1;
+			lws_callback_on_writable(wsi);
+		}
+	}
+
+	memmove(rxbuf, &rxbuf[used], rxlen - used);
+	rxlen -= used;
+
+	return 0;
+}
+
+static int
+callback_raw(struct lws *wsi, enum lws_callback_reasons reason, void *user,
+	     void *in, size_t len)
+{
+	uint8_t buf[LWS_PRE + 512], *start = &buf[LWS_PRE], *p = start;
+	const uint8_t *c;
+	size_t n;
+
+	switch (reason) {
+	case LWS_CALLBACK_RAW_ADOPT:
+		memcpy(p, upgrade_req, strlen(upgrade_req));
+		if (lws_write(wsi, p, strlen(upgrade_req), LWS_WRITE_RAW) !=
+						(int)strlen(upgrade_req))
+			return -1;
+		break;
+
+	case LWS_CALLBACK_RAW_RX:
+		if (rxlen + len > sizeof(rxbuf)) {
+			lwsl_err("%s: rx overflow\n", __func__);
+			fail++;
+			return -1;
+		}
+		memcpy(&rxbuf[rxlen], in, len);
+		rxlen += len;
+
+		if (!upgraded) {
+			c = (const uint8_t *)strstr((const char *)rxbuf,
+						    "\r\n\r\n");
+			if (!c)
+				break;
+			if (strncmp((const char *)rxbuf,
+				    "HTTP/1.1 101", 12)) {
+				lwsl_err("%s: upgrade refused\n", __func__);
+				fail++;
+				return -1;
+			}
+			n = (size_t)lws_ptr_diff(c + 4, rxbuf);
+			memmove(rxbuf, &rxbuf[n], rxlen - n);
+			rxlen -= n;
+			upgraded = 1;
+			need_preface = 1;
+			lws_callback_on_writable(wsi);
+		}
+
+		if (parse_frames(wsi)) {
+			fail++;
+			return -1;
+		}
+		break;
+
+	case LWS_CALLBACK_RAW_WRITEABLE:
+		if (need_preface) {
+			memcpy(p, preface, strlen(preface));
+			p += strlen(preface);
+			p += frame(p, 4, 0, 0, 6);
+			/* ENABLE_PUSH = 0 */
+			memcpy(p, "\x00\x02\x00\x00\x00\x00", 6);
+			p += 6;
+			need_preface = 0;
+		}
+		if (need_ack) {
+			p += frame(p, 4, 1, 0, 0);
+			need_ack = 0;
+		}
+		if (need_round && upgraded) {
+			p += request(p, (uint32_t)(3 + (round_no * 4)),
+				     round_no & 1 ? "/b" : "/a");
+			p += request(p, (uint32_t)(5 + (round_no * 4)),
+				     round_no & 1 ? "/a" : "/b");
+			need_round = 0;
+		}
+		if (p != start &&
+		    lws_write(wsi, start, (size_t)lws_ptr_diff(p, start),
+			      LWS_WRITE_RAW) != lws_ptr_diff(p, start))
+			return -1;
+		break;
+
+	case LWS_CALLBACK_RAW_CLOSE:
+		if (round_no != total) {
+			lwsl_err("%s: closed after %d / %d rounds\n", __func__,
+				 round_no, total);
+			fail++;
+		}
+		interrupted = 1;
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static struct lws_protocols protocols[] = {
+	{ "http", callback_http, sizeof(struct pss), 0 },
+	{ "raw", callback_raw, 0, 0 },
+	{ NULL, NULL, 0, 0 } /* terminator */
+};
+
+static void
+timeout_cb(lws_sorted_usec_list_t *sul)
+{
+	lwsl_err("%s: timed out after %d / %d rounds\n", __func__,
+		 round_no, total);
+	fail++;
+	interrupted = 1;
+}
+
+void sigint_handler(int sig)
+{
+	interrupted = 1;
+}
+
+int
+main(int argc, const char **argv)
+{
+	int n = 1, logs = LLL_USER | LLL_ERR | LLL_WARN | LLL_NOTICE;
+	struct lws_context_creation_info info;
+	lws_sock_file_fd_type fd;
+	struct lws_vhost *vh;
+	const char *p;
+	int sv[2];
+
+	signal(SIGINT, sigint_handler);
+
+	if ((p = lws_cmdline_option(argc, argv, "-d")))
+		logs = atoi(p);
+	if ((p = lws_cmdline_option(argc, argv, "-n")))
+		total = atoi(p);
+
+	lws_set_log_level(logs, NULL);
+	lwsl_user("LWS API selftest: h2 hpack interleaved header blocks\n");
+
+	huf_init();
+	streams[0].which = "a";
+	streams[1].which = "b";
+
+	memset(&info, 0, sizeof info); /* otherwise uninitialized garbage */
+	info.port = CONTEXT_PORT_NO_LISTEN;
+	info.protocols = protocols;
+
+	context = lws_create_context(&info);
+	if (!context) {
+		lwsl_err("lws init failed\n");
+		return 1;
+	}
+
+	vh = lws_get_vhost_by_name(context, "default");
+	if (!vh || socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+		lwsl_err("%s: unable to create socketpair\n", __func__);
+		fail++;
+		goto bail;
+	}
+
+	/* one side is served as http, the other is our raw h2c client */
+
+	fd.sockfd = sv[0];
+	if (!lws_adopt_descriptor_vhost(vh, LWS_ADOPT_SOCKET | LWS_ADOPT_HTTP,
+					fd, "http", NULL)) {
+		lwsl_err("%s: failed to adopt http side\n", __func__);
+		fail++;
+		goto bail;
+	}
+
+	fd.sockfd = sv[1];
+	if (!lws_adopt_descriptor_vhost(vh, LWS_ADOPT_SOCKET, fd, "raw",
+					NULL)) {
+		lwsl_err("%s: failed to adopt raw side\n", __func__);
+		fail++;
+		goto bail;
+	}
+
+	lws_sul_schedule(context, 0, &sul_timeout, timeout_cb,
+			 10 * LWS_US_PER_SEC);
+
+	while (n >= 0 && !interrupted)
+		n = lws_service(context, 0);
+
+	lws_sul_schedule(context, 0, &sul_timeout, NULL,
+			 LWS_SET_TIMER_USEC_CANCEL);
+
+	if (round_no != total)
+		fail++;
+
+bail:
+	lws_context_destroy(context);
+
+	while (dyn_used)
+		dyn_evict();
+
+	if (fail)
+		lwsl_user("Completed: FAIL (%d / %d rounds)\n", round_no,
+			  total);
+	else
+		lwsl_user("Completed: PASS\n");
+
+	return fail;
+}
@@ -0,0 +1,521 @@
+/*
+ * lws-api-test-h2-sched
+ *
+ * Written in 2010-2020 by Andy Green <andy@warmcat.com>
+ *
+ * This file is made available under the Creative Commons CC0 1.0
+ * Universal Public Domain Dedication.
+ *
+ * This api test upgrades a socketpair connection to h2c and checks the order
+ * the server's stream scheduler sends DATA in.  Each bulk stream writes its
+ * body 1KB per writeable callback and immediately asks for another, so which
+ * stream's DATA comes next is decided by the scheduler alone.
+ *
+ *  - weights: two bulk streams given weights 256 and 64 in their HEADERS
+ *    frames must get bandwidth in about that ratio
+ *
+ *  - dependencies: a stream made dependent on another by a later PRIORITY
+ *    frame must not send any DATA until the other has finished
+ *
+ *  - deferred actions: streams that send their whole response from the
+ *    deferred http action, and are closed there, alongside a bulk stream
+ */
+
+#include <libwebsockets.h>
+#include <sys/socket.h>
+#include <string.h>
+#include <signal.h>
+
+#define BULK_LEN	(64 * 1024)
+#define CHUNK		1024
+
+enum {
+	PH_UPGRADE,
+	PH_WEIGHTS,
+	PH_DEPENDENCY,
+	PH_DEFERRED,
+	PH_DONE
+};
+
+struct stream {
+	size_t rx;
+	int done;
+};
+
+static struct lws_context *context;
+static int interrupted, phase, fail, upgraded, need_preface, need_ack,
+	   need_phase;
+static struct stream streams[20];
+static size_t heavy_at_light_end;
+static lws_sorted_usec_list_t sul_timeout;
+static uint8_t rxbuf[32768];
+static size_t rxlen;
+
+static const char *upgrade_req =
+	"GET /u HTTP/1.1\r\n"
+	"Host: localhost\r\n"
+	"Connection: Upgrade, HTTP2-Settings\r\n"
+	"Upgrade: h2c\r\n"
+	"HTTP2-Settings: AAIAAAAA\r\n" /* ENABLE_PUSH = 0 */
+	"\r\n";
+
+static const char *preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+/* server side: /w streams send BULK_LEN, others send one byte right away */
+
+struct pss {
+	size_t left;
+};
+
+static int
+callback_http(struct lws *wsi, enum lws_callback_reasons reason, void *user,
+	      void *in, size_t len)
+{
+	uint8_t buf[LWS_PRE + CHUNK], *start = &buf[LWS_PRE], *p = start,
+		*end = &buf[sizeof(buf) - 1];
+	struct pss *pss = (struct pss *)user;
+	size_t n;
+
+	switch (reason) {
+	case LWS_CALLBACK_HTTP:
+		pss->left = ((const char *)in)[1] == 'w' ? BULK_LEN : 1;
+
+		if (lws_add_http_common_headers(wsi, HTTP_STATUS_OK,
+					"text/plain", (lws_filepos_t)pss->left,
+					&p, end) ||
+		    lws_finalize_write_http_header(wsi, start, &p, end))
+			return 1;
+
+		if (pss->left == 1) {
+			/* all done inside the deferred action */
+			*start = 'x';
+			if (lws_write(wsi, start, 1, LWS_WRITE_HTTP_FINAL) != 1)
+				return 1;
+
+			return lws_http_transaction_completed(wsi) ? -1 : 0;
+		}
+
+		lws_callback_on_writable(wsi);
+
+		return 0;
+
+	case LWS_CALLBACK_HTTP_WRITEABLE:
+		if (!pss->left)
+			return 0;
+
+		n = pss->left > CHUNK ? CHUNK : pss->left;
+		memset(start, 'w', n);
+		pss->left -= n;
+
+		if (lws_write(wsi, start, n, pss->left ? LWS_WRITE_HTTP :
+					     LWS_WRITE_HTTP_FINAL) != (int)n)
+			return 1;
+
+		if (!pss->left)
+			return lws_http_transaction_completed(wsi) ? -1 : 0;
+
+		lws_callback_on_writable(wsi);
+
+		return 0;
+
+	default:
+		break;
+	}
+
+	return lws_callback_http_dummy(wsi, reason, user, in, len);
+}
+
+/* client side */
+
+static int
+frame(uint8_t *p, int type, int flags, uint32_t sid, size_t len)
+{
+	p[0] = (uint8_t)(len >> 16);
+	p[1] = (uint8_t)(len >> 8);
+	p[2] = (uint8_t)len;
+	p[3] = (uint8_t)type;
+	p[4] = (uint8_t)flags;
+	p[5] = (uint8_t)(sid >> 24);
+	p[6] = (uint8_t)(sid >> 16);
+	p[7] = (uint8_t)(sid >> 8);
+	p[8] = (uint8_t)sid;
+
+	return 9;
+}
+
+/* weight is 1 .. 256, or 0 for a HEADERS without priority */
+
+static size_t
+request(uint8_t *p, uint32_t sid, const char *path, int weight)
+{
+	uint8_t *b = p + 9, *q = b;
+
+	if (weight) {
+		memset(q, 0, 4); /* depends on the root */
+		q += 4;
+		*q++ = (uint8_t)(weight - 1);
+	}
+
+	*q++ = 0x82; /* :method GET */
+	*q++ = 0x86; /* :scheme http */
+	*q++ = 0x04; /* :path, without indexing */
+	*q++ = (uint8_t)strlen(path);
+	memcpy(q, path, strlen(path));
+	q += strlen(path);
+	*q++ = 0x01; /* :authority, without indexing */
+	*q++ = 9;
+	memcpy(q, "localhost", 9);
+	q += 9;
+
+	/* END_STREAM | END_HEADERS, and PRIORITY if a weight was given */
+	frame(p, 1, weight ? 0x25 : 5, sid, (size_t)lws_ptr_diff(q, b));
+
+	return (size_t)lws_ptr_diff(q, p);
+}
+
+static size_t
+priority(uint8_t *p, uint32_t sid, uint32_t dep, int weight)
+{
+	p += frame(p, 2, 0, sid, 5);
+	p[0] = (uint8_t)(dep >> 24);
+	p[1] = (uint8_t)(dep >> 16);
+	p[2] = (uint8_t)(dep >> 8);
+	p[3] = (uint8_t)dep;
+	p[4] = (uint8_t)(weight - 1);
+
+	return 14;
+}
+
+static int
+phase_complete(void)
+{
+	int n;
+
+	switch (phase) {
+	case PH_UPGRADE:
+		return streams[1].done;
+
+	case PH_WEIGHTS:
+		if (!streams[3].done || !streams[5].done)
+			return 0;
+		/*
+		 * sid 3 has 4x the weight of sid 5, so by the time it sent its
+		 * whole body, sid 5 should have sent about a quarter of its
+		 */
+		lwsl_user("%s: weights 256:64: light stream had %u / %u\n",
+			  __func__, (unsigned int)heavy_at_light_end,
+			  (unsigned int)BULK_LEN);
+		if (heavy_at_light_end < BULK_LEN / 8 ||
+		    heavy_at_light_end > (BULK_LEN * 3) / 8) {
+			lwsl_err("%s: weights not respected\n", __func__);
+			fail++;
+		}
+		return 1;
+
+	case PH_DEPENDENCY:
+		return streams[7].done && streams[9].done;
+
+	case PH_DEFERRED:
+		for (n = 11; n <= 19; n += 2)
+			if (!streams[n].done)
+				return 0;
+		return 1;
+	}
+
+	return 0;
+}
+
+static int
+parse_frames(struct lws *wsi)
+{
+	size_t flen, used = 0;
+	struct stream *s;
+	uint32_t sid;
+	uint8_t *f;
+
+	while (rxlen - used >= 9) {
+		f = &rxbuf[used];
+		flen = ((size_t)f[0] << 16) | ((size_t)f[1] << 8) | f[2];
+		if (rxlen - used < 9 + flen)
+			break;
+		sid = ((uint32_t)(f[5] & 0x7f) << 24) | ((uint32_t)f[6] << 16) |
+		      ((uint32_t)f[7] << 8) | f[8];
+		used += 9 + flen;
+
+		switch (f[3]) {
+		case 0: /* DATA */
+		case 1: /* HEADERS */
+			if (!sid || sid >= LWS_ARRAY_SIZE(streams) ||
+			    streams[sid].done) {
+				lwsl_err("%s: unexpected sid %u\n", __func__,
+					 (unsigned int)sid);
+				return -1;
+			}
+			s = &streams[sid];
+			if (!f[3]) {
+				s->rx += flen;
+
+				if (sid == 9 && !streams[7].done) {
+					lwsl_err("%s: sid 9 sent DATA before "
+						 "the sid 7 it depends on "
+						 "finished\n", __func__);
+					fail++;
+				}
+			}
+			if (!(f[4] & 1))
+				break;
+
+			s->done = 1;
+			if (sid == 3)
+				heavy_at_light_end = streams[5].rx;
+			if (sid == 5 && !streams[3].done) {
+				lwsl_err("%s: light stream finished first\n",
+					 __func__);
+				fail++;
+			}
+			if (phase_complete()) {
+				if (++phase == PH_DONE) {
+					interrupted = 1;
+					lws_cancel_service(lws_get_context(wsi));
+					return 0;
+				}
+				need_phase = 1;
+				lws_callback_on_writable(wsi);
+			}
+			break;
+
+		case 3: /* RST_STREAM */
+		case 7: /* GOAWAY */
+			lwsl_err("%s: peer sent frame type %d\n", __func__,
+				 f[3]);
+			return -1;
+
+		case 4: /* SETTINGS */
+			if (!(f[4] & 1)) {
+				need_ack = 1;
+				lws_callback_on_writable(wsi);
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	memmove(rxbuf, &rxbuf[used], rxlen - used);
+	rxlen -= used;
+
+	return 0;
+}
+
+static int
+callback_raw(struct lws *wsi, enum lws_callback_reasons reason, void *user,
+	     void *in, size_t len)
+{
+	uint8_t buf[LWS_PRE + 512], *start = &buf[LWS_PRE], *p = start;
+	const uint8_t *c;
+	size_t n;
+
+	switch (reason) {
+	case LWS_CALLBACK_RAW_ADOPT:
+		memcpy(p, upgrade_req, strlen(upgrade_req));
+		if (lws_write(wsi, p, strlen(upgrade_req), LWS_WRITE_RAW) !=
+						(int)strlen(upgrade_req))
+			return -1;
+		break;
+
+	case LWS_CALLBACK_RAW_RX:
+		if (rxlen + len > sizeof(rxbuf)) {
+			lwsl_err("%s: rx overflow\n", __func__);
+			fail++;
+			return -1;
+		}
+		memcpy(&rxbuf[rxlen], in, len);
+		rxlen += len;
+
+		if (!upgraded) {
+			c = (const uint8_t *)strstr((const char *)rxbuf,
+						    "\r\n\r\n");
+			if (!c)
+				break;
+			if (strncmp((const char *)rxbuf,
+				    "HTTP/1.1 101", 12)) {
+				lwsl_err("%s: upgrade refused\n", __func__);
+				fail++;
+				return -1;
+			}
+			n = (size_t)lws_ptr_diff(c + 4, rxbuf);
+			memmove(rxbuf, &rxbuf[n], rxlen - n);
+			rxlen -= n;
+			upgraded = 1;
+			need_preface = 1;
+			lws_callback_on_writable(wsi);
+		}
+
+		if (parse_frames(wsi)) {
+			fail++;
+			return -1;
+		}
+		break;
+
+	case LWS_CALLBACK_RAW_WRITEABLE:
+		if (need_preface) {
+			memcpy(p, preface, strlen(preface));
+			p += strlen(preface);
+			/*
+			 * ENABLE_PUSH = 0, INITIAL_WINDOW_SIZE = 2^31 - 1 and
+			 * open the connection window fully, so flow control
+			 * never decides who goes next
+			 */
+			p += frame(p, 4, 0, 0, 12);
+			memcpy(p, "\x00\x02\x00\x00\x00\x00"
+				  "\x00\x04\x7f\xff\xff\xff", 12);
+			p += 12;
+			p += frame(p, 8, 0, 0, 4);
+			memcpy(p, "\x7f\xff\x00\x00", 4);
+			p += 4;
+			need_preface = 0;
+		}
+		if (need_ack) {
+			p += frame(p, 4, 1, 0, 0);
+			need_ack = 0;
+		}
+		if (need_phase && upgraded) {
+			switch (phase) {
+			case PH_WEIGHTS:
+				p += request(p, 3, "/w", 256);
+				p += request(p, 5, "/w", 64);
+				break;
+			case PH_DEPENDENCY:
+				/*
+				 * The PRIORITY frame comes after a HEADERS
+				 * with no priority of its own, its values only
+				 * exist once its payload has been parsed
+				 */
+				p += request(p, 7, "/w", 0);
+				p += request(p, 9, "/w", 0);
+				p += priority(p, 9, 7, 256);
+				break;
+			case PH_DEFERRED:
+				p += request(p, 11, "/w", 0);
+				for (n = 13; n <= 19; n += 2)
+					p += request(p, (uint32_t)n, "/c", 0);
+				break;
+			}
+			need_phase = 0;
+		}
+		if (p != start &&
+		    lws_write(wsi, start, (size_t)lws_ptr_diff(p, start),
+			      LWS_WRITE_RAW) != lws_ptr_diff(p, start))
+			return -1;
+		break;
+
+	case LWS_CALLBACK_RAW_CLOSE:
+		if (phase != PH_DONE) {
+			lwsl_err("%s: closed in phase %d\n", __func__, phase);
+			fail++;
+		}
+		interrupted = 1;
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static struct lws_protocols protocols[] = {
+	{ "http", callback_http, sizeof(struct pss), 0 },
+	{ "raw", callback_raw, 0, 0 },
+	{ NULL, NULL, 0, 0 } /* terminator */
+};
+
+static void
+timeout_cb(lws_sorted_usec_list_t *sul)
+{
+	lwsl_err("%s: timed out in phase %d\n", __func__, phase);
+	fail++;
+	interrupted = 1;
+}
+
+void sigint_handler(int sig)
+{
+	interrupted = 1;
+}
+
+int
+main(int argc, const char **argv)
+{
+	int n = 1, logs = LLL_USER | LLL_ERR | LLL_WARN | LLL_NOTICE;
+	struct lws_context_creation_info info;
+	lws_sock_file_fd_type fd;
+	struct lws_vhost *vh;
+	const char *p;
+	int sv[2];
+
+	signal(SIGINT, sigint_handler);
+
+	if ((p = lws_cmdline_option(argc, argv, "-d")))
+		logs = atoi(p);
+
+	lws_set_log_level(logs, NULL);
+	lwsl_user("LWS API selftest: h2 stream scheduling\n");
+
+	memset(&info, 0, sizeof info); /* otherwise uninitialized garbage */
+	info.port = CONTEXT_PORT_NO_LISTEN;
+	info.protocols = protocols;
+
+	context = lws_create_context(&info);
+	if (!context) {
+		lwsl_err("lws init failed\n");
+		return 1;
+	}
+
+	vh = lws_get_vhost_by_name(context, "default");
+	if (!vh || socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+		lwsl_err("%s: unable to create socketpair\n", __func__);
+		fail++;
+		goto bail;
+	}
+
+	/* one side is served as http, the other is our raw h2c client */
+
+	fd.sockfd = sv[0];
+	if (!lws_adopt_descriptor_vhost(vh, LWS_ADOPT_SOCKET | LWS_ADOPT_HTTP,
+					fd, "http", NULL)) {
+		lwsl_err("%s: failed to adopt http side\n", __func__);
+		fail++;
+		goto bail;
+	}
+
+	fd.sockfd = sv[1];
+	if (!lws_adopt_descriptor_vhost(vh, LWS_ADOPT_SOCKET, fd, "raw",
+					NULL)) {
+		lwsl_err("%s: failed to adopt raw side\n", __func__);
+		fail++;
+		goto bail;
+	}
+
+	lws_sul_schedule(context, 0, &sul_timeout, timeout_cb,
+			 10 * LWS_US_PER_SEC);
+
+	while (n >= 0 && !interrupted)
+		n = lws_service(context, 0);
+
+	lws_sul_schedule(context, 0, &sul_timeout, NULL,
+			 LWS_SET_TIMER_USEC_CANCEL);
+
+	if (phase != PH_DONE)
+		fail++;
+
+bail:
+	lws_context_destroy(context);
+
+	if (fail)
+		lwsl_user("Completed: FAIL (phase %d)\n", phase);
+	else
+		lwsl_user("Completed: PASS\n");
+
+	return fail;
+}
@@ -0,0 +1,370 @@
+/*
+ * lws-api-test-lejp
+ *
+ * Written in 2010-2020 by Andy Green <andy@warmcat.com>
+ *
+ * This file is made available under the Creative Commons CC0 1.0
+ * Universal Public Domain Dedication.
+ *
+ * This api test checks lejp gives the same results however its input is
+ * split up.
+ *
+ * lejp_parse() takes runs of string value bytes, whitespace and comment lines
+ * in bulk, several bytes at a time where it can.  Each document here is
+ * parsed a byte at a time as a reference, then split in two at every offset,
+ * fed in chunks of many different sizes and in one go.  The callbacks, their
+ * paths, line numbers and string chunks, and the final result, must always be
+ * the same as the reference.
+ */
+
+#include <libwebsockets.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define TRACE_MAX	(256 * 1024)
+#define DOC_MAX		(32 * 1024)
+
+struct trace {
+	char		*p;
+	size_t		len;
+	int		overflow;
+};
+
+static char doc[DOC_MAX];
+static size_t doc_len;
+
+static const char * const paths[] = {
+	"s[]",
+	"o.*",
+	"o.n",
+};
+
+static void
+trace_add(struct trace *t, const void *p, size_t len)
+{
+	if (t->len + len > TRACE_MAX) {
+		t->overflow = 1;
+		return;
+	}
+	memcpy(t->p + t->len, p, len);
+	t->len += len;
+}
+
+static signed char
+cb(struct lejp_ctx *ctx, char reason)
+{
+	struct trace *t = (struct trace *)ctx->user;
+	char hdr[LEJP_MAX_PATH + 48];
+	int n;
+
+	/* START comes again for each call until the first token */
+
+	if (reason == LEJPCB_CONSTRUCTED || reason == LEJPCB_DESTRUCTED ||
+	    reason == LEJPCB_START)
+		return 0;
+
+	n = lws_snprintf(hdr, sizeof(hdr), "%d %u %d %s %d:", reason & 0x3f,
+			 (unsigned int)ctx->line, ctx->path_match, ctx->path,
+			 (reason & LEJP_FLAG_CB_IS_VALUE) ? ctx->npos : 0);
+	trace_add(t, hdr, (size_t)n);
+	if (reason & LEJP_FLAG_CB_IS_VALUE)
+		trace_add(t, ctx->buf, ctx->npos);
+	trace_add(t, "\n", 1);
+
+	return 0;
+}
+
+/* feed the document in pieces of the given sizes, the last one repeating */
+
+static int
+parse(struct trace *t, const size_t *sizes, int count_sizes)
+{
+	struct lejp_ctx ctx;
+	size_t pos = 0, n;
+	int r = LEJP_CONTINUE, s = 0;
+
+	t->len = 0;
+	t->overflow = 0;
+
+	lejp_construct(&ctx, cb, t, paths, LWS_ARRAY_SIZE(paths));
+
+	while (pos < doc_len && r == LEJP_CONTINUE) {
+		n = sizes[s];
+		if (s < count_sizes - 1)
+			s++;
+		if (n > doc_len - pos)
+			n = doc_len - pos;
+		r = lejp_parse(&ctx, (const unsigned char *)doc + pos, (int)n);
+		pos += n;
+	}
+
+	lejp_destruct(&ctx);
+
+	return r;
+}
+
+/* the document building helpers */
+
+static void
+add(const char *s)
+{
+	size_t n = strlen(s);
+
+	if (doc_len + n < sizeof(doc)) {
+		memcpy(doc + doc_len, s, n);
+		doc_len += n;
+	}
+}
+
+static void
+add_run(char c, int n)
+{
+	while (n-- > 0 && doc_len < sizeof(doc) - 1)
+		doc[doc_len++] = c;
+}
+
+/* a string value of len plain bytes, with esc inserted at offset at */
+
+static void
+add_str(int len, int at, const char *esc)
+{
+	int n;
+
+	add("\"");
+	for (n = 0; n < len; n++) {
+		if (n == at)
+			add(esc);
+		if (doc_len < sizeof(doc) - 1)
+			doc[doc_len++] = (char)('a' + (n % 26));
+	}
+	if (at >= len)
+		add(esc);
+	add("\"");
+}
+
+static void
+doc_strings(void)
+{
+	static const int lens[] = { 0, 1, 7, 8, 9, 15, 16, 17, 31, 32, 33,
+				    252, 253, 254, 255, 256, 300, 508, 509,
+				    600 };
+	static const char * const escs[] = { "", "\\\"", "\\\\", "\\n",
+					     "\\u00e9", "\\/", "\xc3\xa9" };
+	char num[16];
+	int n, m = 0;
+
+	doc_len = 0;
+	add("# strings of many lengths, with escapes in them\n{\"s\":[");
+	for (n = 0; n < (int)LWS_ARRAY_SIZE(lens); n++) {
+		if (n)
+			add(",");
+		add_str(lens[n], -1, "");
+		add(",");
+		add_str(lens[n], lens[n] / 2,
+			escs[m++ % LWS_ARRAY_SIZE(escs)]);
+		add(",");
+		add_str(lens[n], lens[n] - 1,
+			escs[m++ % LWS_ARRAY_SIZE(escs)]);
+		add(",");
+		add_str(lens[n], 16, escs[m++ % LWS_ARRAY_SIZE(escs)]);
+		add(",");
+		add_str(lens[n], 253, escs[m++ % LWS_ARRAY_SIZE(escs)]);
+	}
+	add("],\"o\":{\"n\":");
+	lws_snprintf(num, sizeof(num), "%d", m);
+	add(num);
+	add(",\"t\":true,\"f\":1.5e3,\"z\":null}}");
+}
+
+static void
+doc_whitespace(void)
+{
+	static const char ws[] = " \t\r\n";
+	int n;
+
+	doc_len = 0;
+
+	/* runs of each whitespace char and mixtures, of many lengths */
+
+	add_run(' ', 20);
+	add("{\n");
+	for (n = 0; n < 40; n++) {
+		add("\"k");
+		add_run((char)('a' + (n % 26)), n % 5);
+		add("\"");
+		add_run(ws[n & 3], n);
+		add(":");
+		if (n & 1) {
+			add("\r\n");
+			add_run(' ', n + 3);
+		} else
+			add_run(ws[(n + 1) & 3], 33 - n % 20);
+		add_str(n * 3, 2, "\\t");
+		add_run('\n', n % 3);
+		add_run('\t', n % 17);
+		add(n == 39 ? "\n" : ",\n");
+	}
+	add_run(' ', 17);
+	add("}");
+}
+
+static void
+doc_comments(void)
+{
+	int n;
+
+	doc_len = 0;
+	add("# leading comment line\n");
+	add("#\n");
+	add("{\n");
+	for (n = 0; n < 24; n++) {
+		add_run(' ', n);
+		add("# a comment ");
+		add_run('#', n);
+		add_run('x', n * 3);
+		add(" with \"quotes\" and \\ and { } [ ] : ,\n");
+		add_run('\t', n & 7);
+		add("\"c");
+		add_run('0', n);
+		add("\":");
+		add_run(' ', 16 - (n % 16));
+		add("\"# not a comment\"");
+		if (n < 23)
+			add(",");
+		add_run(' ', n % 4);
+		add("# trailing\r\n");
+	}
+	add("}");
+}
+
+/* bad documents must fail at the same point however they are fed */
+
+static void
+doc_ctrl(void)
+{
+	doc_len = 0;
+	add("{\"a\": ");
+	add_str(40, 200, "");
+	add(", \"b\": \"0123456789abcdef0123456789abcdef\x01xyz\"}");
+}
+
+static void
+doc_ctrl_nl(void)
+{
+	doc_len = 0;
+	add("{\"a\": [");
+	add_str(300, 290, "\\\\");
+	add(", \"0123456789abcdef01234\nxyz\"]}");
+}
+
+static const struct {
+	const char	*name;
+	void		(*build)(void);
+	int		bad;
+} docs[] = {
+	{ "strings",	doc_strings,	0 },
+	{ "whitespace",	doc_whitespace,	0 },
+	{ "comments",	doc_comments,	0 },
+	{ "ctrl",	doc_ctrl,	1 },
+	{ "ctrl nl",	doc_ctrl_nl,	1 },
+};
+
+static int
+check(struct trace *ref, int ref_r, struct trace *t, int r,
+      const char *doc_name, const char *how, size_t arg)
+{
+	size_t n;
+
+	if (r == ref_r && !t->overflow && t->len == ref->len &&
+	    !memcmp(t->p, ref->p, ref->len))
+		return 0;
+
+	for (n = 0; n < t->len && n < ref->len; n++)
+		if (t->p[n] != ref->p[n])
+			break;
+
+	lwsl_err("%s: %s: %s %u: result %d (ref %d), trace differs at %u\n",
+		 __func__, doc_name, how, (unsigned int)arg, r, ref_r,
+		 (unsigned int)n);
+
+	return 1;
+}
+
+int
+main(int argc, const char **argv)
+{
+	int d, r, ref_r, e = 0, logs = LLL_USER | LLL_ERR | LLL_WARN |
+				       LLL_NOTICE;
+	struct trace ref, t;
+	size_t sizes[2], k;
+	const char *p;
+
+	if ((p = lws_cmdline_option(argc, argv, "-d")))
+		logs = atoi(p);
+
+	lws_set_log_level(logs, NULL);
+	lwsl_user("LWS API selftest: lejp split input\n");
+
+	ref.p = malloc(TRACE_MAX);
+	t.p = malloc(TRACE_MAX);
+	if (!ref.p || !t.p) {
+		e++;
+		goto bail;
+	}
+
+	for (d = 0; d < (int)LWS_ARRAY_SIZE(docs); d++) {
+		docs[d].build();
+
+		/* the reference, a byte at a time */
+
+		sizes[0] = 1;
+		ref_r = parse(&ref, sizes, 1);
+		if ((docs[d].bad ? !ref_r || ref_r == LEJP_CONTINUE : !!ref_r) ||
+		    ref.overflow) {
+			lwsl_err("%s: %s: reference parse gave %d\n", __func__,
+				 docs[d].name, ref_r);
+			e++;
+			continue;
+		}
+
+		/* in one go */
+
+		sizes[0] = doc_len;
+		r = parse(&t, sizes, 1);
+		e += check(&ref, ref_r, &t, r, docs[d].name, "whole", doc_len);
+
+		/* split in two at every offset */
+
+		for (k = 1; k < doc_len && !e; k++) {
+			sizes[0] = k;
+			sizes[1] = doc_len;
+			r = parse(&t, sizes, 2);
+			e += check(&ref, ref_r, &t, r, docs[d].name, "split", k);
+		}
+
+		/* in pieces of every size up to a couple of string chunks */
+
+		for (k = 2; k < 2 * LEJP_STRING_CHUNK + 4 && !e; k++) {
+			sizes[0] = k;
+			r = parse(&t, sizes, 1);
+			e += check(&ref, ref_r, &t, r, docs[d].name, "pieces", k);
+		}
+
+		lwsl_info("%s: %s: %u bytes\n", __func__, docs[d].name,
+			  (unsigned int)doc_len);
+
+		if (e)
+			break;
+	}
+
+bail:
+	free(ref.p);
+	free(t.p);
+
+	if (e)
+		lwsl_user("Completed: FAIL %d\n", e);
+	else
+		lwsl_user("Completed: PASS\n");
+
+	return e;
+}
@@ -310,6 +310,192 @@ show_target(struct lws_dll2 *d, void *user)
 	return 0;
 }
 
+/*
+ * Serialize again into small buffers, which must resume correctly across
+ * calls and add up to the same JSON as doing it in one go
+ */
+
+static int
+serialize_chunked(const lws_struct_map_t *map, size_t map_entries,
+		  const void *obj, size_t chunk, const char *expected)
+{
+	lws_struct_serialize_t *ser;
+	char out[4096];
+	uint8_t buf[256];
+	size_t w, pos = 0;
+	int n;
+
+	ser = lws_struct_json_serialize_create(map, map_entries, 0, obj);
+	if (!ser)
+		return 1;
+
+	do {
+		n = lws_struct_json_serialize(ser, buf, chunk, &w);
+		if (n == LSJS_RESULT_ERROR || pos + w >= sizeof(out))
+			break;
+		memcpy(out + pos, buf, w);
+		pos += w;
+	} while (n == LSJS_RESULT_CONTINUE);
+
+	lws_struct_json_serialize_destroy(&ser);
+	out[pos] = '\0';
+
+	if (n != LSJS_RESULT_FINISH || strcmp(out, expected)) {
+		lwsl_err("%s: chunk %d: got %s\n", __func__, (int)chunk, out);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Path matching benchmark: a policy-sized path table, and a large JSON doc
+ * that exercises it, parsed with linear matching and then with a compiled
+ * path index.  Both must see identical matches.
+ */
+
+static const char * const bench_paths[] = {
+	"release",
+	"product",
+	"schema-version",
+	"retry[].*.backoff",
+	"retry[].*.conceal",
+	"retry[].*.jitterpc",
+	"retry[].*",
+	"certs[].*",
+	"trust_stores[].name",
+	"trust_stores[].stack",
+	"s[].*.endpoint",
+	"s[].*.protocol",
+	"s[].*.port",
+	"s[].*.plugins",
+	"s[].*.tls",
+	"s[].*.client_cert",
+	"s[].*.opportunistic",
+	"s[].*.nailed_up",
+	"s[].*.urgent_tx",
+	"s[].*.urgent_rx",
+	"s[].*.long_poll",
+	"s[].*.retry",
+	"s[].*.tls_trust_store",
+	"s[].*.metadata",
+	"s[].*.metadata[].*",
+	"s[].*.http_auth_header",
+	"s[].*.http_dsn_header",
+	"s[].*.http_fwv_header",
+	"s[].*.http_devtype_header",
+	"s[].*.http_auth_preamble",
+	"s[].*.http_no_content_length",
+	"s[].*.rideshare",
+	"s[].*.payload_fmt",
+	"s[].*.http_method",
+	"s[].*.http_url",
+	"s[].*.h2q_oflow_txcr",
+	"s[].*.http_multipart_name",
+	"s[].*.http_multipart_filename",
+	"s[].*.http_mime_content_type",
+	"s[].*.http_www_form_urlencoded",
+	"s[].*.ws_subprotocol",
+	"s[].*.ws_binary",
+	"s[].*.local_sink",
+	"s[].*.mqtt_topic",
+	"s[].*.mqtt_subscribe",
+	"s[].*.mqtt_qos",
+	"s[].*.mqtt_keep_alive",
+	"s[].*.mqtt_clean_start",
+	"s[].*.mqtt_will_topic",
+	"s[].*.mqtt_will_message",
+	"s[].*.mqtt_will_qos",
+	"s[].*.mqtt_will_retain",
+	"s[].*",
+};
+
+static signed char
+bench_cb(struct lejp_ctx *ctx, char reason)
+{
+	uint32_t *sum = (uint32_t *)ctx->user;
+	int n;
+
+	if (reason != LEJPCB_PAIR_NAME && !(reason & LEJP_FLAG_CB_IS_VALUE))
+		return 0;
+
+	*sum = (*sum * 31) + ctx->path_match;
+	for (n = 0; n < ctx->wildcount; n++)
+		*sum = (*sum * 31) + ctx->wild[n];
+
+	return 0;
+}
+
+static int
+bench_path_match(int entries)
+{
+	struct lejp_path_index *pidx;
+	uint32_t sum[2] = { 0, 0 };
+	struct lejp_ctx ctx;
+	lws_usec_t us[2];
+	size_t len = 0;
+	char *json;
+	int n, m;
+
+	json = malloc((size_t)entries * 512 + 128);
+	if (!json)
+		return 1;
+
+	len = (size_t)lws_snprintf(json, 128, "{\"release\":\"01234567\","
+				   "\"product\":\"bench\",\"s\":[");
+	for (n = 0; n < entries; n++)
+		len += (size_t)lws_snprintf(json + len, 512,
+			"%s{\"streamtype%d\":{\"endpoint\":\"api.example.com\","
+			"\"port\":443,\"protocol\":\"h2\",\"http_method\":"
+			"\"POST\",\"http_url\":\"v1/things/%d\",\"tls\":true,"
+			"\"retry\":\"default\",\"tls_trust_store\":\"le\","
+			"\"metadata\":[{\"ctype\":\"content-type:\"},"
+			"{\"xctx\":\"x-context:\"}],\"opportunistic\":true,"
+			"\"mqtt_qos\":1,\"unknown\":{\"deeper\":[1,2,3]}}}",
+			n ? "," : "", n, n);
+	len += (size_t)lws_snprintf(json + len, 8, "]}");
+
+	pidx = lejp_path_index_create(bench_paths,
+				      LWS_ARRAY_SIZE(bench_paths), 0);
+	if (!pidx) {
+		free(json);
+		return 1;
+	}
+
+	for (m = 0; m < 2; m++) {
+		us[m] = lws_now_usecs();
+		if (m)
+			lejp_construct_indexed(&ctx, bench_cb, &sum[m], pidx);
+		else
+			lejp_construct(&ctx, bench_cb, &sum[m], bench_paths,
+				       LWS_ARRAY_SIZE(bench_paths));
+		n = lejp_parse(&ctx, (uint8_t *)json, (int)len);
+		lejp_destruct(&ctx);
+		us[m] = lws_now_usecs() - us[m];
+		if (n < 0) {
+			lwsl_err("%s: parse failed %d\n", __func__, n);
+			break;
+		}
+	}
+
+	lejp_path_index_destroy(&pidx);
+	free(json);
+
+	if (n < 0)
+		return 1;
+
+	lwsl_user("%s: %uKB, linear paths %lldus, path index %lldus\n",
+		  __func__, (unsigned int)(len / 1024), (long long)us[0],
+		  (long long)us[1]);
+
+	if (sum[0] != sum[1]) {
+		lwsl_err("%s: match mismatch %08x vs %08x\n", __func__,
+			 sum[0], sum[1]);
+		return 1;
+	}
+
+	return 0;
+}
 
 int main(int argc, const char **argv)
 {
@@ -323,8 +509,9 @@ int main(int argc, const char **argv)
 	lws_struct_args_t a;
 	sai_builder_t *b, mb;
 	sai_target_t mt;
-	sai_other_t *o;
+	sai_other_t *o, mo;
 	const char *p;
+	char esc[512];
 	meta_t meta;
 
 	if ((p = lws_cmdline_option(argc, argv, "-d")))
@@ -432,6 +619,17 @@ int main(int argc, const char **argv)
 			goto done;
 		}
 
+		for (n = 160; n <= 256; n += 24)
+			if (serialize_chunked(m + 1 != 8 ? lsm_schema_map :
+							&lsm_schema_map[1],
+					      m + 1 != 8 ?
+						LWS_ARRAY_SIZE(lsm_schema_map) : 1,
+					      m + 1 != 8 ? (void *)b : (void *)o,
+					      (size_t)n, json_expected[m])) {
+				e++;
+				goto done;
+			}
+
 		lws_struct_json_serialize_destroy(&ser);
 
 done:
@@ -482,6 +680,28 @@ done:
 
 	lws_struct_json_serialize_destroy(&ser);
 
+	/*
+	 * A string that is all \u-escaped chars, into buffers that run out
+	 * partway through an escape... it must resume without losing or
+	 * repeating anything
+	 */
+
+	memset(&mo, 1, sizeof(mo.name) - 1);
+	mo.name[sizeof(mo.name) - 1] = '\0';
+
+	n = lws_snprintf(esc, sizeof(esc), "{\"schema\":\"com-warmcat-sai-other\","
+							"\"name\":\"");
+	for (m = 0; m < (int)sizeof(mo.name) - 1; m++)
+		n += lws_snprintf(esc + n, sizeof(esc) - (size_t)n, "\\u0001");
+	lws_snprintf(esc + n, sizeof(esc) - (size_t)n, "\"}");
+
+	for (n = 122; n <= 256; n++)
+		if (serialize_chunked(&lsm_schema_map[1], 1, &mo, (size_t)n,
+				      esc))
+			goto bail;
+
+	if (bench_path_match(4000))
+		goto bail;
 
 	lwsl_user("Completed: PASS\n");
 
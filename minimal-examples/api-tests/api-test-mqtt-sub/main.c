@@ -0,0 +1,543 @@
+/*
+ * lws-api-test-mqtt-sub
+ *
+ * Written in 2010-2020 by Andy Green <andy@warmcat.com>
+ *
+ * This file is made available under the Creative Commons CC0 1.0
+ * Universal Public Domain Dedication.
+ *
+ * This api test opens three mqtt client streams sharing one connection to a
+ * tiny fake broker in the same context.  The streams subscribe to
+ * overlapping literal and wildcard filters, then the broker publishes a set
+ * of topics and each stream checks it got exactly the ones its own filters
+ * match.  The broker checks the client only asked it for each filter once,
+ * and only unsubscribed from a filter when the last stream using it let go.
+ */
+
+#include <libwebsockets.h>
+#include <string.h>
+#include <signal.h>
+
+enum {
+	PH_SUBSCRIBE,
+	PH_PUBLISH,	/* wildcard matching */
+	PH_UNSUB_A,	/* A drops d/#, B still has it */
+	PH_UNSUB_B,	/* B drops d/#, the broker is told now */
+	PH_PUBLISH2,	/* only B's d/+ and C's # are left for d/... */
+	PH_DONE
+};
+
+struct stream {
+	lws_mqtt_topic_elem_t		*filters;
+	uint32_t			num_filters;
+	const char			*expect[2]; /* topics for each publish */
+	char				rx[256];
+	struct lws			*wsi;
+	int				subscribed;
+};
+
+static lws_mqtt_topic_elem_t filters_a[] = {
+	{ .name = "+/x/y" },
+	{ .name = "x/+/y" },
+	{ .name = "x/y/+" },
+	{ .name = "t/#" },
+	{ .name = "$SYS/+" },
+	{ .name = "d/#" },
+	{ .name = "sync" },
+}, filters_b[] = {
+	{ .name = "d/#" },
+	{ .name = "d/+" },
+	{ .name = "sync" },
+}, filters_c[] = {
+	{ .name = "#" },
+	{ .name = "+/sys" },
+}, unsub_d[] = {
+	{ .name = "d/#" },
+};
+
+/*
+ * The broker publishes these in order, ending with "sync", so when every
+ * stream got "sync" it has seen everything it will get
+ */
+
+static const char * const publish1[] = {
+	"a/x/y", "x/a/y", "x/y/a", "x/y", "a/x/y/z", "t", "t/1/2", "tt",
+	"$SYS/sys", "d/1", "d/1/2", "sync"
+}, * const publish2[] = {
+	"d/1", "d/1/2", "sync"
+};
+
+static struct stream streams[] = {
+	{
+		.filters = filters_a, .num_filters = LWS_ARRAY_SIZE(filters_a),
+		.expect = {
+			/* '+' at each level, '#' matching its parent "t",
+			 * '$' only matched by a literal first level */
+			"a/x/y;x/a/y;x/y/a;t;t/1/2;$SYS/sys;d/1;d/1/2;sync;",
+			"sync;"
+		}
+	}, {
+		.filters = filters_b, .num_filters = LWS_ARRAY_SIZE(filters_b),
+		.expect = {
+			/* d/1 matches two of ours, but we only hear it once */
+			"d/1;d/1/2;sync;",
+			"d/1;sync;"
+		}
+	}, {
+		.filters = filters_c, .num_filters = LWS_ARRAY_SIZE(filters_c),
+		.expect = {
+			/* '#' and '+' don't match the $SYS first level */
+			"a/x/y;x/a/y;x/y/a;x/y;a/x/y/z;t;t/1/2;tt;d/1;d/1/2;sync;",
+			"d/1;d/1/2;sync;"
+		}
+	},
+};
+
+/* what the broker should be asked for, once each */
+
+static const char *expect_subs = "+/x/y;x/+/y;x/y/+;t/#;$SYS/+;d/#;sync;"
+				 "d/+;#;+/sys;",
+		  *expect_unsubs = "d/#;";
+
+static const lws_mqtt_client_connect_param_t client_connect_param = {
+	.client_id			= "lws-api-test-mqtt-sub",
+	.keep_alive			= 60,
+	.clean_start			= 1,
+	.username			= "lwsUser",
+};
+
+static struct lws_context *context;
+static int interrupted, phase, fail, synced, started;
+static char subs[256], unsubs[256];
+static lws_sorted_usec_list_t sul_timeout;
+
+/* the fake broker */
+
+static struct lws *broker;
+static uint8_t brx[1024], btx[1024];
+static size_t brx_len, btx_len;
+
+static void
+next_phase(void);
+
+static void
+btx_add(const void *p, size_t len)
+{
+	if (btx_len + len > sizeof(btx)) {
+		lwsl_err("%s: broker tx overflow\n", __func__);
+		fail++;
+		return;
+	}
+	memcpy(&btx[btx_len], p, len);
+	btx_len += len;
+	lws_callback_on_writable(broker);
+}
+
+static void
+broker_publish(const char * const *topics, size_t count)
+{
+	uint8_t b[64];
+	size_t n, tl;
+
+	for (n = 0; n < count; n++) {
+		tl = strlen(topics[n]);
+		b[0] = 0x30; /* PUBLISH, QoS0 */
+		b[1] = (uint8_t)(2 + tl + 1);
+		b[2] = 0;
+		b[3] = (uint8_t)tl;
+		memcpy(&b[4], topics[n], tl);
+		b[4 + tl] = 'x';
+		btx_add(b, 5 + tl);
+	}
+}
+
+static void
+topic_list(char *list, size_t size, const uint8_t *p, const uint8_t *end,
+	   int has_qos)
+{
+	size_t l = strlen(list), tl;
+
+	while (end - p >= 2) {
+		tl = (size_t)lws_ser_ru16be(p);
+		p += 2;
+		if (tl > (size_t)(end - p) || l + tl + 2 > size) {
+			fail++;
+			return;
+		}
+		memcpy(&list[l], p, tl);
+		l += tl;
+		list[l++] = ';';
+		list[l] = '\0';
+		p += tl + (has_qos ? 1 : 0);
+	}
+}
+
+static int
+broker_packet(uint8_t type, const uint8_t *p, size_t len)
+{
+	const uint8_t *q, *end = p + len;
+	uint8_t b[16];
+	size_t n;
+
+	switch (type >> 4) {
+	case 1: /* CONNECT */
+		btx_add("\x20\x02\x00\x00", 4);
+		break;
+
+	case 8: /* SUBSCRIBE */
+		topic_list(subs, sizeof(subs), p + 2, end, 1);
+		b[0] = 0x90;
+		b[2] = p[0];
+		b[3] = p[1];
+		n = 4;
+		/* grant QoS0 for each filter in the request */
+		for (q = p + 2; end - q >= 2 && n < sizeof(b);
+		     q += 2 + lws_ser_ru16be(q) + 1)
+			b[n++] = 0;
+		b[1] = (uint8_t)(n - 2);
+		btx_add(b, n);
+		break;
+
+	case 10: /* UNSUBSCRIBE */
+		topic_list(unsubs, sizeof(unsubs), p + 2, p + len, 0);
+		b[0] = 0xb0;
+		b[1] = 2;
+		b[2] = p[0];
+		b[3] = p[1];
+		btx_add(b, 4);
+		break;
+
+	case 12: /* PINGREQ */
+		btx_add("\xd0\x00", 2);
+		break;
+
+	case 14: /* DISCONNECT */
+		return -1;
+
+	default:
+		lwsl_err("%s: unexpected packet 0x%x\n", __func__, type);
+		fail++;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+callback_broker(struct lws *wsi, enum lws_callback_reasons reason, void *user,
+		void *in, size_t len)
+{
+	size_t used, rl;
+	int m;
+
+	switch (reason) {
+	case LWS_CALLBACK_RAW_ADOPT:
+		broker = wsi;
+		break;
+
+	case LWS_CALLBACK_RAW_RX:
+		if (brx_len + len > sizeof(brx)) {
+			lwsl_err("%s: broker rx overflow\n", __func__);
+			fail++;
+			return -1;
+		}
+		memcpy(&brx[brx_len], in, len);
+		brx_len += len;
+
+		/* everything we expect has a remaining length < 128 */
+
+		used = 0;
+		while (brx_len - used >= 2) {
+			rl = brx[used + 1];
+			if (rl & 0x80) {
+				lwsl_err("%s: packet too large\n", __func__);
+				fail++;
+				return -1;
+			}
+			if (brx_len - used < 2 + rl)
+				break;
+			if (broker_packet(brx[used], &brx[used + 2], rl))
+				return -1;
+			used += 2 + rl;
+		}
+		memmove(brx, &brx[used], brx_len - used);
+		brx_len -= used;
+		break;
+
+	case LWS_CALLBACK_RAW_WRITEABLE:
+		if (!btx_len)
+			break;
+		m = lws_write(wsi, btx, btx_len, LWS_WRITE_RAW);
+		btx_len = 0;
+		if (m < 0)
+			return -1;
+		break;
+
+	case LWS_CALLBACK_RAW_CLOSE:
+		broker = NULL;
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+/* the client streams */
+
+static int
+connect_stream(struct stream *s)
+{
+	struct lws_vhost *vh = lws_get_vhost_by_name(context, "broker");
+	struct lws_client_connect_info i;
+
+	memset(&i, 0, sizeof i);
+
+	i.mqtt_cp = &client_connect_param;
+	i.opaque_user_data = s;
+	i.protocol = "mqtt-sub";
+	i.address = "127.0.0.1";
+	i.host = "127.0.0.1";
+	i.context = context;
+	i.vhost = vh;
+	i.method = "MQTT";
+	i.alpn = "mqtt";
+	i.port = lws_get_vhost_listen_port(vh);
+	/* they all share the first stream's connection */
+	i.ssl_connection = LCCSCF_PIPELINE;
+
+	if (!lws_client_connect_via_info(&i)) {
+		lwsl_err("%s: connect failed\n", __func__);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void
+check(struct stream *s, int n)
+{
+	if (strcmp(s->rx, s->expect[n])) {
+		lwsl_err("%s: stream %c got \"%s\"\n", __func__,
+			 'A' + (int)(s - streams), s->rx);
+		lwsl_err("%s:     expected \"%s\"\n", __func__, s->expect[n]);
+		fail++;
+	}
+	s->rx[0] = '\0';
+}
+
+static void
+next_phase(void)
+{
+	size_t n;
+
+	switch (++phase) {
+	case PH_PUBLISH:
+		if (strcmp(subs, expect_subs)) {
+			lwsl_err("%s: broker got SUBSCRIBE for \"%s\"\n",
+				 __func__, subs);
+			fail++;
+		}
+		broker_publish(publish1, LWS_ARRAY_SIZE(publish1));
+		break;
+
+	case PH_UNSUB_A:
+		for (n = 0; n < LWS_ARRAY_SIZE(streams); n++)
+			check(&streams[n], 0);
+		lws_callback_on_writable(streams[0].wsi);
+		break;
+
+	case PH_UNSUB_B:
+		if (unsubs[0]) {
+			lwsl_err("%s: UNSUBSCRIBE while B still uses d/#\n",
+				 __func__);
+			fail++;
+		}
+		lws_callback_on_writable(streams[1].wsi);
+		break;
+
+	case PH_PUBLISH2:
+		if (strcmp(unsubs, expect_unsubs)) {
+			lwsl_err("%s: broker got UNSUBSCRIBE for \"%s\"\n",
+				 __func__, unsubs);
+			fail++;
+		}
+		broker_publish(publish2, LWS_ARRAY_SIZE(publish2));
+		break;
+
+	case PH_DONE:
+		for (n = 0; n < LWS_ARRAY_SIZE(streams); n++)
+			check(&streams[n], 1);
+		interrupted = 1;
+		lws_cancel_service(context);
+		break;
+	}
+}
+
+static int
+callback_mqtt(struct lws *wsi, enum lws_callback_reasons reason, void *user,
+	      void *in, size_t len)
+{
+	struct stream *s = (struct stream *)lws_get_opaque_user_data(wsi);
+	lws_mqtt_publish_param_t *pub = (lws_mqtt_publish_param_t *)in;
+	lws_mqtt_subscribe_param_t sp;
+	size_t l;
+
+	switch (reason) {
+	case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
+		lwsl_err("%s: CLIENT_CONNECTION_ERROR: %s\n", __func__,
+			 in ? (char *)in : "(null)");
+		fail++;
+		interrupted = 1;
+		break;
+
+	case LWS_CALLBACK_MQTT_CLIENT_ESTABLISHED:
+		/* the first stream's wsi isn't the one we connected with */
+		s->wsi = wsi;
+		lws_callback_on_writable(wsi);
+		break;
+
+	case LWS_CALLBACK_MQTT_CLIENT_WRITEABLE:
+		memset(&sp, 0, sizeof(sp));
+		if (!s->subscribed) {
+			sp.topic = s->filters;
+			sp.num_topics = s->num_filters;
+			s->subscribed = 1;
+			return !!lws_mqtt_client_send_subcribe(wsi, &sp);
+		}
+		if ((phase == PH_UNSUB_A && s == &streams[0]) ||
+		    (phase == PH_UNSUB_B && s == &streams[1])) {
+			sp.topic = unsub_d;
+			sp.num_topics = LWS_ARRAY_SIZE(unsub_d);
+			return !!lws_mqtt_client_send_unsubcribe(wsi, &sp);
+		}
+		break;
+
+	case LWS_CALLBACK_MQTT_SUBSCRIBED:
+		/* bring up the streams one after another */
+		if (++started < (int)LWS_ARRAY_SIZE(streams)) {
+			if (connect_stream(&streams[started])) {
+				fail++;
+				interrupted = 1;
+			}
+			break;
+		}
+		next_phase();
+		break;
+
+	case LWS_CALLBACK_MQTT_UNSUBSCRIBED:
+		next_phase();
+		break;
+
+	case LWS_CALLBACK_MQTT_CLIENT_RX:
+		l = strlen(s->rx);
+		if (l + pub->topic_len + 2 > sizeof(s->rx)) {
+			fail++;
+			break;
+		}
+		memcpy(&s->rx[l], pub->topic, pub->topic_len);
+		l += pub->topic_len;
+		s->rx[l++] = ';';
+		s->rx[l] = '\0';
+
+		if (!strcmp(pub->topic, "sync") &&
+		    ++synced == (int)LWS_ARRAY_SIZE(streams)) {
+			synced = 0;
+			next_phase();
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static struct lws_protocols protocols[] = {
+	{ "broker", callback_broker, 0, 0 },
+	{ "mqtt-sub", callback_mqtt, 0, 0 },
+	{ NULL, NULL, 0, 0 } /* terminator */
+};
+
+static void
+timeout_cb(lws_sorted_usec_list_t *sul)
+{
+	lwsl_err("%s: timed out in phase %d\n", __func__, phase);
+	fail++;
+	interrupted = 1;
+}
+
+void sigint_handler(int sig)
+{
+	interrupted = 1;
+}
+
+int
+main(int argc, const char **argv)
+{
+	int n = 0, logs = LLL_USER | LLL_ERR | LLL_WARN | LLL_NOTICE;
+	struct lws_context_creation_info info;
+	const char *p;
+
+	signal(SIGINT, sigint_handler);
+
+	if ((p = lws_cmdline_option(argc, argv, "-d")))
+		logs = atoi(p);
+
+	lws_set_log_level(logs, NULL);
+	lwsl_user("LWS API selftest: mqtt subscription matching\n");
+
+	memset(&info, 0, sizeof info); /* otherwise uninitialized garbage */
+	info.options = LWS_SERVER_OPTION_EXPLICIT_VHOSTS;
+
+	context = lws_create_context(&info);
+	if (!context) {
+		lwsl_err("lws init failed\n");
+		return 1;
+	}
+
+	/* the broker listens on any free port */
+
+	info.options = LWS_SERVER_OPTION_ADOPT_APPLY_LISTEN_ACCEPT_CONFIG;
+	info.vhost_name = "broker";
+	info.port = 0;
+	info.iface = "127.0.0.1";
+	info.listen_accept_role = "raw-skt";
+	info.listen_accept_protocol = "broker";
+	info.protocols = protocols;
+
+	if (!lws_create_vhost(context, &info)) {
+		lwsl_err("%s: failed to create broker vhost\n", __func__);
+		fail++;
+		goto bail;
+	}
+
+	if (connect_stream(&streams[0])) {
+		fail++;
+		goto bail;
+	}
+
+	lws_sul_schedule(context, 0, &sul_timeout, timeout_cb,
+			 5 * LWS_US_PER_SEC);
+
+	while (n >= 0 && !interrupted)
+		n = lws_service(context, 0);
+
+	lws_sul_schedule(context, 0, &sul_timeout, NULL,
+			 LWS_SET_TIMER_USEC_CANCEL);
+
+	if (phase != PH_DONE)
+		fail++;
+
+bail:
+	lws_context_destroy(context);
+
+	if (fail)
+		lwsl_user("Completed: FAIL (phase %d)\n", phase);
+	else
+		lwsl_user("Completed: PASS\n");
+
+	return fail;
+}
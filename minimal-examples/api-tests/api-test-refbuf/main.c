@@ -0,0 +1,537 @@
+/*
+ * lws-api-test-refbuf
+ *
+ * Written in 2010-2020 by Andy Green <andy@warmcat.com>
+ *
+ * This file is made available under the Creative Commons CC0 1.0
+ * Universal Public Domain Dedication.
+ *
+ * This api test checks buffered output referencing lws_refbuf payloads.
+ *
+ * It uses a custom allocator to see which buflist segments are allocated as
+ * copies and which as references, and when each refbuf is actually freed.
+ *
+ *  - a refbuf referenced from a buflist outlives its creator's reference
+ *
+ *  - two ws server connections whose peers aren't reading are each sent the
+ *    same two refbufs with lws_write_refbuf().  The first is only partly
+ *    sent, the second is queued whole behind it: its ws header must be
+ *    copied and its payload referenced.  The refbufs must only be freed
+ *    once the last connection drained them.
+ *
+ *  - a ws client connection masks what it sends, so lws_write_refbuf() on it
+ *    must use a private copy and leave the shared payload alone
+ */
+
+#include <libwebsockets.h>
+#include <sys/socket.h>
+#include <string.h>
+#include <signal.h>
+#include <stdlib.h>
+
+#define BIG_LEN		(1024 * 1024)
+#define SMALL_LEN	1000
+#define CLIENTS		2
+
+enum {
+	PH_CONNECT,
+	PH_WRITE,	/* the server sides queue both messages */
+	PH_DRAIN_A,	/* only client A reads */
+	PH_DRAIN_B,	/* then client B */
+	PH_MASK,	/* client A sends a refbuf to the server */
+	PH_DONE
+};
+
+struct conn {
+	struct lws	*cwsi;	/* client side */
+	struct lws	*swsi;	/* its server side */
+	size_t		rx;
+	int		msgs;
+};
+
+static struct lws_context *context;
+static int interrupted, phase, fail, established, drained;
+static struct conn conns[CLIENTS];
+static lws_sorted_usec_list_t sul_timeout;
+static struct lws_refbuf *big, *small, *masked;
+static size_t mask_rx;
+
+/* allocation tracking */
+
+static struct lws_refbuf *watch[3];
+static int freed[3], recording, copies, refs, rb_creates;
+static size_t copy_max;
+
+static void *
+track_realloc(void *ptr, size_t size, const char *reason)
+{
+	void *v;
+	int n;
+
+	if (!size) {
+		for (n = 0; n < (int)LWS_ARRAY_SIZE(watch); n++)
+			if (ptr && ptr == (void *)watch[n])
+				freed[n] = 1;
+		free(ptr);
+
+		return NULL;
+	}
+
+	v = realloc(ptr, size);
+
+	if (recording) {
+		if (!strcmp(reason, "lws_buflist_append_segment")) {
+			copies++;
+			if (size > copy_max)
+				copy_max = size;
+		}
+		if (!strcmp(reason, "lws_buflist_append_segment_refbuf"))
+			refs++;
+		if (!strcmp(reason, "lws_refbuf_create"))
+			rb_creates++;
+	}
+
+	return v;
+}
+
+static uint8_t
+pattern(int msg, size_t pos)
+{
+	return msg ? (uint8_t)(pos * 13 + 1) : (uint8_t)(pos * 7);
+}
+
+static struct lws_refbuf *
+create(int msg, size_t len, int w)
+{
+	struct lws_refbuf *rb = lws_refbuf_create(NULL, len);
+	size_t n;
+
+	if (!rb)
+		return NULL;
+
+	for (n = 0; n < len; n++)
+		lws_refbuf_payload(rb)[n] = pattern(msg, n);
+	watch[w] = rb;
+	freed[w] = 0;
+
+	return rb;
+}
+
+/* the buflist on its own, no connections */
+
+static int
+test_buflist(void)
+{
+	struct lws_buflist *bl = NULL;
+	struct lws_refbuf *rb;
+	uint8_t *p;
+	size_t n;
+	int e = 0;
+
+	rb = create(0, 64, 0);
+	if (!rb)
+		return 1;
+
+	if (lws_buflist_append_segment(&bl, lws_refbuf_payload(rb), 16) != 1 ||
+	    lws_buflist_append_segment_refbuf(&bl, rb,
+				lws_refbuf_payload(rb) + 16, 48) != 0) {
+		lwsl_err("%s: append failed\n", __func__);
+		e++;
+	}
+
+	/* only the segments keep it alive now */
+	lws_refbuf_unref(&rb);
+	if (freed[0]) {
+		lwsl_err("%s: freed while referenced\n", __func__);
+
+		return 1;
+	}
+
+	/* the first segment is a copy, the second points into the refbuf */
+
+	n = lws_buflist_next_segment_len(&bl, &p);
+	if (n != 16 || p == lws_refbuf_payload(watch[0]) ||
+	    memcmp(p, lws_refbuf_payload(watch[0]), 16))
+		e++;
+	lws_buflist_use_segment(&bl, 16);
+
+	n = lws_buflist_next_segment_len(&bl, &p);
+	if (n != 48 || p != lws_refbuf_payload(watch[0]) + 16) {
+		lwsl_err("%s: refbuf segment isn't a reference\n", __func__);
+		e++;
+	}
+
+	lws_buflist_use_segment(&bl, 40);
+	if (freed[0]) {
+		lwsl_err("%s: freed while referenced\n", __func__);
+		e++;
+	}
+
+	lws_buflist_use_segment(&bl, 8);
+	if (!freed[0] || bl) {
+		lwsl_err("%s: not freed after last use\n", __func__);
+		e++;
+	}
+
+	/* destroying the list also drops the references */
+
+	rb = create(0, 64, 0);
+	if (!rb)
+		return 1;
+	if (lws_buflist_append_segment_refbuf(&bl, rb,
+					lws_refbuf_payload(rb), 64) != 1 ||
+	    lws_buflist_append_segment_refbuf(&bl, rb,
+					lws_refbuf_payload(rb), 32) != 0)
+		e++;
+	lws_refbuf_unref(&rb);
+	lws_buflist_destroy_all_segments(&bl);
+	if (!freed[0]) {
+		lwsl_err("%s: destroy didn't drop the reference\n", __func__);
+		e++;
+	}
+
+	return e;
+}
+
+static void
+next_phase(void)
+{
+	int n;
+
+	switch (++phase) {
+	case PH_WRITE:
+		for (n = 0; n < CLIENTS; n++)
+			lws_callback_on_writable(conns[n].swsi);
+		break;
+
+	case PH_DRAIN_A:
+		/*
+		 * Both connections queued both messages.  The ws header for
+		 * each connection was written into the shared LWS_PRE area,
+		 * it must have been copied, so trashing it can't matter.
+		 */
+		memset(lws_refbuf_payload(small) - LWS_PRE, 0xff, LWS_PRE);
+
+		lws_refbuf_unref(&big);
+		lws_refbuf_unref(&small);
+		if (freed[0] || freed[1]) {
+			lwsl_err("%s: refbuf freed while queued\n", __func__);
+			fail++;
+		}
+
+		lws_rx_flow_control(conns[0].cwsi, 1);
+		break;
+
+	case PH_DRAIN_B:
+		if (freed[0] || freed[1]) {
+			lwsl_err("%s: refbuf freed before B drained\n",
+				 __func__);
+			fail++;
+		}
+		lws_rx_flow_control(conns[1].cwsi, 1);
+		break;
+
+	case PH_MASK:
+		if (!freed[0] || !freed[1]) {
+			lwsl_err("%s: refbuf not freed after both drained\n",
+				 __func__);
+			fail++;
+		}
+		lws_callback_on_writable(conns[0].cwsi);
+		break;
+
+	case PH_DONE:
+		interrupted = 1;
+		lws_cancel_service(context);
+		break;
+	}
+}
+
+static int
+callback_refbuf(struct lws *wsi, enum lws_callback_reasons reason,
+		void *user, void *in, size_t len)
+{
+	struct conn *c = (struct conn *)lws_get_opaque_user_data(wsi);
+	const uint8_t *p = (const uint8_t *)in;
+	int n, sndbuf = 4096;
+	size_t m, l;
+
+	switch (reason) {
+
+	/* server side */
+
+	case LWS_CALLBACK_ESTABLISHED:
+		/* keep what the kernel will hold for us small */
+		setsockopt(lws_get_socket_fd(wsi), SOL_SOCKET, SO_SNDBUF,
+			   &sndbuf, sizeof(sndbuf));
+		break;
+
+	case LWS_CALLBACK_RECEIVE:
+		if (!c) {
+			/* the first thing each client sends is its index */
+			if (len != 1 || *p >= CLIENTS) {
+				fail++;
+				return -1;
+			}
+			c = &conns[*p];
+			c->swsi = wsi;
+			lws_set_opaque_user_data(wsi, c);
+			if (++established == CLIENTS)
+				next_phase();
+			break;
+		}
+
+		/* the masked message from client A */
+		for (m = 0; m < len; m++)
+			if (p[m] != pattern(0, mask_rx + m)) {
+				lwsl_err("%s: masked rx corrupt at %u\n",
+					 __func__, (unsigned int)(mask_rx + m));
+				fail++;
+				return -1;
+			}
+		mask_rx += len;
+		if (lws_is_final_fragment(wsi) &&
+		    !lws_remaining_packet_payload(wsi)) {
+			if (mask_rx != SMALL_LEN) {
+				fail++;
+				return -1;
+			}
+			next_phase();
+		}
+		break;
+
+	case LWS_CALLBACK_SERVER_WRITEABLE:
+		if (phase != PH_WRITE || !c)
+			break;
+
+		n = lws_write_refbuf(wsi, big, LWS_WRITE_BINARY);
+		if (n < 0 || !lws_partial_buffered(wsi)) {
+			lwsl_err("%s: big write wasn't partial\n", __func__);
+			fail++;
+			return -1;
+		}
+
+		/*
+		 * This one goes on the buflist behind the rest of the big
+		 * one, the header must be copied, the payload only referenced
+		 */
+
+		copies = refs = 0;
+		copy_max = 0;
+		recording = 1;
+		n = lws_write_refbuf(wsi, small, LWS_WRITE_BINARY);
+		recording = 0;
+		if (n < 0 || copies != 1 || refs != 1 || copy_max >= SMALL_LEN) {
+			lwsl_err("%s: queued write made %d copies (max %u), "
+				 "%d refs\n", __func__, copies,
+				 (unsigned int)copy_max, refs);
+			fail++;
+		}
+
+		if (++drained == CLIENTS) {
+			drained = 0;
+			next_phase();
+		}
+		break;
+
+	/* client side */
+
+	case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
+		lwsl_err("%s: CLIENT_CONNECTION_ERROR: %s\n", __func__,
+			 in ? (char *)in : "(null)");
+		fail++;
+		interrupted = 1;
+		break;
+
+	case LWS_CALLBACK_CLIENT_ESTABLISHED:
+		c->cwsi = wsi;
+		/* let the server side fill up the connection */
+		lws_rx_flow_control(wsi, 0);
+		lws_callback_on_writable(wsi);
+		break;
+
+	case LWS_CALLBACK_CLIENT_WRITEABLE:
+		if (phase == PH_CONNECT) {
+			uint8_t buf[LWS_PRE + 1];
+
+			buf[LWS_PRE] = (uint8_t)(c - conns);
+			if (lws_write(wsi, &buf[LWS_PRE], 1,
+				      LWS_WRITE_BINARY) != 1)
+				return -1;
+			break;
+		}
+		if (phase != PH_MASK || c != &conns[0])
+			break;
+
+		/* masking changes the payload, we must get a private copy */
+
+		rb_creates = 0;
+		recording = 1;
+		n = lws_write_refbuf(wsi, masked, LWS_WRITE_BINARY);
+		recording = 0;
+		if (n < 0)
+			return -1;
+		if (rb_creates != 1) {
+			lwsl_err("%s: client write made %d refbufs\n",
+				 __func__, rb_creates);
+			fail++;
+		}
+		for (m = 0; m < SMALL_LEN; m++)
+			if (lws_refbuf_payload(masked)[m] != pattern(0, m)) {
+				lwsl_err("%s: client write changed the shared "
+					 "payload\n", __func__);
+				fail++;
+				break;
+			}
+		break;
+
+	case LWS_CALLBACK_CLIENT_RECEIVE:
+		for (m = 0; m < len; m++) {
+			l = c->rx + m;
+			if (c->msgs)
+				l -= BIG_LEN;
+			if (p[m] != pattern(c->msgs, l)) {
+				lwsl_err("%s: rx %d corrupt at %u\n", __func__,
+					 c->msgs, (unsigned int)l);
+				fail++;
+				return -1;
+			}
+		}
+		c->rx += len;
+		if (!lws_is_final_fragment(wsi) ||
+		    lws_remaining_packet_payload(wsi))
+			break;
+
+		if (c->rx != (c->msgs ? BIG_LEN + SMALL_LEN : BIG_LEN)) {
+			lwsl_err("%s: message %d ended at %u\n", __func__,
+				 c->msgs, (unsigned int)c->rx);
+			fail++;
+			return -1;
+		}
+		if (++c->msgs == 2)
+			next_phase();
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static struct lws_protocols protocols[] = {
+	{ "refbuf", callback_refbuf, 0, 0 },
+	{ NULL, NULL, 0, 0 } /* terminator */
+};
+
+static void
+timeout_cb(lws_sorted_usec_list_t *sul)
+{
+	lwsl_err("%s: timed out in phase %d\n", __func__, phase);
+	fail++;
+	interrupted = 1;
+}
+
+void sigint_handler(int sig)
+{
+	interrupted = 1;
+}
+
+int
+main(int argc, const char **argv)
+{
+	int n = 0, logs = LLL_USER | LLL_ERR | LLL_WARN | LLL_NOTICE;
+	struct lws_context_creation_info info;
+	struct lws_client_connect_info i;
+	struct lws_vhost *vh;
+	const char *p;
+
+	signal(SIGINT, sigint_handler);
+
+	if ((p = lws_cmdline_option(argc, argv, "-d")))
+		logs = atoi(p);
+
+	lws_set_log_level(logs, NULL);
+	lwsl_user("LWS API selftest: lws_refbuf\n");
+
+	lws_set_allocator(track_realloc);
+
+	if (test_buflist()) {
+		fail++;
+		goto bail1;
+	}
+
+	memset(&info, 0, sizeof info); /* otherwise uninitialized garbage */
+	info.options = LWS_SERVER_OPTION_EXPLICIT_VHOSTS;
+
+	context = lws_create_context(&info);
+	if (!context) {
+		lwsl_err("lws init failed\n");
+		return 1;
+	}
+
+	info.port = 0; /* any free port */
+	info.iface = "127.0.0.1";
+	info.protocols = protocols;
+
+	vh = lws_create_vhost(context, &info);
+	if (!vh) {
+		lwsl_err("%s: failed to create vhost\n", __func__);
+		fail++;
+		goto bail;
+	}
+
+	big = create(0, BIG_LEN, 0);
+	small = create(1, SMALL_LEN, 1);
+	masked = create(0, SMALL_LEN, 2);
+	if (!big || !small || !masked) {
+		fail++;
+		goto bail;
+	}
+
+	for (n = 0; n < CLIENTS; n++) {
+		memset(&i, 0, sizeof i);
+		i.context = context;
+		i.vhost = vh;
+		i.address = "127.0.0.1";
+		i.host = i.address;
+		i.origin = i.address;
+		i.port = lws_get_vhost_listen_port(vh);
+		i.path = "/";
+		i.protocol = protocols[0].name;
+		i.opaque_user_data = &conns[n];
+
+		if (!lws_client_connect_via_info(&i)) {
+			lwsl_err("%s: connect failed\n", __func__);
+			fail++;
+			goto bail;
+		}
+	}
+
+	lws_sul_schedule(context, 0, &sul_timeout, timeout_cb,
+			 10 * LWS_US_PER_SEC);
+
+	n = 0;
+	while (n >= 0 && !interrupted)
+		n = lws_service(context, 0);
+
+	lws_sul_schedule(context, 0, &sul_timeout, NULL,
+			 LWS_SET_TIMER_USEC_CANCEL);
+
+	if (phase != PH_DONE)
+		fail++;
+
+bail:
+	lws_refbuf_unref(&big);
+	lws_refbuf_unref(&small);
+	lws_refbuf_unref(&masked);
+	lws_context_destroy(context);
+
+bail1:
+	if (fail)
+		lwsl_user("Completed: FAIL (phase %d)\n", phase);
+	else
+		lwsl_user("Completed: PASS\n");
+
+	return fail;
+}
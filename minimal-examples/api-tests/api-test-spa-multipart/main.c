@@ -0,0 +1,534 @@
+/*
+ * lws-api-test-spa-multipart
+ *
+ * Written in 2010-2020 by Andy Green <andy@warmcat.com>
+ *
+ * This file is made available under the Creative Commons CC0 1.0
+ * Universal Public Domain Dedication.
+ *
+ * This api test checks lws_spa decodes multipart/form-data bodies the same
+ * however they are split between lws_spa_process() calls.
+ *
+ * Part content is skipped over in bulk up to the next boundary, or up to
+ * where one might start and continue in the next input, so the tests put
+ * boundaries across every split point, and fill the parts with partial
+ * "\r\n--boundary" prefixes that are content and must stay in it.
+ *
+ * Each body is fed whole, split in two at every offset, and in pieces of
+ * every size from 1 byte to past the boundary length.  Each time, the
+ * text params and the concatenated file content must be as expected.
+ */
+
+#include <libwebsockets.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <stdlib.h>
+
+#define BODY_MAX	(32 * 1024)
+#define TRACE_MAX	(32 * 1024)
+#define STORAGE		4096
+
+struct part {
+	const char	*name;
+	const char	*filename;	/* NULL for a text param */
+	char		*content;
+	size_t		len;
+};
+
+struct mp_case {
+	const char	*name;
+	const char	*boundary;
+	struct part	parts[5];
+	int		count_parts;
+
+	char		body[BODY_MAX];
+	size_t		body_len;
+	char		expect[TRACE_MAX];
+	size_t		expect_len;
+};
+
+static const char * const param_names[] = {
+	"t1",
+	"t2",
+	"t3",
+	"f1",
+	"f2",
+};
+
+static struct lws_context *context;
+static int interrupted, done, fail;
+static lws_sorted_usec_list_t sul_timeout;
+
+/* what the file upload callback saw */
+
+static char trace[TRACE_MAX];
+static size_t trace_len;
+static int trace_overflow;
+
+static struct mp_case cases[2];
+
+static void
+trace_add(const void *p, size_t len)
+{
+	if (trace_len + len > sizeof(trace)) {
+		trace_overflow = 1;
+		return;
+	}
+	memcpy(trace + trace_len, p, len);
+	trace_len += len;
+}
+
+static int
+file_upload_cb(void *data, const char *name, const char *filename,
+	       char *buf, int len, enum lws_spa_fileupload_states state)
+{
+	char hdr[256];
+	int n;
+
+	switch (state) {
+	case LWS_UFS_OPEN:
+		n = lws_snprintf(hdr, sizeof(hdr), "open %s %s\n", name,
+				 filename);
+		trace_add(hdr, (size_t)n);
+		break;
+	case LWS_UFS_CONTENT:
+	case LWS_UFS_FINAL_CONTENT:
+		/* however it was chunked, the content must be the same */
+		if (len)
+			trace_add(buf, (size_t)len);
+		if (state == LWS_UFS_FINAL_CONTENT)
+			trace_add("\nfinal\n", 7);
+		break;
+	case LWS_UFS_CLOSE:
+		trace_add("close\n", 6);
+		break;
+	}
+
+	return 0;
+}
+
+/* the body building helpers */
+
+static void
+add(struct mp_case *c, const void *p, size_t len)
+{
+	if (c->body_len + len <= sizeof(c->body)) {
+		memcpy(c->body + c->body_len, p, len);
+		c->body_len += len;
+	}
+}
+
+static void
+adds(struct mp_case *c, const char *s)
+{
+	add(c, s, strlen(s));
+}
+
+static void
+expect(struct mp_case *c, const void *p, size_t len)
+{
+	if (c->expect_len + len <= sizeof(c->expect)) {
+		memcpy(c->expect + c->expect_len, p, len);
+		c->expect_len += len;
+	}
+}
+
+/*
+ * Content made of every partial "\r\n--boundary" prefix followed by a char
+ * that breaks it, including a CR that might start the real thing, and the
+ * boundary without all of its CRLF or with one dash
+ */
+
+static size_t
+near_misses(const char *boundary, char *out, size_t max, uint32_t seed)
+{
+	char full[128], brk[] = "x\r-\n";
+	size_t fl, n, pos = 0, m;
+
+	fl = (size_t)lws_snprintf(full, sizeof(full), "\r\n--%s", boundary);
+
+	for (n = 1; n < fl && pos + fl + 24 < max; n++) {
+		/* some plain content of varying length first */
+		seed = seed * 1103515245 + 12345;
+		m = (seed >> 16) % 23;
+		while (m-- && pos < max)
+			out[pos++] = (char)('A' + ((seed >> 8) + m) % 26);
+
+		memcpy(out + pos, full, n);
+		pos += n;
+		out[pos++] = brk[n & 3] == full[n] ? 'x' : brk[n & 3];
+	}
+
+	n = (size_t)lws_snprintf(out + pos, max - pos,
+				 "--%s\r\n-%s\r\r\n-%s\n--%s\r--%s", boundary,
+				 boundary, boundary, boundary, boundary);
+
+	return pos + n;
+}
+
+static void
+build(struct mp_case *c)
+{
+	char hdr[256];
+	int n, m;
+
+	c->body_len = 0;
+	c->expect_len = 0;
+
+	for (n = 0; n < c->count_parts; n++) {
+		struct part *p = &c->parts[n];
+
+		m = lws_snprintf(hdr, sizeof(hdr), "%s--%s\r\n"
+			"Content-Disposition: form-data; name=\"%s\"%s%s%s\r\n",
+			n ? "\r\n" : "", c->boundary, p->name,
+			p->filename ? "; filename=\"" : "",
+			p->filename ? p->filename : "",
+			p->filename ? "\"" : "");
+		add(c, hdr, (size_t)m);
+		if (p->filename)
+			adds(c, "Content-Type: application/octet-stream\r\n");
+		adds(c, "\r\n");
+		add(c, p->content, p->len);
+
+		if (p->filename) {
+			m = lws_snprintf(hdr, sizeof(hdr), "open %s %s\n",
+					 p->name, p->filename);
+			expect(c, hdr, (size_t)m);
+			expect(c, p->content, p->len);
+			expect(c, "\nfinal\n", 7);
+		}
+	}
+
+	m = lws_snprintf(hdr, sizeof(hdr), "\r\n--%s--\r\n", c->boundary);
+	add(c, hdr, (size_t)m);
+	expect(c, "close\n", 6);
+}
+
+static char text_near[2][2048], file_near[2][BODY_MAX / 4],
+	    text_tail[2][256], file_tail[2][256];
+
+static void
+setup(void)
+{
+	static const char * const boundaries[] = {
+		"----WebKitFormBoundary7MA4YWxkTrZu0gW",
+		"aaaaaaaaab",	/* self-similar, for the skip table */
+	};
+	struct mp_case *c;
+	size_t n;
+	int i;
+
+	for (i = 0; i < (int)LWS_ARRAY_SIZE(cases); i++) {
+		c = &cases[i];
+		c->name = boundaries[i];
+		c->boundary = boundaries[i];
+
+		c->parts[0].name = "t1";
+		c->parts[0].content = (char *)"hello";
+		c->parts[0].len = 5;
+
+		/* a text param made of near misses */
+
+		c->parts[1].name = "t2";
+		c->parts[1].content = text_near[i];
+		c->parts[1].len = near_misses(c->boundary, text_near[i],
+					      sizeof(text_near[i]), 1);
+
+		/* a file bigger than the storage, with near misses */
+
+		c->parts[2].name = "f1";
+		c->parts[2].filename = "a.bin";
+		c->parts[2].content = file_near[i];
+		n = near_misses(c->boundary, file_near[i],
+				sizeof(file_near[i]) / 2, 2);
+		while (n < sizeof(file_near[i]) - 1024) {
+			memcpy(file_near[i] + n, file_near[i], 1024);
+			n += 1024;
+		}
+		c->parts[2].len = n;
+
+		/* parts ending in a partial boundary before the real one */
+
+		c->parts[3].name = "f2";
+		c->parts[3].filename = "b.bin";
+		c->parts[3].content = file_tail[i];
+		c->parts[3].len = (size_t)lws_snprintf(file_tail[i],
+				sizeof(file_tail[i]), "\r\n--%s", c->boundary) - 1;
+
+		c->parts[4].name = "t3";
+		c->parts[4].content = text_tail[i];
+		c->parts[4].len = (size_t)lws_snprintf(text_tail[i],
+				sizeof(text_tail[i]), "end\r\n--%.4s",
+				c->boundary);
+		c->count_parts = 5;
+
+		build(c);
+	}
+}
+
+/* feed the body to a new spa in pieces of the given sizes, last repeating */
+
+static int
+run(struct lws *wsi, struct mp_case *c, const size_t *sizes, int count_sizes,
+    const char *how, size_t arg)
+{
+	lws_spa_create_info_t i;
+	struct lws_spa *spa;
+	size_t pos = 0, n;
+	const char *v;
+	int s = 0, e = 0, p, k;
+
+	memset(&i, 0, sizeof(i));
+	i.param_names = param_names;
+	i.count_params = LWS_ARRAY_SIZE(param_names);
+	i.max_storage = STORAGE;
+	i.opt_cb = file_upload_cb;
+
+	trace_len = 0;
+	trace_overflow = 0;
+
+	spa = lws_spa_create_via_info(wsi, &i);
+	if (!spa)
+		return 1;
+
+	do {
+		n = sizes[s];
+		if (s < count_sizes - 1)
+			s++;
+		if (n > c->body_len - pos)
+			n = c->body_len - pos;
+		if (lws_spa_process(spa, c->body + pos, (int)n)) {
+			lwsl_err("%s: process failed\n", __func__);
+			e = 1;
+			break;
+		}
+		pos += n;
+	} while (pos < c->body_len);
+
+	lws_spa_finalize(spa);
+
+	/* the text params */
+
+	for (p = 0; p < c->count_parts; p++) {
+		if (c->parts[p].filename)
+			continue;
+		for (k = 0; k < (int)LWS_ARRAY_SIZE(param_names); k++)
+			if (!strcmp(param_names[k], c->parts[p].name))
+				break;
+		v = lws_spa_get_string(spa, k);
+		if (!v || lws_spa_get_length(spa, k) != (int)c->parts[p].len ||
+		    memcmp(v, c->parts[p].content, c->parts[p].len)) {
+			lwsl_err("%s: param %s wrong (%d)\n", __func__,
+				 c->parts[p].name, lws_spa_get_length(spa, k));
+			e = 1;
+		}
+	}
+
+	lws_spa_destroy(spa);
+
+	/* the file content */
+
+	if (trace_overflow || trace_len != c->expect_len ||
+	    memcmp(trace, c->expect, trace_len)) {
+		for (n = 0; n < trace_len && n < c->expect_len; n++)
+			if (trace[n] != c->expect[n])
+				break;
+		lwsl_err("%s: file content differs at %u\n", __func__,
+			 (unsigned int)n);
+		e = 1;
+	}
+
+	if (e)
+		lwsl_err("%s: %s: failed %s %u\n", __func__, c->name, how,
+			 (unsigned int)arg);
+
+	return e;
+}
+
+static int
+test_case(struct lws *wsi, struct mp_case *c)
+{
+	size_t sizes[2], k;
+	int e;
+
+	/* in one go */
+
+	sizes[0] = c->body_len;
+	e = run(wsi, c, sizes, 1, "whole", c->body_len);
+
+	/* split in two at every offset */
+
+	for (k = 1; k < c->body_len && !e; k++) {
+		sizes[0] = k;
+		sizes[1] = c->body_len;
+		e = run(wsi, c, sizes, 2, "split", k);
+	}
+
+	/* in pieces of every size up to past the boundary */
+
+	for (k = 1; k < strlen(c->boundary) + 16 && !e; k++) {
+		sizes[0] = k;
+		e = run(wsi, c, sizes, 1, "pieces", k);
+	}
+
+	lwsl_info("%s: %s: %u bytes\n", __func__, c->name,
+		  (unsigned int)c->body_len);
+
+	return e;
+}
+
+static int
+callback_spa(struct lws *wsi, enum lws_callback_reasons reason, void *user,
+	     void *in, size_t len)
+{
+	char path[16];
+	int n;
+
+	switch (reason) {
+	case LWS_CALLBACK_HTTP:
+		/*
+		 * The spa takes the boundary from this request's headers, we
+		 * give it the body ourselves so we choose how it is split
+		 */
+		if (lws_hdr_copy(wsi, path, sizeof(path),
+				 WSI_TOKEN_POST_URI) < 2) {
+			fail++;
+			return -1;
+		}
+		n = atoi(path + 1);
+		if (n < 0 || n >= (int)LWS_ARRAY_SIZE(cases)) {
+			fail++;
+			return -1;
+		}
+
+		if (test_case(wsi, &cases[n]))
+			fail++;
+
+		if (++done == (int)LWS_ARRAY_SIZE(cases)) {
+			interrupted = 1;
+			lws_cancel_service(context);
+		}
+
+		return -1;
+
+	default:
+		break;
+	}
+
+	return lws_callback_http_dummy(wsi, reason, user, in, len);
+}
+
+static struct lws_protocols protocols[] = {
+	{ "http", callback_spa, 0, 0 },
+	{ NULL, NULL, 0, 0 } /* terminator */
+};
+
+static void
+timeout_cb(lws_sorted_usec_list_t *sul)
+{
+	lwsl_err("%s: timed out\n", __func__);
+	fail++;
+	interrupted = 1;
+}
+
+void sigint_handler(int sig)
+{
+	interrupted = 1;
+}
+
+int
+main(int argc, const char **argv)
+{
+	/* the spa logs at notice level each time one is created */
+	int n = 1, logs = LLL_USER | LLL_ERR | LLL_WARN;
+	struct lws_context_creation_info info;
+	int sv[LWS_ARRAY_SIZE(cases)][2], c;
+	lws_sock_file_fd_type fd;
+	struct lws_vhost *vh;
+	char req[256];
+	const char *p;
+
+	signal(SIGINT, sigint_handler);
+
+	if ((p = lws_cmdline_option(argc, argv, "-d")))
+		logs = atoi(p);
+
+	lws_set_log_level(logs, NULL);
+	lwsl_user("LWS API selftest: lws_spa multipart\n");
+
+	setup();
+
+	memset(sv, -1, sizeof(sv));
+	memset(&info, 0, sizeof info); /* otherwise uninitialized garbage */
+	info.port = CONTEXT_PORT_NO_LISTEN;
+	info.protocols = protocols;
+
+	context = lws_create_context(&info);
+	if (!context) {
+		lwsl_err("lws init failed\n");
+		return 1;
+	}
+
+	vh = lws_get_vhost_by_name(context, "default");
+	if (!vh) {
+		fail++;
+		goto bail;
+	}
+
+	/* one request for each case on its own socketpair */
+
+	for (c = 0; c < (int)LWS_ARRAY_SIZE(cases); c++) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv[c])) {
+			lwsl_err("%s: unable to create socketpair\n", __func__);
+			fail++;
+			goto bail;
+		}
+
+		fd.sockfd = sv[c][0];
+		if (!lws_adopt_descriptor_vhost(vh, LWS_ADOPT_SOCKET |
+						    LWS_ADOPT_HTTP, fd,
+						"http", NULL)) {
+			sv[c][0] = -1;
+			fail++;
+			goto bail;
+		}
+		sv[c][0] = -1;
+
+		n = lws_snprintf(req, sizeof(req), "POST /%d HTTP/1.1\r\n"
+			"Host: localhost\r\n"
+			"Content-Type: multipart/form-data; boundary=%s\r\n"
+			"Content-Length: 0\r\n\r\n", c, cases[c].boundary);
+		if (write(sv[c][1], req, (size_t)n) != n) {
+			fail++;
+			goto bail;
+		}
+	}
+
+	lws_sul_schedule(context, 0, &sul_timeout, timeout_cb,
+			 60 * LWS_US_PER_SEC);
+
+	n = 0;
+	while (n >= 0 && !interrupted)
+		n = lws_service(context, 0);
+
+	lws_sul_schedule(context, 0, &sul_timeout, NULL,
+			 LWS_SET_TIMER_USEC_CANCEL);
+
+	if (done != (int)LWS_ARRAY_SIZE(cases))
+		fail++;
+
+bail:
+	lws_context_destroy(context);
+	for (c = 0; c < (int)LWS_ARRAY_SIZE(cases); c++)
+		if (sv[c][1] >= 0)
+			close(sv[c][1]);
+
+	if (fail)
+		lwsl_user("Completed: FAIL\n");
+	else
+		lwsl_user("Completed: PASS\n");
+
+	return fail;
+}
@@ -0,0 +1,571 @@
+/*
+ * lws-api-test-ws-bcast
+ *
+ * Written in 2010-2020 by Andy Green <andy@warmcat.com>
+ *
+ * This file is made available under the Creative Commons CC0 1.0
+ * Universal Public Domain Dedication.
+ *
+ * This api test checks ws broadcast messages sent with lws_ws_bcast_write()
+ * reach peers with different permessage-deflate settings intact.
+ *
+ * The peers are raw sockets in the same context doing their own ws framing
+ * and inflating, so they can see exactly what went on the wire: RSV1, how
+ * many frames each message took, and whether the deflate stream they got
+ * fits the window they expect.  A shared deflated broadcast frame goes out
+ * as one frame, a message deflated on the connection's own stream is
+ * fragmented by pmd.
+ *
+ *  - the first fresh pmd peer deflates the message once, with its 32KB
+ *    window
+ *
+ *  - a fresh peer whose server window is set smaller can't use that frame
+ *
+ *  - a peer whose tx stream was reset after an earlier message because it
+ *    negotiated client_no_context_takeover, and a fresh peer with other
+ *    window and takeover options, get the shared frame
+ *
+ *  - a peer whose tx stream holds context from an earlier message must not
+ *    get the shared frame, or its next message won't inflate
+ *
+ *  - a peer without pmd gets the plain frame
+ */
+
+#include <libwebsockets.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <zlib.h>
+
+#define BLOCK		4096
+#define MSG_LEN		(2 * BLOCK)	/* a block, then the same again */
+#define RX_MAX		(32 * 1024)
+
+enum {
+	M1,		/* sent with lws_write() before the broadcast */
+	B,		/* the broadcast */
+	M3,		/* M1's content again with lws_write() */
+};
+
+enum {
+	F_ONE		= 1,	/* whole message in one frame */
+	F_MANY		= 2,	/* message fragmented by pmd */
+};
+
+struct peer {
+	const char	*offer;		/* Sec-WebSocket-Extensions, or NULL */
+	int		server_wbits;	/* set on the server side, or 0 */
+	int		m1;		/* gets M1 before the broadcast */
+	int		bframes;	/* how the broadcast must arrive */
+
+	/* server side */
+	struct lws	*swsi;
+
+	/* client side */
+	struct lws	*cwsi;
+	uint8_t		rx[RX_MAX];
+	size_t		rx_len;
+	uint8_t		msg[RX_MAX];
+	size_t		msg_len;
+	z_stream	inf;
+	char		inf_init;
+	char		upgraded;
+	char		rsv1;
+	int		frames;
+	int		msgs;
+};
+
+static struct peer peers[] = {
+	{ "permessage-deflate",				0,  0, F_ONE  },
+	{ "permessage-deflate",				10, 0, F_MANY },
+	{ "permessage-deflate; client_no_context_takeover",
+							0,  1, F_ONE  },
+	{ "permessage-deflate",				0,  1, F_MANY },
+	{ NULL,						0,  1, F_ONE  },
+	{ "permessage-deflate; client_max_window_bits=9; "
+	  "client_no_context_takeover; server_no_context_takeover",
+							0,  0, F_ONE  },
+};
+
+#define PEERS ((int)LWS_ARRAY_SIZE(peers))
+
+/* what the server sends, in this order */
+
+struct step {
+	int		peer;
+	int		msg;
+};
+
+static struct step script[3 * LWS_ARRAY_SIZE(peers)];
+static int script_len, cursor;
+
+static struct lws_context *context;
+static int interrupted, established, done, fail;
+static lws_sorted_usec_list_t sul_timeout;
+static struct lws_ws_bcast *bcast;
+static uint8_t content[2][MSG_LEN];
+
+static void
+fill(uint8_t *p, uint32_t seed)
+{
+	int n;
+
+	/* incompressible, except that the second block repeats the first */
+
+	for (n = 0; n < BLOCK; n++) {
+		seed = seed * 1103515245 + 12345;
+		p[n] = (uint8_t)(seed >> 16);
+	}
+	memcpy(p + BLOCK, p, BLOCK);
+}
+
+static int
+expected_msgs(struct peer *pe)
+{
+	return pe->m1 ? 3 : 2;
+}
+
+static void
+next_step(void)
+{
+	if (++cursor < script_len)
+		lws_callback_on_writable(peers[script[cursor].peer].swsi);
+}
+
+static int
+callback_bcast(struct lws *wsi, enum lws_callback_reasons reason,
+	       void *user, void *in, size_t len)
+{
+	struct peer *pe = (struct peer *)lws_get_opaque_user_data(wsi);
+	uint8_t buf[LWS_PRE + MSG_LEN];
+	char path[16], val[4];
+
+	switch (reason) {
+
+	case LWS_CALLBACK_ESTABLISHED:
+		if (lws_hdr_copy(wsi, path, sizeof(path),
+				 WSI_TOKEN_GET_URI) < 2 ||
+		    atoi(path + 1) >= PEERS) {
+			fail++;
+			return -1;
+		}
+		pe = &peers[atoi(path + 1)];
+		pe->swsi = wsi;
+		lws_set_opaque_user_data(wsi, pe);
+
+		if (pe->server_wbits) {
+			lws_snprintf(val, sizeof(val), "%d", pe->server_wbits);
+			if (lws_set_extension_option(wsi, "permessage-deflate",
+					"server_max_window_bits", val)) {
+				fail++;
+				return -1;
+			}
+		}
+
+		if (++established == PEERS)
+			lws_callback_on_writable(
+					peers[script[0].peer].swsi);
+		break;
+
+	case LWS_CALLBACK_SERVER_WRITEABLE:
+		if (cursor >= script_len || pe != &peers[script[cursor].peer])
+			break;
+
+		if (script[cursor].msg == B) {
+			if (lws_ws_bcast_write(wsi, bcast) != MSG_LEN) {
+				lwsl_err("%s: bcast write failed\n", __func__);
+				fail++;
+				return -1;
+			}
+		} else {
+			memcpy(&buf[LWS_PRE], content[M1], MSG_LEN);
+			if (lws_write(wsi, &buf[LWS_PRE], MSG_LEN,
+				      LWS_WRITE_BINARY) < 0)
+				return -1;
+		}
+		next_step();
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+/* the peers' side: a ws client done by hand */
+
+static int
+peer_message(struct peer *pe)
+{
+	const uint8_t *want = content[pe->msgs == !!pe->m1 ? B : M1];
+	int wframes = 0, rsv1 = !!pe->offer;
+	uint8_t out[MSG_LEN + 1];
+	size_t olen;
+	int n = (int)(pe - peers);
+
+	/* only how the broadcast is framed is predictable */
+	if (pe->msgs == !!pe->m1)
+		wframes = pe->bframes;
+	if (!pe->offer)
+		wframes = F_ONE;
+
+	if (pe->rsv1 != rsv1 ||
+	    (wframes && (pe->frames == 1 ? F_ONE : F_MANY) != wframes)) {
+		lwsl_err("%s: peer %d msg %d: rsv1 %d, %d frames\n", __func__,
+			 n, pe->msgs, pe->rsv1, pe->frames);
+		return 1;
+	}
+
+	if (pe->rsv1) {
+		if (pe->msg_len + 4 > sizeof(pe->msg))
+			return 1;
+		memcpy(pe->msg + pe->msg_len, "\x00\x00\xff\xff", 4);
+		pe->inf.next_in = pe->msg;
+		pe->inf.avail_in = (unsigned int)pe->msg_len + 4;
+		pe->inf.next_out = out;
+
+		/*
+		 * zlib lets a distance reach back into what the same call
+		 * already produced, so only a little at a time, to hold the
+		 * stream to the window we expect
+		 */
+
+		while (pe->inf.avail_in) {
+			pe->inf.avail_out = (unsigned int)lws_ptr_diff(
+						out + sizeof(out),
+						pe->inf.next_out);
+			if (pe->inf.avail_out > 256)
+				pe->inf.avail_out = 256;
+			if (!pe->inf.avail_out ||
+			    inflate(&pe->inf, Z_SYNC_FLUSH) != Z_OK) {
+				lwsl_err("%s: peer %d msg %d: inflate failed: "
+					 "%s\n", __func__, n, pe->msgs,
+					 pe->inf.msg ? pe->inf.msg : "");
+				return 1;
+			}
+		}
+		olen = (size_t)lws_ptr_diff(pe->inf.next_out, out);
+	} else {
+		if (pe->msg_len > sizeof(out))
+			return 1;
+		memcpy(out, pe->msg, pe->msg_len);
+		olen = pe->msg_len;
+	}
+
+	if (olen != MSG_LEN || memcmp(out, want, MSG_LEN)) {
+		lwsl_err("%s: peer %d msg %d: wrong content (%u)\n", __func__,
+			 n, pe->msgs, (unsigned int)olen);
+		return 1;
+	}
+
+	if (++pe->msgs == expected_msgs(pe) && ++done == PEERS) {
+		interrupted = 1;
+		lws_cancel_service(context);
+	}
+
+	return 0;
+}
+
+static int
+peer_rx(struct peer *pe)
+{
+	size_t o = 0, hl, fl;
+	uint8_t *p;
+	char *e;
+
+	if (!pe->upgraded) {
+		pe->rx[pe->rx_len] = '\0';
+		e = strstr((char *)pe->rx, "\r\n\r\n");
+		if (!e)
+			return 0;
+		if (strncmp((char *)pe->rx, "HTTP/1.1 101", 12) ||
+		    !!strstr((char *)pe->rx, "permessage-deflate") !=
+								!!pe->offer) {
+			lwsl_err("%s: bad upgrade %s\n", __func__, pe->rx);
+			return 1;
+		}
+		pe->upgraded = 1;
+		o = (size_t)lws_ptr_diff(e, pe->rx) + 4;
+	}
+
+	while (pe->rx_len - o >= 2) {
+		p = pe->rx + o;
+		fl = p[1] & 0x7f;
+		hl = 2;
+		if (fl == 126)
+			hl = 4;
+		if (fl == 127)
+			hl = 10;
+		if (pe->rx_len - o < hl)
+			break;
+		if (fl == 126)
+			fl = lws_ser_ru16be(p + 2);
+		if (fl == 127)
+			fl = (size_t)lws_ser_ru64be(p + 2);
+		if (p[1] & 0x80 || fl > sizeof(pe->msg) - 4 - pe->msg_len) {
+			lwsl_err("%s: bad frame\n", __func__);
+			return 1;
+		}
+		if (pe->rx_len - o < hl + fl)
+			break;
+
+		if (!pe->frames) {
+			/* binary, RSV1 for a deflated message */
+			if ((p[0] & 0xf) != 2)
+				return 1;
+			pe->rsv1 = !!(p[0] & 0x40);
+		} else
+			/* continuation, no RSV1 */
+			if ((p[0] & 0x4f) != 0)
+				return 1;
+		pe->frames++;
+
+		memcpy(pe->msg + pe->msg_len, p + hl, fl);
+		pe->msg_len += fl;
+
+		if (p[0] & 0x80) {
+			if (peer_message(pe))
+				return 1;
+			pe->msg_len = 0;
+			pe->frames = 0;
+		}
+		o += hl + fl;
+	}
+
+	pe->rx_len -= o;
+	memmove(pe->rx, pe->rx + o, pe->rx_len);
+
+	return 0;
+}
+
+static int
+callback_raw(struct lws *wsi, enum lws_callback_reasons reason,
+	     void *user, void *in, size_t len)
+{
+	struct peer *pe = (struct peer *)lws_get_opaque_user_data(wsi);
+	char req[LWS_PRE + 512], *p = &req[LWS_PRE];
+	int n;
+
+	switch (reason) {
+	case LWS_CALLBACK_RAW_ADOPT:
+		lws_callback_on_writable(wsi);
+		break;
+
+	case LWS_CALLBACK_RAW_WRITEABLE:
+		n = lws_snprintf(p, sizeof(req) - LWS_PRE,
+			"GET /%d HTTP/1.1\r\n"
+			"Host: 127.0.0.1\r\n"
+			"Upgrade: websocket\r\n"
+			"Connection: Upgrade\r\n"
+			"Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+			"Sec-WebSocket-Version: 13\r\n"
+			"Sec-WebSocket-Protocol: bcast\r\n"
+			"%s%s%s\r\n", (int)(pe - peers),
+			pe->offer ? "Sec-WebSocket-Extensions: " : "",
+			pe->offer ? pe->offer : "", pe->offer ? "\r\n" : "");
+		if (lws_write(wsi, (uint8_t *)p, (size_t)n, LWS_WRITE_RAW) != n)
+			return -1;
+		break;
+
+	case LWS_CALLBACK_RAW_RX:
+		if (len > sizeof(pe->rx) - 1 - pe->rx_len) {
+			fail++;
+			return -1;
+		}
+		memcpy(pe->rx + pe->rx_len, in, len);
+		pe->rx_len += len;
+		if (peer_rx(pe)) {
+			fail++;
+			interrupted = 1;
+			return -1;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static struct lws_protocols protocols_server[] = {
+	{ "bcast", callback_bcast, 0, 0 },
+	{ NULL, NULL, 0, 0 } /* terminator */
+};
+
+static struct lws_protocols protocols_peer[] = {
+	{ "raw", callback_raw, 0, 0 },
+	{ NULL, NULL, 0, 0 } /* terminator */
+};
+
+static const struct lws_extension extensions[] = {
+	{
+		"permessage-deflate",
+		lws_extension_callback_pm_deflate,
+		"permessage-deflate"
+		 "; client_no_context_takeover"
+		 "; client_max_window_bits"
+	},
+	{ NULL, NULL, NULL /* terminator */ }
+};
+
+static void
+timeout_cb(lws_sorted_usec_list_t *sul)
+{
+	lwsl_err("%s: timed out at step %d\n", __func__, cursor);
+	fail++;
+	interrupted = 1;
+}
+
+void sigint_handler(int sig)
+{
+	interrupted = 1;
+}
+
+int
+main(int argc, const char **argv)
+{
+	int n = 0, logs = LLL_USER | LLL_ERR | LLL_WARN | LLL_NOTICE;
+	struct lws_context_creation_info info;
+	struct lws_vhost *vh, *vh_peer;
+	lws_sock_file_fd_type fd;
+	struct sockaddr_in sin;
+	const char *p;
+
+	signal(SIGINT, sigint_handler);
+
+	if ((p = lws_cmdline_option(argc, argv, "-d")))
+		logs = atoi(p);
+
+	lws_set_log_level(logs, NULL);
+	lwsl_user("LWS API selftest: ws broadcast\n");
+
+	fill(content[M1], 1);
+	fill(content[B], 2);
+
+	/* M1 to those that get it, the broadcast to all, then M3 to all */
+
+	for (n = 0; n < PEERS; n++)
+		if (peers[n].m1) {
+			script[script_len].peer = n;
+			script[script_len++].msg = M1;
+		}
+	for (n = 0; n < PEERS; n++) {
+		script[script_len].peer = n;
+		script[script_len++].msg = B;
+	}
+	for (n = 0; n < PEERS; n++) {
+		script[script_len].peer = n;
+		script[script_len++].msg = M3;
+	}
+
+	bcast = lws_ws_bcast_create(content[B], MSG_LEN, LWS_WRITE_BINARY);
+	if (!bcast) {
+		fail++;
+		goto bail1;
+	}
+
+	memset(&info, 0, sizeof info); /* otherwise uninitialized garbage */
+	info.options = LWS_SERVER_OPTION_EXPLICIT_VHOSTS;
+
+	context = lws_create_context(&info);
+	if (!context) {
+		lwsl_err("lws init failed\n");
+		fail++;
+		goto bail1;
+	}
+
+	info.port = 0; /* any free port */
+	info.iface = "127.0.0.1";
+	info.protocols = protocols_server;
+	info.extensions = extensions;
+	info.vhost_name = "server";
+
+	vh = lws_create_vhost(context, &info);
+	if (!vh) {
+		lwsl_err("%s: failed to create vhost\n", __func__);
+		fail++;
+		goto bail;
+	}
+
+	info.port = CONTEXT_PORT_NO_LISTEN;
+	info.iface = NULL;
+	info.protocols = protocols_peer;
+	info.extensions = NULL;
+	info.vhost_name = "peers";
+
+	vh_peer = lws_create_vhost(context, &info);
+	if (!vh_peer) {
+		lwsl_err("%s: failed to create vhost\n", __func__);
+		fail++;
+		goto bail;
+	}
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = htons((uint16_t)lws_get_vhost_listen_port(vh));
+
+	for (n = 0; n < PEERS; n++) {
+		if (peers[n].offer) {
+			if (inflateInit2(&peers[n].inf,
+					 peers[n].server_wbits ?
+					 -peers[n].server_wbits : -15) != Z_OK) {
+				fail++;
+				goto bail;
+			}
+			peers[n].inf_init = 1;
+		}
+
+		fd.sockfd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd.sockfd < 0 ||
+		    connect(fd.sockfd, (struct sockaddr *)&sin,
+			    sizeof(sin)) < 0) {
+			lwsl_err("%s: connect failed\n", __func__);
+			fail++;
+			goto bail;
+		}
+
+		peers[n].cwsi = lws_adopt_descriptor_vhost(vh_peer,
+					LWS_ADOPT_SOCKET, fd, "raw", NULL);
+		if (!peers[n].cwsi) {
+			fail++;
+			goto bail;
+		}
+		lws_set_opaque_user_data(peers[n].cwsi, &peers[n]);
+	}
+
+	lws_sul_schedule(context, 0, &sul_timeout, timeout_cb,
+			 5 * LWS_US_PER_SEC);
+
+	n = 0;
+	while (n >= 0 && !interrupted)
+		n = lws_service(context, 0);
+
+	lws_sul_schedule(context, 0, &sul_timeout, NULL,
+			 LWS_SET_TIMER_USEC_CANCEL);
+
+	if (done != PEERS)
+		fail++;
+
+bail:
+	lws_context_destroy(context);
+
+bail1:
+	lws_ws_bcast_unref(&bcast);
+	for (n = 0; n < PEERS; n++)
+		if (peers[n].inf_init)
+			inflateEnd(&peers[n].inf);
+
+	if (fail)
+		lwsl_user("Completed: FAIL (%d of %d peers)\n", done, PEERS);
+	else
+		lwsl_user("Completed: PASS\n");
+
+	return fail;
+}
@@ -60,6 +60,9 @@ static const struct lws_http_mount mount_ziptest = {
 	8,			/* strlen("/ziptest"), ie length of the mountpoint */
 	NULL,
 
+	0,			/* fastcgi_conns */
+	0,			/* fastcgi_queue */
+
 	{ NULL, NULL } // sentinel
 };
 
@@ -82,6 +85,9 @@ static const struct lws_http_mount mount_post = {
 	9,			/* strlen("/formtest"), ie length of the mountpoint */
 	NULL,
 
+	0,			/* fastcgi_conns */
+	0,			/* fastcgi_queue */
+
 	{ NULL, NULL } // sentinel
 };
 
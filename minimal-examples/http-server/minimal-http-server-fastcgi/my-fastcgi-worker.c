@@ -0,0 +1,214 @@
+/*
+ * lws-minimal-http-server-fastcgi-worker
+ *
+ * Written in 2010-2020 by Andy Green <andy@warmcat.com>
+ *
+ * This file is made available under the Creative Commons CC0 1.0
+ * Universal Public Domain Dedication.
+ *
+ * A tiny FastCGI responder that doesn't need any library.  As FastCGI
+ * expects of a spawned worker, it accept()s connections on the listening
+ * socket it was given as its stdin, and serves requests on each connection
+ * until the server closes it.
+ *
+ * It replies with the request method, uri and how much body it was sent, and
+ * how many requests this worker process has served so far.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define FCGI_BEGIN_REQUEST	1
+#define FCGI_END_REQUEST	3
+#define FCGI_PARAMS		4
+#define FCGI_STDIN		5
+#define FCGI_STDOUT		6
+#define FCGI_KEEP_CONN		1
+
+struct req {
+	char		method[16];
+	char		uri[256];
+	unsigned long	body;
+	int		id;
+	int		keep_conn;
+};
+
+static unsigned long served;
+
+static int
+read_all(int fd, uint8_t *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		n = read(fd, buf, len);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			return 1;
+		}
+		buf += n;
+		len -= (size_t)n;
+	}
+
+	return 0;
+}
+
+static int
+write_all(int fd, const uint8_t *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		n = write(fd, buf, len);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			return 1;
+		}
+		buf += n;
+		len -= (size_t)n;
+	}
+
+	return 0;
+}
+
+static int
+record(int fd, int type, int id, const void *buf, size_t len)
+{
+	uint8_t hdr[8] = { 1, (uint8_t)type, (uint8_t)(id >> 8), (uint8_t)id,
+			   (uint8_t)(len >> 8), (uint8_t)len, 0, 0 };
+
+	return write_all(fd, hdr, sizeof(hdr)) ||
+	       (len && write_all(fd, buf, len));
+}
+
+static size_t
+param_len(const uint8_t **p, const uint8_t *end)
+{
+	size_t n;
+
+	if (*p >= end)
+		return 0;
+	if (!(**p & 0x80))
+		return *(*p)++;
+	if (end - *p < 4)
+		return 0;
+
+	n = ((size_t)((*p)[0] & 0x7f) << 24) | ((size_t)(*p)[1] << 16) |
+	    ((size_t)(*p)[2] << 8) | (*p)[3];
+	*p += 4;
+
+	return n;
+}
+
+static void
+params(struct req *r, const uint8_t *p, size_t len)
+{
+	const uint8_t *end = p + len;
+	size_t nl, vl;
+
+	while (p < end) {
+		nl = param_len(&p, end);
+		vl = param_len(&p, end);
+		if ((size_t)(end - p) < nl + vl)
+			return;
+
+		if (nl == 14 && !memcmp(p, "REQUEST_METHOD", nl) &&
+		    vl < sizeof(r->method)) {
+			memcpy(r->method, p + nl, vl);
+			r->method[vl] = '\0';
+		}
+		if (nl == 11 && !memcmp(p, "REQUEST_URI", nl) &&
+		    vl < sizeof(r->uri)) {
+			memcpy(r->uri, p + nl, vl);
+			r->uri[vl] = '\0';
+		}
+		p += nl + vl;
+	}
+}
+
+static int
+respond(int fd, struct req *r)
+{
+	uint8_t end[8] = { 0 };
+	char body[512];
+	int n;
+
+	n = snprintf(body, sizeof(body),
+		     "Content-Type: text/plain\r\n\r\n"
+		     "FastCGI worker PID %d, request %lu\n"
+		     "%s %s, %lu body bytes\n", (int)getpid(), ++served,
+		     r->method, r->uri, r->body);
+
+	/* the request completed with appStatus 0, FCGI_REQUEST_COMPLETE */
+
+	return record(fd, FCGI_STDOUT, r->id, body, (size_t)n) ||
+	       record(fd, FCGI_STDOUT, r->id, NULL, 0) ||
+	       record(fd, FCGI_END_REQUEST, r->id, end, sizeof(end));
+}
+
+/* serve requests on one connection until it's closed */
+
+static void
+serve(int fd)
+{
+	uint8_t hdr[8], buf[65536 + 256];
+	struct req r;
+	size_t len;
+
+	memset(&r, 0, sizeof(r));
+
+	while (!read_all(fd, hdr, sizeof(hdr))) {
+		len = ((size_t)hdr[4] << 8) | hdr[5];
+		if (read_all(fd, buf, len + hdr[6]))
+			return;
+
+		switch (hdr[1]) {
+		case FCGI_BEGIN_REQUEST:
+			memset(&r, 0, sizeof(r));
+			r.id = (hdr[2] << 8) | hdr[3];
+			r.keep_conn = len >= 3 && (buf[2] & FCGI_KEEP_CONN);
+			break;
+		case FCGI_PARAMS:
+			params(&r, buf, len);
+			break;
+		case FCGI_STDIN:
+			r.body += len;
+			if (len)
+				break;
+			/* the body is complete, so is the request */
+			if (respond(fd, &r) || !r.keep_conn)
+				return;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+int main(void)
+{
+	int fd;
+
+	fprintf(stderr, "FastCGI worker PID %d starting\n", (int)getpid());
+
+	while (1) {
+		fd = accept(0, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "accept failed, errno %d\n", errno);
+			return 1;
+		}
+
+		serve(fd);
+		close(fd);
+	}
+}
@@ -0,0 +1,103 @@
+/*
+ * lws-minimal-secure-streams-policy2bin
+ *
+ * Written in 2010-2020 by Andy Green <andy@warmcat.com>
+ *
+ * This file is made available under the Creative Commons CC0 1.0
+ * Universal Public Domain Dedication.
+ *
+ *
+ * This compiles a JSON secure streams policy into the binary policy format,
+ * which a context can map and use directly via info.pss_policies_bin instead
+ * of parsing the JSON at startup.
+ *
+ * After writing it, the binary policy is checked by creating a context that
+ * uses it.
+ */
+
+#include <libwebsockets.h>
+#include <string.h>
+#include <fcntl.h>
+#if !defined(WIN32)
+#include <unistd.h>
+#endif
+
+int
+main(int argc, const char **argv)
+{
+	struct lws_context_creation_info info;
+	const char *in = NULL, *out = NULL, *p;
+	struct lws_context *context;
+	char *json = NULL;
+	int fd, n, ret = 1;
+	ssize_t len = 0;
+
+	lws_set_log_level(LLL_USER | LLL_ERR | LLL_WARN | LLL_NOTICE, NULL);
+	lwsl_user("LWS secure streams policy to binary policy [-d<verb>] "
+		  "-i <policy.json> -o <policy.bin>\n");
+
+	if ((p = lws_cmdline_option(argc, argv, "-d")))
+		lws_set_log_level(atoi(p), NULL);
+	in = lws_cmdline_option(argc, argv, "-i");
+	out = lws_cmdline_option(argc, argv, "-o");
+	if (!in || !out) {
+		lwsl_err("need -i and -o\n");
+		return 1;
+	}
+
+	/* the policy file is small, read it in one go */
+
+	fd = lws_open(in, O_RDONLY);
+	if (fd < 0) {
+		lwsl_err("unable to open %s\n", in);
+		return 1;
+	}
+	len = lseek(fd, 0, SEEK_END);
+	if (len > 0 && lseek(fd, 0, SEEK_SET) == 0)
+		json = malloc((size_t)len);
+	if (json && read(fd, json, (size_t)len) != len) {
+		free(json);
+		json = NULL;
+	}
+	close(fd);
+	if (!json) {
+		lwsl_err("unable to read %s\n", in);
+		return 1;
+	}
+
+	memset(&info, 0, sizeof info); /* otherwise uninitialized garbage */
+	info.port = CONTEXT_PORT_NO_LISTEN;
+	info.options = LWS_SERVER_OPTION_EXPLICIT_VHOSTS |
+		       LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+
+	context = lws_create_context(&info);
+	if (!context) {
+		lwsl_err("lws init failed\n");
+		goto bail;
+	}
+
+	n = lws_ss_policy_compile(context, json, (size_t)len, out);
+	lws_context_destroy(context);
+	if (n) {
+		lwsl_err("policy compile failed\n");
+		goto bail;
+	}
+
+	/* confirm a context can come up using just the binary policy */
+
+	info.pss_policies_bin = out;
+	context = lws_create_context(&info);
+	if (!context) {
+		lwsl_err("context creation from %s failed\n", out);
+		goto bail;
+	}
+	lws_context_destroy(context);
+
+	ret = 0;
+
+bail:
+	free(json);
+	lwsl_user("Completed: %s\n", ret ? "FAIL" : "OK");
+
+	return ret;
+}
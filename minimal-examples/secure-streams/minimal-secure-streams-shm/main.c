@@ -0,0 +1,442 @@
+/*
+ * lws-minimal-secure-streams-shm
+ *
+ * Written in 2010-2020 by Andy Green <andy@warmcat.com>
+ *
+ * This file is made available under the Creative Commons CC0 1.0
+ * Universal Public Domain Dedication.
+ *
+ *
+ * This runs a Secure Streams proxy and a client of it in two processes, with
+ * the client asking for its stream to be carried in shared memory rings.
+ *
+ * The proxy process also serves ws on localhost, and the stream receives a
+ * generated payload from there that is many times bigger than the rings.  It
+ * comes in ws messages as big as the serialization framing allows, which the
+ * proxy reads whole, so the rings must hold frames larger than 64KiB.
+ *
+ * The client checks every byte of the payload arrives in order, that it came
+ * through the shared memory rings and not the proxy socket, and that asking
+ * for rings too small for the biggest frames is refused.
+ */
+
+#include <libwebsockets.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <string.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define WS_PORT		7693
+#define RING_SIZE	(128 * 1024)
+/* ws messages whose payload frames are as big as the 16-bit length allows */
+#define MSG_LEN		(0xffff - 16)
+#define PAYLOAD_LEN	(16 * MSG_LEN)
+
+static int interrupted, bad = 1;
+static struct lws_context *context;
+static lws_state_notify_link_t nl;
+static lws_sorted_usec_list_t sul_timeout, sul_child;
+static pid_t child;
+static int proxy;
+
+static const char * const proxy_bind = "@lws-minimal-ss-shm",
+		  * const client_bind = "+@lws-minimal-ss-shm";
+
+static const char * const default_ss_policy =
+	"{"
+	  "\"release\":"			"\"01234567\","
+	  "\"product\":"			"\"myproduct\","
+	  "\"schema-version\":"			"1,"
+	  "\"retry\": ["
+		"{\"default\": {"
+			"\"backoff\": ["	 "1000,"
+						 "2000"
+				"],"
+			"\"conceal\":"		"2,"
+			"\"jitterpc\":"		"20,"
+			"\"svalidping\":"	"30,"
+			"\"svalidhup\":"	"35"
+		"}}"
+	  "],"
+	  "\"s\": ["
+		"{\"shmtest\": {"
+			"\"endpoint\":"		"\"127.0.0.1\","
+			"\"port\":"		"7693,"
+			"\"protocol\":"		"\"ws\","
+			"\"http_url\":"		"\"payload\","
+			"\"ws_subprotocol\":"	"\"lws-minimal-ss-shm\","
+			"\"ws_binary\":"		"true,"
+			"\"tls\":"		"false,"
+			"\"opportunistic\":"	"true,"
+			"\"retry\":"		"\"default\""
+		"}}"
+	  "]"
+	"}"
+;
+
+/* the payload is not a repeat of anything a power of two long */
+
+static uint8_t
+payload_byte(size_t pos)
+{
+	return (uint8_t)((pos % 251) ^ (pos >> 16));
+}
+
+/*
+ * Proxy process: serve the payload over ws on localhost.
+ *
+ * The proxy doesn't hold off reading the onward stream when it can't pass it
+ * to the client fast enough, so the payload is sent at a pace the client can
+ * keep up with.
+ */
+
+struct pss_ws {
+	lws_sorted_usec_list_t	sul;
+	struct lws		*wsi;
+	size_t			pos;
+};
+
+static void
+sul_ws_cb(lws_sorted_usec_list_t *sul)
+{
+	struct pss_ws *pss = lws_container_of(sul, struct pss_ws, sul);
+
+	lws_callback_on_writable(pss->wsi);
+}
+
+static int
+callback_ws(struct lws *wsi, enum lws_callback_reasons reason, void *user,
+	    void *in, size_t len)
+{
+	struct pss_ws *pss = (struct pss_ws *)user;
+	uint8_t buf[LWS_PRE + MSG_LEN], *start = &buf[LWS_PRE];
+	size_t n;
+
+	switch (reason) {
+	case LWS_CALLBACK_ESTABLISHED:
+		pss->wsi = wsi;
+		pss->pos = 0;
+		lws_callback_on_writable(wsi);
+		break;
+
+	case LWS_CALLBACK_SERVER_WRITEABLE:
+		if (pss->pos == PAYLOAD_LEN)
+			break;
+
+		for (n = 0; n < MSG_LEN; n++)
+			start[n] = payload_byte(pss->pos + n);
+		pss->pos += MSG_LEN;
+
+		if (lws_write(wsi, start, MSG_LEN, LWS_WRITE_BINARY) !=
+								(int)MSG_LEN)
+			return -1;
+
+		lws_sul_schedule(lws_get_context(wsi), 0, &pss->sul,
+				 sul_ws_cb, 20 * LWS_US_PER_MS);
+		break;
+
+	case LWS_CALLBACK_CLOSED:
+		lws_sul_schedule(lws_get_context(wsi), 0, &pss->sul, NULL,
+				 LWS_SET_TIMER_USEC_CANCEL);
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static const struct lws_protocols ws_protocols[] = {
+	{ "http", lws_callback_http_dummy, 0, 0, 0, NULL, 0 },
+	{ "lws-minimal-ss-shm", callback_ws, sizeof(struct pss_ws), 0, 0,
+	  NULL, 0 },
+	{ NULL, NULL, 0, 0, 0, NULL, 0 }
+};
+
+static void
+sul_child_cb(lws_sorted_usec_list_t *sul)
+{
+	int status;
+
+	/* reap the client when it finished and take its result */
+
+	if (waitpid(child, &status, WNOHANG) == child) {
+		child = 0;
+		bad = !WIFEXITED(status) || WEXITSTATUS(status);
+		interrupted = 1;
+
+		return;
+	}
+
+	lws_sul_schedule(context, 0, &sul_child, sul_child_cb,
+			 100 * LWS_US_PER_MS);
+}
+
+static int
+proxy_state_nf(lws_state_manager_t *mgr, lws_state_notify_link_t *link,
+	       int current, int target)
+{
+	struct lws_context *cx = lws_system_context_from_system_mgr(mgr);
+
+	if (target == LWS_SYSTATE_OPERATIONAL &&
+	    current == LWS_SYSTATE_OPERATIONAL &&
+	    lws_ss_proxy_create(cx, proxy_bind, 0)) {
+		lwsl_err("%s: failed to create ss proxy\n", __func__);
+
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Client process: take the payload through the proxy and check it
+ */
+
+typedef struct myss {
+	struct lws_sspc_handle		*ss;
+	void				*opaque_data;
+
+	size_t				rx;
+	size_t				biggest;
+	int				errors;
+} myss_t;
+
+/* the proxy's memfd for the rings should be mapped in this process */
+
+static int
+rings_mapped(void)
+{
+	FILE *f = fopen("/proc/self/maps", "r");
+	char line[512];
+	int found = 0;
+
+	if (!f)
+		return 0;
+
+	while (!found && fgets(line, sizeof(line), f))
+		found = !!strstr(line, "lws-ss-shm");
+
+	fclose(f);
+
+	return found;
+}
+
+static int
+myss_rx(void *userobj, const uint8_t *buf, size_t len, int flags)
+{
+	myss_t *m = (myss_t *)userobj;
+	size_t n;
+
+	if (len > m->biggest)
+		m->biggest = len;
+
+	for (n = 0; n < len && !m->errors; n++)
+		if (m->rx + n >= PAYLOAD_LEN ||
+		    buf[n] != payload_byte(m->rx + n)) {
+			lwsl_err("%s: payload differs at %u\n", __func__,
+				 (unsigned int)(m->rx + n));
+			m->errors++;
+		}
+	m->rx += len;
+
+	if (m->rx < PAYLOAD_LEN)
+		return 0;
+
+	lwsl_user("%s: %u bytes, biggest %u\n", __func__,
+		  (unsigned int)m->rx, (unsigned int)m->biggest);
+
+	if (m->rx != PAYLOAD_LEN)
+		lwsl_err("%s: expected %u bytes\n", __func__,
+			 (unsigned int)PAYLOAD_LEN);
+	else if (!rings_mapped())
+		lwsl_err("%s: payload didn't come over shm\n", __func__);
+	else if (!m->errors)
+		bad = 0;
+
+	interrupted = 1;
+
+	return 0;
+}
+
+static int
+myss_tx(void *userobj, lws_ss_tx_ordinal_t ord, uint8_t *buf, size_t *len,
+	int *flags)
+{
+	return 1;
+}
+
+static int
+myss_state(void *userobj, void *sh, lws_ss_constate_t state,
+	   lws_ss_tx_ordinal_t ack)
+{
+	myss_t *m = (myss_t *)userobj;
+
+	lwsl_info("%s: %s, ord 0x%x\n", __func__, lws_ss_state_name(state),
+		  (unsigned int)ack);
+
+	switch (state) {
+	case LWSSSCS_CREATING:
+		lws_sspc_client_connect(m->ss);
+		break;
+	case LWSSSCS_ALL_RETRIES_FAILED:
+	case LWSSSCS_DISCONNECTED:
+		interrupted = 1;
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static int
+client_state_nf(lws_state_manager_t *mgr, lws_state_notify_link_t *link,
+		int current, int target)
+{
+	struct lws_context *cx = lws_system_context_from_system_mgr(mgr);
+	lws_ss_info_t ssi;
+
+	if (target != LWS_SYSTATE_OPERATIONAL ||
+	    current != LWS_SYSTATE_OPERATIONAL)
+		return 0;
+
+	memset(&ssi, 0, sizeof(ssi));
+	ssi.handle_offset = offsetof(myss_t, ss);
+	ssi.opaque_user_data_offset = offsetof(myss_t, opaque_data);
+	ssi.rx = myss_rx;
+	ssi.tx = myss_tx;
+	ssi.state = myss_state;
+	ssi.user_alloc = sizeof(myss_t);
+	ssi.streamtype = "shmtest";
+
+	/* rings that can't hold the biggest frames must be refused */
+
+	ssi.proxy_shm_ring_size = 64 * 1024;
+	if (!lws_sspc_create(cx, 0, &ssi, NULL, NULL, NULL, NULL)) {
+		lwsl_err("%s: accepted too small a ring\n", __func__);
+
+		return -1;
+	}
+
+	ssi.proxy_shm_ring_size = RING_SIZE;
+	if (lws_sspc_create(cx, 0, &ssi, NULL, NULL, NULL, NULL)) {
+		lwsl_err("%s: failed to create secure stream\n", __func__);
+
+		return -1;
+	}
+
+	return 0;
+}
+
+static lws_state_notify_link_t * const app_notifier_list[] = {
+	&nl, NULL
+};
+
+static void
+sul_timeout_cb(lws_sorted_usec_list_t *sul)
+{
+	lwsl_err("%s: timed out\n", __func__);
+	interrupted = 1;
+}
+
+static void
+sigint_handler(int sig)
+{
+	interrupted = 1;
+}
+
+int main(int argc, const char **argv)
+{
+	int n = 0, logs = LLL_USER | LLL_ERR | LLL_WARN;
+	struct lws_context_creation_info info;
+	const char *p;
+
+	signal(SIGINT, sigint_handler);
+
+	if ((p = lws_cmdline_option(argc, argv, "-d")))
+		logs = atoi(p);
+
+	lws_set_log_level(logs, NULL);
+	lwsl_user("LWS secure streams shm [-d<verb>]\n");
+
+	memset(&info, 0, sizeof info); /* otherwise uninitialized garbage */
+	info.port = CONTEXT_PORT_NO_LISTEN;
+	info.fd_limit_per_thread = 1 + 6 + 1;
+	info.register_notifier_list = app_notifier_list;
+	nl.name = "app";
+
+	/* the client retries connecting until the proxy is up */
+
+	child = fork();
+	if (child < 0) {
+		lwsl_err("%s: fork failed\n", __func__);
+		return 1;
+	}
+
+	if (!child) {
+		info.protocols = lws_sspc_protocols;
+		info.ss_proxy_bind = client_bind;
+		nl.notify_cb = client_state_nf;
+
+		context = lws_create_context(&info);
+		if (!context) {
+			lwsl_err("lws init failed\n");
+			return 1;
+		}
+	} else {
+		struct lws_vhost *vh;
+
+		proxy = 1;
+		info.options = LWS_SERVER_OPTION_EXPLICIT_VHOSTS;
+		info.pss_policies_json = default_ss_policy;
+		/* the onward ws stream reads whole messages into this */
+		info.pt_serv_buf_size = MSG_LEN;
+		nl.notify_cb = proxy_state_nf;
+
+		context = lws_create_context(&info);
+		if (!context) {
+			lwsl_err("lws init failed\n");
+			kill(child, SIGTERM);
+			return 1;
+		}
+
+		info.port = WS_PORT;
+		info.iface = "127.0.0.1";
+		info.vhost_name = "localhost";
+		info.protocols = ws_protocols;
+		vh = lws_create_vhost(context, &info);
+		if (!vh) {
+			lwsl_err("%s: failed to create ws vhost\n", __func__);
+			kill(child, SIGTERM);
+			interrupted = 1;
+		}
+
+		lws_sul_schedule(context, 0, &sul_child, sul_child_cb,
+				 100 * LWS_US_PER_MS);
+	}
+
+	lws_sul_schedule(context, 0, &sul_timeout, sul_timeout_cb,
+			 20 * LWS_US_PER_SEC);
+
+	while (n >= 0 && !interrupted)
+		n = lws_service(context, 0);
+
+	lws_context_destroy(context);
+
+	if (proxy) {
+		/* the proxy only passes if the client did */
+		if (child) {
+			kill(child, SIGTERM);
+			waitpid(child, NULL, 0);
+			bad = 1;
+		}
+		lwsl_user("Completed: %s\n", bad ? "FAIL" : "PASS");
+	}
+
+	return bad;
+}
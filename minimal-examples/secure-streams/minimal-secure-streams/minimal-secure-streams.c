@@ -359,6 +359,9 @@ int main(int argc, const char **argv)
 	info.pss_policies_json = default_ss_policy;
 	info.options = LWS_SERVER_OPTION_EXPLICIT_VHOSTS |
 		       LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+
+	/* use a precompiled binary policy if we can, else the JSON one */
+	info.pss_policies_bin = lws_cmdline_option(argc, argv, "-b");
 #endif
 #if defined(LWS_WITH_DETAILED_LATENCY)
 	info.detailed_latency_cb = lws_det_lat_plot_cb;
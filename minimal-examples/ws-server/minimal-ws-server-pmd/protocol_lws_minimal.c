@@ -9,6 +9,10 @@
  * This version holds a single message at a time, which may be lost if a new
  * message comes.  See the minimal-ws-server-ring sample for the same thing
  * but using an lws_ring ringbuffer to hold up to 8 messages at a time.
+ *
+ * The message is held as an lws_ws_bcast, so it is framed, and deflated for
+ * the client_no_context_takeover connections, once for everybody rather than
+ * once per connection.
  */
 
 #if !defined (LWS_PLUGIN_STATIC)
@@ -19,13 +23,6 @@
 
 #include <string.h>
 
-/* one of these created for each message */
-
-struct msg {
-	void *payload; /* is malloc'd */
-	size_t len;
-};
-
 /* one of these is created for each client connecting to us */
 
 struct per_session_data__minimal {
@@ -43,22 +40,10 @@ struct per_vhost_data__minimal {
 
 	struct per_session_data__minimal *pss_list; /* linked-list of live pss*/
 
-	struct msg amsg; /* the one pending message... */
+	struct lws_ws_bcast *amsg; /* the one pending message... */
 	int current; /* the current message number we are caching */
 };
 
-/* destroys the message when everyone has had a copy of it */
-
-static void
-__minimal_destroy_message(void *_msg)
-{
-	struct msg *msg = _msg;
-
-	free(msg->payload);
-	msg->payload = NULL;
-	msg->len = 0;
-}
-
 static int
 callback_minimal(struct lws *wsi, enum lws_callback_reasons reason,
 			void *user, void *in, size_t len)
@@ -81,6 +66,11 @@ callback_minimal(struct lws *wsi, enum lws_callback_reasons reason,
 		vhd->vhost = lws_get_vhost(wsi);
 		break;
 
+	case LWS_CALLBACK_PROTOCOL_DESTROY:
+		if (vhd)
+			lws_ws_bcast_unref(&vhd->amsg);
+		break;
+
 	case LWS_CALLBACK_ESTABLISHED:
 		/* add ourselves to the list of live pss held in the vhd */
 		pss->pss_list = vhd->pss_list;
@@ -101,16 +91,15 @@ callback_minimal(struct lws *wsi, enum lws_callback_reasons reason,
 		break;
 
 	case LWS_CALLBACK_SERVER_WRITEABLE:
-		if (!vhd->amsg.payload)
+		if (!vhd->amsg)
 			break;
 
 		if (pss->last == vhd->current)
 			break;
 
-		/* notice we allowed for LWS_PRE in the payload already */
-		m = lws_write(wsi, ((unsigned char *)vhd->amsg.payload) +
-			      LWS_PRE, vhd->amsg.len, LWS_WRITE_TEXT);
-		if (m < (int)vhd->amsg.len) {
+		/* the frame, and maybe deflated frame, are shared by everyone */
+		m = lws_ws_bcast_write(wsi, vhd->amsg);
+		if (m < 0) {
 			lwsl_err("ERROR %d writing to ws socket\n", m);
 			return -1;
 		}
@@ -119,18 +108,15 @@ callback_minimal(struct lws *wsi, enum lws_callback_reasons reason,
 		break;
 
 	case LWS_CALLBACK_RECEIVE:
-		if (vhd->amsg.payload)
-			__minimal_destroy_message(&vhd->amsg);
+		/* anybody who didn't get the last one yet will miss it */
+		lws_ws_bcast_unref(&vhd->amsg);
 
-		vhd->amsg.len = len;
-		/* notice we over-allocate by LWS_PRE */
-		vhd->amsg.payload = malloc(LWS_PRE + len);
-		if (!vhd->amsg.payload) {
+		vhd->amsg = lws_ws_bcast_create(in, len, LWS_WRITE_TEXT);
+		if (!vhd->amsg) {
 			lwsl_user("OOM: dropping\n");
 			break;
 		}
 
-		memcpy((char *)vhd->amsg.payload + LWS_PRE, in, len);
 		vhd->current++;
 
 		/*
@@ -24,7 +24,7 @@
 /* one of these created for each message */
 
 struct msg {
-	void *payload; /* is malloc'd */
+	struct lws_refbuf *rb; /* refcounted, with LWS_PRE before payload */
 	size_t len;
 };
 
@@ -142,8 +142,8 @@ __minimal_destroy_message(void *_msg)
 {
 	struct msg *msg = _msg;
 
-	free(msg->payload);
-	msg->payload = NULL;
+	/* connections still sending it hold their own reference */
+	lws_refbuf_unref(&msg->rb);
 	msg->len = 0;
 }
 
@@ -202,9 +202,11 @@ callback_minimal(struct lws *wsi, enum lws_callback_reasons reason,
 		if (!pmsg)
 			break;
 
-		/* notice we allowed for LWS_PRE in the payload already */
-		m = lws_write(wsi, ((unsigned char *)pmsg->payload) +
-			      LWS_PRE, pmsg->len, LWS_WRITE_TEXT);
+		/*
+		 * the refbuf already allowed for LWS_PRE, and anything that
+		 * can't be sent right now is queued as a reference on it
+		 */
+		m = lws_write_refbuf(wsi, pmsg->rb, LWS_WRITE_TEXT);
 		if (m < (int)pmsg->len) {
 			lwsl_err("ERROR %d writing to ws socket\n", m);
 			return -1;
@@ -239,15 +241,13 @@ callback_minimal(struct lws *wsi, enum lws_callback_reasons reason,
 		lwsl_user("LWS_CALLBACK_RECEIVE: free space %d\n", n);
 
 		amsg.len = len;
-		/* notice we over-allocate by LWS_PRE... */
-		amsg.payload = malloc(LWS_PRE + len);
-		if (!amsg.payload) {
+		/* one copy of the payload, shared by every subscriber */
+		amsg.rb = lws_refbuf_create(in, len);
+		if (!amsg.rb) {
 			lwsl_user("OOM: dropping\n");
 			break;
 		}
 
-		/* ...and we copy the payload in at +LWS_PRE */
-		memcpy((char *)amsg.payload + LWS_PRE, in, len);
 		if (!lws_ring_insert(vhd->ring, &amsg, 1)) {
 			__minimal_destroy_message(&amsg);
 			lwsl_user("dropping!\n");
@@ -68,6 +68,7 @@ struct conn {
 	char rx_enabled[2];
 	char closed[2];
 	char established[2];
+	char spliced;
 };
 
 struct raw_pss {
@@ -80,6 +81,7 @@ struct raw_vhd {
 	char addr[128];
 	uint16_t port;
 	char ipv6;
+	char splice;
 };
 
 static void
@@ -165,6 +167,34 @@ flow_control(struct conn *conn, int side, int enable)
 	return 0;
 }
 
+/*
+ * Once both sides are up and nothing is queued in either direction, we can
+ * let lws splice plain tcp tunnels in the kernel instead of passing the data
+ * through the rings.  Until then, or if that's not possible, eg because of
+ * TLS, we carry on as usual.
+ */
+
+static void
+try_splice(struct raw_vhd *vhd, struct conn *conn)
+{
+	if (!vhd->splice || conn->spliced ||
+	    !conn->established[ACC] || !conn->established[ONW] ||
+	    conn->closed[ACC] || conn->closed[ONW] ||
+	    lws_ring_get_element(conn->r[ACC], &conn->t[ACC]) ||
+	    lws_ring_get_element(conn->r[ONW], &conn->t[ONW]))
+		return;
+
+	/* the splice does its own flow control from here */
+	if (flow_control(conn, ACC, 1) || flow_control(conn, ONW, 1))
+		return;
+
+	if (lws_raw_proxy_splice(conn->wsi[ACC], conn->wsi[ONW]))
+		return;
+
+	conn->spliced = 1;
+	lwsl_info("%s: tunnel spliced\n", __func__);
+}
+
 static int
 callback_raw_proxy(struct lws *wsi, enum lws_callback_reasons reason,
 		   void *user, void *in, size_t len)
@@ -231,6 +261,11 @@ callback_raw_proxy(struct lws *wsi, enum lws_callback_reasons reason,
 		} else
 			lws_strncpy(vhd->addr, ts.token, sizeof(vhd->addr));
 
+		/* splice plain tcp tunnels unless told not to */
+		vhd->splice = 1;
+		if (!lws_pvo_get_str(in, "splice", &cp))
+			vhd->splice = !!atoi(cp);
+
 		lwsl_notice("%s: vh %s: onward %s:%s:%d\n", __func__,
 			    lws_get_vhost_name(lws_get_vhost(wsi)),
 			    vhd->ipv6 ? "ipv6": "ipv4", vhd->addr, vhd->port);
@@ -253,18 +288,30 @@ bad_onward:
 
         case LWS_CALLBACK_RAW_PROXY_CLI_ADOPT:
 		lwsl_debug("%s: %p: LWS_CALLBACK_RAW_CLI_ADOPT: pss %p\n", __func__, wsi, pss);
-		if (conn || !pss)
+		if (!pss)
 			break;
+		if (conn) {
+			/*
+			 * we hear about it again when the connection is really
+			 * up, our next WRITEABLE can start passing data
+			 */
+			lws_callback_on_writable(wsi);
+			break;
+		}
 		conn = pss->conn = lws_get_opaque_user_data(wsi);
 		if (!conn)
 			break;
 		conn->established[ONW] = 1;
-		/* they start enabled */
-		conn->rx_enabled[ACC] = 1;
+		/* he starts enabled */
 		conn->rx_enabled[ONW] = 1;
 
-		/* he disabled his rx while waiting for use to be established */
-		flow_control(conn, ACC, 1);
+		/*
+		 * he disabled his rx while waiting for use to be established...
+		 * if we may splice, leave it until our first WRITEABLE, when
+		 * we are really connected, so nothing is in the rings then
+		 */
+		if (!vhd->splice)
+			flow_control(conn, ACC, 1);
 
 		lws_callback_on_writable(wsi);
 		lws_set_timeout(wsi, NO_PENDING_TIMEOUT, 0);
@@ -329,6 +376,9 @@ bad_onward:
 		if (!ppkt) {
 			lwsl_info("%s: CLI_WRITABLE had nothing in acc ring\n",
 				  __func__);
+			try_splice(vhd, conn);
+			/* if we didn't splice, we can start taking his rx */
+			flow_control(conn, ACC, 1);
 			break;
 		}
 
@@ -379,6 +429,10 @@ bad_onward:
 
 			if (lws_ring_get_element(conn->r[ONW], &conn->t[ONW]))
 				lws_callback_on_writable(conn->wsi[ACC]);
+
+			/* when it has all gone out, see if we can splice */
+			if (!ppkt && vhd->splice && !conn->spliced)
+				lws_callback_on_writable(wsi);
 		}
 		break;
 
@@ -413,8 +467,10 @@ bad_onward:
 		}
 
 		conn->established[ACC] = 1;
+		/* he starts enabled... */
+		conn->rx_enabled[ACC] = 1;
 
-		/* disable any rx until the client side is up */
+		/* ...disable any rx until the client side is up */
 		flow_control(conn, ACC, 0);
 
 		lws_set_timeout(wsi, NO_PENDING_TIMEOUT, 0);
@@ -486,6 +542,7 @@ bad_onward:
 		if (!ppkt) {
 			lwsl_info("%s: SRV_WRITABLE nothing in onw ring\n",
 				  __func__);
+			try_splice(vhd, conn);
 			break;
 		}
 
@@ -536,8 +593,12 @@ bad_onward:
 				 */
 				return lws_raw_transaction_completed(wsi);
 
-		if (lws_ring_get_element(conn->r[ACC], &conn->t[ACC]))
-			lws_callback_on_writable(conn->wsi[ONW]);
+			if (lws_ring_get_element(conn->r[ACC], &conn->t[ACC]))
+				lws_callback_on_writable(conn->wsi[ONW]);
+
+			/* when it has all gone out, see if we can splice */
+			if (!ppkt && vhd->splice && !conn->spliced)
+				lws_callback_on_writable(wsi);
 		}
 		break;
 
@@ -238,6 +238,9 @@ static const struct lws_http_mount mount_ziptest = {
 	8,			/* strlen("/ziptest"), ie length of the mountpoint */
 	NULL,
 
+	0,			/* fastcgi_conns */
+	0,			/* fastcgi_queue */
+
 	{ NULL, NULL } // sentinel
 };
 
@@ -260,6 +263,9 @@ static const struct lws_http_mount mount_post = {
 	9,			/* strlen("/formtest"), ie length of the mountpoint */
 	NULL,
 
+	0,			/* fastcgi_conns */
+	0,			/* fastcgi_queue */
+
 	{ NULL, NULL } // sentinel
 };
 
@@ -288,6 +294,9 @@ static const struct lws_http_mount mount = {
 	1,		/* strlen("/"), ie length of the mountpoint */
 	NULL,
 
+	0,			/* fastcgi_conns */
+	0,			/* fastcgi_queue */
+
 	{ NULL, NULL } // sentinel
 };
 